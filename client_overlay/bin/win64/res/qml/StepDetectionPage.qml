@@ -28,6 +28,8 @@ MyMainViewPage {
         stepControlBox.updateGUI()
         stepThresholdBox.updateGUI()    
         stepDetectionEnableToggle.checked = WalkInPlaceTabController.isStepDetectionEnabled()
+        driverStepDetectionToggle.checked = WalkInPlaceTabController.getUseDriverStepDetection()
+        poseRecordingToggle.checked = WalkInPlaceTabController.isPoseRecording()
         gameTypeDialog.currentIndex = WalkInPlaceTabController.getGameType()
         hmdTypeDialog.currentIndex = WalkInPlaceTabController.getHMDType()
         controlSelect.currentIndex = WalkInPlaceTabController.getControlSelect()
@@ -254,6 +256,28 @@ MyMainViewPage {
                         }
                     }
                 }
+
+                GridLayout {
+                    columns: 1
+
+                    MyToggleButton {
+                        id: driverStepDetectionToggle
+                        text: "Detect steps in driver (touchpad/thumbstick only)"
+                        Layout.fillWidth: true
+                        onCheckedChanged: {
+                            WalkInPlaceTabController.setUseDriverStepDetection(checked)
+                        }
+                    }
+
+                    MyToggleButton {
+                        id: poseRecordingToggle
+                        text: "Record pose session"
+                        Layout.fillWidth: true
+                        onCheckedChanged: {
+                            WalkInPlaceTabController.setPoseRecording(checked)
+                        }
+                    }
+                }
             }
         }
 
@@ -15,7 +15,16 @@
 #include <openvr.h>
 #include <iostream>
 #include <fstream>
+#include <binarylog.h>
+#include <vrwalkinplace.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
 #include "logging.h"
+#include "posereplay.h"
+#include "tabcontrollers/TrackingSource.h"
+#include <ipc_stub_server.h>
 
 
 /*
@@ -108,6 +117,136 @@ void removeManifest() {
 }
 
 
+// Prints the driver's statistics page (see ipc_stats.h) every intervalMs, rates and latencies cover the last interval
+void printIpcStats(std::ostream& out, uint32_t intervalMs, uint32_t sampleCount) {
+	vrwalkinplace::StatsReader reader;
+	reader.open();
+	vrwalkinplace::ipc::StatsSnapshot last;
+	reader.sample(last);
+	auto printHistogram = [&out](const char* name, const vrwalkinplace::ipc::StatsHistogramSnapshot& h) {
+		out << "  " << name << ": " << h.count << " samples, avg " << h.averageUs() << " us, p50 < " << h.percentileUs(0.5)
+			<< " us, p99 < " << h.percentileUs(0.99) << " us, max " << h.maxUs << " us (since start)" << std::endl;
+	};
+	for (uint32_t n = 0; sampleCount == 0 || n < sampleCount; ++n) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+		vrwalkinplace::ipc::StatsSnapshot current;
+		reader.sample(current);
+		double seconds = (double)(current.sampleTimeUs - last.sampleTimeUs) / 1000000.0;
+		out << "--- " << (current.sampleTimeUs - current.startTimeUs) / 1000000 << " s since driver start ---" << std::endl;
+		for (uint32_t t = 0; t < IPC_STATS_REQUESTTYPE_COUNT; ++t) {
+			auto count = current.requests[t] - last.requests[t];
+			if (count > 0) {
+				out << "  " << vrwalkinplace::ipc::requestTypeName((vrwalkinplace::ipc::RequestType)t) << ": " << count / seconds << " /s" << std::endl;
+			}
+		}
+		out << "  server queue: depth " << current.messageQueueDepth << ", high water " << current.messageQueueHighWater << std::endl;
+		out << "  shm ring: depth " << current.shmRingDepth << ", high water " << current.shmRingHighWater << std::endl;
+		out << "  output queue: high water " << current.outputQueueHighWater << ", dropped " << current.outputQueueDropped << std::endl;
+		out << "  injections: " << (current.buttonInjections - last.buttonInjections) / seconds << " button/s, "
+			<< (current.axisInjections - last.axisInjections) / seconds << " axis/s, " << current.injectionErrors << " errors" << std::endl;
+		printHistogram("dispatch latency (message queue)", current.dispatchLatency[vrwalkinplace::ipc::StatsTransport_MessageQueue].since(last.dispatchLatency[vrwalkinplace::ipc::StatsTransport_MessageQueue]));
+		printHistogram("dispatch latency (shm ring)", current.dispatchLatency[vrwalkinplace::ipc::StatsTransport_ShmRing].since(last.dispatchLatency[vrwalkinplace::ipc::StatsTransport_ShmRing]));
+		printHistogram("movement lane latency", current.laneLatency[(uint32_t)vrwalkinplace::ipc::RequestLane::Movement].since(last.laneLatency[(uint32_t)vrwalkinplace::ipc::RequestLane::Movement]));
+		printHistogram("control lane latency", current.laneLatency[(uint32_t)vrwalkinplace::ipc::RequestLane::Control].since(last.laneLatency[(uint32_t)vrwalkinplace::ipc::RequestLane::Control]));
+		printHistogram("output latency", current.outputLatency.since(last.outputLatency));
+		printHistogram("injection call time", current.injectionTime.since(last.injectionTime));
+		last = current;
+	}
+}
+
+
+// Connects and disconnects clientCount clients against the running driver while 32 others stay connected and keep pinging.
+// Every 16th client goes away without disconnecting, the driver has to expire its lease. Returns the number of failures.
+uint32_t runIpcStress(std::ostream& out, uint32_t clientCount) {
+	const uint32_t liveCount = 32;
+	uint32_t failures = 0;
+	std::vector<std::unique_ptr<vrwalkinplace::VRWalkInPlace>> live;
+	for (uint32_t n = 0; n < liveCount; ++n) {
+		live.emplace_back(new vrwalkinplace::VRWalkInPlace());
+		live.back()->connect();
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t n = 0; n < clientCount; ++n) {
+		try {
+			vrwalkinplace::VRWalkInPlace client;
+			client.connect();
+			client.ping();
+			client.disconnect(n % 16 != 15);
+			live[n % liveCount]->ping();
+		} catch (std::exception& e) {
+			failures++;
+			out << "client " << n << ": " << e.what() << std::endl;
+		}
+	}
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	out << clientCount << " clients in " << seconds << " s (" << clientCount / seconds << " connects/s), " << failures << " failures" << std::endl;
+	return failures;
+}
+
+
+// Prints what the stub driver endpoint has seen so far
+void printStubStats(std::ostream& out, const vrwalkinplace::ipc::StubServer& stub) {
+	vrwalkinplace::ipc::StatsSnapshot stats;
+	stub.stats().snapshot(stats);
+	for (uint32_t t = 0; t < IPC_STATS_REQUESTTYPE_COUNT; ++t) {
+		if (stats.requests[t] > 0) {
+			out << "  " << vrwalkinplace::ipc::requestTypeName((vrwalkinplace::ipc::RequestType)t) << ": " << stats.requests[t] << std::endl;
+		}
+	}
+	out << "  server queue: high water " << stats.messageQueueHighWater << ", " << stub.clientCount() << " clients connected" << std::endl;
+	const char* laneNames[] = { "control lane latency", "movement lane latency" };
+	for (uint32_t l = 0; l < (uint32_t)vrwalkinplace::ipc::RequestLane::Count; ++l) {
+		auto& h = stats.laneLatency[l];
+		out << "  " << laneNames[l] << ": " << h.count << " samples, avg " << h.averageUs() << " us, p50 < " << h.percentileUs(0.5)
+			<< " us, p99 < " << h.percentileUs(0.99) << " us, max " << h.maxUs << " us" << std::endl;
+	}
+}
+
+
+// Runs the overlay's step detection loop at 90 Hz on a recorded pose session instead of SteamVR, optionally against an
+// in-process stub driver endpoint (when no driver is serving the queue the controller just keeps trying to connect).
+void runHeadless(std::ostream& out, const std::string& sessionPath, bool withStub, const vrwalkinplace::stepdetector::Config& config) {
+	std::unique_ptr<vrwalkinplace::ipc::StubServer> stub;
+	if (withStub) {
+		stub.reset(new vrwalkinplace::ipc::StubServer());
+		stub->start();
+	}
+	auto tracking = std::make_shared<walkinplace::MockTrackingSource>(sessionPath);
+	walkinplace::WalkInPlaceTabController controller;
+	controller.setTrackingSource(tracking);
+	controller.initStage2(nullptr, nullptr);
+	controller.setHMDThreshold((float)config.hmdThreshold.v[0], (float)config.hmdThreshold.v[1]);
+	controller.setTrackerThreshold((float)config.trackerThreshold.v[0], (float)config.trackerThreshold.v[1]);
+	controller.setHandJogThreshold(config.handJogThreshold);
+	controller.setHandRunThreshold(config.handRunThreshold);
+	controller.setWalkTouch(config.walkTouch);
+	controller.setJogTouch(config.jogTouch);
+	controller.setRunTouch(config.runTouch);
+	controller.setStepTime(config.stepIntSec);
+	controller.setGameStepType(config.gameStepType);
+	controller.setHMDType((int)config.hmdType);
+	controller.setUseTrackers(config.useTrackers);
+	controller.setDisableHMD(config.disableHmd);
+	controller.setScaleTouchWithSwing(config.scaleTouchWithSwing);
+	controller.enableStepDetection(true);
+	auto start = std::chrono::steady_clock::now();
+	auto next = start;
+	uint64_t ticks = 0;
+	while (!tracking->finished()) {
+		controller.eventLoopTick();
+		ticks++;
+		next += std::chrono::microseconds(11111);
+		std::this_thread::sleep_until(next);
+	}
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	out << tracking->frameCount() << " frames in " << ticks << " ticks, " << seconds << " s" << std::endl;
+	if (stub) {
+		printStubStats(out, *stub);
+		stub->stop();
+	}
+}
+
+
 int main(int argc, char *argv[]) {
 
 	std::ofstream errorLog;
@@ -176,6 +315,139 @@ int main(int argc, char *argv[]) {
 			}
 			vr::VR_Shutdown();
 			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-decodelog") == 0) {
+			// Turns a binary log file (driver_vrwalkinplace.blog, VRWalkInPlace.blog) into text on stdout
+			int exitcode = 0;
+			if (i + 1 < argc) {
+				std::ifstream blogFile(argv[i + 1], std::ios::in | std::ios::binary);
+				try {
+					if (!blogFile) {
+						throw std::runtime_error(std::string("Could not open ") + argv[i + 1]);
+					}
+					vrwalkinplace::binarylog::decode(blogFile, std::cout);
+				} catch (std::exception& e) {
+					exitcode = -1;
+					errorLog << "Could not decode binary log: " << e.what() << std::endl;
+				}
+			} else {
+				exitcode = -1;
+				errorLog << "-decodelog: No file given" << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-ipcstats") == 0) {
+			// Samples the driver's statistics page: -ipcstats [interval ms] [sample count, 0 = forever]
+			int exitcode = 0;
+			uint32_t intervalMs = i + 1 < argc ? (uint32_t)std::strtoul(argv[i + 1], nullptr, 10) : 1000;
+			uint32_t sampleCount = i + 2 < argc ? (uint32_t)std::strtoul(argv[i + 2], nullptr, 10) : 0;
+			try {
+				printIpcStats(std::cout, intervalMs > 0 ? intervalMs : 1000, sampleCount);
+			} catch (std::exception& e) {
+				exitcode = -1;
+				errorLog << "Could not read driver statistics: " << e.what() << std::endl;
+				std::cerr << "Could not read driver statistics: " << e.what() << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-ipcstress") == 0) {
+			// Opens and closes many ipc clients against the running driver: -ipcstress [client count]
+			int exitcode = 0;
+			uint32_t clientCount = i + 1 < argc ? (uint32_t)std::strtoul(argv[i + 1], nullptr, 10) : 5000;
+			try {
+				if (runIpcStress(std::cout, clientCount > 0 ? clientCount : 5000) > 0) {
+					exitcode = -1;
+				}
+			} catch (std::exception& e) {
+				exitcode = -1;
+				std::cerr << "Could not connect to the driver: " << e.what() << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-replayposes") == 0) {
+			// Runs a recorded pose session through the step detection: -replayposes <file> [option=value ...]
+			int exitcode = 0;
+			if (i + 1 < argc) {
+				vrwalkinplace::stepdetector::Config config;
+				for (int k = i + 2; k < argc; ++k) {
+					if (!walkinplace::parseStepDetectorOption(config, argv[k])) {
+						std::cerr << "Ignoring unknown step detection option " << argv[k] << std::endl;
+					}
+				}
+				try {
+					walkinplace::replayPoseSession(std::cout, argv[i + 1], config);
+				} catch (std::exception& e) {
+					exitcode = -1;
+					errorLog << "Could not replay pose session: " << e.what() << std::endl;
+					std::cerr << "Could not replay pose session: " << e.what() << std::endl;
+				}
+			} else {
+				exitcode = -1;
+				errorLog << "-replayposes: No file given" << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-benchposes") == 0) {
+			// Step detection regression/latency benchmark over labeled sessions: -benchposes <manifest> [baseline file] [option=value ...]
+			int exitcode = 0;
+			if (i + 1 < argc) {
+				std::string baselinePath;
+				vrwalkinplace::stepdetector::Config config;
+				for (int k = i + 2; k < argc; ++k) {
+					if (std::strchr(argv[k], '=') == nullptr && baselinePath.empty()) {
+						baselinePath = argv[k];
+					} else if (!walkinplace::parseStepDetectorOption(config, argv[k])) {
+						std::cerr << "Ignoring unknown step detection option " << argv[k] << std::endl;
+					}
+				}
+				try {
+					if (walkinplace::benchmarkPoseSessions(std::cout, argv[i + 1], baselinePath, config) > 0) {
+						exitcode = -1;
+					}
+				} catch (std::exception& e) {
+					exitcode = -1;
+					errorLog << "Could not run pose benchmark: " << e.what() << std::endl;
+					std::cerr << "Could not run pose benchmark: " << e.what() << std::endl;
+				}
+			} else {
+				exitcode = -1;
+				errorLog << "-benchposes: No manifest given" << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-headless") == 0) {
+			// Drives the overlay's detection loop from a recorded pose session: -headless <file> [stub] [option=value ...]
+			int exitcode = 0;
+			if (i + 1 < argc) {
+				bool withStub = false;
+				vrwalkinplace::stepdetector::Config config;
+				for (int k = i + 2; k < argc; ++k) {
+					if (std::string(argv[k]).compare("stub") == 0) {
+						withStub = true;
+					} else if (!walkinplace::parseStepDetectorOption(config, argv[k])) {
+						std::cerr << "Ignoring unknown step detection option " << argv[k] << std::endl;
+					}
+				}
+				try {
+					runHeadless(std::cout, argv[i + 1], withStub, config);
+				} catch (std::exception& e) {
+					exitcode = -1;
+					errorLog << "Could not run headless: " << e.what() << std::endl;
+					std::cerr << "Could not run headless: " << e.what() << std::endl;
+				}
+			} else {
+				exitcode = -1;
+				errorLog << "-headless: No file given" << std::endl;
+			}
+			exit(exitcode);
+		} else if (std::string(argv[i]).compare("-stubdriver") == 0) {
+			// Serves the driver's ipc queue with a stub endpoint (e.g. for -ipcstress without SteamVR): -stubdriver [seconds]
+			int exitcode = 0;
+			uint32_t seconds = i + 1 < argc ? (uint32_t)std::strtoul(argv[i + 1], nullptr, 10) : 60;
+			try {
+				vrwalkinplace::ipc::StubServer stub;
+				stub.start();
+				std::this_thread::sleep_for(std::chrono::seconds(seconds > 0 ? seconds : 60));
+				printStubStats(std::cout, stub);
+			} catch (std::exception& e) {
+				exitcode = -1;
+				std::cerr << "Could not serve the driver queue: " << e.what() << std::endl;
+			}
+			exit(exitcode);
 		} else if (std::string(argv[i]).compare("-postinstallationstep") == 0) {
 			std::this_thread::sleep_for(std::chrono::seconds(1)); // When we don't wait here we get an ipc error during installation
 			int exitcode = 0;
@@ -224,6 +496,13 @@ int main(int argc, char *argv[]) {
 		if (!logFilePath.isEmpty()) {
 			LOG(INFO) << "Log File: " << logFilePath;
 		}
+		try {
+			auto blogFilePath = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).absoluteFilePath("VRWalkInPlace.blog");
+			vrwalkinplace::binarylog::BinaryLog::instance().start(QDir::toNativeSeparators(blogFilePath).toStdString());
+			LOG(INFO) << "Binary Log File: " << blogFilePath;
+		} catch (std::exception& e) {
+			LOG(ERROR) << e.what();
+		}
 		
 		if (desktopMode) {
 			LOG(INFO) << "Desktop mode enabled.";
@@ -271,7 +550,9 @@ int main(int argc, char *argv[]) {
 
 		}
 
-		return a.exec();
+		auto retval = a.exec();
+		vrwalkinplace::binarylog::BinaryLog::instance().stop();
+		return retval;
 
 	} catch (const std::exception& e) {
 		LOG(FATAL) << e.what();
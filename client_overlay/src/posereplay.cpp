@@ -0,0 +1,356 @@
+#include "posereplay.h"
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+
+// application namespace
+namespace walkinplace {
+
+
+bool parseStepDetectorOption(vrwalkinplace::stepdetector::Config& config, const std::string& option) {
+	auto sep = option.find('=');
+	if (sep == std::string::npos) {
+		return false;
+	}
+	auto name = option.substr(0, sep);
+	auto value = std::strtod(option.c_str() + sep + 1, nullptr);
+	if (name == "hmdThresholdXZ") {
+		config.hmdThreshold.v[0] = config.hmdThreshold.v[2] = value;
+	} else if (name == "hmdThresholdY") {
+		config.hmdThreshold.v[1] = value;
+	} else if (name == "trackerThresholdXZ") {
+		config.trackerThreshold.v[0] = config.trackerThreshold.v[2] = value;
+	} else if (name == "trackerThresholdY") {
+		config.trackerThreshold.v[1] = value;
+	} else if (name == "handJogThreshold") {
+		config.handJogThreshold = (float)value;
+	} else if (name == "handRunThreshold") {
+		config.handRunThreshold = (float)value;
+	} else if (name == "walkTouch") {
+		config.walkTouch = (float)value;
+	} else if (name == "jogTouch") {
+		config.jogTouch = (float)value;
+	} else if (name == "runTouch") {
+		config.runTouch = (float)value;
+	} else if (name == "stepTime") {
+		config.stepIntSec = (float)value;
+	} else if (name == "gameType") {
+		config.gameStepType = (int)value;
+	} else if (name == "hmdType") {
+		config.hmdType = (uint32_t)value;
+	} else if (name == "controlSelect") {
+		config.controlSelect = (uint32_t)value;
+	} else if (name == "useTrackers") {
+		config.useTrackers = value != 0;
+	} else if (name == "disableHMD") {
+		config.disableHmd = value != 0;
+	} else if (name == "scaleTouchWithSwing") {
+		config.scaleTouchWithSwing = value != 0;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+
+uint64_t replayPoseSession(std::ostream& out, const std::string& path, const vrwalkinplace::stepdetector::Config& config) {
+	using namespace vrwalkinplace;
+	posesession::Reader reader(path);
+	stepdetector::StepDetector detector;
+	detector.configure(config);
+	out << std::fixed << std::setprecision(3);
+	uint64_t decisions = 0;
+	double firstTimeMs = -1.0;
+	double lastTimeMs = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	auto frames = forEachPoseFrame(reader, [&](double timeMs, const stepdetector::DeviceSample* devices) {
+		if (firstTimeMs < 0.0) {
+			firstTimeMs = timeMs;
+		}
+		lastTimeMs = timeMs;
+		auto decision = detector.update(timeMs, devices, POSESESSION_MAXDEVICES);
+		if (decision.changed) {
+			decisions++;
+			out << (timeMs - firstTimeMs) / 1000.0 << " s: device " << decision.deviceId
+				<< ", gait " << (uint32_t)decision.gait << ", axis (" << decision.axisX << ", " << decision.axisY << ")" << std::endl;
+		}
+	});
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	auto sessionSeconds = frames > 0 ? (lastTimeMs - firstTimeMs) / 1000.0 : 0.0;
+	out << frames << " frames (" << sessionSeconds << " s session) in " << seconds << " s, " << frames / seconds << " frames/s, "
+		<< sessionSeconds / seconds << "x real time, " << decisions << " decision changes" << std::endl;
+	if (reader.truncated()) {
+		out << "The file ends with an incomplete block, it was ignored" << std::endl;
+	}
+	return frames;
+}
+
+
+// Regression limits of benchmarkPoseSessions()
+#define POSEBENCH_LATENCY_TOLERANCE_MS 50.0
+#define POSEBENCH_MISCLASSIFIED_TOLERANCE_PCT 2.0
+#define POSEBENCH_TICKTIME_WARNING_FACTOR 1.5 // only a warning, tick times depend on the machine
+
+
+struct PoseBenchSession {
+	std::string path;
+	std::string profile;
+	bool moving = false; // walk/jog/run
+	vrwalkinplace::stepdetector::Gait gait = vrwalkinplace::stepdetector::Gait::Stopped;
+	double stepStartMs = 0.0;
+	double stepStopMs = 0.0;
+};
+
+
+// Sums over all sessions of one profile
+struct PoseBenchResult {
+	uint32_t sessions = 0;
+	uint32_t onsetCount = 0;
+	uint32_t onsetMissed = 0;
+	double onsetMsSum = 0.0;
+	uint32_t stopCount = 0;
+	uint32_t stopMissed = 0;
+	double stopMsSum = 0.0;
+	uint32_t falsePositives = 0;
+	uint64_t movingTicks = 0;
+	uint64_t misclassifiedTicks = 0;
+	uint64_t ticks = 0;
+	double seconds = 0.0;
+
+	double onsetMs() const { return onsetCount > 0 ? onsetMsSum / onsetCount : 0.0; }
+	double stopMs() const { return stopCount > 0 ? stopMsSum / stopCount : 0.0; }
+	double misclassifiedPct() const { return movingTicks > 0 ? 100.0 * misclassifiedTicks / movingTicks : 0.0; }
+	double nsPerTick() const { return ticks > 0 ? seconds * 1e9 / ticks : 0.0; }
+};
+
+
+// The numbers a baseline file stores per profile
+struct PoseBenchBaseline {
+	uint32_t sessions;
+	double onsetMs;
+	uint32_t onsetMissed;
+	double stopMs;
+	uint32_t stopMissed;
+	uint32_t falsePositives;
+	double misclassifiedPct;
+	double nsPerTick;
+};
+
+
+static std::vector<PoseBenchSession> _readPoseBenchManifest(const std::string& manifestPath) {
+	std::ifstream file(manifestPath);
+	if (!file) {
+		throw std::runtime_error("Could not open " + manifestPath);
+	}
+	auto sep = manifestPath.find_last_of("/\\");
+	auto dir = sep != std::string::npos ? manifestPath.substr(0, sep + 1) : std::string();
+	std::vector<PoseBenchSession> sessions;
+	std::string line;
+	for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+		std::istringstream fields(line);
+		PoseBenchSession s;
+		if (!(fields >> s.path) || s.path[0] == '#') {
+			continue;
+		}
+		if (!(fields >> s.profile)) {
+			throw std::runtime_error(manifestPath + ":" + std::to_string(lineNumber) + ": No profile given");
+		}
+		if (s.profile == "walk" || s.profile == "jog" || s.profile == "run") {
+			s.moving = true;
+			s.gait = s.profile == "walk" ? vrwalkinplace::stepdetector::Gait::Walk
+				: s.profile == "jog" ? vrwalkinplace::stepdetector::Gait::Jog : vrwalkinplace::stepdetector::Gait::Run;
+			double start, stop;
+			if (!(fields >> start >> stop) || stop <= start) {
+				throw std::runtime_error(manifestPath + ":" + std::to_string(lineNumber) + ": " + s.profile + " needs the first step and stop time");
+			}
+			s.stepStartMs = start * 1000.0;
+			s.stepStopMs = stop * 1000.0;
+		}
+		else if (s.profile != "stand" && s.profile != "nod") {
+			throw std::runtime_error(manifestPath + ":" + std::to_string(lineNumber) + ": Unknown profile " + s.profile);
+		}
+		if (!(s.path.size() > 1 && (s.path[0] == '/' || s.path[0] == '\\' || s.path[1] == ':'))) {
+			s.path = dir + s.path;
+		}
+		sessions.push_back(s);
+	}
+	return sessions;
+}
+
+
+/**
+* Output is "moving" while the decision has a gait and a non-zero axis.
+* Moving sessions: onset is the time from the labeled first step to moving output, stop the time from the labeled
+* stop to stopped output. Every other switch to moving (before the first step, after the stop) is a false positive,
+* as is every switch to moving in stand/nod sessions. Ticks with moving output between the first step and the stop
+* are misclassified when their gait differs from the profile's.
+*/
+static void _runPoseBenchSession(const PoseBenchSession& session, const vrwalkinplace::stepdetector::Config& config, PoseBenchResult& result) {
+	using namespace vrwalkinplace;
+	posesession::Reader reader(session.path);
+	stepdetector::StepDetector detector;
+	detector.configure(config);
+	stepdetector::Decision output;
+	bool wasMoving = false;
+	double firstTimeMs = -1.0;
+	double onsetMs = -1.0;
+	double stopMs = -1.0;
+	auto start = std::chrono::steady_clock::now();
+	auto frames = forEachPoseFrame(reader, [&](double timeMs, const stepdetector::DeviceSample* devices) {
+		auto decision = detector.update(timeMs, devices, POSESESSION_MAXDEVICES);
+		if (decision.changed) {
+			output = decision;
+		}
+		if (firstTimeMs < 0.0) {
+			firstTimeMs = timeMs;
+		}
+		auto t = timeMs - firstTimeMs;
+		bool moving = output.gait != stepdetector::Gait::Stopped && (output.axisX != 0.0f || output.axisY != 0.0f);
+		if (!session.moving) {
+			if (moving && !wasMoving) {
+				result.falsePositives++;
+			}
+		}
+		else if (t < session.stepStartMs) {
+			if (moving && !wasMoving) {
+				result.falsePositives++;
+			}
+		}
+		else if (t < session.stepStopMs) {
+			if (moving) {
+				if (onsetMs < 0.0) {
+					onsetMs = t - session.stepStartMs;
+				}
+				result.movingTicks++;
+				if (output.gait != session.gait) {
+					result.misclassifiedTicks++;
+				}
+			}
+		}
+		else if (stopMs < 0.0) {
+			if (!moving) {
+				stopMs = t - session.stepStopMs;
+			}
+		}
+		else if (moving && !wasMoving) {
+			result.falsePositives++;
+		}
+		wasMoving = moving;
+	});
+	result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.ticks += frames;
+	result.sessions++;
+	if (session.moving) {
+		if (onsetMs < 0.0) {
+			result.onsetMissed++;
+			return; // no stop either
+		}
+		result.onsetMsSum += onsetMs;
+		result.onsetCount++;
+		if (stopMs >= 0.0) {
+			result.stopMsSum += stopMs;
+			result.stopCount++;
+		}
+		else {
+			result.stopMissed++;
+		}
+	}
+}
+
+
+uint32_t benchmarkPoseSessions(std::ostream& out, const std::string& manifestPath, const std::string& baselinePath, const vrwalkinplace::stepdetector::Config& config) {
+	auto sessions = _readPoseBenchManifest(manifestPath);
+	if (sessions.empty()) {
+		throw std::runtime_error("No sessions in " + manifestPath);
+	}
+	std::map<std::string, PoseBenchResult> results;
+	for (auto& s : sessions) {
+		_runPoseBenchSession(s, config, results[s.profile]);
+	}
+
+	out << std::fixed << std::setprecision(1);
+	out << "profile  sessions  onset ms (missed)  stop ms (missed)  false positives  misclassified %  ns/tick" << std::endl;
+	for (auto& r : results) {
+		auto& p = r.second;
+		out << std::left << std::setw(9) << r.first << std::right << std::setw(8) << p.sessions
+			<< std::setw(11) << p.onsetMs() << " (" << p.onsetMissed << ")" << std::setw(12) << p.stopMs() << " (" << p.stopMissed << ")"
+			<< std::setw(17) << p.falsePositives << std::setw(17) << p.misclassifiedPct() << std::setw(9) << p.nsPerTick() << std::endl;
+	}
+	if (baselinePath.empty()) {
+		return 0;
+	}
+
+	std::ifstream baselineFile(baselinePath);
+	if (!baselineFile) {
+		std::ofstream file(baselinePath);
+		file << std::fixed << std::setprecision(3);
+		file << "# profile sessions onsetMs onsetMissed stopMs stopMissed falsePositives misclassifiedPct nsPerTick" << std::endl;
+		for (auto& r : results) {
+			auto& p = r.second;
+			file << r.first << " " << p.sessions << " " << p.onsetMs() << " " << p.onsetMissed << " " << p.stopMs() << " " << p.stopMissed
+				<< " " << p.falsePositives << " " << p.misclassifiedPct() << " " << p.nsPerTick() << std::endl;
+		}
+		if (!file) {
+			throw std::runtime_error("Could not write baseline " + baselinePath);
+		}
+		out << "Baseline written to " << baselinePath << std::endl;
+		return 0;
+	}
+
+	std::map<std::string, PoseBenchBaseline> baseline;
+	std::string line;
+	while (std::getline(baselineFile, line)) {
+		std::istringstream fields(line);
+		std::string profile;
+		PoseBenchBaseline b;
+		if ((fields >> profile) && profile[0] != '#' && (fields >> b.sessions >> b.onsetMs >> b.onsetMissed >> b.stopMs >> b.stopMissed
+				>> b.falsePositives >> b.misclassifiedPct >> b.nsPerTick)) {
+			baseline[profile] = b;
+		}
+	}
+	uint32_t regressions = 0;
+	auto regression = [&](const std::string& profile, const char* what, double value, double baselineValue) {
+		out << "REGRESSION " << profile << ": " << what << " " << value << ", baseline " << baselineValue << std::endl;
+		regressions++;
+	};
+	for (auto& r : results) {
+		auto b = baseline.find(r.first);
+		if (b == baseline.end()) {
+			out << "No baseline for profile " << r.first << std::endl;
+			continue;
+		}
+		auto& p = r.second;
+		if (p.onsetMissed > b->second.onsetMissed) {
+			regression(r.first, "missed onsets", p.onsetMissed, b->second.onsetMissed);
+		}
+		if (p.onsetCount > 0 && p.onsetMs() > b->second.onsetMs + POSEBENCH_LATENCY_TOLERANCE_MS) {
+			regression(r.first, "onset ms", p.onsetMs(), b->second.onsetMs);
+		}
+		if (p.stopMissed > b->second.stopMissed) {
+			regression(r.first, "missed stops", p.stopMissed, b->second.stopMissed);
+		}
+		if (p.stopCount > 0 && p.stopMs() > b->second.stopMs + POSEBENCH_LATENCY_TOLERANCE_MS) {
+			regression(r.first, "stop ms", p.stopMs(), b->second.stopMs);
+		}
+		if (p.falsePositives > b->second.falsePositives) {
+			regression(r.first, "false positives", p.falsePositives, b->second.falsePositives);
+		}
+		if (p.misclassifiedPct() > b->second.misclassifiedPct + POSEBENCH_MISCLASSIFIED_TOLERANCE_PCT) {
+			regression(r.first, "misclassified %", p.misclassifiedPct(), b->second.misclassifiedPct);
+		}
+		if (p.nsPerTick() > b->second.nsPerTick * POSEBENCH_TICKTIME_WARNING_FACTOR) {
+			out << "Slower than baseline " << r.first << ": " << p.nsPerTick() << " ns/tick, baseline " << b->second.nsPerTick << std::endl;
+		}
+	}
+	out << regressions << " regressions against " << baselinePath << std::endl;
+	return regressions;
+}
+
+
+} // namespace walkinplace
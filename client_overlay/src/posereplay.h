@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+#include <posesession.h>
+#include <stepdetector.h>
+
+
+// application namespace
+namespace walkinplace {
+
+
+/**
+* Calls f(timeMs, devices) for each frame of a recorded pose session, devices holds the samples of all
+* POSESESSION_MAXDEVICES devices in the form the step detection engine takes. Returns the number of frames.
+*/
+template<typename F>
+uint64_t forEachPoseFrame(vrwalkinplace::posesession::Reader& reader, F f) {
+	using namespace vrwalkinplace;
+	stepdetector::DeviceSample devices[POSESESSION_MAXDEVICES];
+	return reader.forEachBlock([&](const posesession::Block& block) {
+		const float* columns[POSESESSION_MAXDEVICES][posesession::Column_Count];
+		for (uint32_t id = 0; id < POSESESSION_MAXDEVICES; ++id) {
+			if (block.hasDevice(id)) {
+				devices[id].deviceClass = (stepdetector::DeviceClass)block.deviceClass(id);
+				for (uint32_t k = 0; k < posesession::Column_Count; ++k) {
+					columns[id][k] = block.column(id, (posesession::Column)k);
+				}
+			}
+			else {
+				devices[id].valid = false;
+			}
+		}
+		for (uint32_t n = 0; n < block.frameCount(); ++n) {
+			for (uint32_t id = 0; id < POSESESSION_MAXDEVICES; ++id) {
+				if (!block.hasDevice(id)) {
+					continue;
+				}
+				auto& d = devices[id];
+				auto c = columns[id];
+				d.valid = block.flags(id)[n] == (posesession::Flag_PoseIsValid | posesession::Flag_DeviceIsConnected);
+				d.position = { { c[posesession::Column_PositionX][n], c[posesession::Column_PositionY][n], c[posesession::Column_PositionZ][n] } };
+				d.velocity = { { c[posesession::Column_VelocityX][n], c[posesession::Column_VelocityY][n], c[posesession::Column_VelocityZ][n] } };
+				d.rotation = { c[posesession::Column_RotationW][n], c[posesession::Column_RotationX][n], c[posesession::Column_RotationY][n], c[posesession::Column_RotationZ][n] };
+			}
+			f(block.time()[n], (const stepdetector::DeviceSample*)devices);
+		}
+	});
+}
+
+
+// Sets one step detection option from a "name=value" argument, returns false for unknown names
+bool parseStepDetectorOption(vrwalkinplace::stepdetector::Config& config, const std::string& option);
+
+// Feeds a recorded pose session through the step detection engine as fast as possible and prints every decision change
+uint64_t replayPoseSession(std::ostream& out, const std::string& path, const vrwalkinplace::stepdetector::Config& config);
+
+/**
+* Runs the step detection over a corpus of labeled sessions and prints detection latencies, false positives,
+* gait misclassifications and the time per tick for each profile (stand, nod, walk, jog, run).
+*
+* The manifest lists one session per line: "<file> <profile> [<first step s> <stop s>]", the times are relative to
+* the first frame and required for walk/jog/run. Relative file names are resolved against the manifest's folder.
+* When baselinePath names an existing file the results are compared against it, otherwise they are written to it.
+* Returns the number of regressions against the baseline.
+*/
+uint32_t benchmarkPoseSessions(std::ostream& out, const std::string& manifestPath, const std::string& baselinePath, const vrwalkinplace::stepdetector::Config& config);
+
+
+} // namespace walkinplace
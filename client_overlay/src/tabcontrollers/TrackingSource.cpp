@@ -0,0 +1,151 @@
+#include "TrackingSource.h"
+#include <openvr_math.h>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+
+// application namespace
+namespace walkinplace {
+
+	MockTrackingSource::MockTrackingSource(Script script) : _script(std::move(script)) {
+		_init();
+	}
+
+	MockTrackingSource::MockTrackingSource(const std::string& sessionPath) {
+		_init();
+		_session.reset(new vrwalkinplace::posesession::Reader(sessionPath));
+		_blockOffset = vrwalkinplace::posesession::Reader::firstBlockOffset();
+		auto header = _session->blockAt(_blockOffset);
+		if (!header) {
+			throw std::runtime_error("Pose session " + sessionPath + " has no frames");
+		}
+		_blockHeader = header;
+		_block.reset(new vrwalkinplace::posesession::Block(header));
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount && id < POSESESSION_MAXDEVICES; ++id) {
+			if (_block->hasDevice(id)) {
+				_deviceClasses[id] = (vr::ETrackedDeviceClass)_block->deviceClass(id);
+			}
+		}
+	}
+
+	void MockTrackingSource::_init() {
+		memset(_poses, 0, sizeof(_poses));
+		memset(_controllerStates, 0, sizeof(_controllerStates));
+		for (auto& c : _deviceClasses) {
+			c = vr::TrackedDeviceClass_Invalid;
+		}
+	}
+
+	void MockTrackingSource::setDeviceClass(vr::TrackedDeviceIndex_t deviceId, vr::ETrackedDeviceClass deviceClass) {
+		if (deviceId < vr::k_unMaxTrackedDeviceCount) {
+			_deviceClasses[deviceId] = deviceClass;
+		}
+	}
+
+	void MockTrackingSource::setButtons(vr::TrackedDeviceIndex_t deviceId, uint64_t pressed, uint64_t touched) {
+		if (deviceId < vr::k_unMaxTrackedDeviceCount) {
+			_controllerStates[deviceId].ulButtonPressed = pressed;
+			_controllerStates[deviceId].ulButtonTouched = touched;
+		}
+	}
+
+	bool MockTrackingSource::_nextSessionFrame() {
+		if (_blockFrame >= _block->frameCount()) {
+			auto offset = _blockOffset + _blockHeader->byteSize;
+			auto header = _session->blockAt(offset);
+			if (!header) {
+				return false;
+			}
+			_blockOffset = offset;
+			_blockHeader = header;
+			_block.reset(new vrwalkinplace::posesession::Block(header));
+			_blockFrame = 0;
+		}
+		auto n = _blockFrame++;
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount && id < POSESESSION_MAXDEVICES; ++id) {
+			auto& pose = _poses[id];
+			if (!_block->hasDevice(id) || _block->flags(id)[n] == 0) {
+				pose.bDeviceIsConnected = false;
+				pose.bPoseIsValid = false;
+				continue;
+			}
+			using vrwalkinplace::posesession::Column;
+			auto value = [&](Column c) { return (double)_block->column(id, c)[n]; };
+			auto flags = _block->flags(id)[n];
+			_deviceClasses[id] = (vr::ETrackedDeviceClass)_block->deviceClass(id);
+			pose.bDeviceIsConnected = (flags & vrwalkinplace::posesession::Flag_DeviceIsConnected) != 0;
+			pose.bPoseIsValid = (flags & vrwalkinplace::posesession::Flag_PoseIsValid) != 0;
+			pose.eTrackingResult = vr::TrackingResult_Running_OK;
+			vr::HmdQuaternion_t rotation = { value(vrwalkinplace::posesession::Column_RotationW), value(vrwalkinplace::posesession::Column_RotationX),
+				value(vrwalkinplace::posesession::Column_RotationY), value(vrwalkinplace::posesession::Column_RotationZ) };
+			vr::HmdVector3d_t position = { { value(vrwalkinplace::posesession::Column_PositionX), value(vrwalkinplace::posesession::Column_PositionY),
+				value(vrwalkinplace::posesession::Column_PositionZ) } };
+			pose.mDeviceToAbsoluteTracking = vrmath::matrixFromQuaternion(rotation, position);
+			pose.vVelocity.v[0] = (float)value(vrwalkinplace::posesession::Column_VelocityX);
+			pose.vVelocity.v[1] = (float)value(vrwalkinplace::posesession::Column_VelocityY);
+			pose.vVelocity.v[2] = (float)value(vrwalkinplace::posesession::Column_VelocityZ);
+		}
+		return true;
+	}
+
+	void MockTrackingSource::GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin, float, vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) {
+		if (!_finished) {
+			if (_session) {
+				_finished = !_nextSessionFrame();
+			}
+			else {
+				memset(_poses, 0, sizeof(_poses));
+				_finished = !_script(_frame, _poses, vr::k_unMaxTrackedDeviceCount);
+			}
+			if (!_finished) {
+				_frame++;
+			}
+		}
+		auto count = unTrackedDevicePoseArrayCount < vr::k_unMaxTrackedDeviceCount ? unTrackedDevicePoseArrayCount : vr::k_unMaxTrackedDeviceCount;
+		memcpy(pTrackedDevicePoseArray, _poses, count * sizeof(vr::TrackedDevicePose_t));
+	}
+
+	vr::ETrackedDeviceClass MockTrackingSource::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) {
+		return unDeviceIndex < vr::k_unMaxTrackedDeviceCount ? _deviceClasses[unDeviceIndex] : vr::TrackedDeviceClass_Invalid;
+	}
+
+	uint32_t MockTrackingSource::GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, char* pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError* pError) {
+		if (unDeviceIndex >= vr::k_unMaxTrackedDeviceCount || _deviceClasses[unDeviceIndex] == vr::TrackedDeviceClass_Invalid) {
+			if (pError) {
+				*pError = vr::TrackedProp_InvalidDevice;
+			}
+			return 0;
+		}
+		if (prop != vr::Prop_SerialNumber_String) {
+			if (pError) {
+				*pError = vr::TrackedProp_UnknownProperty;
+			}
+			return 0;
+		}
+		char serial[32];
+		auto length = (uint32_t)snprintf(serial, sizeof(serial), "mock-%u", unDeviceIndex) + 1;
+		if (unBufferSize < length) {
+			if (pError) {
+				*pError = vr::TrackedProp_BufferTooSmall;
+			}
+			return length;
+		}
+		memcpy(pchValue, serial, length);
+		if (pError) {
+			*pError = vr::TrackedProp_Success;
+		}
+		return length;
+	}
+
+	bool MockTrackingSource::GetControllerState(vr::TrackedDeviceIndex_t unControllerDeviceIndex, vr::VRControllerState_t* pControllerState, uint32_t unControllerStateSize) {
+		if (unControllerDeviceIndex >= vr::k_unMaxTrackedDeviceCount || unControllerStateSize != sizeof(vr::VRControllerState_t)
+				|| _deviceClasses[unControllerDeviceIndex] != vr::TrackedDeviceClass_Controller) {
+			return false;
+		}
+		auto& state = _controllerStates[unControllerDeviceIndex];
+		state.unPacketNum = (uint32_t)_frame;
+		*pControllerState = state;
+		return true;
+	}
+
+} // namespace walkinplace
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <openvr.h>
+#include <posesession.h>
+#include <memory>
+#include <string>
+#include <functional>
+
+// application namespace
+namespace walkinplace {
+
+/**
+* The part of vr::IVRSystem that WalkInPlaceTabController gets its tracking data from (same signatures).
+*
+* OpenVRTrackingSource forwards to the runtime, MockTrackingSource stands in for it with scripted or recorded
+* poses so that the controller (and through it the ipc path to the driver) runs without SteamVR.
+*/
+class TrackingSource {
+public:
+	virtual ~TrackingSource() {}
+
+	virtual void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow,
+		vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) = 0;
+	virtual vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) = 0;
+	virtual uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop,
+		char* pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError* pError = nullptr) = 0;
+	virtual bool GetControllerState(vr::TrackedDeviceIndex_t unControllerDeviceIndex, vr::VRControllerState_t* pControllerState, uint32_t unControllerStateSize) = 0;
+};
+
+
+class OpenVRTrackingSource : public TrackingSource {
+public:
+	virtual void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow,
+			vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override {
+		vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(eOrigin, fPredictedSecondsToPhotonsFromNow, pTrackedDevicePoseArray, unTrackedDevicePoseArrayCount);
+	}
+
+	virtual vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) override {
+		return vr::VRSystem()->GetTrackedDeviceClass(unDeviceIndex);
+	}
+
+	virtual uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop,
+			char* pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError* pError = nullptr) override {
+		return vr::VRSystem()->GetStringTrackedDeviceProperty(unDeviceIndex, prop, pchValue, unBufferSize, pError);
+	}
+
+	virtual bool GetControllerState(vr::TrackedDeviceIndex_t unControllerDeviceIndex, vr::VRControllerState_t* pControllerState, uint32_t unControllerStateSize) override {
+		return vr::VRSystem()->GetControllerState(unControllerDeviceIndex, pControllerState, unControllerStateSize);
+	}
+};
+
+
+/**
+* Every GetDeviceToAbsoluteTrackingPose() call advances one frame, so a recorded session plays back at the cadence
+* it was recorded with. Devices are known from the start (classes of the first recorded block, or set by the script
+* owner), their serial numbers are "mock-<id>". Controller buttons stay released unless setButtons() says otherwise.
+*/
+class MockTrackingSource : public TrackingSource {
+public:
+	// Fills the poses of one frame (they are cleared before), returns false when the script is done
+	typedef std::function<bool(uint64_t frame, vr::TrackedDevicePose_t* poses, uint32_t count)> Script;
+
+	explicit MockTrackingSource(Script script);
+
+	// Plays back a recorded pose session (see posesession.h), throws when the file cannot be read
+	explicit MockTrackingSource(const std::string& sessionPath);
+
+	void setDeviceClass(vr::TrackedDeviceIndex_t deviceId, vr::ETrackedDeviceClass deviceClass);
+	void setButtons(vr::TrackedDeviceIndex_t deviceId, uint64_t pressed, uint64_t touched);
+
+	// No more frames, the last poses are repeated
+	bool finished() const {
+		return _finished;
+	}
+
+	uint64_t frameCount() const {
+		return _frame;
+	}
+
+	virtual void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow,
+		vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+	virtual vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) override;
+	virtual uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop,
+		char* pchValue, uint32_t unBufferSize, vr::ETrackedPropertyError* pError = nullptr) override;
+	virtual bool GetControllerState(vr::TrackedDeviceIndex_t unControllerDeviceIndex, vr::VRControllerState_t* pControllerState, uint32_t unControllerStateSize) override;
+
+private:
+	Script _script;
+	std::unique_ptr<vrwalkinplace::posesession::Reader> _session;
+	std::unique_ptr<vrwalkinplace::posesession::Block> _block;
+	const vrwalkinplace::posesession::BlockHeader* _blockHeader = nullptr;
+	uint64_t _blockOffset = 0;
+	uint32_t _blockFrame = 0;
+	uint64_t _frame = 0;
+	bool _finished = false;
+	vr::TrackedDevicePose_t _poses[vr::k_unMaxTrackedDeviceCount];
+	vr::ETrackedDeviceClass _deviceClasses[vr::k_unMaxTrackedDeviceCount];
+	vr::VRControllerState_t _controllerStates[vr::k_unMaxTrackedDeviceCount];
+
+	void _init();
+	bool _nextSessionFrame();
+};
+
+} // namespace walkinplace
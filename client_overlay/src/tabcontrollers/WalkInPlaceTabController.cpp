@@ -5,9 +5,14 @@
 #include <QtQuick/QQuickItem>
 #include <QtCore/QDebug>
 #include <QtCore/QtMath>
+#include <QDir>
+#include <QStandardPaths>
+#include <QDateTime>
 #include "../overlaycontroller.h"
 #include <openvr_math.h>
 #include <chrono>
+#include <cstring>
+#include <binarylog.h>
 
 // application namespace
 namespace walkinplace {
@@ -30,7 +35,7 @@ namespace walkinplace {
 		this->widget = widget;
 		try {
 			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id) {
-				auto deviceClass = vr::VRSystem()->GetTrackedDeviceClass(id);
+				auto deviceClass = _tracking->GetTrackedDeviceClass(id);
 				if (deviceClass != vr::TrackedDeviceClass_Invalid) {
 					if (deviceClass == vr::TrackedDeviceClass_HMD || deviceClass == vr::TrackedDeviceClass_Controller || deviceClass == vr::TrackedDeviceClass_GenericTracker) {
 						auto info = std::make_shared<DeviceInfo>();
@@ -38,7 +43,7 @@ namespace walkinplace {
 						info->deviceClass = deviceClass;
 						char buffer[vr::k_unMaxPropertyStringSize];
 						vr::ETrackedPropertyError pError = vr::TrackedProp_Success;
-						vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
+						_tracking->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
 						if (pError == vr::TrackedProp_Success) {
 							info->serial = std::string(buffer);
 						}
@@ -66,12 +71,21 @@ namespace walkinplace {
 		catch (const std::exception& e) {
 			LOG(ERROR) << "Could not connect to driver component: " << e.what();
 		}
+		connectDriver();
 	}
 
 
 	void WalkInPlaceTabController::eventLoopTick() {
-		if (stepDetectEnabled) {
-			applyStepPoseDetect();
+		if (stepDetectEnabled && useDriverStepDetection && gameType >= 0 && gameType <= 5) {
+			applyDriverStepDetect();
+		}
+		else {
+			if (_driverStepDetectionActive) {
+				stopDriverStepDetect();
+			}
+			if (stepDetectEnabled) {
+				applyStepPoseDetect();
+			}
 		}
 		if (identifyControlTimerSet) {
 			auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
@@ -82,12 +96,22 @@ namespace walkinplace {
 				setDeviceRenderModel(controlSelectOverlayHandle, 0, 1, 1, 1, 1, 1, 1);
 			}
 		}
+		if (driverHeartbeatCounter >= 50) {
+			driverHeartbeatCounter = 0;
+			// The library's ipc thread sends the heartbeats, so a hung driver never blocks the UI here
+			if (connectDriver() && vrwalkinplace.connectionLost()) {
+				driverConnectionLost(vrwalkinplace::vrwalkinplace_connectionerror("Driver stopped answering heartbeats"));
+			}
+		}
+		else {
+			driverHeartbeatCounter++;
+		}
 		if (settingsUpdateCounter >= 50) {
 			settingsUpdateCounter = 0;
-			if (parent->isDashboardVisible() || parent->isDesktopMode()) {
+			if (parent && (parent->isDashboardVisible() || parent->isDesktopMode())) {
 				bool newDeviceAdded = false;
 				for (uint32_t id = maxValidDeviceId + 1; id < vr::k_unMaxTrackedDeviceCount; ++id) {
-					auto deviceClass = vr::VRSystem()->GetTrackedDeviceClass(id);
+					auto deviceClass = _tracking->GetTrackedDeviceClass(id);
 					if (deviceClass != vr::TrackedDeviceClass_Invalid) {
 						if (deviceClass == vr::TrackedDeviceClass_HMD || deviceClass == vr::TrackedDeviceClass_Controller || deviceClass == vr::TrackedDeviceClass_GenericTracker) {
 							auto info = std::make_shared<DeviceInfo>();
@@ -95,7 +119,7 @@ namespace walkinplace {
 							info->deviceClass = deviceClass;
 							char buffer[vr::k_unMaxPropertyStringSize];
 							vr::ETrackedPropertyError pError = vr::TrackedProp_Success;
-							vr::VRSystem()->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
+							_tracking->GetStringTrackedDeviceProperty(id, vr::Prop_SerialNumber_String, buffer, vr::k_unMaxPropertyStringSize, &pError);
 							if (pError == vr::TrackedProp_Success) {
 								info->serial = std::string(buffer);
 							}
@@ -288,8 +312,9 @@ namespace walkinplace {
 
 	QList<qreal> WalkInPlaceTabController::getGraphPoses() {
 		showingStepGraph = true;
-		if (!stepDetectEnabled) {
-			vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, 0.0f, latestDevicePoses, vr::k_unMaxTrackedDeviceCount);
+		bool overlayDetects = stepDetectEnabled && !_driverStepDetectionActive;
+		if (!overlayDetects) {
+			_tracking->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, 0.0f, latestDevicePoses, vr::k_unMaxTrackedDeviceCount);
 		}
 		auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 		bool firstController = true;
@@ -297,22 +322,27 @@ namespace walkinplace {
 		for (auto info : deviceInfos) {
 			if (latestDevicePoses[info->openvrId].bPoseIsValid) {
 				if (info->deviceClass == vr::TrackedDeviceClass_HMD) {
-					if (hmdType != 0) {
-						if (!stepDetectEnabled) {
-							auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-							double tdiff = ((double)(now - _velStepTime)) / 1000.0;
-							auto m = latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking.m;
+					if (overlayDetects && !disableHMD) {
+						// what the step detection saw, differentiated from positions for hmdType != 0
+						auto& vel = _stepDetector.hmdVelocity();
+						hmdVel.v[0] = vel.v[0];
+						hmdVel.v[1] = vel.v[1];
+						hmdVel.v[2] = vel.v[2];
+					}
+					else if (hmdType != 0) {
+						auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+						double tdiff = ((double)(now - _velStepTime)) / 1000.0;
+						auto m = latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking.m;
 
-							hmdVel.v[0] = (m[0][3] - lastHmdPos.v[0]) / tdiff;
-							hmdVel.v[1] = (m[1][3] - lastHmdPos.v[1]) / tdiff;
-							hmdVel.v[2] = (m[2][3] - lastHmdPos.v[2]) / tdiff;
+						hmdVel.v[0] = (m[0][3] - lastHmdPos.v[0]) / tdiff;
+						hmdVel.v[1] = (m[1][3] - lastHmdPos.v[1]) / tdiff;
+						hmdVel.v[2] = (m[2][3] - lastHmdPos.v[2]) / tdiff;
 
-							lastHmdPos.v[0] = m[0][3];
-							lastHmdPos.v[1] = m[1][3];
-							lastHmdPos.v[2] = m[2][3];
+						lastHmdPos.v[0] = m[0][3];
+						lastHmdPos.v[1] = m[1][3];
+						lastHmdPos.v[2] = m[2][3];
 
-							_velStepTime = now;
-						}
+						_velStepTime = now;
 					}
 					else {
 						hmdVel.v[0] = latestDevicePoses[info->openvrId].vVelocity.v[0];
@@ -380,7 +410,6 @@ namespace walkinplace {
 		vals.push_back(cont1Vel.v[0]);
 		vals.push_back(cont1Vel.v[1]);
 		vals.push_back(cont1Vel.v[2]);
-		//vals.push_back(hmdPitchAngVel);
 
 		vals.push_back(cont2Vel.v[0]);
 		vals.push_back(cont2Vel.v[1]);
@@ -463,6 +492,7 @@ namespace walkinplace {
 	void WalkInPlaceTabController::reloadWalkInPlaceSettings() {
 		auto settings = OverlayController::appSettings();
 		settings->beginGroup("walkInPlaceSettings");
+		useDriverStepDetection = settings->value("driverStepDetection", false).toBool();
 		settings->endGroup();
 	}
 
@@ -507,6 +537,7 @@ namespace walkinplace {
 	void WalkInPlaceTabController::saveWalkInPlaceSettings() {
 		auto settings = OverlayController::appSettings();
 		settings->beginGroup("walkInPlaceSettings");
+		settings->setValue("driverStepDetection", useDriverStepDetection);
 		settings->endGroup();
 		settings->sync();
 	}
@@ -671,6 +702,9 @@ namespace walkinplace {
 	}
 
 	void WalkInPlaceTabController::enableStepDetection(bool enable) {
+		if (enable && !stepDetectEnabled) {
+			_stepDetector.reset();
+		}
 		stepDetectEnabled = enable;
 		_controllerDeviceIds[0] = -1;
 		_controllerDeviceIds[1] = -1;
@@ -680,6 +714,76 @@ namespace walkinplace {
 		betaEnabled = enable;
 	}
 
+	void WalkInPlaceTabController::setUseDriverStepDetection(bool val) {
+		useDriverStepDetection = val;
+		saveWalkInPlaceSettings();
+	}
+
+	bool WalkInPlaceTabController::getUseDriverStepDetection() {
+		return useDriverStepDetection;
+	}
+
+	void WalkInPlaceTabController::setPoseRecording(bool enable) {
+		if (enable && !_poseRecorder) {
+			auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+			dir.mkpath(".");
+			auto path = QDir::toNativeSeparators(dir.absoluteFilePath("poses-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".wipposes")).toStdString();
+			try {
+				std::unique_ptr<vrwalkinplace::posesession::Writer> recorder(new vrwalkinplace::posesession::Writer());
+				recorder->open(path);
+				_poseRecorder = std::move(recorder);
+				LOG(INFO) << "Recording poses to " << path;
+			}
+			catch (const std::exception& e) {
+				LOG(ERROR) << "Could not start pose recording: " << e.what();
+			}
+		}
+		else if (!enable && _poseRecorder) {
+			try {
+				_poseRecorder->close();
+				LOG(INFO) << "Pose recording stopped, " << _poseRecorder->frameCount() << " frames";
+			}
+			catch (const std::exception& e) {
+				LOG(ERROR) << "Could not finish pose recording: " << e.what();
+			}
+			_poseRecorder.reset();
+		}
+	}
+
+	bool WalkInPlaceTabController::isPoseRecording() {
+		return _poseRecorder != nullptr;
+	}
+
+	void WalkInPlaceTabController::recordPoses(double timeMs) {
+		vrwalkinplace::posesession::DeviceSample samples[vr::k_unMaxTrackedDeviceCount] = {};
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id) {
+			auto& pose = latestDevicePoses[id];
+			auto& sample = samples[id];
+			if (!pose.bDeviceIsConnected) {
+				continue;
+			}
+			sample.flags = vrwalkinplace::posesession::Flag_DeviceIsConnected | (pose.bPoseIsValid ? vrwalkinplace::posesession::Flag_PoseIsValid : 0);
+			sample.deviceClass = (uint8_t)_tracking->GetTrackedDeviceClass(id);
+			auto& m = pose.mDeviceToAbsoluteTracking.m;
+			auto q = vrmath::quaternionFromRotationMatrix(pose.mDeviceToAbsoluteTracking);
+			for (int k = 0; k < 3; ++k) {
+				sample.position[k] = m[k][3];
+				sample.velocity[k] = pose.vVelocity.v[k];
+			}
+			sample.rotation[0] = (float)q.w;
+			sample.rotation[1] = (float)q.x;
+			sample.rotation[2] = (float)q.y;
+			sample.rotation[3] = (float)q.z;
+		}
+		try {
+			_poseRecorder->append(timeMs, samples, vr::k_unMaxTrackedDeviceCount);
+		}
+		catch (const std::exception& e) {
+			LOG(ERROR) << "Pose recording stopped: " << e.what();
+			_poseRecorder.reset();
+		}
+	}
+
 	void WalkInPlaceTabController::setStepTime(double value) {
 		_stepIntegrateStepLimit = (value * 1000);
 	}
@@ -765,7 +869,7 @@ namespace walkinplace {
 	void WalkInPlaceTabController::updateAccuracyButtonState(uint32_t deviceId, bool firstController) {
 		if (deviceId >= 0 && (buttonControlSelect >= 2 || _controllerDeviceIds[buttonControlSelect] == deviceId)) {
 			vr::VRControllerState_t state;
-			vr::VRSystem()->GetControllerState(deviceId, &state, sizeof(state));
+			_tracking->GetControllerState(deviceId, &state, sizeof(state));
 			//LOG(INFO) << "Check accuracy button : " << deviceId << " : " << g_AccuracyButton << " : " << state.ulButtonPressed << " : " << vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Trigger);
 			//LOG(INFO) << "current button : " << state.ulButtonPressed;
 			bool isHoldingButton = false;
@@ -959,578 +1063,113 @@ namespace walkinplace {
 	}
 
 	void WalkInPlaceTabController::applyStepPoseDetect() {
-		double deltatime = 1.0 / 90.0 * 1000;
-		auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		double tdiff = ((double)(now - _timeLastTick));
-		//LOG(INFO) << "DT: " << tdiff;
-		if (tdiff >= deltatime) {
-			if (g_AccuracyButton >= 0 && _controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0) {
-				g_isHoldingAccuracyButton = false;
-				updateAccuracyButtonState(_controllerDeviceIds[0], true);
-				updateAccuracyButtonState(_controllerDeviceIds[1], false);
-			}
+		if (g_AccuracyButton >= 0 && _controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0) {
+			g_isHoldingAccuracyButton = false;
+			updateAccuracyButtonState(_controllerDeviceIds[0], true);
+			updateAccuracyButtonState(_controllerDeviceIds[1], false);
 		}
-		bool moveButtonCheck = accuracyButtonOnOrDisabled();
-		if (moveButtonCheck) {
-			if (tdiff >= deltatime) {
-				vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, 0.0f, latestDevicePoses, vr::k_unMaxTrackedDeviceCount);
-				if (!_stepPoseDetected) {
-					bool firstController = true;
-					for (auto info : deviceInfos) {
-						if (latestDevicePoses[info->openvrId].bPoseIsValid) {
-							vr::ETrackedDeviceClass deviceClass = vr::VRSystem()->GetTrackedDeviceClass(info->openvrId);
-							if (!disableHMD && deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_HMD) {
-
-								auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-
-								vr::HmdVector3d_t poseWorldVel;// = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecVelocity, true);
-
-								vr::HmdQuaternion_t qRotation = vrmath::quaternionFromRotationMatrix(latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking);
-
-								vr::HmdVector3d_t forward = { 0,0,-1 };
-								hmdForward = vrmath::quaternionRotateVector(qRotation, forward);
-
-								double tvelDiff = ((double)(now - _velStepTime)) / 1000.0;
-
-								bool detectNod = false;
-								/*float pitch = (180 * std::asin(hmdForward.v[1])) / M_PI;
-
-								hmdPitchAngVel = (pitch - hmdLastPitch) / tvelDiff;
-								hmdLastPitch = pitch;
-								
-								if (nodCheck(hmdPitchAngVel)) {
-									peaksCount = 0;
-									_timeLastNod = now;
-									detectNod = true;
-								}*/
-								_velStepTime = now;
-
-								if (!detectNod) {
-									if (hmdType != 0) {
-										auto m = latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking.m;
-
-										poseWorldVel.v[0] = (m[0][3] - lastHmdPos.v[0]) / tvelDiff;
-										poseWorldVel.v[1] = (m[1][3] - lastHmdPos.v[1]) / tvelDiff;
-										poseWorldVel.v[2] = (m[2][3] - lastHmdPos.v[2]) / tvelDiff;
-
-										hmdVel.v[0] = poseWorldVel.v[0];
-										hmdVel.v[1] = poseWorldVel.v[1];
-										hmdVel.v[2] = poseWorldVel.v[2];
-
-										lastHmdPos.v[0] = m[0][3];
-										lastHmdPos.v[1] = m[1][3];
-										lastHmdPos.v[2] = m[2][3];
-
-									}
-									else {
-										poseWorldVel.v[0] = latestDevicePoses[info->openvrId].vVelocity.v[0];
-										poseWorldVel.v[1] = latestDevicePoses[info->openvrId].vVelocity.v[1];
-										poseWorldVel.v[2] = latestDevicePoses[info->openvrId].vVelocity.v[2];
-									}
-
-									//LOG(INFO) << "HMD Step: " << poseWorldVel.v[0] << "," << poseWorldVel.v[1] << "," << poseWorldVel.v[2];
-									//LOG(INFO) << "HMD POS: " << pose.vecPosition[0] << " " << pose.vecPosition[1] << " " << pose.vecPosition[2];
-
-									if (upAndDownStepCheck(poseWorldVel, _hmdThreshold, 0, 0) && (now - _timeLastNod) >= _stepIntegrateStepLimit * 3) {
-
-										vr::HmdQuaternion_t qRotation = vrmath::quaternionFromRotationMatrix(latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking);
-
-										vr::HmdVector3d_t forward = { 0,0,-1 };
-										hmdForward = vrmath::quaternionRotateVector(qRotation, forward);
-
-										hmdYaw = (180 * std::asin(hmdForward.v[0])) / M_PI;
-
-										peaksCount = 1;
-									}
-								}
-								if ( peaksCount < 1 && (now - _timeLastStepPeak) > _stepFrequencyMin) {
-									trackerStepDetected = false;
-								}
-							}
-							else if (useTrackers && deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_GenericTracker) {
-
-								vr::HmdVector3d_t poseWorldVel;// = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecVelocity, true);
-								poseWorldVel.v[0] = latestDevicePoses[info->openvrId].vVelocity.v[0];
-								poseWorldVel.v[1] = latestDevicePoses[info->openvrId].vVelocity.v[1];
-								poseWorldVel.v[2] = latestDevicePoses[info->openvrId].vVelocity.v[2];
-
-								if (upAndDownStepCheck(poseWorldVel, _trackerThreshold, 0, 0)) {
-									trackerStepDetected = true;
-									_timeLastTrackerStep = now;
-								}
-							}
-							else if (deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_Controller) {
-								if (_controllerDeviceIds[0] < 0) {
-									_controllerDeviceIds[0] = info->openvrId;
-								}
-								else if (_controllerDeviceIds[1] < 0) {
-									_controllerDeviceIds[1] = info->openvrId;
-								}
-								if (firstController) {
-									firstController = false;
-									if (controlSelect == 0 && _controlUsedID != info->openvrId) {
-										_controlUsedID = info->openvrId;
-										LOG(INFO) << "Set Main Controller to device : " << _controllerDeviceIds[0];
-									}
-								}
-								else {
-									if (controlSelect != 0 && _controlUsedID != info->openvrId) {
-										_controlUsedID = info->openvrId;
-										LOG(INFO) << "Set Main Controller to device : " << _controllerDeviceIds[1];
-									}
-								}
-							}
-						}
-					}
-					trackerStepDetected = trackerStepDetected || !useTrackers;
-					if (!disableHMD) {
-						if (peaksCount >= 1 && (trackerStepDetected)) {
-							_stepPoseDetected = true;
-							_stepIntegrateSteps = 0;
-						}
-					}
-					else if (trackerStepDetected && useTrackers) {
-						_stepPoseDetected = true;
-						_stepIntegrateSteps = 0;
-					}
-					if (!_stepPoseDetected && _hasUnTouchedStepAxis < 4) {
-						int deviceId = _controlUsedID;
-						if (_controlUsedID < 0) {
-							deviceId = _controllerDeviceIds[0];
-						}
-						if (gameType == 0 || gameType == 1 || gameType == 2 || gameType == 3) {
-							if (_stepIntegrateSteps < (_stepIntegrateStepLimit / 2.0)) {
-								vr::VRControllerAxis_t axisState;
-								axisState.x = 0;
-								axisState.y = (walkTouch)*(1 - (_stepIntegrateSteps / (_stepIntegrateStepLimit / 2.0)));
-								applyAxisMovement(deviceId, axisState);
-								_stepIntegrateSteps += tdiff;
-								_hasUnTouchedStepAxis = 1;
-							}
-							else {
-								stopMovement(deviceId);
-								_hasUnTouchedStepAxis++;
-							}
-						}
-						else {
-							stopMovement(deviceId);
-							_hasUnTouchedStepAxis++;
-						}
-						_teleportUnpressed = true;
-					}
-					else {
-						_stepIntegrateSteps = 0;
-					}
+		if (!accuracyButtonOnOrDisabled()) {
+			return;
+		}
+		auto now = (double)vrwalkinplace::ipc::monotonicTimeUs() / 1000.0;
+		_tracking->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, 0.0f, latestDevicePoses, vr::k_unMaxTrackedDeviceCount);
+		if (_poseRecorder) {
+			recordPoses(now);
+		}
+		vrwalkinplace::stepdetector::DeviceSample samples[vr::k_unMaxTrackedDeviceCount];
+		for (auto info : deviceInfos) {
+			auto& pose = latestDevicePoses[info->openvrId];
+			auto& sample = samples[info->openvrId];
+			sample.valid = pose.bPoseIsValid && pose.bDeviceIsConnected;
+			if (!sample.valid) {
+				continue;
+			}
+			vr::ETrackedDeviceClass deviceClass = _tracking->GetTrackedDeviceClass(info->openvrId);
+			sample.deviceClass = (vrwalkinplace::stepdetector::DeviceClass)deviceClass;
+			if (deviceClass == vr::TrackedDeviceClass_Controller && _controllerDeviceIds[0] != (int)info->openvrId) {
+				if (_controllerDeviceIds[0] < 0) {
+					_controllerDeviceIds[0] = info->openvrId;
 				}
-				if (!_stepPoseDetected) {
-					_timeLastTick = now;
+				else if (_controllerDeviceIds[1] < 0) {
+					_controllerDeviceIds[1] = info->openvrId;
 				}
 			}
-			if (_stepPoseDetected) {
-				bool isWalking = true;
-				bool isJogging = false;
-				bool isRunning = false;
-				bool axisStateChange = false;
-				bool oneTrackerStepping = false;
-				_hasUnTouchedStepAxis = 2;
-				vr::VRControllerAxis_t axisState;
-				float * hand1Vel;
-				float * hand2Vel;
-				if (tdiff >= deltatime) {
-					for (auto info : deviceInfos) {
-						vr::ETrackedDeviceClass deviceClass = vr::VRSystem()->GetTrackedDeviceClass(info->openvrId);
-						if (!disableHMD && deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_HMD) {
-
-
-
-							auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-
-							vr::HmdVector3d_t poseWorldVel;// = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecVelocity, true);
-
-							vr::HmdQuaternion_t qRotation = vrmath::quaternionFromRotationMatrix(latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking);
-
-							vr::HmdVector3d_t forward = { 0,0,-1 };
-							hmdForward = vrmath::quaternionRotateVector(qRotation, forward);
-
-							hmdYaw = (180 * std::asin(hmdForward.v[0])) / M_PI;
-
-							double tvelDiff = ((double)(now - _velStepTime)) / 1000.0;
-
-							bool detectNod = false;
-
-							/*float pitch = (180 * std::asin(hmdForward.v[1])) / M_PI;
-							hmdPitchAngVel = (pitch - hmdLastPitch) / tvelDiff;
-							hmdLastPitch = pitch;
-
-							if (nodCheck(hmdPitchAngVel)) {
-								peaksCount = 0;
-								_timeLastNod = now;
-								isWalking = false;
-								detectNod = true;
-							}*/
-							_velStepTime = now;
-
-							if (!detectNod) {
-								if (hmdType != 0) {
-									auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-									double tvelDiff = ((double)(now - _velStepTime)) / 1000.0;
-									if (tvelDiff > 0.0) {
-										auto m = latestDevicePoses[info->openvrId].mDeviceToAbsoluteTracking.m;
-
-										poseWorldVel.v[0] = (m[0][3] - lastHmdPos.v[0]) / tvelDiff;
-										poseWorldVel.v[1] = (m[1][3] - lastHmdPos.v[1]) / tvelDiff;
-										poseWorldVel.v[2] = (m[2][3] - lastHmdPos.v[2]) / tvelDiff;
-
-										hmdVel.v[0] = poseWorldVel.v[0];
-										hmdVel.v[1] = poseWorldVel.v[1];
-										hmdVel.v[2] = poseWorldVel.v[2];
-
-										lastHmdPos.v[0] = m[0][3];
-										lastHmdPos.v[1] = m[1][3];
-										lastHmdPos.v[2] = m[2][3];
-
-										_velStepTime = now;
-									}
-								}
-								else {
-									poseWorldVel.v[0] = latestDevicePoses[info->openvrId].vVelocity.v[0];
-									poseWorldVel.v[1] = latestDevicePoses[info->openvrId].vVelocity.v[1];
-									poseWorldVel.v[2] = latestDevicePoses[info->openvrId].vVelocity.v[2];
-								}
-
-								//LOG(INFO) << "HMD In Step: " << poseWorldVel.v[0] << "," << poseWorldVel.v[1] << "," << poseWorldVel.v[2];
+			auto& m = pose.mDeviceToAbsoluteTracking.m;
+			auto q = vrmath::quaternionFromRotationMatrix(pose.mDeviceToAbsoluteTracking);
+			for (int k = 0; k < 3; ++k) {
+				sample.position.v[k] = m[k][3];
+				sample.velocity.v[k] = pose.vVelocity.v[k];
+			}
+			sample.rotation = { q.w, q.x, q.y, q.z };
+		}
 
-								if (upAndDownStepCheck(poseWorldVel, _hmdThreshold, 0, 0) && (now - _timeLastNod) >= _stepIntegrateStepLimit * 3) {
-									_stepIntegrateSteps = 0;
-									int velsign = poseWorldVel.v[1] > 0 ? 1 : -1;
-									int hmdsign = hmdLastYVel > 0 ? 1 : -1;
-									if (velsign != hmdsign) {
-										_timeLastStepPeak = now;
-										hmdLastYVel = poseWorldVel.v[1];
-									}
-								}
-							}
-						}
-						else if (useTrackers && deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_GenericTracker) {
-
-							vr::HmdVector3d_t poseWorldVel;
-							poseWorldVel.v[0] = latestDevicePoses[info->openvrId].vVelocity.v[0];
-							poseWorldVel.v[1] = latestDevicePoses[info->openvrId].vVelocity.v[1];
-							poseWorldVel.v[2] = latestDevicePoses[info->openvrId].vVelocity.v[2];
-
-							if (upAndDownStepCheck(poseWorldVel, _trackerThreshold, 0, 0)) {
-								trackerStepDetected = true;
-								oneTrackerStepping = true;
-								_timeLastTrackerStep = now;
-								if (disableHMD && useTrackers) {
-									_stepIntegrateSteps = 0;
-								}
-							}
-						}
-						//else if (deviceClass == vr::ETrackedDeviceClass::TrackedDeviceClass_Controller) {
-						//}
-					}
-					if (useTrackers) {
-						if (!disableHMD) {
-							if ((!oneTrackerStepping && (now - _timeLastTrackerStep) > _stepIntegrateStepLimit * 3)) {
-								trackerStepDetected = false;
-							}
-						}
-						else {
-							if ((!oneTrackerStepping && (now - _timeLastTrackerStep) > _stepIntegrateStepLimit)) {
-								trackerStepDetected = false;
-							}
-						}
-					}
-					if (_controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0) {
-						//check if first controller is running / jogging
-						hand1Vel = latestDevicePoses[_controllerDeviceIds[0]].vVelocity.v;
-						hand2Vel = latestDevicePoses[_controllerDeviceIds[1]].vVelocity.v;
-						if (scaleSpeedWithSwing) {
-							if (contVelSampleTime > _stepIntegrateStepLimit * 4) {
-								float frontVal = contVelSamples.front();
-								totalContYVel = totalContYVel - frontVal;
-								contVelSamples.pop_front();
-							}
-							else {
-								contVelSampleTime += tdiff;
-							}
-							contVelSamples.push_back((std::fabs(hand1Vel[1]) + std::fabs(hand2Vel[1])) / 2.0);
-							totalContYVel = totalContYVel + contVelSamples.back();
-							avgContYVel = totalContYVel / contVelSamples.size();
-						}
-						isRunning = isRunningStep(hand1Vel);
-						if (isRunning) {
-							_runIntegrateSteps = 0;
-						}
-						else {
-							isRunning = g_runPoseDetected;
-						}
-						if (!isRunning) {
-							isJogging = isJoggingStep(hand1Vel);
-							if (isJogging) {
-								_jogIntegrateSteps = 0;
-							}
-							else {
-								isJogging = g_jogPoseDetected;
-							}
-						}
-						//check if second controller is running / jogging
-						isRunning = isRunningStep(hand2Vel);
-						if (isRunning) {
-							_runIntegrateSteps = 0;
-						}
-						else {
-							isRunning = g_runPoseDetected;
-						}
-						if (!isRunning) {
-							isJogging = isJoggingStep(hand2Vel);
-							if (isJogging) {
-								_jogIntegrateSteps = 0;
-							}
-							else {
-								isJogging = g_jogPoseDetected;
-							}
-						}
-						if (g_jogPoseDetected) {
-							_jogIntegrateSteps += tdiff;
-							if (_jogIntegrateSteps > _stepIntegrateStepLimit) {
-								g_jogPoseDetected = false;
-								_jogIntegrateSteps = 0.0;
-								isJogging = false;
-								axisStateChange = true;
-							}
-						}
-						if (g_runPoseDetected) {
-							_runIntegrateSteps += tdiff;
-							if (_runIntegrateSteps > _stepIntegrateStepLimit) {
-								g_runPoseDetected = false;
-								_teleportUnpressed = false;
-								_runIntegrateSteps = 0.0;
-								isRunning = false;
-								axisStateChange = true;
-							}
-						}
-					}
-					_timeLastTick = now;
-					_stepIntegrateSteps += tdiff;
-				}
-				else {
-					isWalking = _stepPoseDetected;
-					isJogging = g_jogPoseDetected;
-					isRunning = g_runPoseDetected;
-					axisStateChange = true;
-				}
-				trackerStepDetected = trackerStepDetected || !useTrackers;
-				if (!isWalking || (useTrackers && !trackerStepDetected) || _stepIntegrateSteps >= (_stepIntegrateStepLimit)) {
-					_stepPoseDetected = false;
-					trackerStepDetected = false;
-					if (_hasUnTouchedStepAxis == 0) {
-						_stepIntegrateSteps = 0.0;
-					}
-					_jogIntegrateSteps = 0.0;
-					_runIntegrateSteps = 0.0;
-					contVelSamples.clear();
-					totalContYVel = 0.0;
-					avgContYVel = 0.0;
-					contVelSampleTime = 0.0;
-					peaksCount = 0;
-					g_stepPoseDetected = false;
-					g_jogPoseDetected = false;
-					g_runPoseDetected = false;
-				}
-				else {
-					if (_controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0) {
-						int deviceId = _controlUsedID;
-						if (_controlUsedID < 0) {
-							deviceId = _controllerDeviceIds[0];
-						}
-						if (useContDirForStraf || useContDirForRev) {
-							vr::HmdQuaternion_t qRotation = vrmath::quaternionFromRotationMatrix(latestDevicePoses[deviceId].mDeviceToAbsoluteTracking);
-
-							vr::HmdVector3d_t forward = { 0,0,-1 };
-							vr::HmdVector3d_t right = { 1,0,0 };
-							vr::HmdVector3d_t forwardRot = vrmath::quaternionRotateVector(qRotation, forward);
-							vr::HmdVector3d_t rightRot = vrmath::quaternionRotateVector(qRotation, right);
-
-							float pitch = (180 * std::asin(forwardRot.v[1])) / M_PI;
-							float yaw = (180 * std::asin(forwardRot.v[0])) / M_PI;
-							float roll = (180 * std::asin(rightRot.v[1])) / M_PI;
-							touchX = 0;
-							touchY = 1;
-							float diffYaw = (hmdYaw < 0 ? -1.0 : 1.0)*(hmdYaw - yaw);
-							hmdForward.v[1] = 0;
-							forwardRot.v[1] = 0;
-							double hmdForwardMag = (std::sqrt((hmdForward.v[0] * hmdForward.v[0]) + (hmdForward.v[2] * hmdForward.v[2])));
-							double forwardMag = (std::sqrt((forwardRot.v[0] * forwardRot.v[0]) + (forwardRot.v[2] * forwardRot.v[2])));
-							hmdForward.v[0] = hmdForward.v[0] / hmdForwardMag;
-							hmdForward.v[2] = hmdForward.v[2] / hmdForwardMag;
-							forwardRot.v[0] = forwardRot.v[0] / forwardMag;
-							forwardRot.v[2] = forwardRot.v[2] / forwardMag;
-							if (useContDirForStraf && useContDirForRev && (pitch > 77
-								|| (hmdForward.v[0] > 0.6 && forwardRot.v[0] < 0)
-								|| (hmdForward.v[2] > 0.6 && forwardRot.v[2] < 0)
-								|| (hmdForward.v[0] < -0.6 && forwardRot.v[0] > 0)
-								|| (hmdForward.v[2] < -0.6 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] > 0 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] < 0 && forwardRot.v[2] < 0)
-								|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] < 0 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] > 0 && forwardRot.v[2] < 0))) {
-								touchY = -1;
-								touchX = 0;
-							}
-							else if (useContDirForStraf && pitch < 77 && std::fabs(diffYaw) > 30) { //std::fabs(roll) > 45 ) {
-								if ((hmdForward.v[0] > 0.6 && forwardRot.v[2] > 0.6)
-									|| (hmdForward.v[2] > 0.6 && forwardRot.v[0] < -0.6)
-									|| (hmdForward.v[0] < -0.6 && forwardRot.v[2] < -0.6)
-									|| (hmdForward.v[2] < -0.6 && forwardRot.v[0] > 0.6)
-									|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] > 0)
-									|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] < 0)
-									|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[2] > 0)
-									|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[2] < 0)) {
-									touchX = 1;
-									if (std::fabs(diffYaw) > 66) {
-										touchY = 0;
-									}
-								}
-								else if ((hmdForward.v[0] > 0.6 && forwardRot.v[2] < -0.6)
-									|| (hmdForward.v[2] > 0.6 && forwardRot.v[0] > 0.6)
-									|| (hmdForward.v[0] < -0.6 && forwardRot.v[2] > 0.6)
-									|| (hmdForward.v[2] < -0.6 && forwardRot.v[0] < -0.6)
-									|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[2] > 0)
-									|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[2] < 0)
-									|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] < 0)
-									|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] > 0)) {
-									touchX = -1;
-									if (std::fabs(diffYaw) > 66) {
-										touchY = 0;
-									}
-								}
-							}
-							else if (!useContDirForStraf && useContDirForRev && (pitch > 77
-								|| (hmdForward.v[0] > 0.6 && forwardRot.v[0] < 0)
-								|| (hmdForward.v[2] > 0.6 && forwardRot.v[2] < 0)
-								|| (hmdForward.v[0] < -0.6 && forwardRot.v[0] > 0)
-								|| (hmdForward.v[2] < -0.6 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] > 0 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] < 0 && forwardRot.v[2] < 0)
-								|| (hmdForward.v[0] > 0.27 && hmdForward.v[2] < -0.27 && forwardRot.v[0] < 0 && forwardRot.v[2] > 0)
-								|| (hmdForward.v[0] < -0.27 && hmdForward.v[2] > 0.27 && forwardRot.v[0] > 0 && forwardRot.v[2] < 0))) {
-								touchY = -1;
-								touchX = 0;
-							}
-							//LOG(INFO) << "CONT Pitch,Yaw,Roll : " << pitch << ",(" << hmdYaw << "-" << yaw << ")=" << diffYaw << "," << roll;
-							//LOG(INFO) << "CONT Pitch,Yaw,Roll : " << pitch << "," <<  yaw << "," << roll;
-							//LOG(INFO) << "Cont Forward (x,y,z): " << forwardRot.v[0] << "," << forwardRot.v[1] << "," << forwardRot.v[2];
-							//LOG(INFO) << "HMD  Forward (x,y,z): " << hmdForward.v[0] << "," << hmdForward.v[1] << "," << hmdForward.v[2];
-						}
-						if (gameType == 0 || gameType == 1 || gameType == 2 || gameType == 3 || gameType == 4 || gameType == 5) {
-							axisState.x = 0;
-							axisState.y = walkTouch;
-							axisStateChange = axisStateChange || (isRunning && !g_runPoseDetected);
-							if (isRunning) {
-								axisState.y = runTouch;
-								g_runPoseDetected = true;
-							}
-							else if (isJogging) {
-								if (scaleSpeedWithSwing) {
-									axisState.y = getScaledTouch(jogTouch, runTouch, avgContYVel, handRunThreshold);
-								}
-								else {
-									axisState.y = jogTouch;
-								}
-								axisStateChange = axisStateChange || (!g_jogPoseDetected);
-								g_jogPoseDetected = true;
-							}
-							else {
-								if (scaleSpeedWithSwing) {
-									axisState.y = getScaledTouch(walkTouch, runTouch, avgContYVel, handRunThreshold);
-								}
-								else {
-									axisState.y = walkTouch;
-								}
-							}
-							if (useContDirForStraf || useContDirForRev) {
-								axisState.x = walkTouch * touchX;
-								if (isRunning) {
-									axisState.x = jogTouch * touchX;
-								}
-								else if (isJogging) {
-									axisState.x = runTouch * touchX;
-								}
-								axisState.y = axisState.y * touchY;
-							}
-							if (true || axisStateChange) {
-								if (axisState.y > 1) {
-									axisState.y = 1;
-								}
-								if (axisState.y < -1) {
-									axisState.y = -1;
-								}
-								try {
-									if (!_teleportUnpressed) {
-										stopClickMovement(deviceId);
-									}
-									applyAxisMovement(deviceId, axisState);
-									_hasUnTouchedStepAxis = 0;
-								}
-								catch (std::exception& e) {
-									//LOG(INFO) << "Exception caught while applying virtual step movement: " << e.what();
-								}
-							}
-						}
-						else if (gameType == 9999) {
-							applyClickMovement(deviceId);
-						}
-						else if (gameType == 6) {
-							applyGripMovement(deviceId);
-						}
-					}
-					if (gameType == 7) {
-						if (_teleportUnpressed) {
-							INPUT input[2];
-							input[0].type = INPUT_KEYBOARD;
-							input[0].ki.wVk = 0;
-							input[0].ki.wScan = MapVirtualKey(0x57, 0);
-							input[0].ki.dwFlags = KEYEVENTF_SCANCODE;
-							input[0].ki.time = 0;
-							input[0].ki.dwExtraInfo = 0;
-							SendInput(1, input, sizeof(INPUT));
-
-							_teleportUnpressed = false;
-						}
-					}
-					else if (gameType == 8) {
-						if (_teleportUnpressed) {
-							INPUT input[2];
-							input[0].type = INPUT_KEYBOARD;
-							input[0].ki.wVk = 0;
-							input[0].ki.wScan = MapVirtualKey(0x26, 0);
-							input[0].ki.dwFlags = KEYEVENTF_SCANCODE;
-							input[0].ki.time = 0;
-							input[0].ki.dwExtraInfo = 0;
-							SendInput(1, input, sizeof(INPUT));
-						}
-						_teleportUnpressed = false;
-					}
-				}
+		// Same engine as the driver's step detection, configured from the current settings every tick
+		vrwalkinplace::stepdetector::Config config;
+		config.useTrackers = useTrackers;
+		config.disableHmd = disableHMD;
+		config.hmdType = hmdType;
+		config.controlSelect = controlSelect;
+		config.scaleTouchWithSwing = scaleSpeedWithSwing;
+		config.useContDirForStraf = useContDirForStraf;
+		config.useContDirForRev = useContDirForRev;
+		memcpy(config.hmdThreshold.v, _hmdThreshold.v, sizeof(config.hmdThreshold.v));
+		memcpy(config.trackerThreshold.v, _trackerThreshold.v, sizeof(config.trackerThreshold.v));
+		config.handJogThreshold = handJogThreshold;
+		config.handRunThreshold = handRunThreshold;
+		config.walkTouch = walkTouch;
+		config.jogTouch = jogTouch;
+		config.runTouch = runTouch;
+		config.stepIntSec = (float)(_stepIntegrateStepLimit / 1000.0);
+		config.gameStepType = gameType;
+		_stepDetector.configure(config);
+		bool wasStepping = _stepDetector.stepDetected();
+		auto decision = _stepDetector.update(now, samples, vr::k_unMaxTrackedDeviceCount);
+		_stepPoseDetected = _stepDetector.stepDetected();
+		trackerStepDetected = _stepDetector.trackerStepDetected();
+		g_jogPoseDetected = _stepPoseDetected && _stepDetector.lastDecision().gait == vrwalkinplace::stepdetector::Gait::Jog;
+		g_runPoseDetected = _stepPoseDetected && _stepDetector.lastDecision().gait == vrwalkinplace::stepdetector::Gait::Run;
+
+		if (gameType == 0 || gameType == 1 || gameType == 2 || gameType == 3 || gameType == 4 || gameType == 5) {
+			if (!decision.changed) {
+				return;
 			}
-			else if (_hasUnTouchedStepAxis < 4) {
-				if (tdiff >= deltatime) {
-					int deviceId = _controlUsedID;
-					if (_controlUsedID < 0) {
-						deviceId = _controllerDeviceIds[0];
-					}
-					stopMovement(deviceId);
-					if (_hasUnTouchedStepAxis < 1000) {
-						_hasUnTouchedStepAxis++;
-					}
-					_teleportUnpressed = true;
+			if (decision.gait == vrwalkinplace::stepdetector::Gait::Stopped) {
+				stopMovement(decision.deviceId);
+				_teleportUnpressed = true;
+			}
+			else if (!_stepPoseDetected) {
+				// one intent for the whole ramp, the driver interpolates it at frame rate
+				if (!_rampDownSent) {
+					rampDownMovement(decision.deviceId, _stepIntegrateStepLimit / 2.0);
 				}
+				_teleportUnpressed = true;
 			}
 			else {
-				_stepIntegrateSteps = 0;
+				if (!_teleportUnpressed) {
+					stopClickMovement(decision.deviceId);
+				}
+				applyAxisMovement(decision.deviceId, { decision.axisX, decision.axisY });
 			}
+			return;
+		}
+
+		// Button and keyboard game types only follow the step state
+		uint32_t deviceId = _stepDetector.controllerDeviceId();
+		if (_stepPoseDetected) {
+			if (gameType == 9999 && deviceId != vrwalkinplace::stepdetector::Decision::invalidDeviceId) {
+				applyClickMovement(deviceId);
+			}
+			else if (gameType == 6 && deviceId != vrwalkinplace::stepdetector::Decision::invalidDeviceId) {
+				applyGripMovement(deviceId);
+			}
+			else if ((gameType == 7 || gameType == 8) && _teleportUnpressed) {
+				sendGameKey(false);
+				_teleportUnpressed = false;
+			}
+		}
+		else if (wasStepping) {
+			stopMovement(deviceId);
+			_teleportUnpressed = true;
 		}
 	}
 
@@ -1540,227 +1179,317 @@ namespace walkinplace {
 				|| (!g_isHoldingAccuracyButton && flipButtonUse)));
 	}
 
-	bool WalkInPlaceTabController::upAndDownStepCheck(vr::HmdVector3d_t vel, vr::HmdVector3d_t threshold, double roll, double pitch) {
-		bool stepParams = ((std::fabs(vel.v[2]) < threshold.v[2]) &&
-			(std::fabs(vel.v[0]) < threshold.v[0]) &&
-			((std::fabs(vel.v[1]) > threshold.v[1])
-				&& (std::fabs(vel.v[1]) > std::fabs(vel.v[0]) && std::fabs(vel.v[1]) > std::fabs(vel.v[2]))));
-		return stepParams;
-	}
-
-	bool WalkInPlaceTabController::nodCheck(float angVel) {
-		return false && angVel > pitchAngVelThreshold;
-	}
 
-	bool WalkInPlaceTabController::sideToSideStepCheck(vr::HmdVector3d_t vel, vr::HmdVector3d_t threshold) {
-		bool stepParams = ((std::fabs(vel.v[2]) > threshold.v[1] && std::fabs(vel.v[2]) > threshold.v[2]) ||
-			(std::fabs(vel.v[0]) > threshold.v[1] && std::fabs(vel.v[0]) > threshold.v[0]));
-		return stepParams;
-	}
-
-	bool WalkInPlaceTabController::isJoggingStep(float * vel) {
-		float magVel = std::fabs(vel[1]);// (std::abs(vel[0]) + std::abs(vel[1]) + std::abs(vel[2]));
-		return (std::fabs(vel[1]) > std::fabs(vel[0]) && std::fabs(vel[1]) > std::fabs(vel[2]))
-			&& (magVel > handJogThreshold);
-	}
+	/************ DRIVER LIBRARY DEPENDENT (VRWalkInPlace - VRInputEmulator) CODE *****************/
+	/*********************************************************************************************/
+	/*********************************************************************************************/
 
-	bool WalkInPlaceTabController::isRunningStep(float * vel) {
-		float magVel = std::fabs(vel[1]);// (std::abs(vel[0]) + std::abs(vel[1]) + std::abs(vel[2]));
-		return (std::fabs(vel[1]) > std::fabs(vel[0]) && std::fabs(vel[1]) > std::fabs(vel[2]))
-			&& (magVel > handRunThreshold);
-	}
 
-	float WalkInPlaceTabController::getScaledTouch(float minTouch, float maxTouch, float avgVel, float maxVel) {
-		float scaledTouch = maxTouch;
-		if (avgVel < maxVel) {
-			scaledTouch = (avgVel / maxVel);
+	// Makes sure the long-lived driver connection is up, reconnects at most once per _driverReconnectInterval
+	bool WalkInPlaceTabController::connectDriver() {
+		if (vrwalkinplace.isConnected()) {
+			return true;
+		}
+		auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		if (_timeLastDriverConnectAttempt > 0.0 && (now - _timeLastDriverConnectAttempt) < _driverReconnectInterval) {
+			return false;
 		}
-		if (scaledTouch < minTouch) {
-			scaledTouch = minTouch;
+		_timeLastDriverConnectAttempt = now;
+		try {
+			vrwalkinplace.connect();
+			LOG(INFO) << "Connected to driver component.";
+			_driverConnectErrorReported = false;
+			_locomotionBindingGameType = -1;
+			_lastLocomotionIntentValid = false;
+			_driverStepDetectionActive = false;
+			return true;
 		}
-		return scaledTouch > 1 ? 1 : scaledTouch;
+		catch (const std::exception& e) {
+			if (!_driverConnectErrorReported) {
+				LOG(ERROR) << "Could not connect to driver component: " << e.what();
+				_driverConnectErrorReported = true;
+			}
+		}
+		return false;
 	}
 
-
-	/************ DRIVER LIBRARY DEPENDENT (VRWalkInPlace - VRInputEmulator) CODE *****************/
-	/*********************************************************************************************/
-	/*********************************************************************************************/
+	void WalkInPlaceTabController::driverConnectionLost(const std::exception& e) {
+		LOG(WARNING) << "Lost connection to driver component: " << e.what();
+		// The server is most likely gone (e.g. vrserver restart), so don't wait for a disconnect reply
+		vrwalkinplace.disconnect(false);
+		_timeLastDriverConnectAttempt = 0.0;
+	}
 
 
 	void WalkInPlaceTabController::stopMovement(uint32_t deviceId) {
-		if (gameType == 0 || gameType == 1 || gameType == 2) {
+		if (gameType == 0 || gameType == 1 || gameType == 2 || gameType == 3 || gameType == 4 || gameType == 5) {
 			vr::VRControllerAxis_t axisState;
 			axisState.x = 0;
 			axisState.y = 0;
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				if (gameType != 1) {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+			if (connectDriver()) {
+				try {
+					sendLocomotionIntent(deviceId, vrwalkinplace::LocomotionGait::Stopped, axisState);
 				}
-				vrwalkinplace.openvrAxisEvent(deviceId, 0, axisState);
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUntouched, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while stopping virtual step movement: " << e.what();
-			}
-		}
-		else if (gameType == 3 || gameType == 4 || gameType == 5) {
-			vr::VRControllerAxis_t axisState;
-			axisState.x = 0;
-			axisState.y = 0;
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				if (gameType != 4) {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Axis2, 0.0);
+				catch (std::exception& e) {
+					driverConnectionLost(e);
 				}
-				vrwalkinplace.openvrAxisEvent(deviceId, 2, axisState);
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUntouched, deviceId, vr::k_EButton_Axis2, 0.0);
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while stopping virtual step movement: " << e.what();
 			}
 		}
 		else if (gameType == 6) {
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Grip, 0.0);
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while applying virtual grip movement: " << e.what();
+			if (connectDriver()) {
+				try {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Grip, 0.0);
+				}
+				catch (std::exception& e) {
+					driverConnectionLost(e);
+				}
 			}
 		}
 		else if (gameType == 9999) { //click only disabled atm
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while stopping virtual teleport movement: " << e.what();
+			if (connectDriver()) {
+				try {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+				}
+				catch (std::exception& e) {
+					driverConnectionLost(e);
+				}
 			}
 		}
-		else if (gameType == 7) {
-			INPUT input[2];
-			input[0].type = INPUT_KEYBOARD;
-			input[0].ki.wVk = 0;
-			input[0].ki.wScan = MapVirtualKey(0x57, 0);
-			input[0].ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
-			input[0].ki.time = 0;
-			input[0].ki.dwExtraInfo = 0;
-			SendInput(2, input, sizeof(INPUT));
+		else if (gameType == 7 || gameType == 8) {
+			sendGameKey(true);
 		}
-		else if (gameType == 8) {
-			INPUT input[2];
-			input[0].type = INPUT_KEYBOARD;
-			input[0].ki.wVk = 0;
-			input[0].ki.wScan = MapVirtualKey(0x26, 0);
-			input[0].ki.dwFlags = KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP;
-			input[0].ki.time = 0;
-			input[0].ki.dwExtraInfo = 0;
-			SendInput(2, input, sizeof(INPUT));
+	}
+
+	// Game types 7 and 8 walk with the W and the up arrow key
+	void WalkInPlaceTabController::sendGameKey(bool keyUp) {
+		INPUT input;
+		input.type = INPUT_KEYBOARD;
+		input.ki.wVk = 0;
+		input.ki.wScan = MapVirtualKey(gameType == 7 ? 0x57 : 0x26, 0);
+		input.ki.dwFlags = KEYEVENTF_SCANCODE | (keyUp ? KEYEVENTF_KEYUP : 0);
+		input.ki.time = 0;
+		input.ki.dwExtraInfo = 0;
+		SendInput(1, &input, sizeof(INPUT));
+	}
+
+	void WalkInPlaceTabController::rampDownMovement(uint32_t deviceId, double rampTimeMs) {
+		if (!connectDriver()) {
+			return;
+		}
+		try {
+			vr::VRControllerAxis_t axisState = { 0.0f, 0.0f };
+			sendLocomotionIntent(deviceId, vrwalkinplace::LocomotionGait::Stopped, axisState, (float)(rampTimeMs / 1000.0));
+			_rampDownSent = true;
+		}
+		catch (std::exception& e) {
+			driverConnectionLost(e);
 		}
 	}
 
 	void WalkInPlaceTabController::stopClickMovement(uint32_t deviceId) {
 		if (gameType == 0) {
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-				_teleportUnpressed = true;
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while stopping virtual step movement: " << e.what();
+			if (connectDriver()) {
+				try {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+					_teleportUnpressed = true;
+				}
+				catch (std::exception& e) {
+					driverConnectionLost(e);
+				}
 			}
 		}
 		else if (gameType == 3) {
-			vr::VRControllerAxis_t axisState;
-			axisState.x = 0;
-			axisState.y = 0;
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
-				_teleportUnpressed = true;
-			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while stopping virtual step movement: " << e.what();
+			if (connectDriver()) {
+				try {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
+					_teleportUnpressed = true;
+				}
+				catch (std::exception& e) {
+					driverConnectionLost(e);
+				}
 			}
 		}
 	}
 
 	void WalkInPlaceTabController::applyAxisMovement(uint32_t deviceId, vr::VRControllerAxis_t axisState) {
-		vrwalkinplace::VRWalkInPlace vrwalkinplace;
-		vrwalkinplace.connect();
-		if (gameType == 0 || gameType == 1 || gameType == 2) {
-			vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonTouched, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-			if (gameType == 0 ) {
+		if (!connectDriver()) {
+			return;
+		}
+		try {
+			if (gameType == 0 || gameType == 1 || gameType == 2 || gameType == 3 || gameType == 4 || gameType == 5) {
+				auto gait = vrwalkinplace::LocomotionGait::Walk;
 				if (g_runPoseDetected) {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+					gait = vrwalkinplace::LocomotionGait::Run;
 				}
-				else {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+				else if (g_jogPoseDetected) {
+					gait = vrwalkinplace::LocomotionGait::Jog;
 				}
-			} else if ( gameType == 2 ) {
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);				
+				sendLocomotionIntent(deviceId, gait, axisState);
 			}
-			vrwalkinplace.openvrAxisEvent(deviceId, 0, axisState);
 		}
-		else if (gameType == 3 || gameType == 4 || gameType == 5) {
-			vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonTouched, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
-			if (gameType == 3) {
-				if (g_runPoseDetected) {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
-				}
-				else {
-					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
-				}
-			} else if (gameType == 5) {
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_Knuckles_JoyStick, 0.0);
+		catch (std::exception& e) {
+			driverConnectionLost(e);
+		}
+	}
+
+	// The driver maps the intent to touchpad/joystick updates according to the binding of the current game type
+	bool WalkInPlaceTabController::updateLocomotionBinding() {
+		if (_locomotionBindingGameType != gameType) {
+			uint32_t axisId = 0;
+			vr::EVRButtonId buttonId = vr::k_EButton_SteamVR_Touchpad;
+			if (gameType == 3 || gameType == 4 || gameType == 5) {
+				axisId = 2;
+				buttonId = vr::k_EButton_Knuckles_JoyStick;
 			}
-			vrwalkinplace.openvrAxisEvent(deviceId, 2, axisState);
+			auto pressMode = vrwalkinplace::LocomotionPressMode::Never;
+			if (gameType == 0 || gameType == 3) {
+				pressMode = vrwalkinplace::LocomotionPressMode::OnRun;
+			}
+			else if (gameType == 2 || gameType == 5) {
+				pressMode = vrwalkinplace::LocomotionPressMode::Always;
+			}
+			if (!vrwalkinplace.setLocomotionBinding(axisId, buttonId, pressMode)) {
+				return false; // try again next tick
+			}
+			_locomotionBindingGameType = gameType;
+			_lastLocomotionIntentValid = false;
 		}
+		return true;
 	}
 
-	void WalkInPlaceTabController::applyClickMovement(uint32_t deviceId) {
-		if (_teleportUnpressed) {
-			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-				_teleportUnpressed = false;
+	void WalkInPlaceTabController::sendLocomotionIntent(uint32_t deviceId, vrwalkinplace::LocomotionGait gait, const vr::VRControllerAxis_t& axisState, float rampTime) {
+		if (!updateLocomotionBinding()) {
+			return;
+		}
+		if (rampTime <= 0.0f) {
+			_rampDownSent = false;
+		}
+		if (_lastLocomotionIntentValid && _lastLocomotionIntentDeviceId == deviceId && _lastLocomotionIntentGait == gait
+				&& _lastLocomotionIntentAxis.x == axisState.x && _lastLocomotionIntentAxis.y == axisState.y) {
+			return;
+		}
+		float speed = std::sqrt(axisState.x * axisState.x + axisState.y * axisState.y);
+		vr::HmdVector2_t direction = { { 0.0f, 1.0f } };
+		if (speed > 0.0f) {
+			direction.v[0] = axisState.x / speed;
+			direction.v[1] = axisState.y / speed;
+		}
+		if (vrwalkinplace.sendLocomotionIntent(deviceId, gait, speed, direction, rampTime)) {
+			_lastLocomotionIntentValid = true;
+			_lastLocomotionIntentDeviceId = deviceId;
+			_lastLocomotionIntentGait = gait;
+			_lastLocomotionIntentAxis = axisState;
+		}
+	}
+
+	void WalkInPlaceTabController::applyDriverStepDetect() {
+		if (!connectDriver()) {
+			return;
+		}
+		if (_controllerDeviceIds[0] < 0 || _controllerDeviceIds[1] < 0) {
+			for (auto info : deviceInfos) {
+				if (info->deviceClass == vr::TrackedDeviceClass_Controller && _controllerDeviceIds[0] != (int)info->openvrId) {
+					if (_controllerDeviceIds[0] < 0) {
+						_controllerDeviceIds[0] = info->openvrId;
+					}
+					else if (_controllerDeviceIds[1] < 0) {
+						_controllerDeviceIds[1] = info->openvrId;
+					}
+				}
 			}
-			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while applying virtual telport movement: " << e.what();
+		}
+		if (g_AccuracyButton >= 0 && _controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0) {
+			g_isHoldingAccuracyButton = false;
+			updateAccuracyButtonState(_controllerDeviceIds[0], true);
+			updateAccuracyButtonState(_controllerDeviceIds[1], false);
+		}
+		vrwalkinplace::ipc::Request_WalkInPlace_StepDetectionMode mode;
+		memset(&mode, 0, sizeof(mode)); // compared with memcmp below
+		mode.enableStepDetect = accuracyButtonOnOrDisabled();
+		mode.useTrackers = useTrackers;
+		mode.disableHMD = disableHMD;
+		mode.hmdType = hmdType;
+		mode.controlSelect = controlSelect;
+		mode.scaleTouchWithSwing = scaleSpeedWithSwing;
+		mode.useContDirForStraf = useContDirForStraf;
+		mode.useContDirForRev = useContDirForRev;
+		mode.hmdThreshold = _hmdThreshold;
+		mode.trackerThreshold = _trackerThreshold;
+		mode.handJogThreshold = handJogThreshold;
+		mode.handRunThreshold = handRunThreshold;
+		mode.walkTouch = walkTouch;
+		mode.jogTouch = jogTouch;
+		mode.runTouch = runTouch;
+		mode.stepIntSec = (float)(_stepIntegrateStepLimit / 1000.0);
+		mode.gameStepType = gameType;
+		try {
+			if (!updateLocomotionBinding()) {
+				return;
+			}
+			if (!_driverStepDetectionActive || memcmp(&mode, &_driverStepDetectionMode, sizeof(mode)) != 0) {
+				vrwalkinplace.setStepDetectionMode(mode);
+				_driverStepDetectionMode = mode;
+				_driverStepDetectionActive = true;
+			}
+			// The driver moves the player itself, the status is only shown, so it may be a few ticks old
+			vrwalkinplace::ipc::Reply_WalkInPlace_StepDetect status;
+			if (vrwalkinplace.pollStepDetectionStatus(status)) {
+				_stepPoseDetected = status.stepDetected;
+				trackerStepDetected = status.trackerStepDetected;
+				g_jogPoseDetected = status.gait == vrwalkinplace::LocomotionGait::Jog;
+				g_runPoseDetected = status.gait == vrwalkinplace::LocomotionGait::Run;
 			}
 		}
-		else {
+		catch (const std::exception& e) {
+			driverConnectionLost(e);
+		}
+	}
+
+	void WalkInPlaceTabController::stopDriverStepDetect() {
+		_driverStepDetectionActive = false;
+		_stepPoseDetected = false;
+		g_jogPoseDetected = false;
+		g_runPoseDetected = false;
+		if (!connectDriver()) {
+			return;
+		}
+		try {
+			auto mode = _driverStepDetectionMode;
+			mode.enableStepDetect = 0;
+			vrwalkinplace.setStepDetectionMode(mode);
+		}
+		catch (const std::exception& e) {
+			driverConnectionLost(e);
+		}
+	}
+
+	void WalkInPlaceTabController::applyClickMovement(uint32_t deviceId) {
+		if (connectDriver()) {
 			try {
-				vrwalkinplace::VRWalkInPlace vrwalkinplace;
-				vrwalkinplace.connect();
-				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
-				_teleportUnpressed = true;
+				if (_teleportUnpressed) {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+					_teleportUnpressed = false;
+				}
+				else {
+					vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Touchpad, 0.0);
+					_teleportUnpressed = true;
+				}
 			}
 			catch (std::exception& e) {
-				//LOG(INFO) << "Exception caught while resetting virtual telport movement: " << e.what();
+				driverConnectionLost(e);
 			}
 		}
-		_hasUnTouchedStepAxis = 0;
 	}
 
 	void WalkInPlaceTabController::applyGripMovement(uint32_t deviceId) {
-		try {
-			vrwalkinplace::VRWalkInPlace vrwalkinplace;
-			vrwalkinplace.connect();
-			vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Grip, 0.0);
-		}
-		catch (std::exception& e) {
-			//LOG(INFO) << "Exception caught while applying virtual telport movement: " << e.what();
+		if (connectDriver()) {
+			try {
+				vrwalkinplace.openvrButtonEvent(vrwalkinplace::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_Grip, 0.0);
+			}
+			catch (std::exception& e) {
+				driverConnectionLost(e);
+			}
 		}
-		_hasUnTouchedStepAxis = 0;
 	}
 
 
@@ -5,6 +5,9 @@
 #include <memory>
 #include <openvr.h>
 #include <vrwalkinplace.h>
+#include <posesession.h>
+#include <stepdetector.h>
+#include "TrackingSource.h"
 
 class QQuickWindow;
 
@@ -74,6 +77,42 @@ private:
 
 	unsigned settingsUpdateCounter = 0;
 
+	// persistent driver connection
+	unsigned driverHeartbeatCounter = 0;
+	double _timeLastDriverConnectAttempt = 0.0;
+	double _driverReconnectInterval = 1000;
+	bool _driverConnectErrorReported = false;
+	bool connectDriver();
+	void driverConnectionLost(const std::exception& e);
+
+	// locomotion state last sent to the driver (only changes are sent)
+	int _locomotionBindingGameType = -1;
+	bool _lastLocomotionIntentValid = false;
+	uint32_t _lastLocomotionIntentDeviceId = 0;
+	vrwalkinplace::LocomotionGait _lastLocomotionIntentGait = vrwalkinplace::LocomotionGait::Stopped;
+	vr::VRControllerAxis_t _lastLocomotionIntentAxis = { 0.0f, 0.0f };
+	bool _rampDownSent = false; // the driver ramps the axis down on its own
+	bool updateLocomotionBinding();
+	void sendLocomotionIntent(uint32_t deviceId, vrwalkinplace::LocomotionGait gait, const vr::VRControllerAxis_t& axisState, float rampTime = 0.0f);
+
+	// step detection running in the driver (only axis based game types), the overlay configures it and polls the status
+	bool useDriverStepDetection = false;
+	bool _driverStepDetectionActive = false;
+	vrwalkinplace::ipc::Request_WalkInPlace_StepDetectionMode _driverStepDetectionMode;
+	void applyDriverStepDetect();
+	void stopDriverStepDetect();
+
+	// step detection running in the overlay (all game types), the controller only maps its decisions to the game's input
+	vrwalkinplace::stepdetector::StepDetector _stepDetector;
+	void sendGameKey(bool keyUp);
+
+	// pose session recording, each snapshot of the overlay's detection loop goes into the file
+	std::unique_ptr<vrwalkinplace::posesession::Writer> _poseRecorder;
+	void recordPoses(double timeMs);
+
+	// where the tracking data comes from, the runtime unless a mock is set for headless runs
+	std::shared_ptr<TrackingSource> _tracking = std::make_shared<OpenVRTrackingSource>();
+
 	std::vector<WalkInPlaceProfile> walkInPlaceProfiles;
 
 	vr::TrackedDevicePose_t latestDevicePoses[vr::k_unMaxTrackedDeviceCount];
@@ -85,10 +124,8 @@ private:
 	vr::HmdVector3d_t cont2Vel = { 0, 0, 0 };
 	vr::HmdVector3d_t _hmdThreshold = { 0.27, 0.12, 0.27 };
 	vr::HmdVector3d_t _trackerThreshold = { 0.27, 0.10, 0.27 };
-	vr::HmdVector3d_t hmdForward = { 0,0,-1 };
 	vr::VROverlayHandle_t overlayHandle;
 
-	std::list<float> contVelSamples;
 	bool identifyControlTimerSet = false;
 	bool stepDetectEnabled = false;
 	bool _stepPoseDetected = false;
@@ -108,7 +145,6 @@ private:
 	bool g_isHoldingAccuracyButton2 = false;
 	bool g_useButtonAsToggle = false;
 	bool g_buttonToggled = true;
-	bool g_stepPoseDetected = false;
 	bool g_jogPoseDetected = false;
 	bool g_runPoseDetected = false;
 	bool g_accuracyButtonWithTouch = false;
@@ -123,45 +159,16 @@ private:
 	int useAccuracyButton = 2;
 	int g_AccuracyButton = -1;
 	int _teleportUnpressed = true;
-	int _hasUnTouchedStepAxis = 50;
-	int peaksCount = 0;
 	int _controllerDeviceIds[2] = { -1, -1 };
 	int _controlUsedID = -1;
-	int stepPeaksToStart = 3;
-	float hmdYaw = 0;
-	float contYaw = 0;
-	float contRoll = 0;
-	float contPitch = 0;
-	float touchX = 0;
-	float touchY = 0;
 	float handWalkThreshold = 0.02;
 	float handJogThreshold = 1.0;
 	float handRunThreshold = 2.0;
 	float walkTouch = 0.35;
 	float jogTouch = 1.0;
 	float runTouch = 1.0;
-	float minTouch = 0.45;
-	float trackerLastYVel = 0;
-	float hmdLastYVel = 0;
-	float cont1LastYVel = 0;
-	float cont2LastYVel = 0;
-	float hmdLastPitch = 0;
-	float hmdPitchAngVel = 0;
-	float pitchAngVelThreshold = 90;
-	float stepPeaksFullSpeed = 13.0;
-	float avgContYVel = 0.0;
-	float totalContYVel = 0.0;
-	double _stepFrequencyMin = 250;
-	double _stepIntegrateSteps = 0.0;
-	double _jogIntegrateSteps = 0.0;
-	double _runIntegrateSteps = 0.0;
 	double _stepIntegrateStepLimit = 500;
-	double _timeLastTick = 0.0;
 	double _velStepTime = 0.0;
-	double _timeLastStepPeak = 0.0;
-	double _timeLastTrackerStep = 0.0;
-	double _timeLastNod = 0.0;
-	double contVelSampleTime = 0.0;
 	double identifyControlLastTime = 99999;
 	double identifyControlTimeOut = 6000;
 	double _timeLastGraphPoint = 0.0;
@@ -171,6 +178,11 @@ public:
 	void initStage1();
 	void initStage2(OverlayController* parent, QQuickWindow* widget);
 
+	// Has to be called before initStage2(), parent and widget may then be null
+	void setTrackingSource(std::shared_ptr<TrackingSource> source) {
+		_tracking = source;
+	}
+
 	void eventLoopTick();
 	void handleEvent(const vr::VREvent_t& vrEvent);
 
@@ -204,6 +216,8 @@ public:
 	Q_INVOKABLE bool getAccuracyButtonIsToggle();
 	Q_INVOKABLE bool getAccuracyButtonFlip();
 	Q_INVOKABLE bool isStepDetectionEnabled();
+	Q_INVOKABLE bool getUseDriverStepDetection();
+	Q_INVOKABLE bool isPoseRecording();
 	Q_INVOKABLE bool isStepDetected();
 	Q_INVOKABLE QList<qreal> getGraphPoses();
 	Q_INVOKABLE void setupStepGraph();
@@ -219,6 +233,8 @@ public:
 public slots:
     void enableStepDetection(bool enable);
 	void enableBeta(bool enable);
+	void setUseDriverStepDetection(bool val);
+	void setPoseRecording(bool enable);
 	void setStepTime(double value);
 	void setHMDThreshold(float xz, float y);
 	void setUseTrackers(bool val);
@@ -244,14 +260,9 @@ public slots:
 	void applyStepPoseDetect();
 
 	bool accuracyButtonOnOrDisabled();
-	bool upAndDownStepCheck(vr::HmdVector3d_t vel, vr::HmdVector3d_t threshold, double roll, double pitch);
-	bool nodCheck(float angVel);
-	bool sideToSideStepCheck(vr::HmdVector3d_t vel, vr::HmdVector3d_t threshold);
-	bool isJoggingStep(float * vel);
-	bool isRunningStep(float * vel);
-	float getScaledTouch(float minTouch, float maxTouch, float avgVel, float maxVel);
 
 	void stopMovement(uint32_t deviceId);
+	void rampDownMovement(uint32_t deviceId, double rampTimeMs);
 	void stopClickMovement(uint32_t deviceId);
 	void applyAxisMovement(uint32_t deviceId, vr::VRControllerAxis_t axisState);
 	void applyClickMovement(uint32_t deviceId);
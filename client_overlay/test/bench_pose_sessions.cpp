@@ -0,0 +1,40 @@
+#include "../src/posereplay.h"
+#include <cstring>
+#include <iostream>
+
+
+/*
+* Step detection benchmark over labeled pose sessions, the overlay's -benchposes without Qt and OpenVR.
+*
+* bench_pose_sessions <manifest> [baseline file] [option=value ...]
+* Fails when detection latencies, missed steps, false positives or gait misclassifications are worse than the
+* baseline, slower tick times only print a warning. Without an existing baseline file the results are written to it.
+*/
+
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: bench_pose_sessions <manifest> [baseline file] [option=value ...]" << std::endl;
+		return 1;
+	}
+	std::string baselinePath;
+	vrwalkinplace::stepdetector::Config config;
+	for (int k = 2; k < argc; ++k) {
+		if (std::strchr(argv[k], '=') == nullptr && baselinePath.empty()) {
+			baselinePath = argv[k];
+		}
+		else if (!walkinplace::parseStepDetectorOption(config, argv[k])) {
+			std::cerr << "Ignoring unknown step detection option " << argv[k] << std::endl;
+		}
+	}
+	try {
+		if (walkinplace::benchmarkPoseSessions(std::cout, argv[1], baselinePath, config) > 0) {
+			return 1;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "FAILED: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include <posesession.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+/*
+* Writes the synthetic labeled pose sessions of bench_pose_sessions and their manifest.
+*
+* One HMD (device 0) and two controllers (devices 1 and 2) at 90 Hz. Standing and nodding players only jitter, the
+* nod moves the head forward with a vertical velocity below the default threshold. Walking players bob their head at
+* 1.8 steps per second, jogging and running players swing their hands as well. Jitter comes from a fixed seed, so
+* the files are the same on every run.
+*/
+
+
+using namespace vrwalkinplace::posesession;
+
+
+#define CORPUS_FRAME_MS (1000.0 / 90.0)
+#define CORPUS_STEP_HZ 1.8
+
+
+static const double pi = 3.14159265358979323846;
+
+static uint32_t randomState = 12345;
+
+// Uniform in [-1, 1]
+static double jitter() {
+	randomState = randomState * 1664525u + 1013904223u;
+	return (double)(randomState >> 8) / (double)(1u << 23) - 1.0;
+}
+
+
+struct Profile {
+	const char* name;
+	double seconds;
+	double stepStart; // seconds, moving profiles only
+	double stepStop;
+	double hmdBob; // peak vertical hmd velocity while stepping
+	double handSwing; // peak vertical hand velocity while stepping
+	double nod; // peak vertical hmd velocity of the nod, with the same forward velocity
+};
+
+
+static void writeSession(const std::string& path, const Profile& profile) {
+	Writer writer;
+	writer.open(path);
+	DeviceSample devices[3] = {};
+	for (uint32_t i = 0; i < 3; ++i) {
+		devices[i].flags = Flag_PoseIsValid | Flag_DeviceIsConnected;
+		devices[i].deviceClass = i == 0 ? 1 : 2;
+		devices[i].rotation[0] = 1.0f;
+	}
+	double headY = 1.7;
+	uint32_t frames = (uint32_t)(profile.seconds * 1000.0 / CORPUS_FRAME_MS);
+	for (uint32_t n = 0; n < frames; ++n) {
+		double t = n * CORPUS_FRAME_MS / 1000.0;
+		bool stepping = t >= profile.stepStart && t < profile.stepStop;
+		double phase = 2.0 * pi * CORPUS_STEP_HZ * t;
+		double hmdVel[3] = { 0.02 * jitter(), 0.03 * jitter(), 0.02 * jitter() };
+		if (stepping) {
+			hmdVel[1] += profile.hmdBob * std::sin(2.0 * phase);
+		}
+		if (profile.nod > 0.0) {
+			double nod = std::sin(2.0 * pi * 0.5 * t);
+			hmdVel[1] += profile.nod * nod;
+			hmdVel[2] -= profile.nod * nod;
+		}
+		headY += hmdVel[1] * CORPUS_FRAME_MS / 1000.0;
+		for (int k = 0; k < 3; ++k) {
+			devices[0].velocity[k] = (float)hmdVel[k];
+		}
+		devices[0].position[1] = (float)headY;
+		for (uint32_t i = 1; i < 3; ++i) {
+			double swing = stepping ? profile.handSwing * std::sin(phase + (i == 1 ? 0.0 : pi)) : 0.0;
+			devices[i].velocity[0] = (float)(0.05 * jitter());
+			devices[i].velocity[1] = (float)(swing + 0.05 * jitter());
+			devices[i].velocity[2] = (float)(0.05 * jitter());
+			devices[i].position[0] = i == 1 ? -0.2f : 0.2f;
+			devices[i].position[1] = 1.0f;
+			devices[i].position[2] = -0.2f;
+		}
+		writer.append(1000.0 + n * CORPUS_FRAME_MS, devices, 3);
+	}
+	writer.close();
+}
+
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: make_pose_corpus <directory>" << std::endl;
+		return 1;
+	}
+	std::string dir = std::string(argv[1]) + "/";
+	const Profile profiles[] = {
+		{ "stand", 3.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+		{ "nod", 3.0, 0.0, 0.0, 0.0, 0.0, 0.08 },
+		{ "walk", 4.0, 1.0, 3.0, 0.3, 0.4, 0.0 },
+		{ "jog", 4.0, 1.0, 3.0, 0.4, 1.5, 0.0 },
+		{ "run", 4.0, 1.0, 3.0, 0.5, 2.6, 0.0 }
+	};
+	std::ofstream manifest(dir + "manifest.txt");
+	manifest << "# Synthetic sessions written by make_pose_corpus: <file> <profile> [<first step s> <stop s>]" << std::endl;
+	try {
+		for (auto& p : profiles) {
+			std::string file = std::string(p.name) + ".poses";
+			writeSession(dir + file, p);
+			manifest << file << " " << p.name;
+			if (p.stepStop > p.stepStart) {
+				manifest << " " << p.stepStart << " " << p.stepStop;
+			}
+			manifest << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "FAILED: " << e.what() << std::endl;
+		return 1;
+	}
+	if (!manifest) {
+		std::cerr << "FAILED: could not write " << dir << "manifest.txt" << std::endl;
+		return 1;
+	}
+	return 0;
+}
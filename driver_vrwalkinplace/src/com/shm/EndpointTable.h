@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <boost/interprocess/ipc/message_queue.hpp>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Connected ipc clients, owned by the ipc thread.
+*
+* Endpoints live in a slab that only grows up to maxEndpoints. Freed slots are reused, a client id is
+* (generation << 16 | slot + 1) so that requests with the id of a former slot owner never reach the new one.
+* Every client holds a lease that any of its requests renews, expire() drops those that stayed silent for too long.
+*/
+class EndpointTable {
+public:
+	struct Endpoint {
+		uint32_t clientId = 0; // 0 = free slot
+		std::string queueName;
+		std::shared_ptr<boost::interprocess::message_queue> queue; // reply queue
+		int64_t lastSeenUs = 0;
+	};
+
+	static const uint32_t maxEndpoints = 0xffff;
+
+	/** Returns nullptr when all slots are taken. */
+	Endpoint* add(const std::string& queueName, std::shared_ptr<boost::interprocess::message_queue> queue, int64_t nowUs) {
+		uint32_t slot;
+		if (!_freeSlots.empty()) {
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+		}
+		else if (_slots.size() < maxEndpoints) {
+			slot = (uint32_t)_slots.size();
+			_slots.emplace_back();
+			_generations.push_back(0);
+		}
+		else {
+			return nullptr;
+		}
+		auto generation = ++_generations[slot] & 0xffff;
+		if (generation == 0) {
+			generation = _generations[slot] = 1;
+		}
+		auto& e = _slots[slot];
+		e.clientId = (generation << 16) | (slot + 1);
+		e.queueName = queueName;
+		e.queue = std::move(queue);
+		e.lastSeenUs = nowUs;
+		_byQueueName[queueName] = e.clientId;
+		_size++;
+		return &e;
+	}
+
+	Endpoint* find(uint32_t clientId) {
+		auto slot = (clientId & 0xffff) - 1;
+		if (slot >= _slots.size() || _slots[slot].clientId != clientId || clientId == 0) {
+			return nullptr;
+		}
+		return &_slots[slot];
+	}
+
+	Endpoint* findByQueueName(const std::string& queueName) {
+		auto i = _byQueueName.find(queueName);
+		return i != _byQueueName.end() ? find(i->second) : nullptr;
+	}
+
+	/** Refreshes the lease, returns false for unknown ids. */
+	bool touch(uint32_t clientId, int64_t nowUs) {
+		auto e = find(clientId);
+		if (!e) {
+			return false;
+		}
+		e->lastSeenUs = nowUs;
+		return true;
+	}
+
+	bool remove(uint32_t clientId) {
+		auto e = find(clientId);
+		if (!e) {
+			return false;
+		}
+		_byQueueName.erase(e->queueName);
+		e->clientId = 0;
+		e->queueName.clear();
+		e->queue.reset();
+		_freeSlots.push_back((clientId & 0xffff) - 1);
+		_size--;
+		return true;
+	}
+
+	/** Removes endpoints not seen for leaseUs, calls f(clientId) for each before it is removed. */
+	template<typename F>
+	uint32_t expire(int64_t nowUs, int64_t leaseUs, F f) {
+		uint32_t count = 0;
+		for (auto& e : _slots) {
+			if (e.clientId != 0 && nowUs - e.lastSeenUs > leaseUs) {
+				auto clientId = e.clientId;
+				f(clientId);
+				remove(clientId);
+				count++;
+			}
+		}
+		return count;
+	}
+
+	uint32_t size() const {
+		return _size;
+	}
+
+	uint32_t capacity() const {
+		return (uint32_t)_slots.size();
+	}
+
+private:
+	std::vector<Endpoint> _slots;
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _freeSlots;
+	std::unordered_map<std::string, uint32_t> _byQueueName;
+	uint32_t _size = 0;
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
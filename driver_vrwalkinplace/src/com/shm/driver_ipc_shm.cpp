@@ -1,27 +1,60 @@
 #include "driver_ipc_shm.h"
-#include "../../driver/ServerDriver.h"
+#include "../../driver/DriverCore.h"
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <ipc_protocol.h>
+#include <ipc_frame.h>
 #include <openvr_math.h>
+#include <algorithm>
 
 namespace vrwalkinplace {
 	namespace driver {
 
 
-		void IpcShmCommunicator::init(ServerDriver* driver) {
+		void IpcShmCommunicator::init(DriverCore* driver) {
 			_driver = driver;
 			_ipcThreadStopFlag = false;
+			try {
+				boost::interprocess::named_semaphore::remove(ipc::shmRingDoorbellName);
+				_ringDoorbell.reset(new boost::interprocess::named_semaphore(boost::interprocess::create_only, ipc::shmRingDoorbellName, 0));
+				_ringThread = std::thread(_ringThreadFunc, this, driver);
+			}
+			catch (std::exception& e) {
+				_ringDoorbell.reset();
+				LOG(ERROR) << "Could not create shared memory ring doorbell, clients fall back to the message queue: " << e.what();
+			}
 			_ipcThread = std::thread(_ipcThreadFunc, this, driver);
 		}
 
 		void IpcShmCommunicator::shutdown() {
-			if (_ipcThreadRunning) {
-				_ipcThreadStopFlag = true;
+			_ipcThreadStopFlag = true;
+			if (_ipcThread.joinable()) {
+				// Wake up the blocking receive, a full queue means the thread is awake anyway
+				try {
+					boost::interprocess::message_queue queue(boost::interprocess::open_only, _ipcQueueName.c_str());
+					ipc::ConnectRequest wakeup;
+					wakeup.type = ipc::RequestType::None;
+					queue.try_send(&wakeup, sizeof(wakeup), 0);
+				}
+				catch (std::exception&) {
+					// the queue is gone, so is the thread
+				}
 				_ipcThread.join();
 			}
+			if (_ringThread.joinable()) {
+				_ringDoorbell->post();
+				_ringThread.join();
+			}
+			{
+				std::lock_guard<std::mutex> lock(_ringsMutex);
+				_ipcChannels.clear();
+			}
+			if (_ringDoorbell) {
+				_ringDoorbell.reset();
+				boost::interprocess::named_semaphore::remove(ipc::shmRingDoorbellName);
+			}
 		}
 
-		void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver * driver) {
+		void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, DriverCore* driver) {
 			_this->_ipcThreadRunning = true;
 			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread started";
 			try {
@@ -31,162 +64,510 @@ namespace vrwalkinplace {
 					boost::interprocess::create_only,
 					_this->_ipcQueueName.c_str(),
 					100,					//max message number
-					sizeof(ipc::Request)    //max message size
+					sizeof(ipc::FramePacket)    //max message size
 				);
 
+				ipc::LatencyStats latency;
+				int64_t lastExpiryUs = ipc::monotonicTimeUs();
+				// Look for expired leases a few times per lease
+				int64_t expiryIntervalUs = std::min<int64_t>(IPC_CLIENT_HEARTBEAT_INTERVAL_MS * 1000ll, _this->_clientLeaseUs / 5);
 				while (!_this->_ipcThreadStopFlag) {
 					try {
-						ipc::Request message;
+						// Large enough for a FramePacket and a ConnectRequest
+						alignas(ipc::ConnectRequest) uint8_t buffer[sizeof(ipc::FramePacket)];
 						uint64_t recv_size;
 						unsigned priority;
-						boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-						if (messageQueue.timed_receive(&message, sizeof(ipc::Request), recv_size, priority, timeout)) {
-							LOG(TRACE) << "CServerDriver::_ipcThreadFunc: IPC request received ( type " << (int)message.type << ")";
-							if (recv_size == sizeof(ipc::Request)) {
-								switch (message.type) {
+						// Blocks until a request arrives, shutdown() posts a wakeup message or it is time to look for expired leases.
+						// Queued movement requests have a higher priority and are received before any control request.
+						auto received = messageQueue.timed_receive(buffer, sizeof(buffer), recv_size, priority,
+							boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(expiryIntervalUs));
+						auto nowUs = ipc::monotonicTimeUs();
+						if (nowUs - lastExpiryUs >= expiryIntervalUs) {
+							lastExpiryUs = nowUs;
+							_this->_expireClients(nowUs, driver);
+						}
+						if (!received) {
+							continue;
+						}
+						auto& stats = driver->stats();
+						auto depth = (uint32_t)messageQueue.get_num_msg();
+						stats.messageQueueDepth.store(depth, std::memory_order_relaxed);
+						ipc::StatsPage::updateHighWater(stats.messageQueueHighWater, depth);
+						uint32_t marker = 0;
+						if (recv_size >= sizeof(marker)) {
+							memcpy(&marker, buffer, sizeof(marker));
+						}
+						if (marker == IPC_FRAME_MARKER) {
+							auto packet = reinterpret_cast<const ipc::FramePacket*>(buffer);
+							BLOG(TRACE, "CServerDriver::_ipcThreadFunc: IPC packet received ( {} frames)", packet->frameCount);
+							if (!packet->forEach(recv_size, [&](const ipc::Request& message) { _this->_handleQueueRequest(message, packet->clientId, driver, latency); })) {
+								LOG(ERROR) << "Error in ipc server receive loop: malformed packet (" << recv_size << " bytes)";
+							}
+						}
+						else if (recv_size == sizeof(ipc::ConnectRequest)) {
+							// a connect request of a client of any version, or the wakeup from shutdown()
+							ipc::ConnectRequest message;
+							memcpy(&message, buffer, sizeof(ipc::ConnectRequest));
+							BLOG(TRACE, "CServerDriver::_ipcThreadFunc: IPC request received ( type {})", (int)message.type);
+							if (message.type == ipc::RequestType::IPC_ClientConnect || message.type == ipc::RequestType::None) {
+								_this->_handleQueueRequest(message.request(), 0, driver, latency);
+							}
+							else {
+								LOG(ERROR) << "Error in ipc server receive loop: unframed request ( type " << (int)message.type << ")";
+							}
+						}
+						else {
+							LOG(ERROR) << "Error in ipc server receive loop: received size is wrong (" << recv_size << ")";
+						}
+					}
+					catch (std::exception& ex) {
+						LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
+					}
+				}
+				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
+			}
+			catch (std::exception& ex) {
+				LOG(ERROR) << "Exception caught in ipc server thread: " << ex.what();
+			}
+			_this->_ipcThreadRunning = false;
+			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
+		}
 
-								case ipc::RequestType::IPC_ClientConnect:
-								{
-									try {
-										auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
-										ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
-										reply.messageId = message.msg.ipc_ClientConnect.messageId;
-										reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
-										if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION) {
-											auto clientId = _this->_ipcClientIdNext++;
-											if (_this->_ipcClientIdNext > 100) {
-												_this->_ipcClientIdNext = 1;
-												clientId = 1;
-												_this->_ipcEndpoints.clear();
-											}
-											if (clientId == 7) {
-												LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
-											}
-											_this->_ipcEndpoints.insert({ clientId, queue });
-											reply.msg.ipc_ClientConnect.clientId = clientId;
-											reply.status = ipc::ReplyStatus::Ok;
-											//LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
-										}
-										else {
-											reply.msg.ipc_ClientConnect.clientId = 0;
-											reply.status = ipc::ReplyStatus::InvalidVersion;
-											LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
-												<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
-										}
-										queue->send(&reply, sizeof(ipc::Reply), 0);
-									}
-									catch (std::exception& e) {
-										LOG(ERROR) << "Error during client connect: " << e.what();
-									}
-								}
-								break;
+		// Handles one request from the server queue, either an unframed connect request or one frame of a packet.
+		// Every request of a connected client renews its lease, whatever its lane.
+		void IpcShmCommunicator::_handleQueueRequest(const ipc::Request& message, uint32_t senderClientId, DriverCore* driver, ipc::LatencyStats& latency) {
+			if (senderClientId != 0) {
+				_touchClient(senderClientId);
+			}
+			if (message.type != ipc::RequestType::None) {
+				_logLatency("message queue", latency, message.sendTime);
+				auto& stats = driver->stats();
+				stats.countRequest(message.type);
+				auto latencyUs = ipc::monotonicTimeUs() - message.sendTime;
+				stats.dispatchLatency[ipc::StatsTransport_MessageQueue].add(latencyUs);
+				stats.laneLatency[(uint32_t)ipc::requestLane(message.type)].add(latencyUs);
+			}
+			switch (message.type) {
 
-								case ipc::RequestType::IPC_ClientDisconnect:
-								{
-									ipc::Reply reply(ipc::ReplyType::GenericReply);
-									reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
-									auto i = _this->_ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										reply.status = ipc::ReplyStatus::Ok;
-										auto msgQueue = i->second;
-										_this->_ipcEndpoints.erase(i);
-										//LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
-										if (reply.messageId != 0) {
-											msgQueue->send(&reply, sizeof(ipc::Reply), 0);
-										}
-									}
-									else {
-										LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
-									}
-								}
-								break;
+			case ipc::RequestType::None: // wakeup from shutdown()
+				break;
 
-								case ipc::RequestType::IPC_Ping:
+			case ipc::RequestType::IPC_ClientConnect:
+			{
+				try {
+					std::string queueName(message.msg.ipc_ClientConnect.queueName, strnlen(message.msg.ipc_ClientConnect.queueName, sizeof(message.msg.ipc_ClientConnect.queueName)));
+					std::shared_ptr<boost::interprocess::message_queue> queue;
+					// The same endpoint connecting again lost its client id (e.g. its connect timed out), keep the opened queue
+					auto previous = _ipcEndpoints.findByQueueName(queueName);
+					if (previous) {
+						queue = previous->queue;
+						_removeClient(previous->clientId, driver);
+					}
+					else {
+						queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, queueName.c_str());
+					}
+					ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
+					reply.messageId = message.msg.ipc_ClientConnect.messageId;
+					reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+					auto clientVersion = message.msg.ipc_ClientConnect.ipcProcotolVersion;
+					auto endpoint = clientVersion == IPC_PROTOCOL_VERSION ? _ipcEndpoints.add(queueName, queue, ipc::monotonicTimeUs()) : nullptr;
+					if (endpoint) {
+						auto clientId = endpoint->clientId;
+						reply.msg.ipc_ClientConnect.transportType = ipc::TransportType::MessageQueue;
+						if (message.msg.ipc_ClientConnect.transportType == ipc::TransportType::ShmRing && _ringDoorbell) {
+							try {
+								_ClientChannel channel;
+								channel.segment = std::make_shared<ipc::ClientChannelSegment>(boost::interprocess::open_only,
+									std::string(message.msg.ipc_ClientConnect.queueName) + ipc::shmChannelNameSuffix);
 								{
-									LOG(TRACE) << "Ping received: clientId " << message.msg.ipc_Ping.clientId << ", nonce " << message.msg.ipc_Ping.nonce;
-									auto i = _this->_ipcEndpoints.find(message.msg.ipc_Ping.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										ipc::Reply reply(ipc::ReplyType::IPC_Ping);
-										reply.messageId = message.msg.ipc_Ping.messageId;
-										reply.status = ipc::ReplyStatus::Ok;
-										reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
-										if (reply.messageId != 0) {
-											i->second->send(&reply, sizeof(ipc::Reply), 0);
-										}
-									}
-									else {
-										LOG(ERROR) << "Error during ping: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
-									}
+									std::lock_guard<std::mutex> lock(_ringsMutex);
+									_ipcChannels[clientId] = channel;
 								}
-								break;
+								// The ring thread may be sleeping without knowing about the new channel
+								_ringDoorbell->post();
+								reply.msg.ipc_ClientConnect.transportType = ipc::TransportType::ShmRing;
+							}
+							catch (std::exception& e) {
+								LOG(ERROR) << "Could not open client channel, falling back to the message queue: " << e.what();
+							}
+						}
+						reply.msg.ipc_ClientConnect.clientId = clientId;
+						reply.status = ipc::ReplyStatus::Ok;
+						//LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
+					}
+					else if (clientVersion == IPC_PROTOCOL_VERSION) {
+						reply.msg.ipc_ClientConnect.clientId = 0;
+						reply.status = ipc::ReplyStatus::TooManyDevices;
+						LOG(ERROR) << "Client (endpoint \"" << queueName << "\") rejected: " << _ipcEndpoints.size() << " clients connected";
+					}
+					else {
+						reply.msg.ipc_ClientConnect.clientId = 0;
+						reply.status = ipc::ReplyStatus::InvalidVersion;
+						LOG(INFO) << "Client (endpoint \"" << queueName << "\") reports incompatible ipc version "
+							<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
+					}
+					_sendReply(*queue, reply);
+				}
+				catch (std::exception& e) {
+					LOG(ERROR) << "Error during client connect: " << e.what();
+				}
+			}
+			break;
 
-								case ipc::RequestType::OpenVR_PoseUpdate:
-								{
-									//if (vr::VRServerDriverHost()) {
-									//	driver->openvr_poseUpdate(message.msg.ipc_PoseUpdate.deviceId, message.msg.ipc_PoseUpdate.flipYaw, message.timestamp);
-									//}
-								}
-								break;
+			case ipc::RequestType::IPC_ClientDisconnect:
+			{
+				ipc::Reply reply(ipc::ReplyType::GenericReply);
+				reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
+				auto endpoint = _ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
+				if (endpoint) {
+					reply.status = ipc::ReplyStatus::Ok;
+					auto msgQueue = endpoint->queue;
+					_removeClient(message.msg.ipc_ClientDisconnect.clientId, driver);
+					//LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
+					if (reply.messageId != 0) {
+						_sendReply(*msgQueue, reply);
+					}
+				}
+				else {
+					LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
+				}
+			}
+			break;
 
-								case ipc::RequestType::OpenVR_ButtonEvent:
-								{
-									try {
-										if (vr::VRServerDriverHost()) {
-											auto& e = message.msg.ipc_ButtonEvent;
-											driver->openvr_buttonEvent(e.deviceId, e.eventType, e.buttonId, e.timeOffset);
-										}
-									}
-									catch (std::exception& e) {
-										LOG(ERROR) << "Error in button event ipc thread: " << e.what();
-									}
-								}
-								break;
+			case ipc::RequestType::IPC_Ping:
+			{
+				BLOG(TRACE, "Ping received: clientId {}, nonce {}", message.msg.ipc_Ping.clientId, message.msg.ipc_Ping.nonce);
+				auto endpoint = _touchClient(message.msg.ipc_Ping.clientId);
+				if (endpoint) {
+					ipc::Reply reply(ipc::ReplyType::IPC_Ping);
+					reply.messageId = message.msg.ipc_Ping.messageId;
+					reply.status = ipc::ReplyStatus::Ok;
+					reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
+					if (reply.messageId != 0) {
+						_sendReply(*endpoint->queue, reply);
+					}
+				}
+				else {
+					LOG(ERROR) << "Error during ping: unknown clientID " << message.msg.ipc_Ping.clientId;
+				}
+			}
+			break;
 
-								case ipc::RequestType::OpenVR_AxisEvent:
-								{
-									try {
-										if (vr::VRServerDriverHost()) {
-											auto& e = message.msg.ipc_AxisEvent;
-											driver->openvr_axisEvent(e.deviceId, e.axisId, e.axisState);
-										}
-									}
-									catch (std::exception& e) {
-										LOG(ERROR) << "Error in axis event ipc thread: " << e.what();
-									}
-								}
-								break;
+			case ipc::RequestType::WalkInPlace_StepDetectionMode:
+			{
+				ipc::Reply reply(ipc::ReplyType::GenericReply);
+				reply.messageId = message.msg.dm_StepDetectionMode.messageId;
+				auto endpoint = _touchClient(message.msg.dm_StepDetectionMode.clientId);
+				if (endpoint) {
+					driver->walkinplace_stepDetectionMode(message.msg.dm_StepDetectionMode);
+					reply.status = ipc::ReplyStatus::Ok;
+					if (reply.messageId != 0) {
+						_sendReply(*endpoint->queue, reply);
+					}
+				}
+				else {
+					LOG(ERROR) << "Error while setting step detection mode: unknown clientID " << message.msg.dm_StepDetectionMode.clientId;
+				}
+			}
+			break;
+
+			case ipc::RequestType::WalkInPlace_StepDetect:
+			{
+				auto endpoint = _touchClient(message.msg.dm_StepDetect.clientId);
+				if (endpoint) {
+					ipc::Reply reply(ipc::ReplyType::WalkInPlace_StepDetect);
+					reply.messageId = message.msg.dm_StepDetect.messageId;
+					reply.status = ipc::ReplyStatus::Ok;
+					driver->walkinplace_stepDetectionStatus(reply.msg.dm_stepDetect);
+					if (reply.messageId != 0) {
+						_sendReply(*endpoint->queue, reply);
+					}
+				}
+				else {
+					LOG(ERROR) << "Error while getting step detection status: unknown clientID " << message.msg.dm_StepDetect.clientId;
+				}
+			}
+			break;
+
+			case ipc::RequestType::OpenVR_PoseUpdate:
+			{
+				//if (vr::VRServerDriverHost()) {
+				//	driver->openvr_poseUpdate(message.msg.ipc_PoseUpdate.deviceId, message.msg.ipc_PoseUpdate.flipYaw, message.timestamp);
+				//}
+			}
+			break;
+
+			case ipc::RequestType::OpenVR_ButtonEvent:
+			case ipc::RequestType::OpenVR_AxisEvent:
+			case ipc::RequestType::OpenVR_EventBatch:
+			case ipc::RequestType::WalkInPlace_LocomotionBinding:
+			case ipc::RequestType::WalkInPlace_LocomotionIntent:
+				_handleEventRequest(message, driver);
+				break;
+
+			default:
+				LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
+				break;
+			}
+		}
 
-								default:
-									LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
+		void IpcShmCommunicator::_ringThreadFunc(IpcShmCommunicator* _this, DriverCore* driver) {
+			LOG(DEBUG) << "CServerDriver::_ringThreadFunc: thread started";
+			ipc::LatencyStats latency;
+			while (!_this->_ipcThreadStopFlag) {
+				try {
+					bool sleep = true;
+					{
+						std::lock_guard<std::mutex> lock(_this->_ringsMutex);
+						for (auto& c : _this->_ipcChannels) {
+							if (_this->_drainChannel(c.second, driver, latency)) {
+								sleep = false;
+							}
+						}
+						if (sleep) {
+							for (auto& c : _this->_ipcChannels) {
+								if (!c.second.segment->get().prepareSleep()) {
+									sleep = false;
 									break;
 								}
 							}
-							else {
-								LOG(ERROR) << "Error in ipc server receive loop: received size is wrong (" << recv_size << " != " << sizeof(ipc::Request) << ")";
+							if (!sleep) {
+								for (auto& c : _this->_ipcChannels) {
+									c.second.segment->get().events.cancelSleep();
+								}
 							}
 						}
 					}
-					catch (std::exception& ex) {
-						LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
+					if (sleep && !_this->_ipcThreadStopFlag) {
+						// Woken up by a producer, a new channel or shutdown()
+						_this->_ringDoorbell->wait();
+						std::lock_guard<std::mutex> lock(_this->_ringsMutex);
+						for (auto& c : _this->_ipcChannels) {
+							c.second.segment->get().events.cancelSleep();
+						}
 					}
 				}
-				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
+				catch (std::exception& ex) {
+					LOG(ERROR) << "Exception caught in ipc ring receive loop: " << ex.what();
+				}
 			}
-			catch (std::exception& ex) {
-				LOG(ERROR) << "Exception caught in ipc server thread: " << ex.what();
+			LOG(DEBUG) << "CServerDriver::_ringThreadFunc: thread stopped";
+		}
+
+		// Applies everything a client has sent so far, returns false when there was nothing to do
+		bool IpcShmCommunicator::_drainChannel(_ClientChannel& client, DriverCore* driver, ipc::LatencyStats& latency) {
+			auto& channel = client.segment->get();
+			bool received = false;
+
+			// Take a snapshot of the changed axis states first, so that we can keep the natural order:
+			// new touches -> ordered events (presses) -> axis values -> released touches
+			struct AxisUpdate {
+				uint32_t deviceId;
+				uint32_t axisId;
+				ipc::AxisMailboxValue value;
+			};
+			AxisUpdate updates[IPC_AXISMAILBOX_DEVICECOUNT * IPC_AXISMAILBOX_AXISCOUNT];
+			uint32_t updateCount = 0;
+			auto dirty = channel.axes.dirtyDevices.exchange(0);
+			for (uint32_t deviceId = 0; dirty != 0; deviceId++, dirty >>= 1) {
+				if ((dirty & 1) == 0) {
+					continue;
+				}
+				for (uint32_t axisId = 0; axisId < IPC_AXISMAILBOX_AXISCOUNT; axisId++) {
+					auto& update = updates[updateCount];
+					if (!channel.axes.read(deviceId, axisId, update.value)) {
+						channel.axes.markDirty(deviceId); // producer is just writing, try again in the next pass
+						continue;
+					}
+					auto& slot = channel.axes.slots[deviceId][axisId];
+					if (update.value.sequence != slot.consumedSequence.load(std::memory_order_relaxed)) {
+						slot.consumedSequence.store(update.value.sequence, std::memory_order_relaxed);
+						update.deviceId = deviceId;
+						update.axisId = axisId;
+						updateCount++;
+					}
+				}
 			}
-			_this->_ipcThreadRunning = false;
-			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
+			bool driverHostReady = driver->driverHost().isReady();
+			if (updateCount > 0) {
+				received = true;
+			}
+
+			try {
+				for (uint32_t i = 0; driverHostReady && i < updateCount; i++) {
+					auto& u = updates[i];
+					if (u.value.touched && !client.touched[u.deviceId][u.axisId]) {
+						driver->openvr_buttonEvent(u.deviceId, ButtonEventType::ButtonTouched, (vr::EVRButtonId)u.value.touchButtonId, 0.0);
+					}
+				}
+			}
+			catch (std::exception& e) {
+				LOG(ERROR) << "Error in axis mailbox ipc thread: " << e.what();
+			}
+
+			auto& stats = driver->stats();
+			auto depth = channel.events.size();
+			stats.shmRingDepth.store(depth, std::memory_order_relaxed);
+			ipc::StatsPage::updateHighWater(stats.shmRingHighWater, depth);
+			while (auto packet = channel.events.peek()) {
+				auto ok = packet->forEach(sizeof(ipc::FramePacket), [&](const ipc::Request& message) {
+					_logLatency("shm ring", latency, message.sendTime);
+					stats.countRequest(message.type);
+					auto latencyUs = ipc::monotonicTimeUs() - message.sendTime;
+					stats.dispatchLatency[ipc::StatsTransport_ShmRing].add(latencyUs);
+					stats.laneLatency[(uint32_t)ipc::requestLane(message.type)].add(latencyUs);
+					_handleEventRequest(message, driver);
+				});
+				channel.events.release();
+				if (!ok) {
+					LOG(ERROR) << "Error in ipc ring receive loop: malformed packet";
+				}
+				received = true;
+			}
+
+			try {
+				for (uint32_t i = 0; driverHostReady && i < updateCount; i++) {
+					auto& u = updates[i];
+					driver->openvr_axisEvent(u.deviceId, u.axisId, u.value.axisState);
+					if (!u.value.touched && client.touched[u.deviceId][u.axisId]) {
+						driver->openvr_buttonEvent(u.deviceId, ButtonEventType::ButtonUntouched, (vr::EVRButtonId)u.value.touchButtonId, 0.0);
+					}
+					client.touched[u.deviceId][u.axisId] = u.value.touched != 0;
+				}
+			}
+			catch (std::exception& e) {
+				LOG(ERROR) << "Error in axis mailbox ipc thread: " << e.what();
+			}
+			if (received) {
+				client.lastReceivedUs = ipc::monotonicTimeUs();
+			}
+			return received;
 		}
 
-		void IpcShmCommunicator::sendReply(uint32_t clientId, const ipc::Reply& reply) {
-			std::lock_guard<std::mutex> guard(_sendMutex);
-			auto i = _ipcEndpoints.find(clientId);
-			if (i != _ipcEndpoints.end()) {
-				i->second->send(&reply, sizeof(ipc::Reply), 0);
+		void IpcShmCommunicator::_logLatency(const char* transport, ipc::LatencyStats& stats, int64_t sendTime) {
+			stats.add(sendTime);
+			if (stats.count >= 1000) {
+				LOG(DEBUG) << "IPC send-to-dispatch latency (" << transport << ", " << stats.count << " requests): avg " << stats.averageUs()
+					<< " us, min " << stats.minUs << " us, max " << stats.maxUs << " us";
+				stats = ipc::LatencyStats();
+			}
+		}
+
+		void IpcShmCommunicator::_handleEventRequest(const ipc::Request& message, DriverCore* driver) {
+			switch (message.type) {
+			case ipc::RequestType::OpenVR_ButtonEvent:
+			{
+				try {
+					if (driver->driverHost().isReady()) {
+						auto& e = message.msg.ipc_ButtonEvent;
+						driver->openvr_buttonEvent(e.deviceId, e.eventType, e.buttonId, e.timeOffset);
+					}
+				}
+				catch (std::exception& e) {
+					LOG(ERROR) << "Error in button event ipc thread: " << e.what();
+				}
+			}
+			break;
+
+			case ipc::RequestType::OpenVR_AxisEvent:
+			{
+				try {
+					if (driver->driverHost().isReady()) {
+						auto& e = message.msg.ipc_AxisEvent;
+						driver->openvr_axisEvent(e.deviceId, e.axisId, e.axisState);
+					}
+				}
+				catch (std::exception& e) {
+					LOG(ERROR) << "Error in axis event ipc thread: " << e.what();
+				}
+			}
+			break;
+
+			case ipc::RequestType::OpenVR_EventBatch:
+			{
+				try {
+					if (driver->driverHost().isReady()) {
+						driver->openvr_eventBatch(message.msg.ipc_EventBatch);
+					}
+				}
+				catch (std::exception& e) {
+					LOG(ERROR) << "Error in event batch ipc thread: " << e.what();
+				}
+			}
+			break;
+
+			case ipc::RequestType::WalkInPlace_LocomotionBinding:
+				driver->walkinplace_locomotionBinding(message.msg.wip_LocomotionBinding);
+				break;
+
+			case ipc::RequestType::WalkInPlace_LocomotionIntent:
+			{
+				try {
+					if (driver->driverHost().isReady()) {
+						driver->walkinplace_locomotionIntent(message.msg.wip_LocomotionIntent);
+					}
+				}
+				catch (std::exception& e) {
+					LOG(ERROR) << "Error in locomotion intent ipc thread: " << e.what();
+				}
+			}
+			break;
+
+			default:
+				LOG(ERROR) << "Error in ipc event dispatch: Unexpected message type (" << (int)message.type << ")";
+				break;
+			}
+		}
+
+		// Finds the endpoint of a request and renews its lease
+		EndpointTable::Endpoint* IpcShmCommunicator::_touchClient(uint32_t clientId) {
+			auto endpoint = _ipcEndpoints.find(clientId);
+			if (endpoint) {
+				endpoint->lastSeenUs = ipc::monotonicTimeUs();
+			}
+			return endpoint;
+		}
+
+		// Drops clients that sent nothing for a lease timeout, neither on the message queue nor on their shm channel
+		void IpcShmCommunicator::_expireClients(int64_t nowUs, DriverCore* driver) {
+			{
+				std::lock_guard<std::mutex> lock(_ringsMutex);
+				for (auto& c : _ipcChannels) {
+					auto endpoint = _ipcEndpoints.find(c.first);
+					if (endpoint && c.second.lastReceivedUs > endpoint->lastSeenUs) {
+						endpoint->lastSeenUs = c.second.lastReceivedUs;
+					}
+				}
+			}
+			_ipcEndpoints.expire(nowUs, _clientLeaseUs, [&](uint32_t clientId) {
+				LOG(INFO) << "Client lease expired: clientId " << clientId;
+				_removeClient(clientId, driver);
+			});
+		}
+
+		void IpcShmCommunicator::_removeClient(uint32_t clientId, DriverCore* driver) {
+			if (_ipcEndpoints.remove(clientId)) {
+				{
+					std::lock_guard<std::mutex> lock(_ringsMutex);
+					_ipcChannels.erase(clientId);
+				}
+				driver->walkinplace_clientDisconnected(clientId);
+			}
+		}
+
+		// Never blocks the ipc thread, a client that does not read its replies (e.g. it crashed) only loses them.
+		// The connect reply goes out as a ConnectReply, which fits the reply queue of a client of any version.
+		void IpcShmCommunicator::_sendReply(boost::interprocess::message_queue& queue, const ipc::Reply& reply) {
+			bool sent;
+			if (reply.type == ipc::ReplyType::IPC_ClientConnect) {
+				ipc::ConnectReply message(reply);
+				sent = queue.try_send(&message, sizeof(message), 0);
 			}
 			else {
-				LOG(ERROR) << "Error while sending reply: Unknown clientId " << clientId;
+				sent = queue.try_send(&reply, sizeof(ipc::Reply), 0);
+			}
+			if (!sent) {
+				LOG(ERROR) << "Error while sending reply: client queue is full";
 			}
 		}
 
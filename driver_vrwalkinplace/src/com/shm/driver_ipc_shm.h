@@ -5,38 +5,63 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <openvr_driver.h>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/sync/named_semaphore.hpp>
+#include <ipc_protocol.h>
+#include <ipc_shm_ring.h>
+#include "EndpointTable.h"
 
 
 // driver namespace
 namespace vrwalkinplace {
 
-namespace ipc { struct Reply; }
-
 namespace driver {
 
 // forward declarations
-class ServerDriver;
+class DriverCore;
 
 
 class IpcShmCommunicator {
 public:
-	void init(ServerDriver* driver);
+	void init(DriverCore* driver);
 	void shutdown();
 
+	/** Clients that send nothing for this long are dropped, call before init() */
+	void setClientLeaseTimeout(int64_t leaseUs) { _clientLeaseUs = leaseUs; }
+
 private:
-	static void _ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver);
+	static void _ipcThreadFunc(IpcShmCommunicator* _this, DriverCore* driver);
+	static void _ringThreadFunc(IpcShmCommunicator* _this, DriverCore* driver);
 
-	void sendReply(uint32_t clientId, const ipc::Reply& reply);
+	void _handleQueueRequest(const ipc::Request& message, uint32_t senderClientId, DriverCore* driver, ipc::LatencyStats& latency);
+	void _handleEventRequest(const ipc::Request& message, DriverCore* driver);
+	EndpointTable::Endpoint* _touchClient(uint32_t clientId);
+	void _removeClient(uint32_t clientId, DriverCore* driver);
+	void _expireClients(int64_t nowUs, DriverCore* driver);
+	static void _sendReply(boost::interprocess::message_queue& queue, const ipc::Reply& reply);
+	static void _logLatency(const char* transport, ipc::LatencyStats& stats, int64_t sendTime);
 
-	std::mutex _sendMutex;
-	ServerDriver* _driver = nullptr;
+	struct _ClientChannel {
+		std::shared_ptr<ipc::ClientChannelSegment> segment;
+		bool touched[IPC_AXISMAILBOX_DEVICECOUNT][IPC_AXISMAILBOX_AXISCOUNT] = {}; // last touch state sent to the device
+		int64_t lastReceivedUs = 0; // renews the lease, the ipc thread carries it over before expiring leases
+	};
+	bool _drainChannel(_ClientChannel& client, DriverCore* driver, ipc::LatencyStats& latency);
+
+	DriverCore* _driver = nullptr;
 	std::thread _ipcThread;
 	volatile bool _ipcThreadRunning = false;
 	volatile bool _ipcThreadStopFlag = false;
 	std::string _ipcQueueName = "driver_vrwalkinplace.server_queue";
-	uint32_t _ipcClientIdNext = 1;
-	std::map<uint32_t, std::shared_ptr<boost::interprocess::message_queue>> _ipcEndpoints;
+	EndpointTable _ipcEndpoints;
+	int64_t _clientLeaseUs = IPC_CLIENT_LEASE_TIMEOUT_MS * 1000ll;
+
+	// shared memory channels (event ring + axis mailbox) of the clients
+	std::thread _ringThread;
+	std::unique_ptr<boost::interprocess::named_semaphore> _ringDoorbell;
+	std::mutex _ringsMutex;
+	std::map<uint32_t, _ClientChannel> _ipcChannels;
 };
 
 
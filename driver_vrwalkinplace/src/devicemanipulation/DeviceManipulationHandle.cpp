@@ -1,18 +1,8 @@
 #include "DeviceManipulationHandle.h"
 
-#include <boost/regex.hpp>
-#include <boost/algorithm/string.hpp>
-#include "../driver/ServerDriver.h"
-#include "../hooks/IVRServerDriverHost004Hooks.h"
-#include "../hooks/IVRServerDriverHost005Hooks.h"
-#include "../hooks/IVRDriverInput001Hooks.h"
-
-#undef WIN32_LEAN_AND_MEAN
-#undef NOSOUND
-#include <Windows.h>
-// According to windows documentation mmsystem.h should be automatically included with Windows.h when WIN32_LEAN_AND_MEAN and NOSOUND are not defined
-// But it doesn't work so I have to include it manually
-#include <mmsystem.h>
+#include "InputComponentPath.h"
+#include "../driver/DriverCore.h"
+#include <cstring>
 
 
 namespace vrwalkinplace {
@@ -25,42 +15,47 @@ namespace vrwalkinplace {
 		lhs[2] += rhs.v[2];
 
 
-		DeviceManipulationHandle::DeviceManipulationHandle(const char* serial, vr::ETrackedDeviceClass eDeviceClass, void* driverPtr, void* driverHostPtr, int driverInterfaceVersion)
-			: m_isValid(true), m_parent(ServerDriver::getInstance()), m_deviceDriverPtr(driverPtr), m_deviceDriverHostPtr(driverHostPtr),
-			m_deviceDriverInterfaceVersion(driverInterfaceVersion), m_eDeviceClass(eDeviceClass), m_serialNumber(serial) {
-			memset(_AxisIdToComponentHandleMap, 0, sizeof(_AxisIdToComponentHandleMap));
+		DeviceManipulationHandle::DeviceManipulationHandle(DriverCore* parent, const char* serial, vr::ETrackedDeviceClass eDeviceClass, void* driverPtr, void* driverHostPtr, int driverInterfaceVersion)
+			: m_isValid(true), m_parent(parent), m_eDeviceClass(eDeviceClass), m_serialNumber(serial),
+			m_deviceDriverInterfaceVersion(driverInterfaceVersion), m_deviceDriverPtr(driverPtr), m_deviceDriverHostPtr(driverHostPtr) {
+			memset(_buttonComponentHandles, 0, sizeof(_buttonComponentHandles));
+			memset(_axisComponentHandles, 0, sizeof(_axisComponentHandles));
 		}
 
 		void DeviceManipulationHandle::ll_sendButtonEvent(ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-			auto it = _ButtonIdToComponentHandleMap.find(eButtonId);
-			if (it != _ButtonIdToComponentHandleMap.end()) {
+			if ((uint32_t)eButtonId < vr::k_EButton_Max && (_buttonComponentHandles[eButtonId][0] != 0 || _buttonComponentHandles[eButtonId][1] != 0)) {
 				uint64_t componentHandle = 0;
 				bool newValue = false;
 				switch (eventType) {
 				case ButtonEventType::ButtonTouched:
-					componentHandle = it->second.first;
+					componentHandle = _buttonComponentHandles[eButtonId][0];
 					newValue = true;
 					break;
 				case ButtonEventType::ButtonUntouched:
-					componentHandle = it->second.first;
+					componentHandle = _buttonComponentHandles[eButtonId][0];
 					newValue = false;
 					break;
 				case ButtonEventType::ButtonPressed:
-					componentHandle = it->second.second;
+					componentHandle = _buttonComponentHandles[eButtonId][1];
 					newValue = true;
 					break;
 				case ButtonEventType::ButtonUnpressed:
-					componentHandle = it->second.second;
+					componentHandle = _buttonComponentHandles[eButtonId][1];
 					newValue = false;
 					break;
 				default:
 					break;
 				}
 				if (componentHandle != 0) {
-					vr::EVRInputError eVRIError = vr::VRDriverInput()->UpdateBooleanComponent(componentHandle, newValue, eventTimeOffset);
-					LOG(INFO) << "apply boolean event " << eButtonId << " on device " << m_openvrId;
+					auto& stats = m_parent->stats();
+					auto startUs = ipc::monotonicTimeUs();
+					vr::EVRInputError eVRIError = m_parent->driverHost().UpdateBooleanComponent(componentHandle, newValue, eventTimeOffset);
+					stats.injectionTime.add(ipc::monotonicTimeUs() - startUs);
+					stats.buttonInjections.fetch_add(1, std::memory_order_relaxed);
+					BLOG(DEBUG, "apply boolean event {} on device {}", eButtonId, m_openvrId);
 					if (eVRIError != vr::EVRInputError::VRInputError_None) {
-						LOG(INFO) << "VR INPUT ERROR: " << eVRIError;
+						stats.injectionErrors.fetch_add(1, std::memory_order_relaxed);
+						BLOG(WARNING, "VR INPUT ERROR: {}", eVRIError);
 					}
 					//IVRDriverInput001Hooks::updateBooleanComponentOrig(m_driverInputPtr, componentHandle, newValue, eventTimeOffset);
 				}
@@ -70,26 +65,36 @@ namespace vrwalkinplace {
 			}
 		}
 
-		void DeviceManipulationHandle::ll_sendAxisEvent(uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {
-			if (unWhichAxis < 5) {
-				if (_AxisIdToComponentHandleMap[unWhichAxis].first == 0 && _AxisIdToComponentHandleMap[unWhichAxis].second == 0) {
+		void DeviceManipulationHandle::ll_sendAxisEvent(uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState, double eventTimeOffset) {
+			if (unWhichAxis < vr::k_unControllerStateAxisCount) {
+				auto& componentHandles = _axisComponentHandles[unWhichAxis];
+				if (componentHandles[0] == 0 && componentHandles[1] == 0) {
 					LOG(WARNING) << "Device " << m_openvrId << ": No mapping from axis id " << unWhichAxis << " to input component.";
 				}
 				else {
-					if (_AxisIdToComponentHandleMap[unWhichAxis].first != 0) {
+					auto& stats = m_parent->stats();
+					if (componentHandles[0] != 0) {
 						//sendScalarComponentUpdate(m_openvrId, unWhichAxis, 0, axisState.x, 0.0);
-						vr::EVRInputError eVRIError = vr::VRDriverInput()->UpdateScalarComponent(_AxisIdToComponentHandleMap[unWhichAxis].first, axisState.x, 0);
-						LOG(INFO) << "apply axis event " << unWhichAxis << " X dimension on device " << m_openvrId;
+						auto startUs = ipc::monotonicTimeUs();
+						vr::EVRInputError eVRIError = m_parent->driverHost().UpdateScalarComponent(componentHandles[0], axisState.x, eventTimeOffset);
+						stats.injectionTime.add(ipc::monotonicTimeUs() - startUs);
+						stats.axisInjections.fetch_add(1, std::memory_order_relaxed);
+						BLOG(DEBUG, "apply axis event {} X dimension on device {}", unWhichAxis, m_openvrId);
 						if (eVRIError != vr::EVRInputError::VRInputError_None) {
-							LOG(INFO) << "VR INPUT ERROR: " << eVRIError;
+							stats.injectionErrors.fetch_add(1, std::memory_order_relaxed);
+							BLOG(WARNING, "VR INPUT ERROR: {}", eVRIError);
 						}
 					}
-					if (_AxisIdToComponentHandleMap[unWhichAxis].second != 0) {
+					if (componentHandles[1] != 0) {
 						//sendScalarComponentUpdate(m_openvrId, unWhichAxis, 1, axisState.y, 0.0);
-						vr::EVRInputError eVRIError = vr::VRDriverInput()->UpdateScalarComponent(_AxisIdToComponentHandleMap[unWhichAxis].second, axisState.y, 0);
-						LOG(INFO) << "apply axis event " << unWhichAxis << " Y dimension on device " << m_openvrId;
+						auto startUs = ipc::monotonicTimeUs();
+						vr::EVRInputError eVRIError = m_parent->driverHost().UpdateScalarComponent(componentHandles[1], axisState.y, eventTimeOffset);
+						stats.injectionTime.add(ipc::monotonicTimeUs() - startUs);
+						stats.axisInjections.fetch_add(1, std::memory_order_relaxed);
+						BLOG(DEBUG, "apply axis event {} Y dimension on device {}", unWhichAxis, m_openvrId);
 						if (eVRIError != vr::EVRInputError::VRInputError_None) {
-							LOG(INFO) << "VR INPUT ERROR: " << eVRIError;
+							stats.injectionErrors.fetch_add(1, std::memory_order_relaxed);
+							BLOG(WARNING, "VR INPUT ERROR: {}", eVRIError);
 						}
 					}
 				}
@@ -99,65 +104,29 @@ namespace vrwalkinplace {
 		void DeviceManipulationHandle::RunFrame() {
 		}
 
-		bool _matchInputComponentName(const char* name, std::string& segment0, std::string& segment1, std::string& segment2, std::string& segment3) {
-			boost::regex rgx("^/([^/]*)(/([^/]*))?(/([^/]*))?(/([^/]*))?");
-			boost::smatch match;
-			std::string text(name);
-			if (boost::regex_search(text, match, rgx)) {
-				segment0 = match[1];
-				segment1 = match[3];
-				segment2 = match[5];
-				segment3 = match[7];
-				return true;
-			}
-			else {
-				return false;
-			}
+		std::string _segmentString(const InputComponentPathSegment& segment) {
+			return std::string(segment.str, segment.length);
 		}
 
-		std::map<std::string, vr::EVRButtonId> _inputComponentNameToButtonId = {
-			{ "system", vr::k_EButton_System },
-			{ "application_menu", vr::k_EButton_ApplicationMenu },
-			{ "grip", vr::k_EButton_Grip },
-			{ "dpad_left/", vr::k_EButton_DPad_Left },
-			{ "dpad_up", vr::k_EButton_DPad_Up },
-			{ "dpad_right", vr::k_EButton_DPad_Right },
-			{ "dpad_down", vr::k_EButton_DPad_Down },
-			{ "a", vr::k_EButton_A },
-			{ "x", vr::k_EButton_A },
-			{ "b", vr::k_EButton_ApplicationMenu },
-			{ "y", vr::k_EButton_ApplicationMenu },
-			{ "trackpad", vr::k_EButton_SteamVR_Touchpad },
-			{ "joystick", vr::k_EButton_Axis2 },
-			{ "trigger", vr::k_EButton_SteamVR_Trigger },
-		};
-
-		std::map<std::string, uint32_t> _inputComponentNameToAxisId = {
-			{ "trackpad", 0 },
-			{ "trigger", 1 },
-			{ "joystick", 2 },
-		};
-
 		void DeviceManipulationHandle::inputAddBooleanComponent(const char *pchName, uint64_t pHandle) {
-			std::string sg0, sg1, sg2, sg3;
-			if (_matchInputComponentName(pchName, sg0, sg1, sg2, sg3)) {
-				LOG(DEBUG) << "Device Component Name Segments: \"" << sg0 << "\", \"" << sg1 << "\", \"" << sg2 << "\", \"" << sg3 << "\"";
+			InputComponentPath path;
+			if (splitInputComponentPath(pchName, path)) {
+				auto& sg = path.segments;
+				LOG(DEBUG) << "Device Component Name Segments: \"" << _segmentString(sg[0]) << "\", \"" << _segmentString(sg[1]) << "\", \"" << _segmentString(sg[2]) << "\", \"" << _segmentString(sg[3]) << "\"";
 				vr::EVRButtonId buttonId;
 				int buttonType = 1; // 0 .. touch, 1 ..click
 				bool errorFlag = false;
-				if (!sg3.empty()) {
+				if (!sg[3].empty()) {
 					LOG(ERROR) << "Device input component name \"" << pchName << "\" has too many segments.";
+					errorFlag = true;
 				}
 				else {
-					if (boost::iequals(sg0, "proximity")) { // proximity sensor
+					if (inputComponentNameEquals(sg[0], "proximity")) { // proximity sensor
 						buttonId = vr::k_EButton_ProximitySensor;
 					}
-					else if (boost::iequals(sg0, "input")) { // digital button
-						boost::algorithm::to_lower(sg1);
-						auto it = _inputComponentNameToButtonId.find(sg1);
-						if (it != _inputComponentNameToButtonId.end()) {
-							buttonId = it->second;
-							if (boost::iequals(sg2, "touch")) {
+					else if (inputComponentNameEquals(sg[0], "input")) { // digital button
+						if (inputComponentNameToButtonId(sg[1], buttonId)) {
+							if (inputComponentNameEquals(sg[2], "touch")) {
 								buttonType = 0;
 							}
 						}
@@ -167,18 +136,12 @@ namespace vrwalkinplace {
 						}
 					}
 					else {
-						LOG(ERROR) << "Unknown first component name segment \"" << sg0 << "\".";
+						LOG(ERROR) << "Unknown first component name segment \"" << _segmentString(sg[0]) << "\".";
 						errorFlag = true;
 					}
 				}
 				if (!errorFlag) {
-					_componentHandleToButtonIdMap.emplace(pHandle, std::make_pair(buttonId, buttonType));
-					if (buttonType == 0) {
-						_ButtonIdToComponentHandleMap[buttonId].first = pHandle;
-					}
-					else {
-						_ButtonIdToComponentHandleMap[buttonId].second = pHandle;
-					}
+					_buttonComponentHandles[buttonId][buttonType] = pHandle;
 					LOG(INFO) << "Mapped input component \"" << pchName << "\" on device " << m_openvrId << " to button id (" << (int)buttonId << ", " << buttonType << ")";
 				}
 			}
@@ -187,26 +150,25 @@ namespace vrwalkinplace {
 			}
 		}
 
-		void DeviceManipulationHandle::inputAddScalarComponent(const char *pchName, uint64_t pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) {
-			std::string sg0, sg1, sg2, sg3;
-			if (_matchInputComponentName(pchName, sg0, sg1, sg2, sg3)) {
-				LOG(DEBUG) << "Device Component Name Segments: \"" << sg0 << "\", \"" << sg1 << "\", \"" << sg2 << "\", \"" << sg3 << "\"";
+		void DeviceManipulationHandle::inputAddScalarComponent(const char *pchName, uint64_t pHandle, vr::EVRScalarType /*eType*/, vr::EVRScalarUnits /*eUnits*/) {
+			InputComponentPath path;
+			if (splitInputComponentPath(pchName, path)) {
+				auto& sg = path.segments;
+				LOG(DEBUG) << "Device Component Name Segments: \"" << _segmentString(sg[0]) << "\", \"" << _segmentString(sg[1]) << "\", \"" << _segmentString(sg[2]) << "\", \"" << _segmentString(sg[3]) << "\"";
 				uint32_t axisId;
 				uint32_t axisDim = 0;
 				bool errorFlag = false;
-				if (!sg3.empty()) {
+				if (!sg[3].empty()) {
 					LOG(ERROR) << "Device input component name \"" << pchName << "\" has too many segments.";
+					errorFlag = true;
 				}
 				else {
-					if (boost::iequals(sg0, "input")) { // analog input
-						boost::algorithm::to_lower(sg1);
-						auto it = _inputComponentNameToAxisId.find(sg1);
-						if (it != _inputComponentNameToAxisId.end()) {
-							axisId = it->second;
-							if (boost::iequals(sg2, "x")) {
+					if (inputComponentNameEquals(sg[0], "input")) { // analog input
+						if (inputComponentNameToAxisId(sg[1], axisId)) {
+							if (inputComponentNameEquals(sg[2], "x")) {
 								axisDim = 0;
 							}
-							else if (boost::iequals(sg2, "y")) {
+							else if (inputComponentNameEquals(sg[2], "y")) {
 								axisDim = 1;
 							}
 						}
@@ -216,18 +178,12 @@ namespace vrwalkinplace {
 						}
 					}
 					else {
-						LOG(ERROR) << "Unknown first component name segment \"" << sg0 << "\".";
+						LOG(ERROR) << "Unknown first component name segment \"" << _segmentString(sg[0]) << "\".";
 						errorFlag = true;
 					}
 				}
 				if (!errorFlag) {
-					_componentHandleToAxisIdMap.emplace(pHandle, std::make_pair(axisId, axisDim));
-					if (axisDim == 0) {
-						_AxisIdToComponentHandleMap[axisId].first = pHandle;
-					}
-					else {
-						_AxisIdToComponentHandleMap[axisId].second = pHandle;
-					}
+					_axisComponentHandles[axisId][axisDim] = pHandle;
 					LOG(INFO) << "Mapped input component \"" << pchName << "\" on device " << m_openvrId << " to axis id (" << axisId << ", " << axisDim << ")" << " with handle " << pHandle;
 				}
 			}
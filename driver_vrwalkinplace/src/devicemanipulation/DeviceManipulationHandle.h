@@ -1,11 +1,11 @@
 #pragma once
-#pragma once
 
+#include <memory>
+#include <string>
 #include <openvr_driver.h>
 #include <vrwalkinplace_types.h>
 #include <openvr_math.h>
 #include "../logging.h"
-#include "../hooks/common.h"
 
 
 
@@ -15,7 +15,7 @@ namespace driver {
 
 
 // forward declarations
-class ServerDriver;
+class DriverCore;
 class InterfaceHooks;
 class MotionCompensationManager;
 
@@ -24,8 +24,7 @@ class MotionCompensationManager;
 class DeviceManipulationHandle {
 private:
 	bool m_isValid = false;
-	ServerDriver* m_parent;
-	std::recursive_mutex _mutex;
+	DriverCore* m_parent;
 	vr::ETrackedDeviceClass m_eDeviceClass = vr::TrackedDeviceClass_Invalid;
 	uint32_t m_openvrId = vr::k_unTrackedDeviceIndexInvalid;
 	std::string m_serialNumber;
@@ -45,14 +44,13 @@ private:
 
 	vr::PropertyContainerHandle_t m_propertyContainerHandle = vr::k_ulInvalidPropertyContainer;
 
-	std::map<vr::VRInputComponentHandle_t, std::pair<vr::EVRButtonId, int>> _componentHandleToButtonIdMap;
-	std::map<vr::EVRButtonId, std::pair<vr::VRInputComponentHandle_t, vr::VRInputComponentHandle_t>> _ButtonIdToComponentHandleMap;
-	std::map<vr::VRInputComponentHandle_t, std::pair<unsigned, unsigned>> _componentHandleToAxisIdMap;
-	std::pair<vr::VRInputComponentHandle_t, vr::VRInputComponentHandle_t> _AxisIdToComponentHandleMap[5];
+	// Filled when the device's input components are created, 0 means no component
+	vr::VRInputComponentHandle_t _buttonComponentHandles[vr::k_EButton_Max][2]; // [button id][0 .. touch, 1 .. click]
+	vr::VRInputComponentHandle_t _axisComponentHandles[vr::k_unControllerStateAxisCount][2]; // [axis id][0 .. x, 1 .. y]
 
 
 public:
-	DeviceManipulationHandle(const char* serial, vr::ETrackedDeviceClass eDeviceClass, void* driverPtr, void* driverHostPtr, int driverInterfaceVersion);
+	DeviceManipulationHandle(DriverCore* parent, const char* serial, vr::ETrackedDeviceClass eDeviceClass, void* driverPtr, void* driverHostPtr, int driverInterfaceVersion);
 
 	bool isValid() const { return m_isValid; }
 	vr::ETrackedDeviceClass deviceClass() const { return m_eDeviceClass; }
@@ -70,7 +68,7 @@ public:
 	int deviceMode() const { return m_deviceMode; }
 
 	void ll_sendButtonEvent(ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
-	void ll_sendAxisEvent(uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
+	void ll_sendAxisEvent(uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState, double eventTimeOffset);
 	
 	void inputAddBooleanComponent(const char *pchName, uint64_t pHandle);
 	void inputAddScalarComponent(const char *pchName, uint64_t pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <openvr_driver.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+// One segment of an input component path, points into the original string
+struct InputComponentPathSegment {
+	const char* str = "";
+	uint32_t length = 0;
+
+	bool empty() const {
+		return length == 0;
+	}
+};
+
+
+// "/input/trackpad/click" is split into "input", "trackpad", "click" (same segments as the former regex "^/([^/]*)(/([^/]*))?(/([^/]*))?(/([^/]*))?")
+struct InputComponentPath {
+	static const uint32_t maxSegments = 4;
+	InputComponentPathSegment segments[maxSegments];
+};
+
+// Returns false when the name does not start with '/'. Anything after the fourth segment is ignored.
+inline bool splitInputComponentPath(const char* name, InputComponentPath& path) {
+	if (!name || *name != '/') {
+		return false;
+	}
+	path = InputComponentPath();
+	const char* p = name + 1;
+	for (uint32_t i = 0; i < InputComponentPath::maxSegments; ++i) {
+		const char* start = p;
+		while (*p != '\0' && *p != '/') {
+			++p;
+		}
+		path.segments[i].str = start;
+		path.segments[i].length = (uint32_t)(p - start);
+		if (*p == '\0') {
+			break;
+		}
+		++p;
+	}
+	return true;
+}
+
+
+constexpr char inputComponentToLower(char c) {
+	return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Case insensitive FNV-1a
+constexpr uint32_t inputComponentNameHash(const char* str, uint32_t length) {
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < length; ++i) {
+		hash = (hash ^ (uint8_t)inputComponentToLower(str[i])) * 16777619u;
+	}
+	return hash;
+}
+
+constexpr uint32_t inputComponentNameHash(const char* str) {
+	uint32_t length = 0;
+	while (str[length] != '\0') {
+		++length;
+	}
+	return inputComponentNameHash(str, length);
+}
+
+inline bool inputComponentNameEquals(const InputComponentPathSegment& segment, const char* name) {
+	uint32_t i = 0;
+	for (; i < segment.length; ++i) {
+		if (name[i] == '\0' || inputComponentToLower(segment.str[i]) != name[i]) {
+			return false;
+		}
+	}
+	return name[i] == '\0';
+}
+
+
+/*
+* Name tables. The lookups switch over the compile-time hashes of the known names, a hash collision
+* between two names fails to compile (duplicate case label), so the hash is perfect for each table.
+* The final compare rejects unknown names that happen to hash to a known one.
+*/
+
+inline bool inputComponentNameToButtonId(const InputComponentPathSegment& segment, vr::EVRButtonId& buttonId) {
+#define INPUTCOMPONENT_BUTTON(name, id) case inputComponentNameHash(name): buttonId = id; return inputComponentNameEquals(segment, name);
+	switch (inputComponentNameHash(segment.str, segment.length)) {
+		INPUTCOMPONENT_BUTTON("system", vr::k_EButton_System)
+		INPUTCOMPONENT_BUTTON("application_menu", vr::k_EButton_ApplicationMenu)
+		INPUTCOMPONENT_BUTTON("grip", vr::k_EButton_Grip)
+		INPUTCOMPONENT_BUTTON("dpad_left", vr::k_EButton_DPad_Left)
+		INPUTCOMPONENT_BUTTON("dpad_up", vr::k_EButton_DPad_Up)
+		INPUTCOMPONENT_BUTTON("dpad_right", vr::k_EButton_DPad_Right)
+		INPUTCOMPONENT_BUTTON("dpad_down", vr::k_EButton_DPad_Down)
+		INPUTCOMPONENT_BUTTON("a", vr::k_EButton_A)
+		INPUTCOMPONENT_BUTTON("x", vr::k_EButton_A)
+		INPUTCOMPONENT_BUTTON("b", vr::k_EButton_ApplicationMenu)
+		INPUTCOMPONENT_BUTTON("y", vr::k_EButton_ApplicationMenu)
+		INPUTCOMPONENT_BUTTON("trackpad", vr::k_EButton_SteamVR_Touchpad)
+		INPUTCOMPONENT_BUTTON("joystick", vr::k_EButton_Axis2)
+		INPUTCOMPONENT_BUTTON("trigger", vr::k_EButton_SteamVR_Trigger)
+	default:
+		return false;
+	}
+#undef INPUTCOMPONENT_BUTTON
+}
+
+inline bool inputComponentNameToAxisId(const InputComponentPathSegment& segment, uint32_t& axisId) {
+#define INPUTCOMPONENT_AXIS(name, id) case inputComponentNameHash(name): axisId = id; return inputComponentNameEquals(segment, name);
+	switch (inputComponentNameHash(segment.str, segment.length)) {
+		INPUTCOMPONENT_AXIS("trackpad", 0)
+		INPUTCOMPONENT_AXIS("trigger", 1)
+		INPUTCOMPONENT_AXIS("joystick", 2)
+	default:
+		return false;
+	}
+#undef INPUTCOMPONENT_AXIS
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
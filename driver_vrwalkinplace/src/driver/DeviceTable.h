@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <memory>
+#include <vector>
+#include <openvr_driver.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+// forward declarations
+class DeviceManipulationHandle;
+
+
+/**
+* Lookup tables from openvr id, property container and input component to device manipulation handle.
+*
+* Readers (pose hook, RunFrame, property hooks) get the current snapshot through a ReadGuard and never lock.
+* Writers (device added/activated and component creation hooks) copy the snapshot, modify the copy and publish it.
+* Replaced snapshots are retired and freed by reclaim() once no reader can see them anymore (epoch based: a reader
+* counts itself in the reader counter of the current epoch, reclaim() only advances the epoch when the readers of
+* the previous one are gone). Handles are never removed from byDriverPtr, so handle pointers outlive the guard.
+*/
+class DeviceTable {
+public:
+	struct Snapshot {
+		uint64_t version = 0;
+		std::map<void*, std::shared_ptr<DeviceManipulationHandle>> byDriverPtr;
+		DeviceManipulationHandle* byOpenvrId[vr::k_unMaxTrackedDeviceCount] = {};
+		std::map<vr::PropertyContainerHandle_t, DeviceManipulationHandle*> byPropertyContainer;
+		// All property containers seen so far, k_unTrackedDeviceIndexInvalid when the container belongs to no device
+		std::map<vr::PropertyContainerHandle_t, uint32_t> deviceIdByPropertyContainer;
+		std::map<vr::VRInputComponentHandle_t, DeviceManipulationHandle*> byInputComponent;
+	};
+
+	// Keeps the snapshot it points to alive, only hold it for the duration of a lookup
+	class ReadGuard {
+	public:
+		ReadGuard(const DeviceTable* table) : _table(table) {
+			while (true) {
+				_epoch = table->_epoch.load();
+				table->_readers[_epoch & 1].fetch_add(1);
+				// a reclaim() in between may not have seen us, count ourselves in the new epoch instead
+				if (table->_epoch.load() == _epoch) {
+					break;
+				}
+				table->_readers[_epoch & 1].fetch_sub(1);
+			}
+			_snapshot = table->_current.load();
+		}
+		ReadGuard(ReadGuard&& other) : _table(other._table), _epoch(other._epoch), _snapshot(other._snapshot) {
+			other._table = nullptr;
+		}
+		~ReadGuard() {
+			if (_table) {
+				_table->_readers[_epoch & 1].fetch_sub(1, std::memory_order_release);
+			}
+		}
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+
+		const Snapshot* operator->() const { return _snapshot; }
+		const Snapshot& operator*() const { return *_snapshot; }
+
+	private:
+		const DeviceTable* _table;
+		uint32_t _epoch;
+		const Snapshot* _snapshot;
+	};
+
+	DeviceTable() : _currentSnapshot(new Snapshot()) {
+		_readers[0].store(0, std::memory_order_relaxed);
+		_readers[1].store(0, std::memory_order_relaxed);
+		_current.store(_currentSnapshot.get(), std::memory_order_release);
+	}
+
+	ReadGuard read() const {
+		return ReadGuard(this);
+	}
+
+	// Writers are serialized, update(Snapshot&) modifies a copy of the current snapshot which is published afterwards
+	template<typename F>
+	void update(F update) {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		std::unique_ptr<Snapshot> next(new Snapshot(*_currentSnapshot));
+		next->version++;
+		update(*next);
+		_current.store(next.get());
+		_retired.push_back(std::move(_currentSnapshot));
+		_currentSnapshot = std::move(next);
+	}
+
+	// Frees the snapshots retired before the previous call when their readers are gone and advances the epoch.
+	// Never blocks, called once per frame. Returns the number of freed snapshots.
+	size_t reclaim() {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		if (_retired.empty() && _retiredPrevious.empty()) {
+			return 0;
+		}
+		auto epoch = _epoch.load(std::memory_order_relaxed);
+		if (_readers[(epoch + 1) & 1].load() != 0) {
+			return 0; // a reader of the previous epoch may still hold a snapshot retired before the last call
+		}
+		auto freed = _retiredPrevious.size();
+		_retiredPrevious.clear();
+		_retiredPrevious.swap(_retired);
+		_epoch.store(epoch + 1);
+		return freed;
+	}
+
+	// Number of replaced snapshots that are not freed yet
+	size_t retiredCount() {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		return _retired.size() + _retiredPrevious.size();
+	}
+
+private:
+	std::mutex _writeMutex;
+	std::atomic<const Snapshot*> _current;
+	std::unique_ptr<Snapshot> _currentSnapshot;
+	mutable std::atomic<uint32_t> _epoch = { 0 };
+	mutable std::atomic<uint32_t> _readers[2]; // readers that entered in an even/odd epoch
+	std::vector<std::unique_ptr<Snapshot>> _retired; // replaced in the current epoch
+	std::vector<std::unique_ptr<Snapshot>> _retiredPrevious; // replaced in the previous epoch
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
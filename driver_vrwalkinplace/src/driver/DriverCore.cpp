@@ -0,0 +1,548 @@
+#include "DriverCore.h"
+
+#include <cmath>
+#include <cstring>
+#include "../devicemanipulation/DeviceManipulationHandle.h"
+
+
+namespace vrwalkinplace {
+	namespace driver {
+
+		DriverCore::DriverCore(std::shared_ptr<DriverHost> driverHost) : _driverHost(driverHost) {
+			_localStats.init();
+			_locomotionBinding.axisId = 0;
+			_locomotionBinding.buttonId = vr::k_EButton_SteamVR_Touchpad;
+			_locomotionBinding.pressMode = LocomotionPressMode::OnRun;
+		}
+
+
+		std::shared_ptr<DeviceManipulationHandle> DriverCore::trackedDeviceAdded(void* serverDriverHost, int version, const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass& eDeviceClass, void* pDriver) {
+			LOG(INFO) << "Found device " << pchDeviceSerialNumber << " (deviceClass: " << (int)eDeviceClass << ")";
+
+			// Device Class Override
+			if (eDeviceClass == vr::TrackedDeviceClass_GenericTracker && _propertiesOverrideGenericTrackerFakeController) {
+				eDeviceClass = vr::TrackedDeviceClass_Controller;
+				LOG(INFO) << "Disguised GenericTracker " << pchDeviceSerialNumber << " as Controller.";
+			}
+
+			// Create ManipulationInfo entry
+			auto handle = std::make_shared<DeviceManipulationHandle>(this, pchDeviceSerialNumber, eDeviceClass, pDriver, serverDriverHost, version);
+			_deviceTable.update([&](DeviceTable::Snapshot& table) {
+				table.byDriverPtr[pDriver] = handle;
+			});
+			return handle;
+		}
+
+
+		// Input components every controller gets on activation, the device handle maps them to button and axis ids
+		static const struct {
+			const char* name;
+			bool isScalar;
+		} _controllerInputComponents[] = {
+			{ "/input/trackpad/click", false },
+			{ "/input/trackpad/touch", false },
+			{ "/input/trackpad/x", true },
+			{ "/input/trackpad/y", true },
+			{ "/input/joystick/click", false },
+			{ "/input/joystick/touch", false },
+			{ "/input/joystick/x", true },
+			{ "/input/joystick/y", true },
+			{ "/input/trigger/click", false },
+			{ "/input/trigger/touch", false },
+			{ "/input/grip/click", false },
+			{ "/input/grip/touch", false },
+		};
+
+
+		void DriverCore::trackedDeviceActivated(void* serverDriver, int /*version*/, uint32_t unObjectId) {
+			auto devices = _deviceTable.read();
+			auto i = devices->byDriverPtr.find(serverDriver);
+			if (i != devices->byDriverPtr.end() && unObjectId < vr::k_unMaxTrackedDeviceCount) {
+				auto handle = i->second;
+				handle->setOpenvrId(unObjectId);
+
+				// get device property container
+				auto m_ulPropertyContainer = _driverHost->TrackedDeviceToPropertyContainer(unObjectId);
+				handle->setPropertyContainer(m_ulPropertyContainer);
+				_deviceTable.update([&](DeviceTable::Snapshot& table) {
+					table.byOpenvrId[unObjectId] = handle.get();
+					table.byPropertyContainer[m_ulPropertyContainer] = handle.get();
+					table.deviceIdByPropertyContainer[m_ulPropertyContainer] = unObjectId;
+				});
+
+				LOG(INFO) << "Successfully added device " << handle->serialNumber() << " (OpenVR Id: " << unObjectId << ") (" << handle->openvrId() << ")";
+
+				if (handle->deviceClass() == vr::TrackedDeviceClass_Controller) {
+					// Configure JSON controller configuration input profile
+					//vr::ETrackedPropertyError tpeError;
+					//installDir = vr::VRProperties()->GetStringProperty(pDriverContext->GetDriverHandle(), vr::Prop_InstallPath_String, &tpeError);
+					//vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, vr::Prop_InputProfilePath_String, "{vrwalkinplace}/input/vive_controller.json");
+
+					for (auto& component : _controllerInputComponents) {
+						vr::VRInputComponentHandle_t componentHandle = vr::k_ulInvalidInputComponentHandle;
+						if (component.isScalar) {
+							_driverHost->CreateScalarComponent(m_ulPropertyContainer, component.name, &componentHandle, vr::VRScalarType_Absolute, vr::VRScalarUnits_NormalizedTwoSided);
+							scalarComponentCreated(serverDriver, m_ulPropertyContainer, component.name, componentHandle, vr::VRScalarType_Absolute, vr::VRScalarUnits_NormalizedTwoSided);
+						}
+						else {
+							_driverHost->CreateBooleanComponent(m_ulPropertyContainer, component.name, &componentHandle);
+							booleanComponentCreated(serverDriver, m_ulPropertyContainer, component.name, componentHandle);
+						}
+					}
+				}
+			}
+		}
+
+
+		std::string _propertyValueToString(void *pvBuffer, uint32_t /*unBufferSize*/, vr::PropertyTypeTag_t unTag) {
+			switch (unTag) {
+			case vr::k_unFloatPropertyTag:
+				return std::to_string(*(float*)pvBuffer) + " [float]";
+				break;
+			case vr::k_unInt32PropertyTag:
+				return std::to_string(*(int32_t*)pvBuffer) + " [int32]";
+				break;
+			case vr::k_unUint64PropertyTag:
+				return std::to_string(*(uint64_t*)pvBuffer) + " [uint64]";
+				break;
+			case vr::k_unBoolPropertyTag:
+				return std::to_string(*(bool*)pvBuffer) + " [bool]";
+				break;
+			case vr::k_unStringPropertyTag:
+				return std::string((const char*)pvBuffer) + " [string]";
+				break;
+			case vr::k_unHmdMatrix34PropertyTag:
+				return std::string("[matrix34]");
+				break;
+			case vr::k_unHmdMatrix44PropertyTag:
+				return std::string("[matrix44]");
+				break;
+			case vr::k_unHmdVector3PropertyTag:
+				return std::string("[vector3]");
+				break;
+			case vr::k_unHmdVector4PropertyTag:
+				return std::string("[vector4]");
+				break;
+			case vr::k_unHiddenAreaPropertyTag:
+				return std::string("[HiddenAreaProperty]");
+				break;
+			case vr::k_unInvalidPropertyTag:
+				return std::string("[Invalid]");
+				break;
+			default:
+				return std::string("<Unknown>");
+				break;
+			}
+		}
+
+
+		void DriverCore::propertiesWritePropertyBatch(vr::PropertyContainerHandle_t ulContainer, void* pBatch, uint32_t unBatchEntryCount) {
+			if (_propertyOverrides.empty()) {
+				return;
+			}
+			bool deviceIdResolved = false;
+			uint32_t deviceId = vr::k_unTrackedDeviceIndexInvalid;
+			for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+				vr::PropertyWrite_t& be = ((vr::PropertyWrite_t*)pBatch)[i];
+				//LOG(TRACE) << "\tProperty "<< i << ": " << (int)be.prop << " = " << _propertyValueToString(be.pvBuffer, be.unBufferSize, be.unTag);
+				auto o = _propertyOverrides.find(be.prop);
+				if (!o) {
+					continue;
+				}
+				if (o->scope == PropertyOverrides::Scope::Hmd) {
+					if (!deviceIdResolved) {
+						deviceId = _propertyContainerToDeviceId(ulContainer);
+						deviceIdResolved = true;
+					}
+					if (deviceId != vr::k_unTrackedDeviceIndex_Hmd) {
+						continue;
+					}
+				}
+				if (PropertyOverrides::apply(*o, be)) {
+					LOG(INFO) << "Overwriting property " << (int)be.prop << " of container " << ulContainer << " => " << o->stringValue;
+				}
+			}
+		}
+
+
+
+		uint32_t DriverCore::_propertyContainerToDeviceId(vr::PropertyContainerHandle_t ulContainer) {
+			auto devices = _deviceTable.read();
+			auto it = devices->deviceIdByPropertyContainer.find(ulContainer);
+			if (it != devices->deviceIdByPropertyContainer.end()) {
+				return it->second;
+			}
+			// Not activated through our hooks, look it up once and remember the result
+			uint32_t deviceId = vr::k_unTrackedDeviceIndexInvalid;
+			for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++) {
+				if (_driverHost->TrackedDeviceToPropertyContainer(id) == ulContainer) {
+					deviceId = id;
+					break;
+				}
+			}
+			_deviceTable.update([&](DeviceTable::Snapshot& table) {
+				table.deviceIdByPropertyContainer.insert({ ulContainer, deviceId });
+			});
+			return deviceId;
+		}
+
+
+		void DriverCore::booleanComponentCreated(void * driverInput, vr::PropertyContainerHandle_t ulContainer, const char * pchName, vr::VRInputComponentHandle_t pHandle) {
+			auto devices = _deviceTable.read();
+			auto it = devices->byPropertyContainer.find(ulContainer);
+			if (it != devices->byPropertyContainer.end()) {
+				//LOG(INFO) << "Device " << it->second->serialNumber() << " has boolean input component \"" << pchName << "\"";
+				it->second->setDriverInputPtr(driverInput);
+				//_inputComponentToDeviceManipulationHandleMap[*((uint64_t*)pHandle)] = it->second;
+				//it->second->inputAddBooleanComponent(pchName, *((uint64_t*)pHandle));
+				auto handle = it->second;
+				_deviceTable.update([&](DeviceTable::Snapshot& table) {
+					table.byInputComponent[pHandle] = handle;
+				});
+				it->second->inputAddBooleanComponent(pchName, pHandle);
+			}
+		}
+
+		void DriverCore::scalarComponentCreated(void * driverInput, vr::PropertyContainerHandle_t ulContainer, const char * pchName, vr::VRInputComponentHandle_t pHandle,
+			vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) {
+			auto devices = _deviceTable.read();
+			auto it = devices->byPropertyContainer.find(ulContainer);
+			if (it != devices->byPropertyContainer.end()) {
+				//LOG(INFO) << "Device " << it->second->serialNumber() << " has scalar input component \"" << pchName << "\" (type: " << (int)eType << ", units: " << (int)eUnits << ")";
+				it->second->setDriverInputPtr(driverInput);
+				//_inputComponentToDeviceManipulationHandleMap[*((uint64_t*)pHandle)] = it->second;
+				//it->second->inputAddScalarComponent(pchName, *((uint64_t*)pHandle), eType, eUnits);
+				auto handle = it->second;
+				_deviceTable.update([&](DeviceTable::Snapshot& table) {
+					table.byInputComponent[pHandle] = handle;
+				});
+				it->second->inputAddScalarComponent(pchName, pHandle, eType, eUnits);
+			}
+		}
+
+
+		void DriverCore::runFrame() {
+			auto nowUs = ipc::monotonicTimeUs();
+			bool driverHostReady = _driverHost->isReady();
+
+			// everything the IPC threads queued since the last frame, in order
+			ipc::StatsPage::updateHighWater(_stats->outputQueueHighWater, _outputScheduler.pendingCount());
+			OutputScheduler::Command command;
+			while (_outputScheduler.pop(command)) {
+				if (driverHostReady || command.type == OutputScheduler::CommandType::LocomotionBinding) {
+					_stats->outputLatency.add(nowUs - command.postTimeUs);
+					_applyOutput(command, nowUs);
+				}
+			}
+
+			auto stepOutput = _stepDetector.runFrame((double)nowUs / 1000.0);
+			if (driverHostReady && stepOutput.changed && stepOutput.deviceId < vr::k_unMaxTrackedDeviceCount) {
+				ipc::Request_WalkInPlace_LocomotionIntent intent;
+				intent.deviceId = stepOutput.deviceId;
+				intent.gait = stepOutput.gait;
+				intent.speed = std::sqrt(stepOutput.axisState.x * stepOutput.axisState.x + stepOutput.axisState.y * stepOutput.axisState.y);
+				intent.direction.v[0] = 0.0f;
+				intent.direction.v[1] = 1.0f;
+				if (intent.speed > 0.0f) {
+					intent.direction.v[0] = stepOutput.axisState.x / intent.speed;
+					intent.direction.v[1] = stepOutput.axisState.y / intent.speed;
+				}
+				intent.rampTime = 0.0f;
+				_applyLocomotionIntent(intent, nowUs);
+			}
+
+			if (driverHostReady) {
+				// ramp values are interpolated for the start of the frame, which is already a bit in the past
+				double rampTimeOffset = (double)(nowUs - ipc::monotonicTimeUs()) / 1000000.0;
+				_outputScheduler.updateRamps(nowUs, [this, rampTimeOffset](uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& value) {
+					_applyAxisEvent(deviceId, axisId, value, rampTimeOffset);
+				});
+				for (uint32_t deviceId = 0; deviceId < vr::k_unMaxTrackedDeviceCount; ++deviceId) {
+					auto& state = _locomotionStates[deviceId];
+					if (state.stopPending && !_outputScheduler.isAxisRamping(deviceId, state.axisId)) {
+						_locomotionStop(deviceId);
+					}
+				}
+			}
+
+			// free the device table snapshots replaced by the hooks since the last frames
+			_deviceTable.reclaim();
+		}
+
+
+		void DriverCore::openvr_buttonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+			OutputScheduler::Command command;
+			command.type = OutputScheduler::CommandType::ButtonEvent;
+			command.buttonEvent.deviceId = unWhichDevice;
+			command.buttonEvent.eventType = eventType;
+			command.buttonEvent.buttonId = eButtonId;
+			command.buttonEvent.timeOffset = eventTimeOffset;
+			_postOutput(command);
+		}
+
+		void DriverCore::openvr_axisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState) {
+			OutputScheduler::Command command;
+			command.type = OutputScheduler::CommandType::AxisEvent;
+			command.axisEvent.deviceId = unWhichDevice;
+			command.axisEvent.axisId = unWhichAxis;
+			command.axisEvent.axisState = axisState;
+			_postOutput(command);
+		}
+
+		void DriverCore::openvr_eventBatch(const ipc::Request_OpenVR_EventBatch& batch) {
+			uint32_t count = batch.eventCount < REQUEST_OPENVR_EVENTBATCH_MAXCOUNT ? batch.eventCount : REQUEST_OPENVR_EVENTBATCH_MAXCOUNT;
+			for (uint32_t i = 0; i < count; ++i) {
+				auto& e = batch.events[i];
+				if (e.type == ipc::RequestType::OpenVR_ButtonEvent) {
+					openvr_buttonEvent(e.buttonEvent.deviceId, e.buttonEvent.eventType, e.buttonEvent.buttonId, e.buttonEvent.timeOffset);
+				}
+				else if (e.type == ipc::RequestType::OpenVR_AxisEvent) {
+					openvr_axisEvent(e.axisEvent.deviceId, e.axisEvent.axisId, e.axisEvent.axisState);
+				}
+			}
+		}
+
+		void DriverCore::walkinplace_locomotionBinding(const ipc::Request_WalkInPlace_LocomotionBinding& binding) {
+			OutputScheduler::Command command;
+			command.type = OutputScheduler::CommandType::LocomotionBinding;
+			command.locomotionBinding = binding;
+			_postOutput(command);
+		}
+
+		void DriverCore::walkinplace_locomotionIntent(const ipc::Request_WalkInPlace_LocomotionIntent& intent) {
+			OutputScheduler::Command command;
+			command.type = OutputScheduler::CommandType::LocomotionIntent;
+			command.locomotionIntent = intent;
+			_postOutput(command);
+		}
+
+		void DriverCore::_postOutput(OutputScheduler::Command& command) {
+			if (!_outputScheduler.post(command)) {
+				_stats->outputQueueDropped.fetch_add(1, std::memory_order_relaxed);
+				BLOG(WARNING, "Output queue is full, dropped command of type {}", command.type);
+			}
+		}
+
+		void DriverCore::_applyOutput(const OutputScheduler::Command& command, int64_t nowUs) {
+			switch (command.type) {
+			case OutputScheduler::CommandType::ButtonEvent:
+			{
+				// the offset the client gave is relative to when it was sent, not to now
+				auto& e = command.buttonEvent;
+				double queuedTime = (double)(nowUs - command.postTimeUs) / 1000000.0;
+				_applyButtonEvent(e.deviceId, e.eventType, e.buttonId, e.timeOffset - queuedTime);
+			}
+			break;
+			case OutputScheduler::CommandType::AxisEvent:
+			{
+				// the axis had this value when the event was posted, like a button event with offset 0
+				auto& e = command.axisEvent;
+				double queuedTime = (double)(nowUs - command.postTimeUs) / 1000000.0;
+				_outputScheduler.setAxis(e.deviceId, e.axisId, e.axisState);
+				_applyAxisEvent(e.deviceId, e.axisId, e.axisState, -queuedTime);
+			}
+			break;
+			case OutputScheduler::CommandType::LocomotionBinding:
+				_applyLocomotionBinding(command.locomotionBinding);
+				break;
+			case OutputScheduler::CommandType::LocomotionIntent:
+				_applyLocomotionIntent(command.locomotionIntent, nowUs);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void DriverCore::_applyButtonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+			auto handle = unWhichDevice < vr::k_unMaxTrackedDeviceCount ? _deviceTable.read()->byOpenvrId[unWhichDevice] : nullptr;
+			if (handle && handle->isValid()) {
+				handle->ll_sendButtonEvent(eventType, eButtonId, eventTimeOffset);
+			}
+		}
+
+		void DriverCore::_applyAxisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState, double eventTimeOffset) {
+			auto handle = unWhichDevice < vr::k_unMaxTrackedDeviceCount ? _deviceTable.read()->byOpenvrId[unWhichDevice] : nullptr;
+			if (handle && handle->isValid()) {
+				handle->ll_sendAxisEvent(unWhichAxis, axisState, eventTimeOffset);
+			}
+		}
+
+		void DriverCore::_applyLocomotionBinding(const ipc::Request_WalkInPlace_LocomotionBinding& binding) {
+			if (binding.axisId != _locomotionBinding.axisId || binding.buttonId != _locomotionBinding.buttonId || binding.pressMode != _locomotionBinding.pressMode) {
+				// release everything that was driven through the old binding, the next intent starts over with the new one
+				for (uint32_t i = 0; i < vr::k_unMaxTrackedDeviceCount; ++i) {
+					_locomotionStop(i);
+				}
+				_locomotionBinding = binding;
+			}
+		}
+
+		void DriverCore::_applyLocomotionIntent(const ipc::Request_WalkInPlace_LocomotionIntent& intent, int64_t nowUs) {
+			if (intent.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				return;
+			}
+			auto& state = _locomotionStates[intent.deviceId];
+			auto rampUs = (int64_t)(intent.rampTime * 1000000.0f);
+			if (intent.gait == LocomotionGait::Stopped) {
+				if (state.active && rampUs > 0) {
+					vr::VRControllerAxis_t zero = { 0.0f, 0.0f };
+					_outputScheduler.rampAxis(intent.deviceId, state.axisId, zero, rampUs, nowUs);
+					state.stopPending = true;
+				}
+				else {
+					_locomotionStop(intent.deviceId);
+				}
+				return;
+			}
+			state.stopPending = false;
+			if (!state.active) {
+				state.active = true;
+				state.pressed = false;
+				state.axisId = _locomotionBinding.axisId;
+				state.buttonId = _locomotionBinding.buttonId;
+				_applyButtonEvent(intent.deviceId, ButtonEventType::ButtonTouched, state.buttonId, 0.0);
+			}
+			bool press = _locomotionBinding.pressMode == LocomotionPressMode::Always
+				|| (_locomotionBinding.pressMode == LocomotionPressMode::OnRun && intent.gait == LocomotionGait::Run);
+			if (press != state.pressed) {
+				_applyButtonEvent(intent.deviceId, press ? ButtonEventType::ButtonPressed : ButtonEventType::ButtonUnpressed, state.buttonId, 0.0);
+				state.pressed = press;
+			}
+			vr::VRControllerAxis_t axisState;
+			axisState.x = intent.speed * intent.direction.v[0];
+			axisState.y = intent.speed * intent.direction.v[1];
+			if (rampUs > 0) {
+				_outputScheduler.rampAxis(intent.deviceId, state.axisId, axisState, rampUs, nowUs);
+			}
+			else {
+				_outputScheduler.setAxis(intent.deviceId, state.axisId, axisState);
+				_applyAxisEvent(intent.deviceId, state.axisId, axisState, 0.0);
+			}
+		}
+
+		void DriverCore::walkinplace_stepDetectionMode(const ipc::Request_WalkInPlace_StepDetectionMode& mode) {
+			_stepDetector.configure(mode);
+		}
+
+		void DriverCore::walkinplace_stepDetectionStatus(ipc::Reply_WalkInPlace_StepDetect& status) {
+			_stepDetector.getStatus(status);
+		}
+
+		void DriverCore::walkinplace_clientDisconnected(uint32_t clientId) {
+			_stepDetector.clientDisconnected(clientId);
+		}
+
+
+		void DriverCore::trackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t& newPose) {
+			if (unWhichDevice >= vr::k_unMaxTrackedDeviceCount || (!_poseTap && !_stepDetector.isEnabled())) {
+				return;
+			}
+			ipc::PoseTapSample sample;
+			sample.sampleTimeUs = ipc::monotonicTimeUs();
+			sample.poseTimeOffset = newPose.poseTimeOffset;
+			sample.position = vrmath::quaternionRotateVector(newPose.qWorldFromDriverRotation, newPose.vecPosition) + newPose.vecWorldFromDriverTranslation;
+			sample.velocity = vrmath::quaternionRotateVector(newPose.qWorldFromDriverRotation, newPose.vecVelocity);
+			sample.rotation = newPose.qWorldFromDriverRotation * newPose.qRotation;
+			sample.flags = (newPose.poseIsValid ? (uint32_t)ipc::PoseTapFlag_PoseIsValid : 0u) | (newPose.deviceIsConnected ? (uint32_t)ipc::PoseTapFlag_DeviceIsConnected : 0u);
+			auto handle = _deviceTable.read()->byOpenvrId[unWhichDevice];
+			auto deviceClass = handle ? handle->deviceClass() : vr::TrackedDeviceClass_Invalid;
+			if (_poseTap && unWhichDevice < IPC_POSETAP_DEVICECOUNT) {
+				auto& ring = _poseTap->devices[unWhichDevice];
+				ring.deviceClass.store(deviceClass, std::memory_order_relaxed);
+				ring.write(sample);
+			}
+			if (handle) {
+				_stepDetector.updatePose(unWhichDevice, deviceClass, sample);
+			}
+		}
+
+
+		void DriverCore::_locomotionStop(uint32_t deviceId) {
+			auto& state = _locomotionStates[deviceId];
+			if (state.active) {
+				if (state.pressed) {
+					_applyButtonEvent(deviceId, ButtonEventType::ButtonUnpressed, state.buttonId, 0.0);
+				}
+				vr::VRControllerAxis_t axisState = { 0.0f, 0.0f };
+				_outputScheduler.setAxis(deviceId, state.axisId, axisState);
+				_applyAxisEvent(deviceId, state.axisId, axisState, 0.0);
+				_applyButtonEvent(deviceId, ButtonEventType::ButtonUntouched, state.buttonId, 0.0);
+				state.active = false;
+				state.pressed = false;
+			}
+			state.stopPending = false;
+		}
+
+		DeviceManipulationHandle* DriverCore::getDeviceManipulationHandleById(uint32_t unWhichDevice) {
+			auto handle = unWhichDevice < vr::k_unMaxTrackedDeviceCount ? _deviceTable.read()->byOpenvrId[unWhichDevice] : nullptr;
+			if (handle && handle->isValid()) {
+				return handle;
+			}
+			return nullptr;
+		}
+
+		DeviceManipulationHandle* DriverCore::getDeviceManipulationHandleByPropertyContainer(vr::PropertyContainerHandle_t container) {
+			auto devices = _deviceTable.read();
+			auto it = devices->byPropertyContainer.find(container);
+			if (it != devices->byPropertyContainer.end()) {
+				return it->second;
+			}
+			return nullptr;
+		}
+
+		bool DriverCore::addDriverEventForInjection(void* serverDriverHost, const vr::VREvent_t& event, uint32_t size) {
+			if (size > sizeof(vr::VREvent_t)) {
+				LOG(ERROR) << "Could not queue event for injection: size " << size << " is too large";
+				return false;
+			}
+			std::lock_guard<std::mutex> lock(_driverEventInjectionMutex);
+			_DriverEventInjectionQueue* queue = nullptr;
+			for (auto& q : _driverEventInjectionQueues) {
+				auto host = q.serverDriverHost.load(std::memory_order_relaxed);
+				if (host == serverDriverHost) {
+					queue = &q;
+					break;
+				}
+				else if (!queue && !host) {
+					queue = &q;
+				}
+			}
+			if (!queue || queue->count.load(std::memory_order_relaxed) >= _driverEventInjectionCapacity) {
+				LOG(WARNING) << "Could not queue event " << event.eventType << " for injection: queue is full";
+				return false;
+			}
+			queue->serverDriverHost.store(serverDriverHost, std::memory_order_relaxed);
+			auto count = queue->count.load(std::memory_order_relaxed);
+			auto index = (queue->readIndex + count) % _driverEventInjectionCapacity;
+			memcpy(&queue->events[index], &event, size);
+			queue->sizes[index] = size;
+			queue->count.store(count + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		bool DriverCore::getDriverEventForInjection(void* serverDriverHost, vr::VREvent_t& event, uint32_t& size) {
+			for (auto& queue : _driverEventInjectionQueues) {
+				if (queue.serverDriverHost.load(std::memory_order_relaxed) == serverDriverHost) {
+					// Events queued for other hosts do not make this host take the lock
+					if (queue.count.load(std::memory_order_relaxed) == 0) {
+						return false;
+					}
+					std::lock_guard<std::mutex> lock(_driverEventInjectionMutex);
+					auto count = queue.count.load(std::memory_order_relaxed);
+					if (count == 0) {
+						return false;
+					}
+					event = queue.events[queue.readIndex];
+					size = queue.sizes[queue.readIndex];
+					queue.readIndex = (queue.readIndex + 1) % _driverEventInjectionCapacity;
+					queue.count.store(count - 1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			return false;
+		}
+
+
+
+	} // end namespace driver
+} // end namespace vrwalkinplace
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <openvr_driver.h>
+#include <vrwalkinplace_types.h>
+#include <openvr_math.h>
+#include "../logging.h"
+#include <ipc_pose_tap.h>
+#include <ipc_stats.h>
+#include <binarylog.h>
+#include "StepDetector.h"
+#include "OutputScheduler.h"
+#include "DeviceTable.h"
+#include "PropertyOverrides.h"
+#include "DriverHost.h"
+
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+// forward declarations
+class DeviceManipulationHandle;
+
+
+/**
+* The part of the driver that does not depend on being hooked into vrserver.
+*
+* Keeps track of the devices and their input components, applies what the ipc threads queue (button, axis and
+* locomotion updates), runs the driver side step detection and queues driver events for injection. It reaches
+* vrserver only through its DriverHost. ServerDriver feeds it from the hooks and plugs in the real interfaces,
+* with a MockDriverHost it runs (and can be benchmarked) in any process.
+*/
+class DriverCore {
+public:
+	explicit DriverCore(std::shared_ptr<DriverHost> driverHost);
+	virtual ~DriverCore() {}
+
+	DriverHost& driverHost() { return *_driverHost; }
+
+	// Statistics shared with monitoring tools (see ipc_stats.h), a process-local page when the shared one could not be created
+	ipc::StatsPage& stats() { return *_stats; }
+
+	/** Applies the queued output, runs the step detection and updates axis ramps. Meant to be called at display rate. */
+	void runFrame();
+
+	// The following are called by the IPC threads, they only queue the update, runFrame() applies it
+	void openvr_buttonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+
+	void openvr_axisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
+
+	// Queues all events of the batch in order
+	void openvr_eventBatch(const ipc::Request_OpenVR_EventBatch& batch);
+
+	// Locomotion intents are turned into touch/press/axis updates according to the current binding
+	void walkinplace_locomotionBinding(const ipc::Request_WalkInPlace_LocomotionBinding& binding);
+	void walkinplace_locomotionIntent(const ipc::Request_WalkInPlace_LocomotionIntent& intent);
+
+	// Step detection running inside the driver, its output is applied as locomotion intent in runFrame()
+	void walkinplace_stepDetectionMode(const ipc::Request_WalkInPlace_StepDetectionMode& mode);
+	void walkinplace_stepDetectionStatus(ipc::Reply_WalkInPlace_StepDetect& status);
+	void walkinplace_clientDisconnected(uint32_t clientId);
+
+	DeviceManipulationHandle* getDeviceManipulationHandleById(uint32_t unWhichDevice);
+	DeviceManipulationHandle* getDeviceManipulationHandleByPropertyContainer(vr::PropertyContainerHandle_t container);
+
+	void executeCodeForEachDeviceManipulationHandle(std::function<void(DeviceManipulationHandle*)> code) {
+		auto devices = _deviceTable.read();
+		for (auto& d : devices->byDriverPtr) {
+			code(d.second.get());
+		}
+	}
+
+	//// device events as vrserver reports them ////
+	/** May change eDeviceClass (device class override), returns the handle of the new device */
+	std::shared_ptr<DeviceManipulationHandle> trackedDeviceAdded(void* serverDriverHost, int version, const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass& eDeviceClass, void* pDriver);
+	/** Controllers get their input components here */
+	void trackedDeviceActivated(void* serverDriver, int version, uint32_t unObjectId);
+	void trackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t& newPose);
+	/** Applies the property overrides to a batch of property writes */
+	void propertiesWritePropertyBatch(vr::PropertyContainerHandle_t ulContainer, void* pBatch, uint32_t unBatchEntryCount);
+	void booleanComponentCreated(void* driverInput, vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t pHandle);
+	void scalarComponentCreated(void* driverInput, vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits);
+
+	// driver events injection
+	/** Returns false when the queue of this host is full (or all host slots are taken) */
+	bool addDriverEventForInjection(void* serverDriverHost, const vr::VREvent_t& event, uint32_t size);
+	/** Called on every PollNextEvent, returns false without locking when nothing is queued */
+	bool getDriverEventForInjection(void* serverDriverHost, vr::VREvent_t& event, uint32_t& size);
+
+
+protected:
+	//// statistics related ////
+	ipc::StatsPage _localStats;
+	ipc::StatsPage* _stats = &_localStats;
+
+	//// pose tap related ////
+	ipc::PoseTap* _poseTap = nullptr; // read without locking by the pose update
+
+	// Device Property Overrides
+	PropertyOverrides _propertyOverrides;
+	bool _propertiesOverrideGenericTrackerFakeController = false;
+
+
+private:
+	std::shared_ptr<DriverHost> _driverHost;
+
+	//// device manipulation related ////
+	DeviceTable _deviceTable;
+	uint32_t _propertyContainerToDeviceId(vr::PropertyContainerHandle_t ulContainer);
+
+	//// locomotion intent related ////
+	struct _LocomotionState {
+		bool active = false;
+		bool pressed = false;
+		uint32_t axisId = 0;
+		vr::EVRButtonId buttonId = vr::k_EButton_SteamVR_Touchpad;
+		bool stopPending = false; // release once the axis ramp is done
+	};
+	ipc::Request_WalkInPlace_LocomotionBinding _locomotionBinding;
+	_LocomotionState _locomotionStates[vr::k_unMaxTrackedDeviceCount];
+	void _locomotionStop(uint32_t deviceId);
+
+	//// output scheduling related ////
+	OutputScheduler _outputScheduler;
+	void _postOutput(OutputScheduler::Command& command);
+	void _applyOutput(const OutputScheduler::Command& command, int64_t nowUs);
+	void _applyButtonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	void _applyAxisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState, double eventTimeOffset);
+	void _applyLocomotionBinding(const ipc::Request_WalkInPlace_LocomotionBinding& binding);
+	void _applyLocomotionIntent(const ipc::Request_WalkInPlace_LocomotionIntent& intent, int64_t nowUs);
+
+	//// step detection related ////
+	StepDetector _stepDetector;
+
+	// driver events injection
+	static const uint32_t _driverEventInjectionHostCount = 4;
+	static const uint32_t _driverEventInjectionCapacity = 64; // per host
+	// serverDriverHost and count are only written under _driverEventInjectionMutex, but read without it, so that a host
+	// polling for events does not take the lock while its own queue is empty
+	struct _DriverEventInjectionQueue {
+		std::atomic<void*> serverDriverHost = { nullptr };
+		uint32_t readIndex = 0;
+		std::atomic<uint32_t> count = { 0 };
+		vr::VREvent_t events[_driverEventInjectionCapacity];
+		uint32_t sizes[_driverEventInjectionCapacity];
+	};
+	std::mutex _driverEventInjectionMutex;
+	_DriverEventInjectionQueue _driverEventInjectionQueues[_driverEventInjectionHostCount];
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
@@ -0,0 +1,315 @@
+#include "DriverCoreBench.h"
+#include "DriverCore.h"
+#include "MockDriverHost.h"
+#include "../devicemanipulation/DeviceManipulationHandle.h"
+#include "../com/shm/driver_ipc_shm.h"
+#include <ipc_protocol.h>
+#include <ipc_frame.h>
+#include <ipc_stats.h>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+#define COREBENCH_DEVICECOUNT 16
+#define COREBENCH_LOOKUPS 1000000
+#define COREBENCH_INJECTION_ROUNDS 10000
+#define COREBENCH_DRIVEREVENTS 1000000
+#define COREBENCH_DRIVEREVENTS_BATCH 32 // below the per host capacity of the injection queue
+#define COREBENCH_IPC_REQUESTS 100000
+#define COREBENCH_IPC_TIMEOUT_MS 10000
+#define COREBENCH_TIMING_WARNING_FACTOR 1.5 // only a warning, timings depend on the machine
+
+
+static const char* _coreBenchServerQueueName = "driver_vrwalkinplace.server_queue";
+
+
+// One result line, counts have to match the baseline exactly, timings only warn when they got worse
+struct CoreBenchValue {
+	std::string name;
+	double value;
+	bool isTiming;
+};
+
+
+static double _elapsedNs(std::chrono::steady_clock::time_point start) {
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Adds controllers with openvr ids 1 .. count the way the hooks report them, the driver pointers are only used as keys
+static void _addMockControllers(DriverCore& core, uint32_t count) {
+	for (uint32_t id = 1; id <= count; ++id) {
+		auto serial = "mock-" + std::to_string(id);
+		auto driverPtr = (void*)(uintptr_t)id;
+		vr::ETrackedDeviceClass deviceClass = vr::TrackedDeviceClass_Controller;
+		core.trackedDeviceAdded(nullptr, 5, serial.c_str(), deviceClass, driverPtr);
+		core.trackedDeviceActivated(driverPtr, 5, id);
+	}
+}
+
+
+static void _benchComponentLookup(std::vector<CoreBenchValue>& results, std::ostream& out, uint32_t& errors) {
+	auto host = std::make_shared<MockDriverHost>();
+	DriverCore core(host);
+	auto start = std::chrono::steady_clock::now();
+	_addMockControllers(core, COREBENCH_DEVICECOUNT);
+	auto registrationNs = _elapsedNs(start);
+	auto components = host->componentCount();
+
+	uint32_t misses = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < COREBENCH_LOOKUPS; ++i) {
+		uint32_t id = 1 + i % COREBENCH_DEVICECOUNT;
+		auto handle = (i & 1) ? core.getDeviceManipulationHandleById(id) : core.getDeviceManipulationHandleByPropertyContainer(MockDriverHost::propertyContainer(id));
+		if (!handle || handle->openvrId() != id) {
+			misses++;
+		}
+	}
+	auto lookupNs = _elapsedNs(start);
+	if (misses > 0) {
+		out << "ERROR " << misses << " of " << COREBENCH_LOOKUPS << " device lookups failed" << std::endl;
+		errors++;
+	}
+
+	results.push_back({ "components", (double)components, false });
+	results.push_back({ "registrationNsPerComponent", components > 0 ? registrationNs / components : 0.0, true });
+	results.push_back({ "lookupMisses", (double)misses, false });
+	results.push_back({ "lookupNs", lookupNs / COREBENCH_LOOKUPS, true });
+}
+
+
+// Per round every device gets touch, axis and untouch queued, then one frame applies them: 1 + 2 + 1 component updates
+static void _benchInjection(std::vector<CoreBenchValue>& results, std::ostream& out, uint32_t& errors) {
+	auto host = std::make_shared<MockDriverHost>(COREBENCH_INJECTION_ROUNDS * COREBENCH_DEVICECOUNT * 4);
+	DriverCore core(host);
+	_addMockControllers(core, COREBENCH_DEVICECOUNT);
+	vr::VRControllerAxis_t axisState = { 0.0f, 0.5f };
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t r = 0; r < COREBENCH_INJECTION_ROUNDS; ++r) {
+		axisState.x = (float)(r % 100) / 100.0f;
+		for (uint32_t id = 1; id <= COREBENCH_DEVICECOUNT; ++id) {
+			core.openvr_buttonEvent(id, ButtonEventType::ButtonTouched, vr::k_EButton_SteamVR_Touchpad, 0.0);
+			core.openvr_axisEvent(id, 0, axisState);
+			core.openvr_buttonEvent(id, ButtonEventType::ButtonUntouched, vr::k_EButton_SteamVR_Touchpad, 0.0);
+		}
+		core.runFrame();
+	}
+	auto injectionNs = _elapsedNs(start);
+
+	uint64_t expected = (uint64_t)COREBENCH_INJECTION_ROUNDS * COREBENCH_DEVICECOUNT * 4;
+	uint64_t recorded = host->updates().size() + host->droppedUpdates();
+	if (recorded != expected) {
+		out << "ERROR Injected " << recorded << " component updates, expected " << expected << std::endl;
+		errors++;
+	}
+	ipc::StatsSnapshot stats;
+	core.stats().snapshot(stats);
+	if (stats.injectionErrors > 0 || stats.outputQueueDropped > 0) {
+		out << "ERROR " << stats.injectionErrors << " injection errors, " << stats.outputQueueDropped << " dropped output commands" << std::endl;
+		errors++;
+	}
+
+	results.push_back({ "injectedUpdates", (double)recorded, false });
+	results.push_back({ "injectionNsPerUpdate", recorded > 0 ? injectionNs / recorded : 0.0, true });
+	results.push_back({ "injectionCallAvgUs", (double)stats.injectionTime.averageUs(), true });
+}
+
+
+static void _benchDriverEvents(std::vector<CoreBenchValue>& results, std::ostream& out, uint32_t& errors) {
+	auto host = std::make_shared<MockDriverHost>();
+	DriverCore core(host);
+	auto serverDriverHost = (void*)(uintptr_t)1;
+	vr::VREvent_t event = {};
+	uint32_t nextEventType = 0;
+	uint32_t lost = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < COREBENCH_DRIVEREVENTS; i += COREBENCH_DRIVEREVENTS_BATCH) {
+		for (uint32_t n = 0; n < COREBENCH_DRIVEREVENTS_BATCH; ++n) {
+			event.eventType = i + n;
+			if (!core.addDriverEventForInjection(serverDriverHost, event, sizeof(event))) {
+				lost++;
+			}
+		}
+		uint32_t size;
+		while (core.getDriverEventForInjection(serverDriverHost, event, size)) {
+			if (event.eventType != nextEventType || size != sizeof(event)) {
+				lost++;
+			}
+			nextEventType = event.eventType + 1;
+		}
+	}
+	auto eventsNs = _elapsedNs(start);
+	if (lost > 0) {
+		out << "ERROR " << lost << " driver events were lost or out of order" << std::endl;
+		errors++;
+	}
+
+	results.push_back({ "driverEventsLost", (double)lost, false });
+	results.push_back({ "driverEventNs", eventsNs / COREBENCH_DRIVEREVENTS, true });
+}
+
+
+// Axis events sent one frame per message like unbatched clients do, received and queued by the ipc thread, applied by a frame thread.
+// The sender does not wait for frames, frames run back to back and the output queue still drops a few commands when the
+// frame thread gets descheduled. How many depends on the machine like the timings do.
+static void _benchIpcDispatch(std::vector<CoreBenchValue>& results, std::ostream& out, uint32_t& errors) {
+	// The communicator recreates the server queue, that would cut off a running driver
+	try {
+		boost::interprocess::message_queue existing(boost::interprocess::open_only, _coreBenchServerQueueName);
+		throw std::runtime_error(std::string(_coreBenchServerQueueName) + " exists, is SteamVR running?");
+	}
+	catch (boost::interprocess::interprocess_exception&) {
+	}
+
+	auto host = std::make_shared<MockDriverHost>(COREBENCH_IPC_REQUESTS * 2);
+	DriverCore core(host);
+	_addMockControllers(core, COREBENCH_DEVICECOUNT);
+	IpcShmCommunicator communicator;
+	communicator.init(&core);
+	std::unique_ptr<boost::interprocess::message_queue> queue;
+	for (uint32_t n = 0; !queue; ++n) {
+		try {
+			queue.reset(new boost::interprocess::message_queue(boost::interprocess::open_only, _coreBenchServerQueueName));
+		}
+		catch (boost::interprocess::interprocess_exception&) {
+			if (n >= 1000) {
+				communicator.shutdown();
+				throw std::runtime_error("The ipc thread did not create the server queue");
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	std::atomic<bool> stopFrames = { false };
+	std::thread frameThread([&]() {
+		while (!stopFrames.load(std::memory_order_relaxed)) {
+			core.runFrame();
+			std::this_thread::yield();
+		}
+		core.runFrame();
+	});
+
+	auto& stats = core.stats();
+	ipc::StatsSnapshot before;
+	stats.snapshot(before);
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < COREBENCH_IPC_REQUESTS; ++i) {
+		ipc::Request request(ipc::RequestType::OpenVR_AxisEvent);
+		request.msg.ipc_AxisEvent.deviceId = 1 + i % COREBENCH_DEVICECOUNT;
+		request.msg.ipc_AxisEvent.axisId = 0;
+		request.msg.ipc_AxisEvent.axisState = { (float)(i % 100) / 100.0f, 0.5f };
+		ipc::FramePacket packet;
+		packet.clear();
+		packet.append(request);
+		queue->send(&packet, packet.byteSize(), 0);
+	}
+	// every request ends up as two scalar updates, or is counted as dropped
+	auto applied = [&]() {
+		return (uint64_t)(stats.axisInjections.load(std::memory_order_relaxed) - before.axisInjections)
+			+ 2ull * (stats.outputQueueDropped.load(std::memory_order_relaxed) - before.outputQueueDropped);
+	};
+	while (applied() < 2ull * COREBENCH_IPC_REQUESTS && _elapsedNs(start) < COREBENCH_IPC_TIMEOUT_MS * 1e6) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	auto ipcNs = _elapsedNs(start);
+	stopFrames.store(true, std::memory_order_relaxed);
+	frameThread.join();
+	queue.reset();
+	communicator.shutdown();
+
+	ipc::StatsSnapshot after;
+	stats.snapshot(after);
+	auto received = after.requests[(uint32_t)ipc::RequestType::OpenVR_AxisEvent] - before.requests[(uint32_t)ipc::RequestType::OpenVR_AxisEvent];
+	auto dropped = after.outputQueueDropped - before.outputQueueDropped;
+	auto dispatch = after.dispatchLatency[ipc::StatsTransport_MessageQueue].since(before.dispatchLatency[ipc::StatsTransport_MessageQueue]);
+	auto output = after.outputLatency.since(before.outputLatency);
+	uint64_t recorded = host->updates().size() + host->droppedUpdates();
+	if (received != COREBENCH_IPC_REQUESTS || recorded + 2ull * dropped != 2ull * COREBENCH_IPC_REQUESTS) {
+		out << "ERROR Sent " << COREBENCH_IPC_REQUESTS << " axis events, " << received << " received, " << dropped << " dropped, "
+			<< recorded << " component updates" << std::endl;
+		errors++;
+	}
+
+	results.push_back({ "ipcRequests", (double)received, false });
+	results.push_back({ "ipcDropped", (double)dropped, true });
+	results.push_back({ "ipcNsPerRequest", ipcNs / COREBENCH_IPC_REQUESTS, true });
+	results.push_back({ "ipcDispatchP50Us", (double)dispatch.percentileUs(0.5), true });
+	results.push_back({ "ipcDispatchP99Us", (double)dispatch.percentileUs(0.99), true });
+	results.push_back({ "ipcOutputP99Us", (double)output.percentileUs(0.99), true });
+}
+
+
+uint32_t benchmarkDriverCore(std::ostream& out, const std::string& baselinePath) {
+	std::vector<CoreBenchValue> results;
+	uint32_t regressions = 0;
+	_benchComponentLookup(results, out, regressions);
+	_benchInjection(results, out, regressions);
+	_benchDriverEvents(results, out, regressions);
+	_benchIpcDispatch(results, out, regressions);
+
+	out << std::fixed << std::setprecision(1);
+	for (auto& r : results) {
+		out << std::left << std::setw(28) << r.name << std::right << std::setw(12) << r.value << std::endl;
+	}
+	if (baselinePath.empty()) {
+		return regressions;
+	}
+
+	std::ifstream baselineFile(baselinePath);
+	if (!baselineFile) {
+		std::ofstream file(baselinePath);
+		file << std::fixed << std::setprecision(3);
+		file << "# metric value" << std::endl;
+		for (auto& r : results) {
+			file << r.name << " " << r.value << std::endl;
+		}
+		if (!file) {
+			throw std::runtime_error("Could not write baseline " + baselinePath);
+		}
+		out << "Baseline written to " << baselinePath << std::endl;
+		return regressions;
+	}
+
+	std::map<std::string, double> baseline;
+	std::string line;
+	while (std::getline(baselineFile, line)) {
+		std::istringstream fields(line);
+		std::string name;
+		double value;
+		if ((fields >> name) && name[0] != '#' && (fields >> value)) {
+			baseline[name] = value;
+		}
+	}
+	for (auto& r : results) {
+		auto b = baseline.find(r.name);
+		if (b == baseline.end()) {
+			out << "No baseline for " << r.name << std::endl;
+		}
+		else if (!r.isTiming && r.value != b->second) {
+			out << "REGRESSION " << r.name << ": " << r.value << ", baseline " << b->second << std::endl;
+			regressions++;
+		}
+		else if (r.isTiming && r.value > b->second * COREBENCH_TIMING_WARNING_FACTOR) {
+			out << "Worse than baseline " << r.name << ": " << r.value << ", baseline " << b->second << std::endl;
+		}
+	}
+	out << regressions << " regressions against " << baselinePath << std::endl;
+	return regressions;
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
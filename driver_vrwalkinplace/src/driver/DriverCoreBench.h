@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Runs the driver core on a MockDriverHost and prints the time per input component registration and device lookup,
+* per injected button/axis update (queued like the ipc threads do, applied by runFrame), per injected driver event
+* and the throughput and latencies of requests dispatched through the server message queue.
+*
+* The ipc part creates the driver's server queue, so it refuses to run while the driver is loaded in vrserver.
+* When baselinePath names an existing file the results are compared against it, otherwise they are written to it.
+* Wrong update counts are regressions, slower timings only print a warning (they depend on the machine).
+* Returns the number of regressions.
+*/
+uint32_t benchmarkDriverCore(std::ostream& out, const std::string& baselinePath);
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
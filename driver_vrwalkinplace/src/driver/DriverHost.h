@@ -0,0 +1,63 @@
+#pragma once
+
+#include <openvr_driver.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* The parts of vr::IVRDriverInput and vr::IVRProperties the driver core calls (same signatures).
+*
+* OpenVRDriverHost forwards to vrserver, MockDriverHost records the calls so that the core runs outside of it.
+*/
+class DriverHost {
+public:
+	virtual ~DriverHost() {}
+
+	/** False while there is no server driver host (before Init()), the core holds back input updates then */
+	virtual bool isReady() = 0;
+
+	virtual vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) = 0;
+	virtual vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) = 0;
+	virtual vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle,
+		vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) = 0;
+	virtual vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) = 0;
+
+	virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) = 0;
+};
+
+
+class OpenVRDriverHost : public DriverHost {
+public:
+	virtual bool isReady() override {
+		return vr::VRServerDriverHost() != nullptr;
+	}
+
+	virtual vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override {
+		return vr::VRDriverInput()->CreateBooleanComponent(ulContainer, pchName, pHandle);
+	}
+
+	virtual vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) override {
+		return vr::VRDriverInput()->UpdateBooleanComponent(ulComponent, bNewValue, fTimeOffset);
+	}
+
+	virtual vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle,
+			vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) override {
+		return vr::VRDriverInput()->CreateScalarComponent(ulContainer, pchName, pHandle, eType, eUnits);
+	}
+
+	virtual vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) override {
+		return vr::VRDriverInput()->UpdateScalarComponent(ulComponent, fNewValue, fTimeOffset);
+	}
+
+	virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override {
+		return vr::VRPropertiesRaw()->TrackedDeviceToPropertyContainer(nDevice);
+	}
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
@@ -0,0 +1,83 @@
+#include "MockDriverHost.h"
+#include <vrwalkinplace_types.h>
+#include <ipc_protocol.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+MockDriverHost::MockDriverHost(size_t updateCapacity) : _updateCapacity(updateCapacity) {
+	_updates.reserve(updateCapacity);
+}
+
+
+const MockDriverHost::Component* MockDriverHost::component(vr::VRInputComponentHandle_t handle) const {
+	if (handle == 0 || handle > _components.size()) {
+		return nullptr;
+	}
+	return &_components[handle - 1];
+}
+
+
+vr::EVRInputError MockDriverHost::_createComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle, bool isScalar) {
+	if (!pchName || !pHandle) {
+		return vr::VRInputError_InvalidParam;
+	}
+	if (ulContainer == vr::k_ulInvalidPropertyContainer) {
+		*pHandle = vr::k_ulInvalidInputComponentHandle;
+		return vr::VRInputError_InvalidHandle;
+	}
+	_components.push_back({ ulContainer, pchName, isScalar });
+	*pHandle = (vr::VRInputComponentHandle_t)_components.size();
+	return vr::VRInputError_None;
+}
+
+
+vr::EVRInputError MockDriverHost::_recordUpdate(vr::VRInputComponentHandle_t ulComponent, bool isScalar, float value, double fTimeOffset) {
+	auto c = component(ulComponent);
+	if (!c) {
+		return vr::VRInputError_InvalidHandle;
+	}
+	if (c->isScalar != isScalar) {
+		return vr::VRInputError_WrongType;
+	}
+	if (_updates.size() < _updateCapacity) {
+		_updates.push_back({ ipc::monotonicTimeUs(), ulComponent, isScalar, value, fTimeOffset });
+	}
+	else {
+		_droppedUpdates++;
+	}
+	return _updateError;
+}
+
+
+vr::EVRInputError MockDriverHost::CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) {
+	return _createComponent(ulContainer, pchName, pHandle, false);
+}
+
+
+vr::EVRInputError MockDriverHost::UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) {
+	return _recordUpdate(ulComponent, false, bNewValue ? 1.0f : 0.0f, fTimeOffset);
+}
+
+
+vr::EVRInputError MockDriverHost::CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle,
+		vr::EVRScalarType /*eType*/, vr::EVRScalarUnits /*eUnits*/) {
+	return _createComponent(ulContainer, pchName, pHandle, true);
+}
+
+
+vr::EVRInputError MockDriverHost::UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) {
+	return _recordUpdate(ulComponent, true, fNewValue, fTimeOffset);
+}
+
+
+vr::PropertyContainerHandle_t MockDriverHost::TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) {
+	return nDevice < vr::k_unMaxTrackedDeviceCount ? propertyContainer(nDevice) : vr::k_ulInvalidPropertyContainer;
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
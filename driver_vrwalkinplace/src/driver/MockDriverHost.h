@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <openvr_driver.h>
+#include "DriverHost.h"
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Stands in for vrserver's input and property interfaces, so that the driver core runs in any process.
+*
+* Components get consecutive handles starting at 1, property containers are deviceId + 1. Every
+* Update*Component call is recorded with its monotonicTimeUs() into a buffer allocated up front, calls beyond
+* its capacity are only counted. Like the real interfaces it expects to be called from one thread at a time.
+*/
+class MockDriverHost : public DriverHost {
+public:
+	struct Component {
+		vr::PropertyContainerHandle_t container;
+		std::string name;
+		bool isScalar;
+	};
+
+	struct Update {
+		int64_t timeUs;
+		vr::VRInputComponentHandle_t component;
+		bool isScalar;
+		float value; // 0 or 1 for boolean components
+		double timeOffset;
+	};
+
+	explicit MockDriverHost(size_t updateCapacity = 1 << 20);
+
+	static vr::PropertyContainerHandle_t propertyContainer(vr::TrackedDeviceIndex_t deviceId) {
+		return (vr::PropertyContainerHandle_t)deviceId + 1;
+	}
+
+	void setReady(bool ready) {
+		_ready.store(ready, std::memory_order_relaxed);
+	}
+
+	// Makes the following updates fail with error (still recorded), VRInputError_None to succeed again
+	void setUpdateError(vr::EVRInputError error) {
+		_updateError = error;
+	}
+
+	// Null for unknown handles
+	const Component* component(vr::VRInputComponentHandle_t handle) const;
+
+	size_t componentCount() const {
+		return _components.size();
+	}
+
+	const std::vector<Update>& updates() const {
+		return _updates;
+	}
+
+	uint64_t droppedUpdates() const {
+		return _droppedUpdates;
+	}
+
+	void clearUpdates() {
+		_updates.clear();
+		_droppedUpdates = 0;
+	}
+
+	virtual bool isReady() override {
+		return _ready.load(std::memory_order_relaxed);
+	}
+
+	virtual vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override;
+	virtual vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) override;
+	virtual vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle,
+		vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) override;
+	virtual vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) override;
+	virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override;
+
+private:
+	std::atomic<bool> _ready = { true };
+	vr::EVRInputError _updateError = vr::VRInputError_None;
+	std::vector<Component> _components; // handle - 1
+	std::vector<Update> _updates;
+	size_t _updateCapacity;
+	uint64_t _droppedUpdates = 0;
+
+	vr::EVRInputError _createComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle, bool isScalar);
+	vr::EVRInputError _recordUpdate(vr::VRInputComponentHandle_t ulComponent, bool isScalar, float value, double fTimeOffset);
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
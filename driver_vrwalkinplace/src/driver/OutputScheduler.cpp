@@ -0,0 +1,92 @@
+#include "OutputScheduler.h"
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+OutputScheduler::OutputScheduler() {
+	static_assert((_queueCapacity & (_queueCapacity - 1)) == 0, "Capacity must be a power of two");
+	for (uint32_t i = 0; i < _queueCapacity; i++) {
+		_queue[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	_enqueuePos.store(0, std::memory_order_release);
+}
+
+
+// Bounded MPMC queue after Dmitry Vyukov: a cell is free for position pos when its sequence is pos,
+// and holds the command for pos when its sequence is pos + 1.
+bool OutputScheduler::post(Command& command) {
+	command.postTimeUs = ipc::monotonicTimeUs();
+	auto pos = _enqueuePos.load(std::memory_order_relaxed);
+	_Cell* cell;
+	while (true) {
+		cell = &_queue[pos & (_queueCapacity - 1)];
+		auto seq = cell->sequence.load(std::memory_order_acquire);
+		auto diff = (int32_t)(seq - pos);
+		if (diff == 0) {
+			if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if (diff < 0) {
+			return false; // full
+		}
+		else {
+			pos = _enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+	cell->command = command;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+
+bool OutputScheduler::pop(Command& command) {
+	auto& cell = _queue[_dequeuePos & (_queueCapacity - 1)];
+	if (cell.sequence.load(std::memory_order_acquire) != _dequeuePos + 1) {
+		return false;
+	}
+	command = cell.command;
+	cell.sequence.store(_dequeuePos + _queueCapacity, std::memory_order_release);
+	_dequeuePos++;
+	return true;
+}
+
+
+void OutputScheduler::setAxis(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& value) {
+	if (deviceId >= vr::k_unMaxTrackedDeviceCount || axisId >= vr::k_unControllerStateAxisCount) {
+		return;
+	}
+	auto& axis = _axes[deviceId][axisId];
+	if (axis.ramping) {
+		axis.ramping = false;
+		_rampingCount--;
+	}
+	axis.current = value;
+}
+
+
+void OutputScheduler::rampAxis(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& target, int64_t durationUs, int64_t nowUs) {
+	if (deviceId >= vr::k_unMaxTrackedDeviceCount || axisId >= vr::k_unControllerStateAxisCount) {
+		return;
+	}
+	if (durationUs <= 0) {
+		setAxis(deviceId, axisId, target);
+		return;
+	}
+	auto& axis = _axes[deviceId][axisId];
+	if (!axis.ramping) {
+		axis.ramping = true;
+		_rampingCount++;
+	}
+	axis.from = axis.current;
+	axis.target = target;
+	axis.rampStartUs = nowUs;
+	axis.rampEndUs = nowUs + durationUs;
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <openvr_driver.h>
+#include <vrwalkinplace_types.h>
+#include <ipc_protocol.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Decouples input component updates from IPC message arrival.
+*
+* The IPC threads post commands into a bounded lock-free queue (any number of producers, DriverCore::runFrame is
+* the only consumer). runFrame drains it once per frame, so all updates are applied at display rate and on one thread.
+* Axis ramps are interpolated here, a whole ramp is one command instead of one message per overlay tick.
+*/
+class OutputScheduler {
+public:
+	enum class CommandType : uint32_t {
+		None,
+		ButtonEvent,
+		AxisEvent,
+		LocomotionBinding,
+		LocomotionIntent
+	};
+
+	struct Command {
+		CommandType type = CommandType::None;
+		int64_t postTimeUs = 0; // monotonicTimeUs(), set by post()
+		union {
+			ipc::Request_OpenVR_ButtonEvent buttonEvent;
+			ipc::Request_OpenVR_AxisEvent axisEvent;
+			ipc::Request_WalkInPlace_LocomotionBinding locomotionBinding;
+			ipc::Request_WalkInPlace_LocomotionIntent locomotionIntent;
+		};
+		Command() {}
+	};
+
+	OutputScheduler();
+
+	/** Any thread. Returns false when the queue is full. */
+	bool post(Command& command);
+
+	/** RunFrame thread only. Returns false when the queue is empty. */
+	bool pop(Command& command);
+
+	/** RunFrame thread only: Number of queued commands, may lag behind concurrent posts */
+	uint32_t pendingCount() const {
+		return _enqueuePos.load(std::memory_order_relaxed) - _dequeuePos;
+	}
+
+	/** RunFrame thread only: The axis was set to value right now, cancels a running ramp */
+	void setAxis(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& value);
+
+	/** RunFrame thread only: Moves the axis linearly from its current value to target within duration */
+	void rampAxis(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& target, int64_t durationUs, int64_t nowUs);
+
+	bool isAxisRamping(uint32_t deviceId, uint32_t axisId) const {
+		return deviceId < vr::k_unMaxTrackedDeviceCount && axisId < vr::k_unControllerStateAxisCount && _axes[deviceId][axisId].ramping;
+	}
+
+	/** RunFrame thread only: Calls apply(deviceId, axisId, value) for every ramping axis */
+	template<typename F>
+	void updateRamps(int64_t nowUs, F apply) {
+		if (_rampingCount == 0) {
+			return;
+		}
+		for (uint32_t deviceId = 0; deviceId < vr::k_unMaxTrackedDeviceCount; deviceId++) {
+			for (uint32_t axisId = 0; axisId < vr::k_unControllerStateAxisCount; axisId++) {
+				auto& axis = _axes[deviceId][axisId];
+				if (axis.ramping) {
+					if (nowUs >= axis.rampEndUs) {
+						axis.current = axis.target;
+						axis.ramping = false;
+						_rampingCount--;
+					}
+					else {
+						float t = (float)(nowUs - axis.rampStartUs) / (float)(axis.rampEndUs - axis.rampStartUs);
+						axis.current.x = axis.from.x + (axis.target.x - axis.from.x) * t;
+						axis.current.y = axis.from.y + (axis.target.y - axis.from.y) * t;
+					}
+					apply(deviceId, axisId, axis.current);
+				}
+			}
+		}
+	}
+
+private:
+	static const uint32_t _queueCapacity = 1024;
+
+	struct _Cell {
+		std::atomic<uint32_t> sequence;
+		Command command;
+	};
+	_Cell _queue[_queueCapacity];
+	alignas(64) std::atomic<uint32_t> _enqueuePos;
+	alignas(64) uint32_t _dequeuePos = 0;
+
+	struct _AxisState {
+		bool ramping = false;
+		vr::VRControllerAxis_t current = { 0.0f, 0.0f };
+		vr::VRControllerAxis_t from = { 0.0f, 0.0f };
+		vr::VRControllerAxis_t target = { 0.0f, 0.0f };
+		int64_t rampStartUs = 0;
+		int64_t rampEndUs = 0;
+	};
+	_AxisState _axes[vr::k_unMaxTrackedDeviceCount][vr::k_unControllerStateAxisCount];
+	uint32_t _rampingCount = 0;
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
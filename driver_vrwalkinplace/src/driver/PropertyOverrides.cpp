@@ -0,0 +1,146 @@
+#include "PropertyOverrides.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+PropertyOverrides::PropertyOverrides() {
+	memset(_index, 0, sizeof(_index));
+}
+
+
+bool PropertyOverrides::set(vr::ETrackedDeviceProperty prop, Scope scope, const std::string& value) {
+	if ((uint32_t)prop >= maxPropertyId || prop == vr::Prop_Invalid) {
+		return false;
+	}
+	Override o;
+	o.prop = prop;
+	o.scope = scope;
+	o.stringValue = value;
+
+	const char* str = value.c_str();
+	char* end;
+	if (value == "true" || value == "1") {
+		o.isBool = true;
+		o.boolValue = true;
+	}
+	else if (value == "false" || value == "0") {
+		o.isBool = true;
+		o.boolValue = false;
+	}
+	if (!value.empty()) {
+		errno = 0;
+		auto i = strtoll(str, &end, 0);
+		if (*end == '\0' && errno == 0) {
+			o.isInteger = true;
+			o.int32Value = (int32_t)i;
+			o.uint64Value = (uint64_t)i;
+		}
+		errno = 0;
+		auto f = strtof(str, &end);
+		if (*end == '\0' && errno == 0) {
+			o.isFloat = true;
+			o.floatValue = f;
+		}
+	}
+
+	if (_index[prop] != 0) {
+		_overrides[_index[prop] - 1] = o;
+	}
+	else {
+		_overrides.push_back(o);
+		_index[prop] = (uint16_t)_overrides.size();
+	}
+	return true;
+}
+
+
+uint32_t PropertyOverrides::parse(const std::string& settings) {
+	uint32_t errors = 0;
+	size_t pos = 0;
+	while (pos < settings.size()) {
+		auto next = settings.find(';', pos);
+		if (next == std::string::npos) {
+			next = settings.size();
+		}
+		auto entry = settings.substr(pos, next - pos);
+		pos = next + 1;
+		if (entry.empty()) {
+			continue;
+		}
+		auto eq = entry.find('=');
+		if (eq == std::string::npos || eq == 0) {
+			errors++;
+			continue;
+		}
+		auto key = entry.substr(0, eq);
+		auto scope = Scope::AllDevices;
+		auto at = key.find('@');
+		if (at != std::string::npos) {
+			if (key.compare(at + 1, std::string::npos, "hmd") != 0) {
+				errors++;
+				continue;
+			}
+			scope = Scope::Hmd;
+			key.resize(at);
+		}
+		char* end;
+		auto prop = strtoul(key.c_str(), &end, 10);
+		if (key.empty() || *end != '\0' || !set((vr::ETrackedDeviceProperty)prop, scope, entry.substr(eq + 1))) {
+			errors++;
+		}
+	}
+	return errors;
+}
+
+
+bool PropertyOverrides::apply(const Override& o, vr::PropertyWrite_t& entry) {
+	if (entry.writeType != vr::PropertyWrite_Set) {
+		return false;
+	}
+	switch (entry.unTag) {
+	case vr::k_unStringPropertyTag:
+		entry.pvBuffer = (void*)o.stringValue.c_str();
+		entry.unBufferSize = (uint32_t)o.stringValue.size() + 1;
+		return true;
+	case vr::k_unBoolPropertyTag:
+		if (!o.isBool) {
+			return false;
+		}
+		entry.pvBuffer = (void*)&o.boolValue;
+		entry.unBufferSize = sizeof(bool);
+		return true;
+	case vr::k_unInt32PropertyTag:
+		if (!o.isInteger) {
+			return false;
+		}
+		entry.pvBuffer = (void*)&o.int32Value;
+		entry.unBufferSize = sizeof(int32_t);
+		return true;
+	case vr::k_unUint64PropertyTag:
+		if (!o.isInteger) {
+			return false;
+		}
+		entry.pvBuffer = (void*)&o.uint64Value;
+		entry.unBufferSize = sizeof(uint64_t);
+		return true;
+	case vr::k_unFloatPropertyTag:
+		if (!o.isFloat) {
+			return false;
+		}
+		entry.pvBuffer = (void*)&o.floatValue;
+		entry.unBufferSize = sizeof(float);
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
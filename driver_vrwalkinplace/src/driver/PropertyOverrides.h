@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <openvr_driver.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Property values that are rewritten when a driver writes them (see DriverCore::propertiesWritePropertyBatch).
+*
+* Overrides are indexed by ETrackedDeviceProperty, so checking a batch entry is one array lookup. The value is stored
+* as string and converted once on configuration, it is applied to string, bool, int32, uint64 and float writes.
+* Configure on driver init only, lookups are not synchronized with changes.
+*/
+class PropertyOverrides {
+public:
+	enum class Scope : uint32_t {
+		AllDevices,
+		Hmd
+	};
+
+	struct Override {
+		vr::ETrackedDeviceProperty prop = vr::Prop_Invalid;
+		Scope scope = Scope::AllDevices;
+		std::string stringValue;
+		bool isBool = false; // value parsed as "true"/"false"/"1"/"0"
+		bool isInteger = false;
+		bool isFloat = false;
+		bool boolValue = false;
+		int32_t int32Value = 0;
+		uint64_t uint64Value = 0;
+		float floatValue = 0.0f;
+	};
+
+	// Covers all properties defined by openvr including the vendor specific range
+	static const uint32_t maxPropertyId = 11000;
+
+	PropertyOverrides();
+
+	/** Adds or replaces the override for prop. Returns false when prop is out of range. */
+	bool set(vr::ETrackedDeviceProperty prop, Scope scope, const std::string& value);
+
+	/**
+	* Adds the overrides from a settings string: "<prop id>[@hmd]=<value>" entries separated by ';'.
+	* E.g. "1005=My Manufacturer;1001@hmd=My Model". Returns the number of malformed entries.
+	*/
+	uint32_t parse(const std::string& settings);
+
+	const Override* find(vr::ETrackedDeviceProperty prop) const {
+		if ((uint32_t)prop >= maxPropertyId || _index[prop] == 0) {
+			return nullptr;
+		}
+		return &_overrides[_index[prop] - 1];
+	}
+
+	bool empty() const {
+		return _overrides.empty();
+	}
+
+	const std::vector<Override>& overrides() const {
+		return _overrides;
+	}
+
+	/** Points the batch entry at the override value. Returns false when the entry's type cannot take the value. */
+	static bool apply(const Override& o, vr::PropertyWrite_t& entry);
+
+private:
+	uint16_t _index[maxPropertyId]; // 1-based index into _overrides, 0 = no override
+	std::vector<Override> _overrides;
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
@@ -2,13 +2,13 @@
 
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <openvr_driver.h>
-#include <vrwalkinplace_types.h>
-#include <openvr_math.h>
 #include "../hooks/common.h"
 #include "../logging.h"
 #include "../com/shm/driver_ipc_shm.h"
+#include <ipc_pose_tap.h>
+#include <ipc_stats.h>
+#include "DriverCore.h"
 
 
 
@@ -28,9 +28,9 @@ class DeviceManipulationHandle;
 * Implements the IServerTrackedDeviceProvider interface.
 *
 * Its the main entry point of the driver. It's a singleton which manages all devices owned by this driver, 
-* and also handles the whole "hacking into OpenVR" stuff.
+* and also handles the whole "hacking into OpenVR" stuff. Everything that does not need the hooks lives in DriverCore.
 */
-class ServerDriver : public vr::IServerTrackedDeviceProvider {
+class ServerDriver : public vr::IServerTrackedDeviceProvider, public DriverCore {
 public:
 	ServerDriver();
 	virtual ~ServerDriver();
@@ -65,22 +65,8 @@ public:
 
 	static std::string getInstallDirectory() { return installDir; }
 
-	void openvr_buttonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
-
-	void openvr_axisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
-
-	DeviceManipulationHandle* getDeviceManipulationHandleById(uint32_t unWhichDevice);
-	DeviceManipulationHandle* getDeviceManipulationHandleByPropertyContainer(vr::PropertyContainerHandle_t container);
-
-
 	// internal API
 
-	void executeCodeForEachDeviceManipulationHandle(std::function<void(DeviceManipulationHandle*)> code) {
-		for (auto d : _deviceManipulationHandles) {
-			code(d.second.get());
-		}
-	}
-
 	/** Called by virtual devices when they are activated */
 	void _trackedDeviceActivated(uint32_t deviceId, VirtualDeviceDriver* device);
 
@@ -90,17 +76,11 @@ public:
 	//// function hooks related ////
 	void hooksTrackedDeviceAdded(void* serverDriverHost, int version, const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass& eDeviceClass, void* pDriver);
 	void hooksTrackedDeviceActivated(void* serverDriver, int version, uint32_t unObjectId);
+	bool hooksTrackedDevicePoseUpdated(void* serverDriverHost, int version, uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize);
 	bool hooksPollNextEvent(void* serverDriverHost, int version, void* pEvent, uint32_t uncbVREvent);
 	
 	void hooksPropertiesReadPropertyBatch(void* properties, int version, vr::PropertyContainerHandle_t ulContainer, void* pBatch, uint32_t unBatchEntryCount);
 	void hooksPropertiesWritePropertyBatch(void* properties, int version, vr::PropertyContainerHandle_t ulContainer, void* pBatch, uint32_t unBatchEntryCount);
-	
-	void hooksCreateBooleanComponent(void* driverInput, int version, vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t pHandle);
-	void hooksCreateScalarComponent(void* driverInput, int version, vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits);
-
-	// driver events injection
-	void addDriverEventForInjection(void* serverDriverHost, std::shared_ptr<void> event, uint32_t size);
-	std::pair<std::shared_ptr<void>, uint32_t> getDriverEventForInjection(void* serverDriverHost);
 
 
 private:
@@ -117,43 +97,14 @@ private:
 	//// ipc shm related ////
 	IpcShmCommunicator shmCommunicator;
 
-	//// device manipulation related ////
-	std::recursive_mutex _deviceManipulationHandlesMutex;
-	std::map<void*, std::shared_ptr<DeviceManipulationHandle>> _deviceManipulationHandles;
-	DeviceManipulationHandle* _openvrIdToDeviceManipulationHandleMap[vr::k_unMaxTrackedDeviceCount];
-	std::map<vr::PropertyContainerHandle_t, DeviceManipulationHandle*> _propertyContainerToDeviceManipulationHandleMap;
-	std::map<void*, DeviceManipulationHandle*> _ptrToDeviceManipulationHandleMap;
-	std::map<vr::VRInputComponentHandle_t, DeviceManipulationHandle*> _inputComponentToDeviceManipulationHandleMap;
-	std::map<uint64_t, std::map<uint64_t, vr::VRInputComponentHandle_t> > m_ulBoolComponentsMap;
-	std::map<uint64_t, std::map<uint64_t, vr::VRInputComponentHandle_t> > m_ulScalarComponentsMap;
-	typedef enum
-	{
-		k_eButton_Trackpad,
-		k_eTouch_Trackpad,
-		k_eAxis_Trackpad_X,
-		k_eAxis_Trackpad_Y,
-		k_eButton_Trigger,
-		k_eTouch_Trigger,
-		k_eButton_Grip,
-		k_eTouch_Grip,
-		k_eTouch_Joystick,
-		k_eButton_Joystick,
-		k_eAxis_Joystick_X,
-		k_eAxis_Joystick_Y,
-	} PossibleInputComponents;
-
 	//// function hooks related ////
 	std::shared_ptr<InterfaceHooks> _driverContextHooks;
 
-	// driver events injection
-	std::mutex _driverEventInjectionMutex;
-	std::map<void*, std::queue<std::pair<std::shared_ptr<void>, uint32_t>>> m_eventsToInjectQueues;
+	//// pose tap related ////
+	std::unique_ptr<ipc::PoseTapSegment> _poseTapSegment;
 
-	// Device Property Overrides
-	std::string _propertiesOverrideHmdManufacturer;
-	std::string _propertiesOverrideHmdModel;
-	std::string _propertiesOverrideHmdTrackingSystem;
-	bool _propertiesOverrideGenericTrackerFakeController;
+	//// statistics related ////
+	std::unique_ptr<ipc::StatsSegment> _statsSegment;
 };
 
 
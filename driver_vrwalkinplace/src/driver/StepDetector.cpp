@@ -0,0 +1,112 @@
+#include "StepDetector.h"
+
+#include <cstring>
+#include "../logging.h"
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+void StepDetector::configure(const ipc::Request_WalkInPlace_StepDetectionMode& mode) {
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	bool wasEnabled = _enabled;
+	stepdetector::Config config;
+	config.useTrackers = mode.useTrackers != 0;
+	config.disableHmd = mode.disableHMD != 0;
+	config.hmdType = mode.hmdType;
+	config.controlSelect = mode.controlSelect;
+	config.scaleTouchWithSwing = mode.scaleTouchWithSwing != 0;
+	config.useContDirForStraf = mode.useContDirForStraf != 0;
+	config.useContDirForRev = mode.useContDirForRev != 0;
+	memcpy(config.hmdThreshold.v, mode.hmdThreshold.v, sizeof(config.hmdThreshold.v));
+	memcpy(config.trackerThreshold.v, mode.trackerThreshold.v, sizeof(config.trackerThreshold.v));
+	config.handJogThreshold = mode.handJogThreshold;
+	config.handRunThreshold = mode.handRunThreshold;
+	config.walkTouch = mode.walkTouch;
+	config.jogTouch = mode.jogTouch;
+	config.runTouch = mode.runTouch;
+	config.stepIntSec = mode.stepIntSec;
+	config.gameStepType = mode.gameStepType;
+	_engine.configure(config);
+	_clientId = mode.clientId;
+	if (mode.enableStepDetect && !wasEnabled) {
+		_engine.reset();
+		std::lock_guard<std::mutex> lock(_posesMutex);
+		for (auto& p : _latestPoses) {
+			p.valid = false;
+		}
+		LOG(INFO) << "Driver step detection enabled";
+	}
+	else if (!mode.enableStepDetect && wasEnabled) {
+		LOG(INFO) << "Driver step detection disabled";
+	}
+	_enabled = mode.enableStepDetect != 0;
+}
+
+
+void StepDetector::clientDisconnected(uint32_t clientId) {
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	if (_enabled && _clientId == clientId) {
+		_enabled = false;
+		LOG(INFO) << "Driver step detection disabled, client " << clientId << " disconnected";
+	}
+}
+
+
+void StepDetector::updatePose(uint32_t deviceId, vr::ETrackedDeviceClass deviceClass, const ipc::PoseTapSample& sample) {
+	if (!_enabled || deviceId >= vr::k_unMaxTrackedDeviceCount) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(_posesMutex);
+	auto& p = _latestPoses[deviceId];
+	p.valid = (sample.flags & ipc::PoseTapFlag_PoseIsValid) && (sample.flags & ipc::PoseTapFlag_DeviceIsConnected);
+	p.deviceClass = (stepdetector::DeviceClass)deviceClass;
+	memcpy(p.position.v, sample.position.v, sizeof(p.position.v));
+	memcpy(p.velocity.v, sample.velocity.v, sizeof(p.velocity.v));
+	p.rotation = { sample.rotation.w, sample.rotation.x, sample.rotation.y, sample.rotation.z };
+}
+
+
+void StepDetector::getStatus(ipc::Reply_WalkInPlace_StepDetect& status) {
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	auto& last = _engine.lastDecision();
+	status.stepDetected = _engine.stepDetected();
+	status.trackerStepDetected = _engine.trackerStepDetected();
+	status.gait = (LocomotionGait)last.gait;
+	status.deviceId = last.deviceId;
+}
+
+
+StepDetector::Output StepDetector::runFrame(double now) {
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	if (!_enabled) {
+		return _output(_engine.stop());
+	}
+	{
+		std::lock_guard<std::mutex> lock(_posesMutex);
+		memcpy(_framePoses, _latestPoses, sizeof(_framePoses));
+	}
+	auto previousDeviceId = _engine.lastDecision().deviceId;
+	auto previousGait = _engine.lastDecision().gait;
+	auto decision = _engine.update(now, _framePoses, vr::k_unMaxTrackedDeviceCount);
+	if (decision.changed && previousGait != stepdetector::Gait::Stopped && previousDeviceId != decision.deviceId) {
+		LOG(INFO) << "Driver step detection moved from device " << previousDeviceId << " to device " << decision.deviceId;
+	}
+	return _output(decision);
+}
+
+
+StepDetector::Output StepDetector::_output(const stepdetector::Decision& decision) {
+	Output output;
+	output.changed = decision.changed;
+	output.deviceId = decision.deviceId;
+	output.gait = (LocomotionGait)decision.gait;
+	output.axisState = { decision.axisX, decision.axisY };
+	return output;
+}
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <openvr_driver.h>
+#include <vrwalkinplace_types.h>
+#include <ipc_protocol.h>
+#include <ipc_pose_tap.h>
+#include <stepdetector.h>
+
+
+// driver namespace
+namespace vrwalkinplace {
+namespace driver {
+
+
+/**
+* Runs the step detection engine (lib_stepdetector) in the driver.
+*
+* Poses are fed from the TrackedDevicePoseUpdated hook, detection runs in DriverCore::runFrame.
+* The result is a locomotion intent for the selected controller which the server driver maps to input updates.
+*
+* Poses are the pose tap samples, i.e. in the driver's world space (qWorldFromDriverRotation applied) instead of the
+* standing universe, both only differ by a rotation around the up axis and a translation.
+*/
+class StepDetector {
+public:
+	struct Output {
+		bool changed = false;
+		uint32_t deviceId = vr::k_unTrackedDeviceIndexInvalid;
+		LocomotionGait gait = LocomotionGait::Stopped;
+		vr::VRControllerAxis_t axisState = { 0.0f, 0.0f };
+	};
+
+	void configure(const ipc::Request_WalkInPlace_StepDetectionMode& mode);
+
+	bool isEnabled() {
+		return _enabled;
+	}
+
+	/** Stops detection when it was configured by this client */
+	void clientDisconnected(uint32_t clientId);
+
+	/** Called from the pose update hook, needs to be fast */
+	void updatePose(uint32_t deviceId, vr::ETrackedDeviceClass deviceClass, const ipc::PoseTapSample& sample);
+
+	/** Runs one detection step, now is a monotonic time in milliseconds (ipc::monotonicTimeUs() / 1000) */
+	Output runFrame(double now);
+
+	void getStatus(ipc::Reply_WalkInPlace_StepDetect& status);
+
+private:
+	static_assert(stepdetector::StepDetector::maxDevices >= vr::k_unMaxTrackedDeviceCount, "Step detector covers fewer devices than openvr");
+
+	std::mutex _posesMutex;
+	stepdetector::DeviceSample _latestPoses[vr::k_unMaxTrackedDeviceCount];
+	stepdetector::DeviceSample _framePoses[vr::k_unMaxTrackedDeviceCount];
+
+	// guards configuration and status, runFrame() and IPC requests run on different threads
+	std::mutex _stateMutex;
+	std::atomic<bool> _enabled = { false };
+	uint32_t _clientId = 0;
+	stepdetector::StepDetector _engine;
+
+	Output _output(const stepdetector::Decision& decision);
+};
+
+
+} // end namespace driver
+} // end namespace vrwalkinplace
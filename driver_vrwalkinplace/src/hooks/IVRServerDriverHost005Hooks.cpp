@@ -15,6 +15,7 @@ HookData<IVRServerDriverHost005Hooks::pollNextEvent_t> IVRServerDriverHost005Hoo
 IVRServerDriverHost005Hooks::IVRServerDriverHost005Hooks(void* iptr) {
 	if (!_isHooked) {
 		CREATE_MH_HOOK(trackedDeviceAddedHook, _trackedDeviceAdded, "IVRServerDriverHost005::TrackedDeviceAdded", iptr, 0);
+		CREATE_MH_HOOK(trackedDevicePoseUpdatedHook, _trackedDevicePoseUpdated, "IVRServerDriverHost005::TrackedDevicePoseUpdated", iptr, 1);
 		CREATE_MH_HOOK(pollNextEventHook, _pollNextEvent, "IVRServerDriverHost005::PollNextEvent", iptr, 5);
 		_isHooked = true;
 	}
@@ -24,6 +25,7 @@ IVRServerDriverHost005Hooks::IVRServerDriverHost005Hooks(void* iptr) {
 IVRServerDriverHost005Hooks::~IVRServerDriverHost005Hooks() {
 	if (_isHooked) {
 		REMOVE_MH_HOOK(trackedDeviceAddedHook);
+		REMOVE_MH_HOOK(trackedDevicePoseUpdatedHook);
 		REMOVE_MH_HOOK(pollNextEventHook);
 		_isHooked = false;
 	}
@@ -53,24 +55,23 @@ void IVRServerDriverHost005Hooks::_trackedDevicePoseUpdated(void* _this, uint32_
 	// Vive Controller: 369 calls/s each
 	//
 	// Time is key. If we assume 1 HMD and 13 controllers, we have a total of  ~6000 calls/s. That's about 166 microseconds per call at 100% load.
-	//auto poseCopy = newPose;
-	//if (serverDriver->hooksTrackedDevicePoseUpdated(_this, 5, unWhichDevice, poseCopy, unPoseStructSize)) {
-	//	trackedDevicePoseUpdatedHook.origFunc(_this, unWhichDevice, poseCopy, unPoseStructSize);
-	//}
+	// The pose is copied into the pose tap (and the step detector when enabled), that costs about 0.1 microseconds.
+	if (serverDriver->hooksTrackedDevicePoseUpdated(_this, 5, unWhichDevice, newPose, unPoseStructSize)) {
+		trackedDevicePoseUpdatedHook.origFunc(_this, unWhichDevice, newPose, unPoseStructSize);
+	}
 }
 
 bool IVRServerDriverHost005Hooks::_pollNextEvent(void* _this, void* pEvent, uint32_t uncbVREvent) {
-	auto injectedEvent = serverDriver->getDriverEventForInjection(_this);
-	if (injectedEvent.first) {
-		if (injectedEvent.second == uncbVREvent) {
-			memcpy(pEvent, injectedEvent.first.get(), uncbVREvent);
-			auto event = (vr::VREvent_t*)pEvent;
-			LOG(DEBUG) << "IVRServerDriverHost005Hooks::_pollNextEvent: Injecting event: " << event->eventType << ", " << event->trackedDeviceIndex;
+	vr::VREvent_t injectedEvent;
+	uint32_t injectedEventSize;
+	if (serverDriver->getDriverEventForInjection(_this, injectedEvent, injectedEventSize)) {
+		if (injectedEventSize == uncbVREvent) {
+			memcpy(pEvent, &injectedEvent, uncbVREvent);
+			BLOG(DEBUG, "IVRServerDriverHost005Hooks::_pollNextEvent: Injecting event: {}, {}", injectedEvent.eventType, injectedEvent.trackedDeviceIndex);
 			return true;
 		} else {
-			auto event = (vr::VREvent_t*)injectedEvent.first.get();
-			LOG(ERROR) << "IVRServerDriverHost005Hooks::_pollNextEvent: Could not inject event (" << event->eventType << ", " << event->trackedDeviceIndex 
-				<< ") because size does not match, expected " << uncbVREvent << " but got " << injectedEvent.second;
+			LOG(ERROR) << "IVRServerDriverHost005Hooks::_pollNextEvent: Could not inject event (" << injectedEvent.eventType << ", " << injectedEvent.trackedDeviceIndex 
+				<< ") because size does not match, expected " << uncbVREvent << " but got " << injectedEventSize;
 		}
 	}
 	bool retval, hretval;
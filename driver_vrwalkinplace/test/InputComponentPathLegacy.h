@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <boost/regex.hpp>
+#include <boost/algorithm/string.hpp>
+#include <openvr_driver.h>
+
+
+/*
+* The input component name parsing of DeviceManipulationHandle before InputComponentPath.h, kept as is
+* (including the "dpad_left/" key that can never match a segment) as the baseline for the equivalence test
+* and the benchmark.
+*/
+namespace vrwalkinplace {
+namespace driver {
+namespace legacy {
+
+
+inline bool _matchInputComponentName(const char* name, std::string& segment0, std::string& segment1, std::string& segment2, std::string& segment3) {
+	boost::regex rgx("^/([^/]*)(/([^/]*))?(/([^/]*))?(/([^/]*))?");
+	boost::smatch match;
+	std::string text(name);
+	if (boost::regex_search(text, match, rgx)) {
+		segment0 = match[1];
+		segment1 = match[3];
+		segment2 = match[5];
+		segment3 = match[7];
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+static std::map<std::string, vr::EVRButtonId> _inputComponentNameToButtonId = {
+	{ "system", vr::k_EButton_System },
+	{ "application_menu", vr::k_EButton_ApplicationMenu },
+	{ "grip", vr::k_EButton_Grip },
+	{ "dpad_left/", vr::k_EButton_DPad_Left },
+	{ "dpad_up", vr::k_EButton_DPad_Up },
+	{ "dpad_right", vr::k_EButton_DPad_Right },
+	{ "dpad_down", vr::k_EButton_DPad_Down },
+	{ "a", vr::k_EButton_A },
+	{ "x", vr::k_EButton_A },
+	{ "b", vr::k_EButton_ApplicationMenu },
+	{ "y", vr::k_EButton_ApplicationMenu },
+	{ "trackpad", vr::k_EButton_SteamVR_Touchpad },
+	{ "joystick", vr::k_EButton_Axis2 },
+	{ "trigger", vr::k_EButton_SteamVR_Trigger },
+};
+
+static std::map<std::string, uint32_t> _inputComponentNameToAxisId = {
+	{ "trackpad", 0 },
+	{ "trigger", 1 },
+	{ "joystick", 2 },
+};
+
+// The button lookup of the former inputAddBooleanComponent (segment 1 of an "/input/..." path)
+inline bool inputComponentNameToButtonId(std::string name, vr::EVRButtonId& buttonId) {
+	boost::algorithm::to_lower(name);
+	auto it = _inputComponentNameToButtonId.find(name);
+	if (it == _inputComponentNameToButtonId.end()) {
+		return false;
+	}
+	buttonId = it->second;
+	return true;
+}
+
+// The axis lookup of the former inputAddScalarComponent
+inline bool inputComponentNameToAxisId(std::string name, uint32_t& axisId) {
+	boost::algorithm::to_lower(name);
+	auto it = _inputComponentNameToAxisId.find(name);
+	if (it == _inputComponentNameToAxisId.end()) {
+		return false;
+	}
+	axisId = it->second;
+	return true;
+}
+
+
+} // end namespace legacy
+} // end namespace driver
+} // end namespace vrwalkinplace
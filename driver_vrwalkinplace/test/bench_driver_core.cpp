@@ -0,0 +1,36 @@
+#include "../src/driver/DriverCoreBench.h"
+#include "../src/logging.h"
+#include <iostream>
+
+
+/*
+* Runs benchmarkDriverCore (see DriverCoreBench.h) outside of vrserver.
+*
+* Usage: bench_driver_core [baselinePath]
+* Returns 1 when there are regressions against the baseline, a missing baseline file is written.
+*/
+
+
+INITIALIZE_EASYLOGGINGPP
+
+
+int main(int argc, char* argv[]) {
+	// the core logs every device and component it sees
+	el::Configurations conf;
+	conf.setToDefault();
+	conf.set(el::Level::Global, el::ConfigurationType::Enabled, "false");
+	el::Loggers::reconfigureAllLoggers(conf);
+
+	std::string baselinePath;
+	if (argc > 1) {
+		baselinePath = argv[1];
+	}
+	try {
+		auto regressions = vrwalkinplace::driver::benchmarkDriverCore(std::cout, baselinePath);
+		return regressions ? 1 : 0;
+	}
+	catch (std::exception& e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,82 @@
+#include "../src/devicemanipulation/InputComponentPath.h"
+#include "InputComponentPathLegacy.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+
+/*
+* Time per input component name of the former boost::regex + std::map parsing (InputComponentPathLegacy.h)
+* against splitInputComponentPath and the constexpr name tables, over the components of a typical controller.
+*
+* Usage: bench_input_component_path [iterations]
+*/
+
+
+using namespace vrwalkinplace::driver;
+
+
+static const char* const componentNames[] = {
+	"/input/system/click", "/input/application_menu/click", "/input/grip/click", "/input/grip/touch",
+	"/input/trackpad/click", "/input/trackpad/touch", "/input/trackpad/x", "/input/trackpad/y",
+	"/input/trigger/click", "/input/trigger/value", "/input/joystick/click", "/input/joystick/x", "/input/joystick/y",
+	"/input/a/click", "/input/a/touch", "/input/b/click", "/input/b/touch", "/proximity", "/input/thumbrest/touch"
+};
+static const uint32_t componentCount = sizeof(componentNames) / sizeof(componentNames[0]);
+
+
+static int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Both variants do what inputAddBooleanComponent/inputAddScalarComponent do with a name: split it and look up segment 1
+static uint32_t parseLegacy(const char* name) {
+	std::string sg0, sg1, sg2, sg3;
+	if (!legacy::_matchInputComponentName(name, sg0, sg1, sg2, sg3) || !boost::iequals(sg0, "input")) {
+		return 0;
+	}
+	vr::EVRButtonId buttonId;
+	uint32_t axisId;
+	return (legacy::inputComponentNameToButtonId(sg1, buttonId) ? 1 : 0) + (legacy::inputComponentNameToAxisId(sg1, axisId) ? 1 : 0);
+}
+
+static uint32_t parseNew(const char* name) {
+	InputComponentPath path;
+	if (!splitInputComponentPath(name, path) || !inputComponentNameEquals(path.segments[0], "input")) {
+		return 0;
+	}
+	vr::EVRButtonId buttonId;
+	uint32_t axisId;
+	return (inputComponentNameToButtonId(path.segments[1], buttonId) ? 1 : 0) + (inputComponentNameToAxisId(path.segments[1], axisId) ? 1 : 0);
+}
+
+template<typename F>
+static double nsPerName(uint32_t iterations, F parse, uint64_t& matches) {
+	matches = 0;
+	auto start = nowNs();
+	for (uint32_t i = 0; i < iterations; i++) {
+		for (auto name : componentNames) {
+			matches += parse(name);
+		}
+	}
+	return (double)(nowNs() - start) / ((double)iterations * componentCount);
+}
+
+
+int main(int argc, char* argv[]) {
+	uint32_t iterations = 20000;
+	if (argc > 1) {
+		iterations = (uint32_t)std::stoul(argv[1]);
+	}
+	uint64_t legacyMatches, newMatches;
+	auto legacyNs = nsPerName(iterations, parseLegacy, legacyMatches);
+	auto newNs = nsPerName(iterations, parseNew, newMatches);
+	std::cout << iterations << " x " << componentCount << " component names" << std::endl << std::fixed << std::setprecision(1)
+		<< "regex + std::map:        " << std::setw(9) << legacyNs << " ns/name" << std::endl
+		<< "split + constexpr table: " << std::setw(9) << newNs << " ns/name   (" << legacyNs / newNs << "x faster)" << std::endl;
+	if (legacyMatches != newMatches) {
+		std::cerr << "Different number of matched names: " << legacyMatches << " vs " << newMatches << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include "../src/driver/DeviceTable.h"
+#include <thread>
+#include <vector>
+#include <iostream>
+
+
+/*
+* Snapshot reclamation of the DeviceTable.
+*
+* A held ReadGuard keeps its snapshot alive over any number of updates and reclaim() calls, and everything
+* retired is freed two reclaim() calls after the last guard is gone. Then a writer thread (hooks) publishes
+* snapshots while reader threads (pose hook, ipc threads) look them up and a frame thread reclaims. Every
+* snapshot a reader sees must be intact: byOpenvrId and deviceIdByPropertyContainer are derived from the version.
+*/
+
+
+using namespace vrwalkinplace::driver;
+
+
+#define TEST_UPDATE_COUNT 20000u
+#define TEST_DEVICE_COUNT 4u
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+static DeviceManipulationHandle* fakeHandle(uint64_t version, uint32_t deviceId) {
+	return reinterpret_cast<DeviceManipulationHandle*>((uintptr_t)((version << 8) | (deviceId + 1)));
+}
+
+static void fillSnapshot(DeviceTable::Snapshot& table) {
+	for (uint32_t id = 0; id < TEST_DEVICE_COUNT; id++) {
+		table.byOpenvrId[id] = fakeHandle(table.version, id);
+	}
+	table.deviceIdByPropertyContainer[table.version % TEST_DEVICE_COUNT] = (uint32_t)table.version;
+}
+
+static bool checkSnapshot(const DeviceTable::Snapshot& table) {
+	for (uint32_t id = 0; id < TEST_DEVICE_COUNT; id++) {
+		if (table.byOpenvrId[id] != fakeHandle(table.version, id)) {
+			return false;
+		}
+	}
+	auto it = table.deviceIdByPropertyContainer.find(table.version % TEST_DEVICE_COUNT);
+	return it != table.deviceIdByPropertyContainer.end() && it->second == table.version;
+}
+
+
+static void testHeldGuard() {
+	DeviceTable deviceTable;
+	deviceTable.update(fillSnapshot);
+	{
+		auto devices = deviceTable.read();
+		CHECK(devices->version == 1, "first update is version " << devices->version);
+		for (unsigned i = 0; i < 5; i++) {
+			deviceTable.update(fillSnapshot);
+			deviceTable.reclaim();
+		}
+		CHECK(checkSnapshot(*devices), "held snapshot changed");
+		CHECK(deviceTable.read()->version == 6, "update while a guard is held");
+		CHECK(deviceTable.retiredCount() > 0, "snapshot of a held guard was freed");
+	}
+	deviceTable.reclaim();
+	deviceTable.reclaim();
+	CHECK(deviceTable.retiredCount() == 0, deviceTable.retiredCount() << " snapshots left after the guard was released");
+	CHECK(checkSnapshot(*deviceTable.read()), "current snapshot after reclaim");
+}
+
+
+static void testConcurrent() {
+	DeviceTable deviceTable;
+	deviceTable.update(fillSnapshot);
+	std::atomic<bool> done = { false };
+	std::atomic<uint64_t> broken = { 0 };
+	std::atomic<uint64_t> reads = { 0 };
+	size_t freed = 0, maxRetired = 0;
+
+	std::vector<std::thread> readers;
+	for (unsigned i = 0; i < 3; i++) {
+		readers.emplace_back([&]() {
+			uint64_t lastVersion = 0;
+			while (!done.load(std::memory_order_acquire)) {
+				auto devices = deviceTable.read();
+				if (!checkSnapshot(*devices) || devices->version < lastVersion) {
+					broken++;
+				}
+				lastVersion = devices->version;
+				reads++;
+				std::this_thread::yield();
+			}
+		});
+	}
+	std::thread frame([&]() {
+		while (!done.load(std::memory_order_acquire)) {
+			freed += deviceTable.reclaim();
+			auto retired = deviceTable.retiredCount();
+			maxRetired = retired > maxRetired ? retired : maxRetired;
+			std::this_thread::yield();
+		}
+	});
+
+	for (uint32_t i = 1; i < TEST_UPDATE_COUNT; i++) {
+		deviceTable.update(fillSnapshot);
+		if ((i & 0x3F) == 0) {
+			std::this_thread::yield();
+		}
+	}
+	done.store(true, std::memory_order_release);
+	for (auto& t : readers) {
+		t.join();
+	}
+	frame.join();
+	freed += deviceTable.reclaim();
+	freed += deviceTable.reclaim();
+
+	std::cout << TEST_UPDATE_COUNT << " updates, " << reads.load() << " reads, " << freed << " snapshots freed, at most "
+		<< maxRetired << " retired at once" << std::endl;
+	CHECK(broken == 0, broken.load() << " reads saw a broken or older snapshot");
+	CHECK(reads > 0, "readers did not read anything");
+	CHECK(freed == TEST_UPDATE_COUNT, "freed " << freed << " of " << TEST_UPDATE_COUNT << " replaced snapshots");
+	CHECK(deviceTable.retiredCount() == 0, deviceTable.retiredCount() << " snapshots left after the readers stopped");
+	CHECK(deviceTable.read()->version == TEST_UPDATE_COUNT && checkSnapshot(*deviceTable.read()), "last snapshot");
+}
+
+
+int main() {
+	testHeldGuard();
+	testConcurrent();
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "../src/devicemanipulation/InputComponentPath.h"
+#include "InputComponentPathLegacy.h"
+#include <iostream>
+
+
+/*
+* Checks that splitInputComponentPath and the constexpr name tables give the same results as the former
+* boost::regex + std::map lookup (InputComponentPathLegacy.h) for every name of the old tables, in any case,
+* and for the component paths of the usual controllers. The only intended difference is "dpad_left", whose
+* old table key "dpad_left/" could never match.
+*/
+
+
+using namespace vrwalkinplace::driver;
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+static std::string segmentString(const InputComponentPathSegment& segment) {
+	return std::string(segment.str, segment.length);
+}
+
+static InputComponentPathSegment makeSegment(const std::string& name) {
+	InputComponentPathSegment segment;
+	segment.str = name.c_str();
+	segment.length = (uint32_t)name.size();
+	return segment;
+}
+
+static std::string toUpper(std::string name) {
+	for (auto& c : name) {
+		c = (char)toupper((unsigned char)c);
+	}
+	return name;
+}
+
+static std::string mixedCase(std::string name) {
+	for (size_t i = 0; i < name.size(); i += 2) {
+		name[i] = (char)toupper((unsigned char)name[i]);
+	}
+	return name;
+}
+
+
+static void checkSplit(const char* name) {
+	std::string sg[4];
+	bool oldMatch = legacy::_matchInputComponentName(name, sg[0], sg[1], sg[2], sg[3]);
+	InputComponentPath path;
+	bool newMatch = splitInputComponentPath(name, path);
+	CHECK(oldMatch == newMatch, "\"" << name << "\" parsed by one splitter only");
+	if (oldMatch && newMatch) {
+		for (uint32_t i = 0; i < InputComponentPath::maxSegments; ++i) {
+			CHECK(sg[i] == segmentString(path.segments[i]), "\"" << name << "\" segment " << i << " is \""
+				<< segmentString(path.segments[i]) << "\" instead of \"" << sg[i] << "\"");
+		}
+	}
+}
+
+static void checkButtonName(const std::string& name) {
+	vr::EVRButtonId oldId = vr::k_EButton_Max, newId = vr::k_EButton_Max;
+	bool oldFound = legacy::inputComponentNameToButtonId(name, oldId);
+	bool newFound = inputComponentNameToButtonId(makeSegment(name), newId);
+	CHECK(oldFound == newFound, "button name \"" << name << "\" found by one table only");
+	if (oldFound && newFound) {
+		CHECK(oldId == newId, "button name \"" << name << "\" maps to " << (int)newId << " instead of " << (int)oldId);
+	}
+}
+
+static void checkAxisName(const std::string& name) {
+	uint32_t oldId = 0xFFFFFFFF, newId = 0xFFFFFFFF;
+	bool oldFound = legacy::inputComponentNameToAxisId(name, oldId);
+	bool newFound = inputComponentNameToAxisId(makeSegment(name), newId);
+	CHECK(oldFound == newFound, "axis name \"" << name << "\" found by one table only");
+	if (oldFound && newFound) {
+		CHECK(oldId == newId, "axis name \"" << name << "\" maps to " << newId << " instead of " << oldId);
+	}
+}
+
+
+int main() {
+	// Every name of the old tables, as a bare segment and inside a path
+	for (auto& e : legacy::_inputComponentNameToButtonId) {
+		if (e.first == "dpad_left/") {
+			continue;
+		}
+		for (auto& name : { e.first, toUpper(e.first), mixedCase(e.first) }) {
+			checkButtonName(name);
+			checkSplit(("/input/" + name + "/click").c_str());
+			checkSplit(("/input/" + name + "/touch").c_str());
+		}
+	}
+	for (auto& e : legacy::_inputComponentNameToAxisId) {
+		for (auto& name : { e.first, toUpper(e.first), mixedCase(e.first) }) {
+			checkAxisName(name);
+			checkSplit(("/input/" + name + "/x").c_str());
+			checkSplit(("/input/" + name + "/y").c_str());
+			checkSplit(("/input/" + name + "/value").c_str());
+		}
+	}
+
+	// Unknown names fail in both
+	for (const char* name : { "", "touchpad", "grip2", "gri", "dpad", "thumbstick", "trackpad ", "z" }) {
+		checkButtonName(name);
+		checkAxisName(name);
+	}
+
+	// Paths that are not a plain /input/<name>/<kind>
+	for (const char* name : { "/", "//", "///", "/proximity", "/input", "/input/", "/input//click", "/input/trackpad/x/extra",
+			"/a/b/c/d/e/f", "/output/haptic", "/input/dpad_left/click", "input/trigger/click", "", "/input/trigger/click/" }) {
+		checkSplit(name);
+	}
+
+	// The fixed typo: the old table never matched dpad_left, the new one does
+	vr::EVRButtonId buttonId;
+	CHECK(!legacy::inputComponentNameToButtonId("dpad_left", buttonId), "old table matches dpad_left");
+	CHECK(inputComponentNameToButtonId(makeSegment("dpad_left"), buttonId) && buttonId == vr::k_EButton_DPad_Left, "dpad_left is not mapped to k_EButton_DPad_Left");
+	CHECK(!inputComponentNameToButtonId(makeSegment("dpad_left/"), buttonId), "dpad_left/ is mapped");
+
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,249 @@
+#include "../src/driver/DriverCore.h"
+#include "../src/driver/MockDriverHost.h"
+#include "../src/com/shm/driver_ipc_shm.h"
+#include <ipc_protocol.h>
+#include <ipc_frame.h>
+#include <ipc_shm_ring.h>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+
+/*
+* Client leases of the IpcShmCommunicator, with a short lease timeout.
+*
+* A client that only streams movement requests (never a ping) must keep its lease, on the message queue as well as on
+* its shm ring, a silent client must lose it. Whether a client still has its lease is checked with a ping that expects
+* a reply. Requests on the ring are counted in the lane of their type.
+* A client of protocol version 1, whose reply queue only holds 40 byte messages, is told InvalidVersion.
+* Uses the driver's server queue and doorbell, so it refuses to run while the driver is loaded in vrserver.
+*/
+
+
+INITIALIZE_EASYLOGGINGPP
+
+
+using namespace vrwalkinplace;
+using namespace vrwalkinplace::driver;
+
+
+#define TEST_LEASE_MS 300
+#define TEST_STREAM_MS 1500
+#define TEST_REPLY_TIMEOUT_MS 1000
+
+
+static const char* serverQueueName = "driver_vrwalkinplace.server_queue";
+
+static unsigned failures = 0;
+
+#undef CHECK // easylogging++ has its own
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+static boost::posix_time::ptime deadline(uint32_t ms) {
+	return boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(ms);
+}
+
+
+// The client side of a connection, like VRWalkInPlace but without its threads
+struct TestClient {
+	std::string queueName;
+	std::unique_ptr<boost::interprocess::message_queue> replyQueue;
+	ipc::TransportType transport;
+	std::unique_ptr<ipc::ClientChannelSegment> channel;
+	std::unique_ptr<boost::interprocess::named_semaphore> doorbell;
+	uint32_t clientId = 0;
+
+	TestClient(const std::string& name, ipc::TransportType transport) : queueName("driver_vrwalkinplace.test_ipc_lease." + name + "." + std::to_string(getpid())), transport(transport) {
+		boost::interprocess::message_queue::remove(queueName.c_str());
+		replyQueue.reset(new boost::interprocess::message_queue(boost::interprocess::create_only, queueName.c_str(), 100, sizeof(ipc::Reply)));
+		if (transport == ipc::TransportType::ShmRing) {
+			doorbell.reset(new boost::interprocess::named_semaphore(boost::interprocess::open_only, ipc::shmRingDoorbellName));
+			channel.reset(new ipc::ClientChannelSegment(boost::interprocess::create_only, queueName + ipc::shmChannelNameSuffix));
+		}
+	}
+
+	~TestClient() {
+		channel.reset();
+		replyQueue.reset();
+		boost::interprocess::message_queue::remove(queueName.c_str());
+	}
+
+	bool waitForReply(uint32_t messageId, ipc::Reply& reply, uint32_t timeoutMs) {
+		boost::interprocess::message_queue::size_type size;
+		unsigned priority;
+		auto until = deadline(timeoutMs);
+		while (replyQueue->timed_receive(&reply, sizeof(reply), size, priority, until)) {
+			if (size == sizeof(ipc::ConnectReply)) {
+				ipc::ConnectReply connectReply;
+				memcpy(&connectReply, static_cast<const void*>(&reply), sizeof(connectReply));
+				reply = connectReply.reply();
+			}
+			if (reply.messageId == messageId) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool connect(boost::interprocess::message_queue& server) {
+		ipc::ConnectRequest message;
+		message.messageId = 1;
+		message.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+		strncpy(message.queueName, queueName.c_str(), sizeof(message.queueName) - 1);
+		message.transportType = transport;
+		server.send(&message, sizeof(message), (unsigned)ipc::RequestLane::Control);
+		ipc::Reply reply;
+		if (!waitForReply(1, reply, TEST_REPLY_TIMEOUT_MS) || reply.status != ipc::ReplyStatus::Ok
+				|| reply.msg.ipc_ClientConnect.transportType != transport) {
+			return false;
+		}
+		clientId = reply.msg.ipc_ClientConnect.clientId;
+		return true;
+	}
+
+	// On the message queue, or on the shm ring for ring clients
+	void sendFrame(boost::interprocess::message_queue& server, const ipc::Request& message, bool ring = false) {
+		ipc::FramePacket packet;
+		packet.clear(clientId);
+		packet.append(message);
+		if (!ring) {
+			server.send(&packet, packet.byteSize(), (unsigned)ipc::requestLane(message.type));
+			return;
+		}
+		auto& events = channel->get().events;
+		auto slot = events.tryReserve();
+		if (slot) {
+			memcpy(slot, &packet, packet.byteSize());
+			events.publish();
+		}
+		if (events.consumerNeedsWakeup()) {
+			doorbell->post();
+		}
+	}
+
+	void sendAxisEvent(boost::interprocess::message_queue& server, float x) {
+		ipc::Request message(ipc::RequestType::OpenVR_AxisEvent);
+		message.msg.ipc_AxisEvent.deviceId = 1;
+		message.msg.ipc_AxisEvent.axisId = 0;
+		message.msg.ipc_AxisEvent.axisState = { x, 0.0f };
+		sendFrame(server, message, transport == ipc::TransportType::ShmRing);
+	}
+
+	// True when the driver still knows our client id
+	bool ping(boost::interprocess::message_queue& server, uint32_t messageId) {
+		ipc::Request message(ipc::RequestType::IPC_Ping);
+		message.msg.ipc_Ping.clientId = clientId;
+		message.msg.ipc_Ping.messageId = messageId;
+		message.msg.ipc_Ping.nonce = messageId;
+		sendFrame(server, message);
+		ipc::Reply reply;
+		return waitForReply(messageId, reply, TEST_REPLY_TIMEOUT_MS) && reply.status == ipc::ReplyStatus::Ok;
+	}
+};
+
+
+int main() {
+	el::Configurations conf;
+	conf.setToDefault();
+	conf.set(el::Level::Global, el::ConfigurationType::Enabled, "false");
+	el::Loggers::reconfigureAllLoggers(conf);
+
+	try {
+		boost::interprocess::message_queue existing(boost::interprocess::open_only, serverQueueName);
+		std::cerr << serverQueueName << " exists, is SteamVR running?" << std::endl;
+		return 1;
+	}
+	catch (boost::interprocess::interprocess_exception&) {
+	}
+
+	auto host = std::make_shared<MockDriverHost>();
+	DriverCore core(host);
+	IpcShmCommunicator communicator;
+	communicator.setClientLeaseTimeout(TEST_LEASE_MS * 1000ll);
+	communicator.init(&core);
+	try {
+		std::unique_ptr<boost::interprocess::message_queue> server;
+		for (uint32_t n = 0; !server; ++n) {
+			try {
+				server.reset(new boost::interprocess::message_queue(boost::interprocess::open_only, serverQueueName));
+			}
+			catch (boost::interprocess::interprocess_exception&) {
+				if (n >= 1000) {
+					throw;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		TestClient streaming("streaming", ipc::TransportType::MessageQueue), ring("ring", ipc::TransportType::ShmRing);
+		TestClient silent("silent", ipc::TransportType::MessageQueue);
+		CHECK(streaming.connect(*server), "streaming client could not connect");
+		CHECK(ring.connect(*server), "ring client could not connect");
+		CHECK(silent.connect(*server), "silent client could not connect");
+
+		// Movement lane only, several lease timeouts long
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; std::chrono::steady_clock::now() - start < std::chrono::milliseconds(TEST_STREAM_MS); i++) {
+			streaming.sendAxisEvent(*server, (float)(i % 100) / 100.0f);
+			ring.sendAxisEvent(*server, (float)(i % 100) / 100.0f);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		// A control request that arrives on the ring is not counted as movement
+		auto& controlLane = core.stats().laneLatency[(uint32_t)ipc::RequestLane::Control];
+		auto controlCount = controlLane.count.load();
+		ipc::Request ping(ipc::RequestType::IPC_Ping);
+		ping.msg.ipc_Ping.clientId = ring.clientId;
+		ping.msg.ipc_Ping.messageId = 0;
+		ring.sendFrame(*server, ping, true);
+		for (uint32_t n = 0; controlLane.count.load() == controlCount && n < TEST_REPLY_TIMEOUT_MS; ++n) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		CHECK(controlLane.count.load() == controlCount + 1, "ring request counted in the wrong lane");
+
+		CHECK(streaming.ping(*server, 2), "client streaming movement requests lost its lease");
+		CHECK(ring.ping(*server, 2), "client streaming on its shm ring lost its lease");
+		CHECK(!silent.ping(*server, 2), "silent client kept its lease");
+
+		// A version 1 client: its connect is a plain Request of 152 bytes, its queue holds Replies of 40 bytes
+		std::string oldQueueName = "driver_vrwalkinplace.test_ipc_lease.v1." + std::to_string(getpid());
+		boost::interprocess::message_queue::remove(oldQueueName.c_str());
+		{
+			boost::interprocess::message_queue oldQueue(boost::interprocess::create_only, oldQueueName.c_str(), 10, 40);
+			ipc::ConnectRequest oldConnect;
+			oldConnect.messageId = 7;
+			oldConnect.ipcProcotolVersion = 1;
+			strncpy(oldConnect.queueName, oldQueueName.c_str(), sizeof(oldConnect.queueName) - 1);
+			server->send(&oldConnect, 152, (unsigned)ipc::RequestLane::Control);
+			ipc::ConnectReply oldReply;
+			boost::interprocess::message_queue::size_type size = 0;
+			unsigned priority;
+			auto received = oldQueue.timed_receive(&oldReply, 40, size, priority, deadline(TEST_REPLY_TIMEOUT_MS));
+			CHECK(received && size == 40, "version 1 client got no reply");
+			CHECK(!received || (oldReply.messageId == 7 && oldReply.status == ipc::ReplyStatus::InvalidVersion
+				&& oldReply.ipcProcotolVersion == IPC_PROTOCOL_VERSION), "version 1 client was not told InvalidVersion");
+		}
+		boost::interprocess::message_queue::remove(oldQueueName.c_str());
+	}
+	catch (std::exception& e) {
+		std::cerr << "FAILED: exception " << e.what() << std::endl;
+		failures++;
+	}
+	communicator.shutdown();
+
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
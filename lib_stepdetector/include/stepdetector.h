@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+
+
+namespace vrwalkinplace {
+namespace stepdetector {
+
+
+/*
+* Step detection engine of the walk in place locomotion (originally WalkInPlaceTabController::applyStepPoseDetect).
+*
+* Plain C++ without Qt, OpenVR or platform dependencies: it gets timestamped device poses and returns a locomotion
+* decision, everything else (where poses come from, what a decision is mapped to) is up to the caller. The driver
+* runs it in RunFrame, tools can feed recorded poses faster than real time.
+*/
+
+
+struct Vector3 {
+	double v[3];
+};
+
+struct Quaternion {
+	double w, x, y, z;
+};
+
+
+// Same values as vr::ETrackedDeviceClass
+enum class DeviceClass : uint32_t {
+	Invalid = 0,
+	Hmd = 1,
+	Controller = 2,
+	Tracker = 3
+};
+
+
+// Same values as LocomotionGait
+enum class Gait : uint32_t {
+	Stopped = 0,
+	Walk = 1,
+	Jog = 2,
+	Run = 3
+};
+
+
+// Pose of one device in a standing space with +y up (e.g. the driver's world space)
+struct DeviceSample {
+	bool valid = false; // pose is valid and device is connected
+	DeviceClass deviceClass = DeviceClass::Invalid;
+	Vector3 position = { { 0, 0, 0 } }; // meters
+	Vector3 velocity = { { 0, 0, 0 } }; // meters per second
+	Quaternion rotation = { 1, 0, 0, 0 };
+};
+
+
+// Thresholds and options, see Request_WalkInPlace_StepDetectionMode
+struct Config {
+	bool useTrackers = false;
+	bool disableHmd = false;
+	uint32_t hmdType = 0; // 0 .. use reported hmd velocity, else differentiate positions
+	uint32_t controlSelect = 0; // 0 .. first controller, 1 .. second controller
+	bool scaleTouchWithSwing = false;
+	bool useContDirForStraf = false;
+	bool useContDirForRev = false;
+	Vector3 hmdThreshold = { { 0.27, 0.12, 0.27 } };
+	Vector3 trackerThreshold = { { 0.27, 0.10, 0.27 } };
+	float handJogThreshold = 1.0f;
+	float handRunThreshold = 2.0f;
+	float walkTouch = 0.35f;
+	float jogTouch = 1.0f;
+	float runTouch = 1.0f;
+	float stepIntSec = 0.5f; // seconds a detected step keeps the player moving
+	int gameStepType = 1; // the engine only produces axis values for the touchpad/thumbstick types 0 .. 5
+};
+
+
+struct Decision {
+	static const uint32_t invalidDeviceId = 0xffffffff;
+
+	bool changed = false; // differs from the previous decision, nothing to do otherwise
+	uint32_t deviceId = invalidDeviceId; // controller that gets the axis values
+	Gait gait = Gait::Stopped;
+	float axisX = 0.0f;
+	float axisY = 0.0f;
+};
+
+
+class StepDetector {
+public:
+	static const uint32_t maxDevices = 64;
+
+	/** Takes effect with the next update(), the detection state is kept. */
+	void configure(const Config& config);
+
+	/** Forgets detected steps, controllers and timing, e.g. when detection is switched on again. */
+	void reset();
+
+	/**
+	* Runs one detection step. devices[i] is the latest pose of device i, nowMs a monotonic time in milliseconds.
+	* Calls closer than 1/90 s to the last step return an unchanged decision.
+	*/
+	Decision update(double nowMs, const DeviceSample* devices, uint32_t deviceCount);
+
+	/** Returns a Stopped decision for the last device unless the player already stopped. */
+	Decision stop();
+
+	bool stepDetected() const {
+		return _stepPoseDetected;
+	}
+
+	bool trackerStepDetected() const {
+		return _trackerStepDetected;
+	}
+
+	const Decision& lastDecision() const {
+		return _lastDecision;
+	}
+
+	/** The controller selected by Config::controlSelect, Decision::invalidDeviceId until one was seen. */
+	uint32_t controllerDeviceId() const;
+
+	/** HMD velocity of the last update, differentiated from positions when Config::hmdType is set. */
+	const Vector3& hmdVelocity() const {
+		return _hmdVel;
+	}
+
+private:
+	Config _config;
+	double _stepIntegrateStepLimit = 500.0;
+
+	bool _stepPoseDetected = false;
+	bool _trackerStepDetected = false;
+	bool _jogPoseDetected = false;
+	bool _runPoseDetected = false;
+	int _peaksCount = 0;
+	int _hasUnTouchedStepAxis = 50;
+	int _controllerDeviceIds[2] = { -1, -1 };
+	float _hmdYaw = 0;
+	float _hmdLastYVel = 0;
+	double _stepIntegrateSteps = 0.0;
+	double _jogIntegrateSteps = 0.0;
+	double _runIntegrateSteps = 0.0;
+	double _timeLastTick = 0.0;
+	double _velStepTime = 0.0;
+	double _timeLastStepPeak = 0.0;
+	double _timeLastTrackerStep = 0.0;
+	Vector3 _lastHmdPos = { { 0, 0, 0 } };
+	Vector3 _hmdVel = { { 0, 0, 0 } };
+	Vector3 _hmdForward = { { 0, 0, -1 } };
+	std::deque<float> _contVelSamples;
+	float _totalContYVel = 0.0;
+	float _avgContYVel = 0.0;
+	double _contVelSampleTime = 0.0;
+	Decision _lastDecision;
+
+	Vector3 _hmdVelocity(const DeviceSample& pose, double now);
+	void _controllerDirection(const DeviceSample& pose, float& touchX, float& touchY);
+	Decision _decide(uint32_t deviceId, Gait gait, float axisX, float axisY);
+
+	static bool _upAndDownStepCheck(const Vector3& vel, const Vector3& threshold);
+	static bool _handStepCheck(const Vector3& vel, float threshold);
+	static float _getScaledTouch(float minTouch, float maxTouch, float avgVel, float maxVel);
+};
+
+
+} // end namespace stepdetector
+} // end namespace vrwalkinplace
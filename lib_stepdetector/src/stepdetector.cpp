@@ -0,0 +1,433 @@
+#include "stepdetector.h"
+
+#include <cmath>
+
+
+namespace vrwalkinplace {
+namespace stepdetector {
+
+
+static const double radToDeg = 180.0 / 3.14159265358979323846;
+static const double stepFrequencyMin = 250.0;
+static const double tickTimeMs = 1000.0 / 90.0;
+
+
+static Quaternion multiply(const Quaternion& lhs, const Quaternion& rhs) {
+	return {
+		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+	};
+}
+
+
+static Vector3 rotate(const Quaternion& quat, const Vector3& vector) {
+	Quaternion pin = { 0.0, vector.v[0], vector.v[1], vector.v[2] };
+	Quaternion conjugate = { quat.w, -quat.x, -quat.y, -quat.z };
+	auto pout = multiply(multiply(quat, pin), conjugate);
+	return { { pout.x, pout.y, pout.z } };
+}
+
+
+void StepDetector::configure(const Config& config) {
+	_config = config;
+	_stepIntegrateStepLimit = config.stepIntSec * 1000.0;
+}
+
+
+void StepDetector::reset() {
+	_stepPoseDetected = false;
+	_trackerStepDetected = false;
+	_jogPoseDetected = false;
+	_runPoseDetected = false;
+	_peaksCount = 0;
+	_hasUnTouchedStepAxis = 50;
+	_controllerDeviceIds[0] = -1;
+	_controllerDeviceIds[1] = -1;
+	_hmdYaw = 0;
+	_hmdLastYVel = 0;
+	_stepIntegrateSteps = 0.0;
+	_jogIntegrateSteps = 0.0;
+	_runIntegrateSteps = 0.0;
+	_timeLastTick = 0.0;
+	_velStepTime = 0.0;
+	_timeLastStepPeak = 0.0;
+	_timeLastTrackerStep = 0.0;
+	_lastHmdPos = { { 0, 0, 0 } };
+	_hmdVel = { { 0, 0, 0 } };
+	_hmdForward = { { 0, 0, -1 } };
+	_contVelSamples.clear();
+	_totalContYVel = 0.0;
+	_avgContYVel = 0.0;
+	_contVelSampleTime = 0.0;
+}
+
+
+uint32_t StepDetector::controllerDeviceId() const {
+	int deviceId = _controllerDeviceIds[_config.controlSelect != 0 ? 1 : 0];
+	if (deviceId < 0) {
+		deviceId = _controllerDeviceIds[0];
+	}
+	return deviceId < 0 ? Decision::invalidDeviceId : (uint32_t)deviceId;
+}
+
+
+Decision StepDetector::stop() {
+	if (_lastDecision.gait != Gait::Stopped) {
+		return _decide(_lastDecision.deviceId, Gait::Stopped, 0.0f, 0.0f);
+	}
+	return Decision();
+}
+
+
+Decision StepDetector::update(double now, const DeviceSample* devices, uint32_t deviceCount) {
+	double tdiff = now - _timeLastTick;
+	if (tdiff < tickTimeMs) {
+		return Decision();
+	}
+	_timeLastTick = now;
+	if (deviceCount > maxDevices) {
+		deviceCount = maxDevices;
+	}
+	for (uint32_t i = 0; i < deviceCount; ++i) {
+		if (devices[i].valid && devices[i].deviceClass == DeviceClass::Controller
+				&& _controllerDeviceIds[0] != (int)i && _controllerDeviceIds[1] != (int)i) {
+			if (_controllerDeviceIds[0] < 0) {
+				_controllerDeviceIds[0] = i;
+			}
+			else if (_controllerDeviceIds[1] < 0) {
+				_controllerDeviceIds[1] = i;
+			}
+		}
+	}
+	uint32_t controllerId = controllerDeviceId();
+	int deviceId = controllerId == Decision::invalidDeviceId ? -1 : (int)controllerId;
+	bool axisGameType = _config.gameStepType >= 0 && _config.gameStepType <= 5;
+
+	if (!_stepPoseDetected) {
+		for (uint32_t i = 0; i < deviceCount; ++i) {
+			auto& pose = devices[i];
+			if (!pose.valid) {
+				continue;
+			}
+			if (!_config.disableHmd && pose.deviceClass == DeviceClass::Hmd) {
+				auto poseWorldVel = _hmdVelocity(pose, now);
+				if (_upAndDownStepCheck(poseWorldVel, _config.hmdThreshold)) {
+					_hmdYaw = (float)(radToDeg * std::asin(_hmdForward.v[0]));
+					_peaksCount = 1;
+				}
+				if (_peaksCount < 1 && (now - _timeLastStepPeak) > stepFrequencyMin) {
+					_trackerStepDetected = false;
+				}
+			}
+			else if (_config.useTrackers && pose.deviceClass == DeviceClass::Tracker) {
+				if (_upAndDownStepCheck(pose.velocity, _config.trackerThreshold)) {
+					_trackerStepDetected = true;
+					_timeLastTrackerStep = now;
+				}
+			}
+		}
+		_trackerStepDetected = _trackerStepDetected || !_config.useTrackers;
+		if (!_config.disableHmd) {
+			if (_peaksCount >= 1 && _trackerStepDetected) {
+				_stepPoseDetected = true;
+				_stepIntegrateSteps = 0;
+			}
+		}
+		else if (_trackerStepDetected && _config.useTrackers) {
+			_stepPoseDetected = true;
+			_stepIntegrateSteps = 0;
+		}
+		if (!_stepPoseDetected) {
+			if (_hasUnTouchedStepAxis < 4 && deviceId >= 0) {
+				// slow down over half the step time instead of stopping abruptly
+				if (_config.gameStepType >= 0 && _config.gameStepType <= 3 && _stepIntegrateSteps < (_stepIntegrateStepLimit / 2.0)) {
+					float axisY = (float)(_config.walkTouch * (1 - (_stepIntegrateSteps / (_stepIntegrateStepLimit / 2.0))));
+					_stepIntegrateSteps += tdiff;
+					_hasUnTouchedStepAxis = 1;
+					return _decide(deviceId, Gait::Walk, 0.0f, axisY);
+				}
+				_hasUnTouchedStepAxis++;
+				return _decide(deviceId, Gait::Stopped, 0.0f, 0.0f);
+			}
+			_stepIntegrateSteps = 0;
+			return Decision();
+		}
+	}
+
+	bool isWalking = true;
+	bool isJogging = false;
+	bool isRunning = false;
+	bool oneTrackerStepping = false;
+	_hasUnTouchedStepAxis = 2;
+	for (uint32_t i = 0; i < deviceCount; ++i) {
+		auto& pose = devices[i];
+		if (!pose.valid) {
+			continue;
+		}
+		if (!_config.disableHmd && pose.deviceClass == DeviceClass::Hmd) {
+			auto poseWorldVel = _hmdVelocity(pose, now);
+			_hmdYaw = (float)(radToDeg * std::asin(_hmdForward.v[0]));
+			if (_upAndDownStepCheck(poseWorldVel, _config.hmdThreshold)) {
+				_stepIntegrateSteps = 0;
+				int velsign = poseWorldVel.v[1] > 0 ? 1 : -1;
+				int hmdsign = _hmdLastYVel > 0 ? 1 : -1;
+				if (velsign != hmdsign) {
+					_timeLastStepPeak = now;
+					_hmdLastYVel = (float)poseWorldVel.v[1];
+				}
+			}
+		}
+		else if (_config.useTrackers && pose.deviceClass == DeviceClass::Tracker) {
+			if (_upAndDownStepCheck(pose.velocity, _config.trackerThreshold)) {
+				_trackerStepDetected = true;
+				oneTrackerStepping = true;
+				_timeLastTrackerStep = now;
+				if (_config.disableHmd) {
+					_stepIntegrateSteps = 0;
+				}
+			}
+		}
+	}
+	if (_config.useTrackers && !oneTrackerStepping) {
+		double trackerTimeout = _config.disableHmd ? _stepIntegrateStepLimit : _stepIntegrateStepLimit * 3;
+		if ((now - _timeLastTrackerStep) > trackerTimeout) {
+			_trackerStepDetected = false;
+		}
+	}
+	bool haveControllers = _controllerDeviceIds[0] >= 0 && _controllerDeviceIds[1] >= 0
+		&& (uint32_t)_controllerDeviceIds[0] < deviceCount && (uint32_t)_controllerDeviceIds[1] < deviceCount;
+	if (haveControllers) {
+		const Vector3* handVels[2] = { &devices[_controllerDeviceIds[0]].velocity, &devices[_controllerDeviceIds[1]].velocity };
+		if (_config.scaleTouchWithSwing) {
+			if (_contVelSampleTime > _stepIntegrateStepLimit * 4) {
+				_totalContYVel -= _contVelSamples.front();
+				_contVelSamples.pop_front();
+			}
+			else {
+				_contVelSampleTime += tdiff;
+			}
+			_contVelSamples.push_back((float)(std::fabs(handVels[0]->v[1]) + std::fabs(handVels[1]->v[1])) / 2.0f);
+			_totalContYVel += _contVelSamples.back();
+			_avgContYVel = _totalContYVel / _contVelSamples.size();
+		}
+		for (auto handVel : handVels) {
+			isRunning = _handStepCheck(*handVel, _config.handRunThreshold);
+			if (isRunning) {
+				_runIntegrateSteps = 0;
+			}
+			else {
+				isRunning = _runPoseDetected;
+			}
+			if (!isRunning) {
+				isJogging = _handStepCheck(*handVel, _config.handJogThreshold);
+				if (isJogging) {
+					_jogIntegrateSteps = 0;
+				}
+				else {
+					isJogging = _jogPoseDetected;
+				}
+			}
+		}
+		if (_jogPoseDetected) {
+			_jogIntegrateSteps += tdiff;
+			if (_jogIntegrateSteps > _stepIntegrateStepLimit) {
+				_jogPoseDetected = false;
+				_jogIntegrateSteps = 0.0;
+				isJogging = false;
+			}
+		}
+		if (_runPoseDetected) {
+			_runIntegrateSteps += tdiff;
+			if (_runIntegrateSteps > _stepIntegrateStepLimit) {
+				_runPoseDetected = false;
+				_runIntegrateSteps = 0.0;
+				isRunning = false;
+			}
+		}
+	}
+	_stepIntegrateSteps += tdiff;
+	_trackerStepDetected = _trackerStepDetected || !_config.useTrackers;
+
+	if (!isWalking || (_config.useTrackers && !_trackerStepDetected) || _stepIntegrateSteps >= _stepIntegrateStepLimit) {
+		_stepPoseDetected = false;
+		_trackerStepDetected = false;
+		_jogIntegrateSteps = 0.0;
+		_runIntegrateSteps = 0.0;
+		_contVelSamples.clear();
+		_totalContYVel = 0.0;
+		_avgContYVel = 0.0;
+		_contVelSampleTime = 0.0;
+		_peaksCount = 0;
+		_jogPoseDetected = false;
+		_runPoseDetected = false;
+		return Decision();
+	}
+	if (!haveControllers || !axisGameType) {
+		return Decision();
+	}
+
+	float axisX = 0;
+	float axisY = _config.walkTouch;
+	Gait gait = Gait::Walk;
+	if (isRunning) {
+		axisY = _config.runTouch;
+		_runPoseDetected = true;
+		gait = Gait::Run;
+	}
+	else if (isJogging) {
+		axisY = _config.scaleTouchWithSwing ? _getScaledTouch(_config.jogTouch, _config.runTouch, _avgContYVel, _config.handRunThreshold) : _config.jogTouch;
+		_jogPoseDetected = true;
+		gait = Gait::Jog;
+	}
+	else if (_config.scaleTouchWithSwing) {
+		axisY = _getScaledTouch(_config.walkTouch, _config.runTouch, _avgContYVel, _config.handRunThreshold);
+	}
+	if (_config.useContDirForStraf || _config.useContDirForRev) {
+		float touchX, touchY;
+		_controllerDirection(devices[deviceId], touchX, touchY);
+		axisX = _config.walkTouch * touchX;
+		if (isRunning) {
+			axisX = _config.jogTouch * touchX;
+		}
+		else if (isJogging) {
+			axisX = _config.runTouch * touchX;
+		}
+		axisY = axisY * touchY;
+	}
+	if (axisY > 1) {
+		axisY = 1;
+	}
+	if (axisY < -1) {
+		axisY = -1;
+	}
+	_hasUnTouchedStepAxis = 0;
+	return _decide(deviceId, gait, axisX, axisY);
+}
+
+
+Vector3 StepDetector::_hmdVelocity(const DeviceSample& pose, double now) {
+	_hmdForward = rotate(pose.rotation, { { 0, 0, -1 } });
+	Vector3 poseWorldVel = pose.velocity;
+	double tvelDiff = (now - _velStepTime) / 1000.0;
+	if (_config.hmdType != 0) {
+		if (tvelDiff <= 0.0) {
+			_hmdVel = { { 0, 0, 0 } };
+			return _hmdVel;
+		}
+		poseWorldVel.v[0] = (pose.position.v[0] - _lastHmdPos.v[0]) / tvelDiff;
+		poseWorldVel.v[1] = (pose.position.v[1] - _lastHmdPos.v[1]) / tvelDiff;
+		poseWorldVel.v[2] = (pose.position.v[2] - _lastHmdPos.v[2]) / tvelDiff;
+		_lastHmdPos = pose.position;
+	}
+	_velStepTime = now;
+	_hmdVel = poseWorldVel;
+	return poseWorldVel;
+}
+
+
+void StepDetector::_controllerDirection(const DeviceSample& pose, float& touchX, float& touchY) {
+	Vector3 forwardRot = rotate(pose.rotation, { { 0, 0, -1 } });
+	Vector3 hmdForward = _hmdForward;
+
+	float pitch = (float)(radToDeg * std::asin(forwardRot.v[1]));
+	float yaw = (float)(radToDeg * std::asin(forwardRot.v[0]));
+	touchX = 0;
+	touchY = 1;
+	float diffYaw = (_hmdYaw < 0 ? -1.0f : 1.0f)*(_hmdYaw - yaw);
+	hmdForward.v[1] = 0;
+	forwardRot.v[1] = 0;
+	double hmdForwardMag = (std::sqrt((hmdForward.v[0] * hmdForward.v[0]) + (hmdForward.v[2] * hmdForward.v[2])));
+	double forwardMag = (std::sqrt((forwardRot.v[0] * forwardRot.v[0]) + (forwardRot.v[2] * forwardRot.v[2])));
+	if (hmdForwardMag <= 0.0 || forwardMag <= 0.0) {
+		return;
+	}
+	hmdForward.v[0] = hmdForward.v[0] / hmdForwardMag;
+	hmdForward.v[2] = hmdForward.v[2] / hmdForwardMag;
+	forwardRot.v[0] = forwardRot.v[0] / forwardMag;
+	forwardRot.v[2] = forwardRot.v[2] / forwardMag;
+	auto& h = hmdForward.v;
+	auto& c = forwardRot.v;
+	bool reverse = pitch > 77
+		|| (h[0] > 0.6 && c[0] < 0)
+		|| (h[2] > 0.6 && c[2] < 0)
+		|| (h[0] < -0.6 && c[0] > 0)
+		|| (h[2] < -0.6 && c[2] > 0)
+		|| (h[0] < -0.27 && h[2] < -0.27 && c[0] > 0 && c[2] > 0)
+		|| (h[0] > 0.27 && h[2] > 0.27 && c[0] < 0 && c[2] < 0)
+		|| (h[0] > 0.27 && h[2] < -0.27 && c[0] < 0 && c[2] > 0)
+		|| (h[0] < -0.27 && h[2] > 0.27 && c[0] > 0 && c[2] < 0);
+	if (_config.useContDirForRev && reverse) {
+		touchY = -1;
+		touchX = 0;
+	}
+	else if (_config.useContDirForStraf && pitch < 77 && std::fabs(diffYaw) > 30) {
+		if ((h[0] > 0.6 && c[2] > 0.6)
+			|| (h[2] > 0.6 && c[0] < -0.6)
+			|| (h[0] < -0.6 && c[2] < -0.6)
+			|| (h[2] < -0.6 && c[0] > 0.6)
+			|| (h[0] < -0.27 && h[2] < -0.27 && c[0] > 0)
+			|| (h[0] > 0.27 && h[2] > 0.27 && c[0] < 0)
+			|| (h[0] > 0.27 && h[2] < -0.27 && c[2] > 0)
+			|| (h[0] < -0.27 && h[2] > 0.27 && c[2] < 0)) {
+			touchX = 1;
+		}
+		else if ((h[0] > 0.6 && c[2] < -0.6)
+			|| (h[2] > 0.6 && c[0] > 0.6)
+			|| (h[0] < -0.6 && c[2] > 0.6)
+			|| (h[2] < -0.6 && c[0] < -0.6)
+			|| (h[0] < -0.27 && h[2] < -0.27 && c[2] > 0)
+			|| (h[0] > 0.27 && h[2] > 0.27 && c[2] < 0)
+			|| (h[0] > 0.27 && h[2] < -0.27 && c[0] < 0)
+			|| (h[0] < -0.27 && h[2] > 0.27 && c[0] > 0)) {
+			touchX = -1;
+		}
+		if (touchX != 0 && std::fabs(diffYaw) > 66) {
+			touchY = 0;
+		}
+	}
+}
+
+
+Decision StepDetector::_decide(uint32_t deviceId, Gait gait, float axisX, float axisY) {
+	Decision decision;
+	decision.deviceId = deviceId;
+	decision.gait = gait;
+	decision.axisX = axisX;
+	decision.axisY = axisY;
+	decision.changed = _lastDecision.deviceId != deviceId || _lastDecision.gait != gait
+		|| _lastDecision.axisX != axisX || _lastDecision.axisY != axisY;
+	_lastDecision = decision;
+	return decision;
+}
+
+
+bool StepDetector::_upAndDownStepCheck(const Vector3& vel, const Vector3& threshold) {
+	return (std::fabs(vel.v[2]) < threshold.v[2])
+		&& (std::fabs(vel.v[0]) < threshold.v[0])
+		&& (std::fabs(vel.v[1]) > threshold.v[1])
+		&& (std::fabs(vel.v[1]) > std::fabs(vel.v[0]) && std::fabs(vel.v[1]) > std::fabs(vel.v[2]));
+}
+
+
+bool StepDetector::_handStepCheck(const Vector3& vel, float threshold) {
+	return (std::fabs(vel.v[1]) > std::fabs(vel.v[0]) && std::fabs(vel.v[1]) > std::fabs(vel.v[2]))
+		&& (std::fabs(vel.v[1]) > threshold);
+}
+
+
+float StepDetector::_getScaledTouch(float minTouch, float maxTouch, float avgVel, float maxVel) {
+	float scaledTouch = maxTouch;
+	if (avgVel < maxVel) {
+		scaledTouch = (avgVel / maxVel);
+	}
+	if (scaledTouch < minTouch) {
+		scaledTouch = minTouch;
+	}
+	return scaledTouch > 1 ? 1 : scaledTouch;
+}
+
+
+} // end namespace stepdetector
+} // end namespace vrwalkinplace
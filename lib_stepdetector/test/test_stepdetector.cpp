@@ -0,0 +1,172 @@
+#include <stepdetector.h>
+#include <cmath>
+#include <iostream>
+
+
+/*
+* Decisions of the StepDetector on synthetic poses: an HMD (device 0) and two controllers (devices 1 and 2).
+*
+* A bobbing HMD starts a walk on the selected controller, swinging hands make it a jog or a run. When the bobbing
+* stops the walk ends after the step time.
+* Button and keyboard game types only get the step state, never an axis decision.
+*/
+
+
+using namespace vrwalkinplace::stepdetector;
+
+
+#define TEST_TICK_MS 12.0
+#define TEST_DEVICE_COUNT 3u
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+struct Player {
+	DeviceSample devices[TEST_DEVICE_COUNT];
+	double nowMs = 1000.0;
+
+	Player() {
+		devices[0].valid = true;
+		devices[0].deviceClass = DeviceClass::Hmd;
+		devices[0].position = { { 0.0, 1.7, 0.0 } };
+		for (uint32_t i = 1; i < TEST_DEVICE_COUNT; ++i) {
+			devices[i].valid = true;
+			devices[i].deviceClass = DeviceClass::Controller;
+			devices[i].position = { { i == 1 ? -0.2 : 0.2, 1.0, -0.2 } };
+		}
+	}
+
+	// Head bobbing with hmdVelY (alternating sign every tick, 0 .. standing still), hands swinging with handVelY
+	Decision tick(StepDetector& detector, double hmdVelY, double handVelY = 0.0) {
+		nowMs += TEST_TICK_MS;
+		int sign = ((int)(nowMs / TEST_TICK_MS) % 2) ? 1 : -1;
+		devices[0].velocity = { { 0.0, sign * hmdVelY, 0.0 } };
+		devices[0].position.v[1] += sign * hmdVelY * TEST_TICK_MS / 1000.0;
+		for (uint32_t i = 1; i < TEST_DEVICE_COUNT; ++i) {
+			devices[i].velocity = { { 0.0, (i == 1 ? sign : -sign) * handVelY, 0.0 } };
+		}
+		return detector.update(nowMs, devices, TEST_DEVICE_COUNT);
+	}
+};
+
+
+static void testWalkRampStop() {
+	StepDetector detector;
+	Config config;
+	detector.configure(config);
+	Player player;
+
+	auto decision = player.tick(detector, 0.0);
+	CHECK(!decision.changed && !detector.stepDetected(), "standing player moves");
+	CHECK(detector.controllerDeviceId() == 1, "first controller not selected");
+
+	decision = player.tick(detector, 0.3);
+	CHECK(detector.stepDetected(), "bobbing hmd not detected as a step");
+	CHECK(decision.changed && decision.deviceId == 1 && decision.gait == Gait::Walk, "no walk decision");
+	CHECK(decision.axisX == 0.0f && decision.axisY == config.walkTouch, "walk axis is not walkTouch");
+	CHECK(std::fabs(detector.hmdVelocity().v[1]) == 0.3, "hmd velocity not reported");
+
+	for (uint32_t i = 0; i < 20; ++i) {
+		decision = player.tick(detector, 0.3);
+		CHECK(!decision.changed, "walk decision changed while walking");
+	}
+
+	// Standing still: the walk ends one step time after the last bob
+	double stopMs = player.nowMs;
+	while (detector.lastDecision().gait != Gait::Stopped && player.nowMs - stopMs < config.stepIntSec * 3000.0) {
+		decision = player.tick(detector, 0.0);
+		CHECK(!decision.changed || decision.gait == Gait::Stopped || !detector.stepDetected(), "walk decision changed while standing");
+	}
+	double stoppedAfterMs = player.nowMs - stopMs;
+	CHECK(!detector.stepDetected(), "step still detected");
+	CHECK(detector.lastDecision().gait == Gait::Stopped && detector.lastDecision().deviceId == 1, "walk never stopped");
+	CHECK(stoppedAfterMs >= config.stepIntSec * 1000.0 && stoppedAfterMs < config.stepIntSec * 1000.0 + 3 * TEST_TICK_MS,
+		"stopped after " << stoppedAfterMs << " ms instead of one step time");
+	CHECK(!detector.stop().changed, "stop() of a stopped player changed the decision");
+}
+
+
+static void testGaits() {
+	StepDetector detector;
+	Config config;
+	config.controlSelect = 1;
+	detector.configure(config);
+	Player player;
+
+	player.tick(detector, 0.0);
+	CHECK(detector.controllerDeviceId() == 2, "second controller not selected");
+	auto decision = player.tick(detector, 0.3, 1.5);
+	CHECK(decision.changed && decision.deviceId == 2 && decision.gait == Gait::Jog && decision.axisY == config.jogTouch, "no jog decision");
+	decision = player.tick(detector, 0.3, 2.5);
+	CHECK(decision.changed && decision.gait == Gait::Run && decision.axisY == config.runTouch, "no run decision");
+	decision = player.tick(detector, 0.3, 0.0);
+	CHECK(!decision.changed && detector.lastDecision().gait == Gait::Run, "run ended before the step time");
+
+	decision = detector.stop();
+	CHECK(decision.changed && decision.deviceId == 2 && decision.gait == Gait::Stopped, "stop() did not stop the run");
+}
+
+
+static void testTickRateAndButtonGameTypes() {
+	StepDetector detector;
+	Config config;
+	config.gameStepType = 7;
+	detector.configure(config);
+	Player player;
+
+	player.tick(detector, 0.0);
+	player.devices[0].velocity = { { 0.0, 0.3, 0.0 } };
+	detector.update(player.nowMs + 1.0, player.devices, TEST_DEVICE_COUNT);
+	CHECK(!detector.stepDetected(), "update closer than 1/90 s was not skipped");
+
+	for (uint32_t i = 0; i < 10; ++i) {
+		auto decision = player.tick(detector, 0.3);
+		CHECK(detector.stepDetected(), "keyboard game type: step not detected");
+		CHECK(!decision.changed, "keyboard game type got an axis decision");
+	}
+
+	detector.reset();
+	CHECK(!detector.stepDetected() && !detector.trackerStepDetected(), "reset() kept the step");
+}
+
+
+static void testTrackers() {
+	StepDetector detector;
+	Config config;
+	config.useTrackers = true;
+	config.disableHmd = true;
+	detector.configure(config);
+	Player player;
+	player.devices[2].deviceClass = DeviceClass::Tracker;
+
+	player.tick(detector, 0.3);
+	CHECK(!detector.stepDetected(), "step detected from the disabled hmd");
+	player.nowMs += TEST_TICK_MS;
+	player.devices[2].velocity = { { 0.0, 0.3, 0.0 } };
+	detector.update(player.nowMs, player.devices, TEST_DEVICE_COUNT);
+	CHECK(detector.stepDetected() && detector.trackerStepDetected(), "tracker step not detected");
+}
+
+
+int main() {
+	testWalkRampStop();
+	testGaits();
+	testTickRateAndButtonGameTypes();
+	testTrackers();
+
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,474 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <type_traits>
+
+
+/**
+* Binary logger for hot paths (pose hooks, event injection, per-message IPC traces).
+*
+* BLOG(level, format, args...) copies the raw arguments plus a call site id into a per-thread
+* single-producer/single-consumer ring. Nothing is formatted and no lock is taken on the logging thread,
+* a background thread appends the records to a binary file, binarylog::decode() turns it into text offline.
+*
+* Levels below VRWALKINPLACE_BINARYLOG_MIN_LEVEL are compiled out. Format strings use "{}" as placeholder,
+* arguments must be arithmetic, enums or pointers (strings belong into the normal LOG()).
+*/
+
+#ifndef VRWALKINPLACE_BINARYLOG_MIN_LEVEL
+#ifdef _DEBUG
+#define VRWALKINPLACE_BINARYLOG_MIN_LEVEL 0 // everything
+#else
+#define VRWALKINPLACE_BINARYLOG_MIN_LEVEL 2 // INFO and above
+#endif
+#endif
+
+#define BINARYLOG_MAXARGS 6
+#define BINARYLOG_RING_CAPACITY 4096 // records per thread
+#define BINARYLOG_FILE_VERSION 1
+
+// The level is pasted, so BLOG(ERROR, ...) works even with the windows ERROR macro (same as easylogging's LOG(ERROR))
+#define BLOG(level, format, ...) \
+	do { \
+		if (vrwalkinplace::binarylog::Level_##level >= VRWALKINPLACE_BINARYLOG_MIN_LEVEL) { \
+			auto& _blog = vrwalkinplace::binarylog::BinaryLog::instance(); \
+			if (_blog.isRunning()) { \
+				static vrwalkinplace::binarylog::Site _blogSite = { vrwalkinplace::binarylog::Level_##level, __FILE__, __LINE__, format, nullptr, { 0 } }; \
+				_blog.write(_blogSite, ##__VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+
+namespace vrwalkinplace {
+namespace binarylog {
+
+
+enum Level : uint32_t {
+	Level_TRACE = 0,
+	Level_DEBUG,
+	Level_INFO,
+	Level_WARNING,
+	Level_ERROR
+};
+
+
+// One per BLOG() statement, id is assigned on first use
+struct Site {
+	Level level;
+	const char* file;
+	uint32_t line;
+	const char* format;
+	const char* argTypes;
+	std::atomic<uint32_t> id;
+};
+
+
+struct Record {
+	uint64_t timeNs; // steady clock
+	uint32_t siteId;
+	uint32_t threadId;
+	uint64_t args[BINARYLOG_MAXARGS];
+};
+
+
+// File chunks following the header
+enum ChunkType : uint8_t {
+	Chunk_Site = 1,
+	Chunk_Record,
+	Chunk_Dropped,
+	Chunk_ClockSync
+};
+
+static const char fileMagic[8] = { 'V', 'R', 'W', 'I', 'P', 'L', 'O', 'G' };
+
+
+// Argument encoding: i .. signed, u .. unsigned, d .. double, p .. pointer
+template<typename T>
+struct ArgTag {
+	static_assert(!std::is_same<T, const char*>::value && !std::is_same<T, char*>::value, "Strings are not supported by BLOG(), use LOG()");
+	static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, "Unsupported BLOG() argument type");
+	static const char value = std::is_floating_point<T>::value ? 'd'
+		: std::is_pointer<T>::value ? 'p'
+		: (std::is_enum<T>::value || std::is_signed<T>::value) ? 'i' : 'u';
+};
+
+template<typename... Args>
+struct ArgTypes {
+	static_assert(sizeof...(Args) <= BINARYLOG_MAXARGS, "Too many BLOG() arguments");
+	static constexpr char value[sizeof...(Args) + 1] = { ArgTag<typename std::decay<Args>::type>::value..., 0 };
+};
+template<typename... Args>
+constexpr char ArgTypes<Args...>::value[sizeof...(Args) + 1];
+
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value, uint64_t>::type encodeArg(T value) {
+	double d = (double)value;
+	uint64_t retval;
+	memcpy(&retval, &d, sizeof(retval));
+	return retval;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_pointer<T>::value, uint64_t>::type encodeArg(T value) {
+	return (uint64_t)(uintptr_t)value;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value || std::is_integral<T>::value, uint64_t>::type encodeArg(T value) {
+	return std::is_signed<T>::value || std::is_enum<T>::value ? (uint64_t)(int64_t)value : (uint64_t)value;
+}
+
+inline void encodeArgs(uint64_t*) {}
+
+template<typename T, typename... Args>
+inline void encodeArgs(uint64_t* out, T value, Args... args) {
+	*out = encodeArg(value);
+	encodeArgs(out + 1, args...);
+}
+
+
+// Single-producer (the logging thread) / single-consumer (the flush thread) ring
+struct ThreadRing {
+	std::atomic<uint32_t> head = { 0 };
+	std::atomic<uint32_t> tail = { 0 };
+	std::atomic<uint64_t> dropped = { 0 };
+	uint32_t threadId = 0;
+	Record slots[BINARYLOG_RING_CAPACITY];
+};
+
+
+class BinaryLog {
+public:
+	static BinaryLog& instance() {
+		static BinaryLog log;
+		return log;
+	}
+
+	~BinaryLog() {
+		stop();
+	}
+
+	// Opens (truncates) the file and starts the flush thread
+	void start(const std::string& path, uint32_t flushIntervalMs = 100) {
+		std::lock_guard<std::mutex> lock(_threadMutex);
+		if (_running) {
+			return;
+		}
+		_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!_file) {
+			throw std::runtime_error("Could not open binary log file " + path);
+		}
+		_file.write(fileMagic, sizeof(fileMagic));
+		uint32_t version = BINARYLOG_FILE_VERSION;
+		_file.write((const char*)&version, sizeof(version));
+		// lets the decoder turn steady clock stamps into wall clock time
+		uint8_t type = Chunk_ClockSync;
+		uint64_t steadyNs = _now();
+		int64_t systemMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		_file.write((const char*)&type, sizeof(type));
+		_file.write((const char*)&steadyNs, sizeof(steadyNs));
+		_file.write((const char*)&systemMs, sizeof(systemMs));
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_sitesWritten = 0;
+		}
+		_flushInterval = std::chrono::milliseconds(flushIntervalMs);
+		_stopFlushThread = false;
+		_running = true;
+		_flushThread = std::thread(&BinaryLog::_flushThreadFunc, this);
+	}
+
+	// Flushes everything that was logged so far and closes the file
+	void stop() {
+		std::lock_guard<std::mutex> lock(_threadMutex);
+		if (!_running) {
+			return;
+		}
+		_running = false;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopFlushThread = true;
+		}
+		_flushCondition.notify_all();
+		if (_flushThread.joinable()) {
+			_flushThread.join();
+		}
+		_file.close();
+	}
+
+	bool isRunning() const {
+		return _running.load(std::memory_order_relaxed);
+	}
+
+	template<typename... Args>
+	void write(Site& site, Args... args) {
+		auto siteId = site.id.load(std::memory_order_acquire);
+		if (siteId == 0) {
+			siteId = _registerSite(site, ArgTypes<Args...>::value);
+		}
+		auto ring = _threadRing();
+		auto t = ring->tail.load(std::memory_order_relaxed);
+		if (t - ring->head.load(std::memory_order_acquire) >= BINARYLOG_RING_CAPACITY) {
+			ring->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		auto& record = ring->slots[t & (BINARYLOG_RING_CAPACITY - 1)];
+		record.timeNs = _now();
+		record.siteId = siteId;
+		record.threadId = ring->threadId;
+		encodeArgs(record.args, args...);
+		ring->tail.store(t + 1, std::memory_order_release);
+	}
+
+private:
+	BinaryLog() {}
+
+	std::mutex _threadMutex; // start/stop
+	std::atomic<bool> _running = { false };
+	std::thread _flushThread;
+	std::chrono::milliseconds _flushInterval;
+	std::ofstream _file; // only used by the flush thread while running
+
+	std::mutex _mutex; // sites and rings
+	std::condition_variable _flushCondition;
+	bool _stopFlushThread = false;
+	std::vector<Site*> _sites;
+	size_t _sitesWritten = 0;
+	std::vector<std::unique_ptr<ThreadRing>> _rings;
+
+	static uint64_t _now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint32_t _registerSite(Site& site, const char* argTypes) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto id = site.id.load(std::memory_order_relaxed);
+		if (id == 0) {
+			site.argTypes = argTypes;
+			_sites.push_back(&site);
+			id = (uint32_t)_sites.size();
+			site.id.store(id, std::memory_order_release);
+		}
+		return id;
+	}
+
+	// Rings are never freed, records of a thread that exited are still flushed
+	ThreadRing* _threadRing() {
+		static thread_local ThreadRing* ring = nullptr;
+		if (!ring) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_rings.emplace_back(new ThreadRing());
+			ring = _rings.back().get();
+			ring->threadId = (uint32_t)_rings.size();
+		}
+		return ring;
+	}
+
+	void _flushThreadFunc() {
+		bool stop = false;
+		while (!stop) {
+			std::vector<ThreadRing*> rings;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_flushCondition.wait_for(lock, _flushInterval, [this]() { return _stopFlushThread; });
+				stop = _stopFlushThread;
+				for (; _sitesWritten < _sites.size(); ++_sitesWritten) {
+					_writeSite(*_sites[_sitesWritten]);
+				}
+				for (auto& r : _rings) {
+					rings.push_back(r.get());
+				}
+			}
+			for (auto ring : rings) {
+				_drain(*ring);
+			}
+			_file.flush();
+		}
+	}
+
+	void _writeSite(const Site& site) {
+		uint8_t type = Chunk_Site;
+		uint32_t id = site.id.load(std::memory_order_relaxed);
+		uint32_t level = site.level;
+		_file.write((const char*)&type, sizeof(type));
+		_file.write((const char*)&id, sizeof(id));
+		_file.write((const char*)&level, sizeof(level));
+		_file.write((const char*)&site.line, sizeof(site.line));
+		_writeString(site.file);
+		_writeString(site.format);
+		_writeString(site.argTypes);
+	}
+
+	void _writeString(const char* str) {
+		uint16_t len = (uint16_t)strlen(str);
+		_file.write((const char*)&len, sizeof(len));
+		_file.write(str, len);
+	}
+
+	void _drain(ThreadRing& ring) {
+		auto h = ring.head.load(std::memory_order_relaxed);
+		auto t = ring.tail.load(std::memory_order_acquire);
+		uint8_t type = Chunk_Record;
+		for (; h != t; ++h) {
+			_file.write((const char*)&type, sizeof(type));
+			_file.write((const char*)&ring.slots[h & (BINARYLOG_RING_CAPACITY - 1)], sizeof(Record));
+		}
+		ring.head.store(h, std::memory_order_release);
+		auto dropped = ring.dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0) {
+			type = Chunk_Dropped;
+			_file.write((const char*)&type, sizeof(type));
+			_file.write((const char*)&ring.threadId, sizeof(ring.threadId));
+			_file.write((const char*)&dropped, sizeof(dropped));
+		}
+	}
+};
+
+
+// Offline decoder, writes one text line per record. Throws std::runtime_error on files it does not understand.
+inline void decode(std::istream& in, std::ostream& out) {
+	struct DecodedSite {
+		uint32_t level;
+		uint32_t line;
+		std::string file;
+		std::string format;
+		std::string argTypes;
+	};
+	auto readString = [&in]() {
+		uint16_t len = 0;
+		in.read((char*)&len, sizeof(len));
+		std::string str(len, '\0');
+		if (len > 0) {
+			in.read(&str[0], len);
+		}
+		return str;
+	};
+	char magic[sizeof(fileMagic)];
+	uint32_t version = 0;
+	in.read(magic, sizeof(magic));
+	in.read((char*)&version, sizeof(version));
+	if (!in || memcmp(magic, fileMagic, sizeof(fileMagic)) != 0) {
+		throw std::runtime_error("Not a binary log file");
+	}
+	if (version != BINARYLOG_FILE_VERSION) {
+		throw std::runtime_error("Unsupported binary log version " + std::to_string(version));
+	}
+
+	// Sites may be written after the first records that use them, so read everything first
+	std::map<uint32_t, DecodedSite> sites;
+	std::vector<Record> records;
+	std::vector<std::string> notes;
+	uint64_t syncSteadyNs = 0;
+	int64_t syncSystemMs = 0;
+	uint8_t type;
+	while (in.read((char*)&type, sizeof(type))) {
+		switch (type) {
+		case Chunk_Site: {
+			uint32_t id;
+			DecodedSite site;
+			in.read((char*)&id, sizeof(id));
+			in.read((char*)&site.level, sizeof(site.level));
+			in.read((char*)&site.line, sizeof(site.line));
+			site.file = readString();
+			site.format = readString();
+			site.argTypes = readString();
+			sites[id] = site;
+			break;
+		}
+		case Chunk_Record: {
+			Record record;
+			if (in.read((char*)&record, sizeof(record))) {
+				records.push_back(record);
+			}
+			break;
+		}
+		case Chunk_Dropped: {
+			uint32_t threadId;
+			uint64_t count;
+			in.read((char*)&threadId, sizeof(threadId));
+			in.read((char*)&count, sizeof(count));
+			notes.push_back("[WARNING] thread " + std::to_string(threadId) + " dropped " + std::to_string(count) + " records");
+			break;
+		}
+		case Chunk_ClockSync:
+			in.read((char*)&syncSteadyNs, sizeof(syncSteadyNs));
+			in.read((char*)&syncSystemMs, sizeof(syncSystemMs));
+			break;
+		default:
+			throw std::runtime_error("Corrupt binary log file (unknown chunk type " + std::to_string((int)type) + ")");
+		}
+	}
+
+	// Every thread has its own ring, so the file is only ordered per thread
+	std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) { return a.timeNs < b.timeNs; });
+
+	static const char* const levelNames[] = { "TRACE", "DEBUG", "INFO", "WARNING", "ERROR" };
+	for (auto& record : records) {
+		auto it = sites.find(record.siteId);
+		if (it == sites.end()) {
+			out << "[UNKNOWN] record of unknown site " << record.siteId << "\n";
+			continue;
+		}
+		auto& site = it->second;
+		int64_t timeMs = syncSystemMs + ((int64_t)record.timeNs - (int64_t)syncSteadyNs) / 1000000;
+		std::time_t seconds = (std::time_t)(timeMs / 1000);
+		char timeBuffer[32];
+		std::strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", std::localtime(&seconds));
+		out << "[" << (site.level < 5 ? levelNames[site.level] : "?") << "] " << timeBuffer << "." << std::setw(3) << std::setfill('0') << (timeMs % 1000)
+			<< std::setfill(' ') << " [" << record.threadId << "] ";
+		size_t arg = 0;
+		for (size_t c = 0; c < site.format.size(); ++c) {
+			if (site.format[c] == '{' && c + 1 < site.format.size() && site.format[c + 1] == '}' && arg < site.argTypes.size()) {
+				auto value = record.args[arg];
+				switch (site.argTypes[arg]) {
+				case 'i':
+					out << (int64_t)value;
+					break;
+				case 'd': {
+					double d;
+					memcpy(&d, &value, sizeof(d));
+					out << d;
+					break;
+				}
+				case 'p':
+					out << "0x" << std::hex << value << std::dec;
+					break;
+				default:
+					out << value;
+					break;
+				}
+				arg++;
+				c++;
+			}
+			else {
+				out << site.format[c];
+			}
+		}
+		out << "\n";
+	}
+	for (auto& note : notes) {
+		out << note << "\n";
+	}
+}
+
+
+} // end namespace binarylog
+} // end namespace vrwalkinplace
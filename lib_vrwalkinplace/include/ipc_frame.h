@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <ipc_protocol.h>
+
+
+namespace vrwalkinplace {
+namespace ipc {
+
+
+/*
+* Wire format of requests since IPC_PROTOCOL_VERSION 9 (the packet header carries the client id since 10).
+*
+* One message queue message or shm ring slot is a FramePacket: a 16 byte packet header with the sender's client id
+* (renews its lease in the driver) followed by frames.
+* A frame is an 8 byte FrameHeader and the request payload, i.e. only the used part of the Request union member
+* (an axis event is 24 bytes on the wire instead of sizeof(Request)). Frames start at 4 byte boundaries.
+*
+* Only the connect request is not framed, it is a ConnectRequest whose layout is frozen (see ipc_protocol.h). It starts
+* with a small RequestType value and never with IPC_FRAME_MARKER, so the server tells both apart by the first 4 bytes.
+*/
+#define IPC_FRAME_MARKER 0x46504957u // "WIPF"
+#define IPC_FRAME_PACKET_SIZE 512
+
+
+struct FrameHeader {
+	uint16_t type; // RequestType
+	uint16_t payloadSize;
+	uint32_t sendTimeUs; // low 32 bits of Request::sendTime, enough for latencies below ~70 minutes
+};
+
+
+// Bytes of message.msg that are sent, 0 for requests without payload
+inline uint32_t requestPayloadSize(const Request& message) {
+	switch (message.type) {
+	case RequestType::IPC_ClientConnect: return sizeof(Request_IPC_ClientConnect);
+	case RequestType::IPC_ClientDisconnect: return sizeof(Request_IPC_ClientDisconnect);
+	case RequestType::IPC_Ping: return sizeof(Request_IPC_Ping);
+	case RequestType::OpenVR_PoseUpdate: return sizeof(Request_OpenVR_PoseUpdate);
+	case RequestType::OpenVR_ButtonEvent: return sizeof(Request_OpenVR_ButtonEvent);
+	case RequestType::OpenVR_AxisEvent: return sizeof(Request_OpenVR_AxisEvent);
+	case RequestType::OpenVR_EventBatch:
+	{
+		auto count = message.msg.ipc_EventBatch.eventCount < REQUEST_OPENVR_EVENTBATCH_MAXCOUNT ? message.msg.ipc_EventBatch.eventCount : REQUEST_OPENVR_EVENTBATCH_MAXCOUNT;
+		return (uint32_t)(offsetof(Request_OpenVR_EventBatch, events) + count * sizeof(Request_OpenVR_BatchedEvent));
+	}
+	case RequestType::OpenVR_DeviceAdded: return sizeof(Request_OpenVR_DeviceAdded);
+	case RequestType::WalkInPlace_StepDetectionMode: return sizeof(Request_WalkInPlace_StepDetectionMode);
+	case RequestType::WalkInPlace_StepDetect: return sizeof(Request_WalkInPlace_StepDetect);
+	case RequestType::WalkInPlace_LocomotionBinding: return sizeof(Request_WalkInPlace_LocomotionBinding);
+	case RequestType::WalkInPlace_LocomotionIntent: return sizeof(Request_WalkInPlace_LocomotionIntent);
+	default: return 0;
+	}
+}
+
+
+struct FramePacket {
+	uint32_t marker;
+	uint16_t size; // used bytes of data
+	uint16_t frameCount;
+	uint32_t clientId; // 0 until the connect reply arrived
+	uint32_t reserved;
+	uint8_t data[IPC_FRAME_PACKET_SIZE - 16];
+
+	static const uint32_t capacity = IPC_FRAME_PACKET_SIZE - 16;
+
+	void clear(uint32_t senderClientId = 0) {
+		marker = IPC_FRAME_MARKER;
+		size = 0;
+		frameCount = 0;
+		clientId = senderClientId;
+		reserved = 0;
+	}
+
+	bool empty() const {
+		return frameCount == 0;
+	}
+
+	// Bytes to send, the unused rest of data is not part of the message
+	uint32_t byteSize() const {
+		return (uint32_t)offsetof(FramePacket, data) + size;
+	}
+
+	// Returns false when the frame does not fit, the packet is unchanged then
+	bool append(const Request& message) {
+		auto payloadSize = requestPayloadSize(message);
+		auto frameSize = (uint32_t)sizeof(FrameHeader) + ((payloadSize + 3) & ~3u);
+		if (size + frameSize > capacity) {
+			return false;
+		}
+		FrameHeader header;
+		header.type = (uint16_t)message.type;
+		header.payloadSize = (uint16_t)payloadSize;
+		header.sendTimeUs = (uint32_t)message.sendTime;
+		memcpy(data + size, &header, sizeof(FrameHeader));
+		memcpy(data + size + sizeof(FrameHeader), &message.msg, payloadSize);
+		size += (uint16_t)frameSize;
+		frameCount++;
+		return true;
+	}
+
+	/**
+	* Calls f(const Request&) for every frame in order. messageSize is the number of received bytes.
+	* Returns false when the packet is malformed, frames before the damage were delivered.
+	*/
+	template<typename F>
+	bool forEach(size_t messageSize, F f) const {
+		if (messageSize < offsetof(FramePacket, data) || marker != IPC_FRAME_MARKER || size > capacity || byteSize() > messageSize) {
+			return false;
+		}
+		auto nowUs = monotonicTimeUs();
+		uint32_t pos = 0;
+		for (uint32_t i = 0; i < frameCount; ++i) {
+			if (pos + sizeof(FrameHeader) > size) {
+				return false;
+			}
+			FrameHeader header;
+			memcpy(&header, data + pos, sizeof(FrameHeader));
+			pos += sizeof(FrameHeader);
+			if (header.payloadSize > sizeof(Request::msg) || pos + header.payloadSize > size) {
+				return false;
+			}
+			Request message;
+			message.type = (RequestType)header.type;
+			message.sendTime = nowUs - (int64_t)(uint32_t)((uint32_t)nowUs - header.sendTimeUs);
+			memcpy(&message.msg, data + pos, header.payloadSize);
+			pos += (header.payloadSize + 3) & ~3u;
+			f(message);
+		}
+		return true;
+	}
+};
+
+static_assert(sizeof(FramePacket) == IPC_FRAME_PACKET_SIZE, "FramePacket has padding");
+static_assert(sizeof(ConnectRequest) <= sizeof(FramePacket), "The server queue holds packets and connect requests");
+static_assert(sizeof(FrameHeader) + sizeof(Request_WalkInPlace_StepDetectionMode) <= FramePacket::capacity, "Largest single frame does not fit into a packet");
+
+
+} // end namespace ipc
+} // end namespace vrwalkinplace
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <ipc_shm_ring.h>
+
+
+namespace vrwalkinplace {
+namespace ipc {
+
+
+#define IPC_POSETAP_VERSION 1
+#define IPC_POSETAP_DEVICECOUNT 64
+#define IPC_POSETAP_CAPACITY 256 // per device, ~230 ms of HMD samples
+
+
+enum PoseTapFlags : uint32_t {
+	PoseTapFlag_PoseIsValid = 1,
+	PoseTapFlag_DeviceIsConnected = 2
+};
+
+
+// One DriverPose_t as reported to TrackedDevicePoseUpdated, transformed into the driver's world space
+struct PoseTapSample {
+	int64_t sampleTimeUs; // monotonicTimeUs() when the driver reported the pose
+	double poseTimeOffset;
+	vr::HmdVector3d_t position;
+	vr::HmdVector3d_t velocity;
+	vr::HmdQuaternion_t rotation;
+	uint32_t flags; // PoseTapFlags
+};
+
+
+/**
+* Per-device ring of pose samples, one writer (the driver thread reporting the device's poses) and any number of readers.
+*
+* Every slot has its own seqlock: while sample n is written the slot sequence is 2n+1, afterwards 2n+2.
+* A reader that wants sample n checks for 2n+2 before and after copying it, anything else means the writer
+* lapped it and the sample is lost. Writing never waits for readers.
+*/
+struct PoseTapSlot {
+	std::atomic<uint32_t> sequence;
+	PoseTapSample sample;
+};
+
+struct PoseTapDeviceRing {
+	static_assert((IPC_POSETAP_CAPACITY & (IPC_POSETAP_CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+	alignas(IPC_SHMRING_CACHELINE_SIZE) std::atomic<uint32_t> writeCount;
+	std::atomic<uint32_t> deviceClass; // vr::ETrackedDeviceClass
+	alignas(IPC_SHMRING_CACHELINE_SIZE) PoseTapSlot slots[IPC_POSETAP_CAPACITY];
+
+	void init() {
+		for (auto& slot : slots) {
+			slot.sequence.store(0, std::memory_order_relaxed);
+		}
+		deviceClass.store(0, std::memory_order_relaxed);
+		writeCount.store(0, std::memory_order_release);
+	}
+
+	// Writer side
+	void write(const PoseTapSample& sample) {
+		auto n = writeCount.load(std::memory_order_relaxed);
+		auto& slot = slots[n & (IPC_POSETAP_CAPACITY - 1)];
+		slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.sample = sample;
+		slot.sequence.store(2 * n + 2, std::memory_order_release);
+		writeCount.store(n + 1, std::memory_order_release);
+	}
+
+	// Reader side. Returns false when sample n was already overwritten (or is being overwritten right now).
+	bool read(uint32_t n, PoseTapSample& sample) const {
+		auto& slot = slots[n & (IPC_POSETAP_CAPACITY - 1)];
+		auto seq = slot.sequence.load(std::memory_order_acquire);
+		if (seq != 2 * n + 2) {
+			return false;
+		}
+		sample = slot.sample;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == seq;
+	}
+};
+
+
+// Shared memory layout of the pose tap, created by the driver
+struct PoseTap {
+	uint32_t version;
+	uint32_t deviceCount;
+	PoseTapDeviceRing devices[IPC_POSETAP_DEVICECOUNT];
+
+	void init() {
+		version = IPC_POSETAP_VERSION;
+		deviceCount = IPC_POSETAP_DEVICECOUNT;
+		for (auto& device : devices) {
+			device.init();
+		}
+	}
+};
+
+
+typedef ShmSegment<PoseTap> PoseTapSegment;
+
+static const char* const poseTapName = "driver_vrwalkinplace.pose_tap";
+
+
+} // end namespace ipc
+} // end namespace vrwalkinplace
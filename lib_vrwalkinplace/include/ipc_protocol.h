@@ -2,9 +2,15 @@
 
 #include "vrwalkinplace_types.h"
 #include <utility>
+#include <chrono>
+#include <stddef.h>
+#include <string.h>
 
 
-#define IPC_PROTOCOL_VERSION 1
+#define IPC_PROTOCOL_VERSION 10
+
+#define IPC_CLIENT_HEARTBEAT_INTERVAL_MS 2000 // clients ping at least this often, any other request renews the lease as well
+#define IPC_CLIENT_LEASE_TIMEOUT_MS 10000 // the driver drops clients that stay silent for longer
 
 namespace vrwalkinplace {
 namespace ipc {
@@ -21,12 +27,15 @@ enum class RequestType : uint32_t {
 	OpenVR_PoseUpdate,
 	OpenVR_ButtonEvent,
 	OpenVR_AxisEvent,
+	OpenVR_EventBatch,
 	OpenVR_DeviceAdded,
 
 	WalkInPlace_GetDeviceInfo,
 	WalkInPlace_DefaultMode,
 	WalkInPlace_StepDetectionMode,
-	WalkInPlace_StepDetect
+	WalkInPlace_StepDetect,
+	WalkInPlace_LocomotionBinding,
+	WalkInPlace_LocomotionIntent
 };
 
 
@@ -43,6 +52,23 @@ enum class ReplyType : uint32_t {
 };
 
 
+// How OpenVR_* event requests travel from client to server (control requests always use the message queue)
+enum class TransportType : uint32_t {
+	MessageQueue,
+	ShmRing
+};
+
+
+// Lanes of the server message queue. The value is the message priority, boost delivers every queued
+// movement request before the next control request. A heartbeat stuck behind movement traffic does not
+// cost the client its lease, the driver renews it for every request and every shm channel drain.
+enum class RequestLane : uint32_t {
+	Control,	// connect, disconnect, ping, step detection configuration and status
+	Movement,	// button, axis and locomotion updates that move the player
+	Count
+};
+
+
 enum class ReplyStatus : uint32_t {
 	None,
 	Ok,
@@ -61,6 +87,7 @@ struct Request_IPC_ClientConnect {
 	uint32_t messageId;
 	uint32_t ipcProcotolVersion;
 	char queueName[128];
+	TransportType transportType; // ShmRing: the client created the channel segment "<queueName>.channel"
 };
 
 
@@ -100,6 +127,25 @@ struct Request_OpenVR_AxisEvent {
 		vr::VRControllerAxis_t axisState;
 };
 
+// Small enough that a batch is not the largest member of the Request union (see the static_assert below Request),
+// one tick of movement is 2-3 events. Longer batches are sent as several requests.
+#define REQUEST_OPENVR_EVENTBATCH_MAXCOUNT 3
+
+// One entry of an event batch, type is either OpenVR_ButtonEvent or OpenVR_AxisEvent
+struct Request_OpenVR_BatchedEvent {
+	RequestType type;
+	union {
+		Request_OpenVR_ButtonEvent buttonEvent;
+		Request_OpenVR_AxisEvent axisEvent;
+	};
+};
+
+// Button and axis events (possibly for several devices) that the driver applies in order and in one pass
+struct Request_OpenVR_EventBatch {
+	uint32_t eventCount; // at most REQUEST_OPENVR_EVENTBATCH_MAXCOUNT
+	Request_OpenVR_BatchedEvent events[REQUEST_OPENVR_EVENTBATCH_MAXCOUNT];
+};
+
 struct Request_OpenVR_DeviceAdded {
 	uint32_t deviceId;
 };
@@ -111,6 +157,22 @@ struct Request_OpenVR_VendorSpecificEvent {
 	double timeOffset;
 };
 
+// How the driver turns locomotion intents into input component updates (e.g. touchpad vs. joystick)
+struct Request_WalkInPlace_LocomotionBinding {
+	uint32_t axisId;
+	vr::EVRButtonId buttonId; // touched while moving, pressed according to pressMode
+	LocomotionPressMode pressMode;
+};
+
+// Desired movement of a device, the driver keeps applying it until the next intent
+struct Request_WalkInPlace_LocomotionIntent {
+	uint32_t deviceId;
+	LocomotionGait gait; // Stopped releases all bound components
+	float speed;
+	vr::HmdVector2_t direction; // axis value is speed * direction (x: strafe, y: forward)
+	float rampTime; // seconds the driver takes to move the axis from its current value to the new one, Stopped releases after the ramp
+};
+
 struct Request_WalkInPlace_StepDetect {
 	uint32_t clientId;
 	uint32_t messageId; // Used to associate with Reply
@@ -119,40 +181,70 @@ struct Request_WalkInPlace_StepDetect {
 struct Request_WalkInPlace_StepDetectionMode {
 	uint32_t clientId;
 	uint32_t messageId; // Used to associate with Reply
-	uint32_t deviceId;
 	uint32_t enableStepDetect;
-	uint32_t useEulerForStep;
-	uint32_t stepDetectOperation;
+	uint32_t useTrackers;
+	uint32_t disableHMD;
+	uint32_t hmdType; // 0 .. use reported hmd velocity, else differentiate positions
+	uint32_t controlSelect; // 0 .. first controller, 1 .. second controller
+	uint32_t scaleTouchWithSwing;
+	uint32_t useContDirForStraf;
+	uint32_t useContDirForRev;
 	vr::HmdVector3d_t hmdThreshold;
+	vr::HmdVector3d_t trackerThreshold;
 	float handJogThreshold;
 	float handRunThreshold;
 	float walkTouch;
 	float jogTouch;
 	float runTouch;
-	float stepAcceleration;
-	float stepSpeed;
 	float stepIntSec;
 	int gameStepType;
-	int useAccuracyButton;
-	bool useButtonAsToggle;
-	bool flipButtonUse;
-	int controlSelect;
+};
+
+
+// steady clock in microseconds, comparable between processes on the same machine
+inline int64_t monotonicTimeUs() {
+	return std::chrono::duration_cast <std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Send-to-dispatch latency of ipc messages in microseconds
+struct LatencyStats {
+	uint64_t count = 0;
+	int64_t sumUs = 0;
+	int64_t minUs = 0;
+	int64_t maxUs = 0;
+
+	void add(int64_t sendTime) {
+		auto latency = monotonicTimeUs() - sendTime;
+		if (count == 0 || latency < minUs) {
+			minUs = latency;
+		}
+		if (count == 0 || latency > maxUs) {
+			maxUs = latency;
+		}
+		sumUs += latency;
+		count++;
+	}
+
+	int64_t averageUs() const {
+		return count > 0 ? sumUs / (int64_t)count : 0;
+	}
 };
 
 
 struct Request {
 	Request() {}
-	Request(RequestType type) : type(type) {
-		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	}
-	Request(RequestType type, uint64_t timestamp) : type(type), timestamp(timestamp) {}
+	Request(RequestType type) : type(type), sendTime(monotonicTimeUs()) {}
+	Request(RequestType type, uint64_t timestamp) : type(type), timestamp(timestamp), sendTime(monotonicTimeUs()) {}
 
 	void refreshTimestamp() {
-		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		sendTime = monotonicTimeUs();
 	}
 
+	// The connect request is sent as a ConnectRequest, everything else as frames (see ipc_frame.h)
 	RequestType type = RequestType::None;
-	int64_t timestamp = 0; // milliseconds since epoch
+	int64_t timestamp = 0; // milliseconds since epoch, not used by the driver (and not sent in frames)
+	int64_t sendTime = 0; // monotonicTimeUs()
 	union {
 		Request_IPC_ClientConnect ipc_ClientConnect;
 		Request_IPC_ClientDisconnect ipc_ClientDisconnect;
@@ -160,17 +252,37 @@ struct Request {
 		Request_OpenVR_PoseUpdate ipc_PoseUpdate;
 		Request_OpenVR_ButtonEvent ipc_ButtonEvent;
 		Request_OpenVR_AxisEvent ipc_AxisEvent;
+		Request_OpenVR_EventBatch ipc_EventBatch;
 		Request_OpenVR_DeviceAdded ipc_DeviceAdded;
 		Request_WalkInPlace_StepDetectionMode dm_StepDetectionMode;
 		Request_WalkInPlace_StepDetect dm_StepDetect;
+		Request_WalkInPlace_LocomotionBinding wip_LocomotionBinding;
+		Request_WalkInPlace_LocomotionIntent wip_LocomotionIntent;
 	} msg;
 };
 
+static_assert(sizeof(Request_OpenVR_EventBatch) <= sizeof(Request_WalkInPlace_StepDetectionMode), "Event batches must not grow the Request union");
+
+
+inline RequestLane requestLane(RequestType type) {
+	switch (type) {
+	case RequestType::OpenVR_ButtonEvent:
+	case RequestType::OpenVR_AxisEvent:
+	case RequestType::OpenVR_EventBatch:
+	case RequestType::WalkInPlace_LocomotionBinding:
+	case RequestType::WalkInPlace_LocomotionIntent:
+		return RequestLane::Movement;
+	default:
+		return RequestLane::Control;
+	}
+}
+
 
 
 struct Reply_IPC_ClientConnect {
 	uint32_t clientId;
 	uint32_t ipcProcotolVersion;
+	TransportType transportType; // transport accepted by the server
 };
 
 struct Reply_IPC_Ping {
@@ -186,18 +298,22 @@ struct Reply_WalkInPlace_GetDeviceInfo {
 
 struct Reply_WalkInPlace_StepDetect {
 	bool stepDetected;
+	bool trackerStepDetected;
+	LocomotionGait gait;
+	uint32_t deviceId;
 };
 
 
 struct Reply {
 	Reply() {}
-	Reply(ReplyType type) : type(type) {
+	Reply(ReplyType type) : type(type), sendTime(monotonicTimeUs()) {
 		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 	}
-	Reply(ReplyType type, uint64_t timestamp) : type(type), timestamp(timestamp) {}
+	Reply(ReplyType type, uint64_t timestamp) : type(type), timestamp(timestamp), sendTime(monotonicTimeUs()) {}
 
 	ReplyType type = ReplyType::None;
 	uint64_t timestamp = 0; // milliseconds since epoch
+	int64_t sendTime = 0; // monotonicTimeUs()
 	uint32_t messageId;
 	ReplyStatus status;
 	union {
@@ -209,5 +325,70 @@ struct Reply {
 };
 
 
+/**
+* Wire layout of the connect request and its reply, frozen at the plain Request (152 bytes) and Reply (40 bytes) of
+* IPC_PROTOCOL_VERSION 1. The connect is the only message that a driver and a client of different versions exchange,
+* so both always understand it: the receiver reads the sender's protocol version and answers with InvalidVersion in a
+* message that fits the sender's queue. Fields added since version 1 only use what was padding then.
+*/
+struct ConnectRequest {
+	ConnectRequest() {}
+	explicit ConnectRequest(const Request& message) : type(message.type), transportType(message.msg.ipc_ClientConnect.transportType),
+			timestamp(message.timestamp), messageId(message.msg.ipc_ClientConnect.messageId), ipcProcotolVersion(message.msg.ipc_ClientConnect.ipcProcotolVersion) {
+		memcpy(queueName, message.msg.ipc_ClientConnect.queueName, sizeof(queueName));
+	}
+
+	Request request() const {
+		Request message(type, timestamp);
+		message.msg.ipc_ClientConnect.messageId = messageId;
+		message.msg.ipc_ClientConnect.ipcProcotolVersion = ipcProcotolVersion;
+		memcpy(message.msg.ipc_ClientConnect.queueName, queueName, sizeof(queueName));
+		message.msg.ipc_ClientConnect.transportType = transportType;
+		return message;
+	}
+
+	RequestType type = RequestType::IPC_ClientConnect; // None is the shutdown wakeup of the driver's own queue
+	TransportType transportType = TransportType::MessageQueue; // padding in version 1, only valid when the versions match
+	int64_t timestamp = 0;
+	uint32_t messageId = 0;
+	uint32_t ipcProcotolVersion = 0;
+	char queueName[128] = {};
+};
+
+struct ConnectReply {
+	ConnectReply() {}
+	explicit ConnectReply(const Reply& reply) : type(reply.type), timestamp(reply.timestamp), messageId(reply.messageId), status(reply.status),
+			clientId(reply.msg.ipc_ClientConnect.clientId), ipcProcotolVersion(reply.msg.ipc_ClientConnect.ipcProcotolVersion),
+			transportType(reply.msg.ipc_ClientConnect.transportType) {}
+
+	Reply reply() const {
+		Reply message(type, timestamp);
+		message.messageId = messageId;
+		message.status = status;
+		message.msg.ipc_ClientConnect.clientId = clientId;
+		message.msg.ipc_ClientConnect.ipcProcotolVersion = ipcProcotolVersion;
+		message.msg.ipc_ClientConnect.transportType = transportType;
+		return message;
+	}
+
+	ReplyType type = ReplyType::IPC_ClientConnect;
+	uint32_t reserved = 0;
+	uint64_t timestamp = 0;
+	uint32_t messageId = 0;
+	ReplyStatus status = ReplyStatus::None;
+	uint32_t clientId = 0;
+	uint32_t ipcProcotolVersion = 0;
+	TransportType transportType = TransportType::MessageQueue; // unused union bytes in version 1
+	uint32_t reserved2 = 0;
+};
+
+static_assert((uint32_t)RequestType::IPC_ClientConnect == 1 && (uint32_t)ReplyType::IPC_ClientConnect == 1
+	&& (uint32_t)ReplyStatus::Ok == 1 && (uint32_t)ReplyStatus::InvalidVersion == 8, "Connect values must keep their version 1 values");
+static_assert(sizeof(ConnectRequest) == 152 && offsetof(ConnectRequest, messageId) == 16 && offsetof(ConnectRequest, ipcProcotolVersion) == 20
+	&& offsetof(ConnectRequest, queueName) == 24, "ConnectRequest must keep the layout of version 1");
+static_assert(sizeof(ConnectReply) == 40 && offsetof(ConnectReply, messageId) == 16 && offsetof(ConnectReply, status) == 20
+	&& offsetof(ConnectReply, clientId) == 24 && offsetof(ConnectReply, ipcProcotolVersion) == 28, "ConnectReply must keep the layout of version 1");
+
+
 } // end namespace ipc
 } // end namespace vrwalkinplace
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <type_traits>
+#include <stdexcept>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/named_semaphore.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <ipc_protocol.h>
+#include <ipc_frame.h>
+
+
+namespace vrwalkinplace {
+namespace ipc {
+
+
+#define IPC_SHMRING_CACHELINE_SIZE 64
+
+
+/**
+* Single-producer/single-consumer ring buffer that lives in a shared memory segment.
+*
+* head is only written by the consumer, tail only by the producer, each on its own cache line.
+* Wakeup works futex-style: a consumer that wants to sleep sets consumerSleeping and re-checks the ring,
+* the producer only touches the (kernel) doorbell semaphore when it sees that flag. So the common case
+* costs two atomic operations and no syscall on either side.
+*/
+template<typename T, uint32_t Capacity>
+struct ShmRing {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static_assert(std::is_trivially_copyable<T>::value, "Ring elements are copied between processes");
+
+	alignas(IPC_SHMRING_CACHELINE_SIZE) std::atomic<uint32_t> head;
+	alignas(IPC_SHMRING_CACHELINE_SIZE) std::atomic<uint32_t> tail;
+	alignas(IPC_SHMRING_CACHELINE_SIZE) std::atomic<uint32_t> consumerSleeping;
+	alignas(IPC_SHMRING_CACHELINE_SIZE) T slots[Capacity];
+
+	void init() {
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+		consumerSleeping.store(0, std::memory_order_release);
+	}
+
+	// Producer side. Returns false when the ring is full.
+	bool tryPush(const T& value) {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) >= Capacity) {
+			return false;
+		}
+		slots[t & (Capacity - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer side, tryPush without the copy of the whole element: fill the returned slot, then publish().
+	// Returns nullptr when the ring is full.
+	T* tryReserve() {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) >= Capacity) {
+			return nullptr;
+		}
+		return &slots[t & (Capacity - 1)];
+	}
+
+	void publish() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Producer side. Returns true when the consumer went to sleep and needs to be woken up.
+	bool consumerNeedsWakeup() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return consumerSleeping.load(std::memory_order_relaxed) != 0 && consumerSleeping.exchange(0) != 0;
+	}
+
+	// Consumer side. Returns false when the ring is empty.
+	bool tryPop(T& value) {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = slots[h & (Capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, tryPop without the copy: the slot stays valid until release(). Returns nullptr when the ring is empty.
+	const T* peek() {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &slots[h & (Capacity - 1)];
+	}
+
+	void release() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Consumer side. Announces that the consumer is about to sleep, returns false when data arrived in the meantime.
+	bool prepareSleep() {
+		consumerSleeping.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire)) {
+			consumerSleeping.store(0, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	void cancelSleep() {
+		consumerSleeping.store(0, std::memory_order_relaxed);
+	}
+
+	uint32_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+};
+
+
+/**
+* Latest-value channel for axis and touch state, one slot per (device, axis).
+*
+* The producer writes a slot under a seqlock (sequence is odd while writing) and sets the device bit in dirtyDevices.
+* The consumer only looks at dirty devices and applies the newest value, older values that it never saw are coalesced.
+*/
+#define IPC_AXISMAILBOX_DEVICECOUNT 64
+#define IPC_AXISMAILBOX_AXISCOUNT 5
+
+struct AxisMailboxSlot {
+	std::atomic<uint32_t> sequence;
+	std::atomic<uint32_t> consumedSequence; // written by the consumer
+	vr::VRControllerAxis_t axisState;
+	uint32_t touchButtonId; // vr::EVRButtonId
+	uint32_t touched;
+};
+
+struct AxisMailboxValue {
+	uint32_t sequence;
+	vr::VRControllerAxis_t axisState;
+	uint32_t touchButtonId;
+	uint32_t touched;
+};
+
+struct AxisMailbox {
+	static_assert(IPC_AXISMAILBOX_DEVICECOUNT <= 64, "dirtyDevices is a 64 bit mask");
+
+	alignas(IPC_SHMRING_CACHELINE_SIZE) std::atomic<uint64_t> dirtyDevices;
+	alignas(IPC_SHMRING_CACHELINE_SIZE) AxisMailboxSlot slots[IPC_AXISMAILBOX_DEVICECOUNT][IPC_AXISMAILBOX_AXISCOUNT];
+
+	void init() {
+		for (auto& device : slots) {
+			for (auto& slot : device) {
+				slot.sequence.store(0, std::memory_order_relaxed);
+				slot.consumedSequence.store(0, std::memory_order_relaxed);
+			}
+		}
+		dirtyDevices.store(0, std::memory_order_release);
+	}
+
+	// Producer side. Returns true when the previous value was never consumed (i.e. it got coalesced).
+	bool write(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& axisState, uint32_t touchButtonId, bool touched) {
+		auto& slot = slots[deviceId][axisId];
+		auto seq = slot.sequence.load(std::memory_order_relaxed);
+		bool coalesced = seq != slot.consumedSequence.load(std::memory_order_relaxed);
+		slot.sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.axisState = axisState;
+		slot.touchButtonId = touchButtonId;
+		slot.touched = touched ? 1 : 0;
+		slot.sequence.store(seq + 2, std::memory_order_release);
+		dirtyDevices.fetch_or((uint64_t)1 << deviceId);
+		return coalesced;
+	}
+
+	// Consumer side. Returns false when the producer is writing this slot right now (the device stays dirty then).
+	bool read(uint32_t deviceId, uint32_t axisId, AxisMailboxValue& value) {
+		auto& slot = slots[deviceId][axisId];
+		auto seq = slot.sequence.load(std::memory_order_acquire);
+		if (seq & 1) {
+			return false;
+		}
+		value.axisState = slot.axisState;
+		value.touchButtonId = slot.touchButtonId;
+		value.touched = slot.touched;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != seq) {
+			return false;
+		}
+		value.sequence = seq;
+		return true;
+	}
+
+	void markDirty(uint32_t deviceId) {
+		dirtyDevices.fetch_or((uint64_t)1 << deviceId);
+	}
+};
+
+
+/**
+* Everything one client shares with the server: the ordered event ring and the axis mailbox.
+* Both use the wakeup flag of the event ring. Each ring slot holds a packet of one or more request frames.
+*/
+#define IPC_SHMRING_PACKET_CAPACITY 256
+
+struct ClientChannel {
+	ShmRing<FramePacket, IPC_SHMRING_PACKET_CAPACITY> events;
+	AxisMailbox axes;
+
+	void init() {
+		events.init();
+		axes.init();
+	}
+
+	// Consumer side, see ShmRing::prepareSleep()
+	bool prepareSleep() {
+		if (!events.prepareSleep()) {
+			return false;
+		}
+		if (axes.dirtyDevices.load(std::memory_order_relaxed) != 0) {
+			events.cancelSleep();
+			return false;
+		}
+		return true;
+	}
+};
+
+
+/**
+* Owns the mapping of one shared memory object. The creator (client) removes the segment again on destruction.
+*/
+template<typename T>
+class ShmSegment {
+public:
+	// Creates a new segment (client side)
+	ShmSegment(boost::interprocess::create_only_t, const std::string& name) : _name(name), _owner(true) {
+		boost::interprocess::shared_memory_object::remove(name.c_str());
+		_shm = boost::interprocess::shared_memory_object(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+		_shm.truncate(sizeof(T));
+		_region = boost::interprocess::mapped_region(_shm, boost::interprocess::read_write);
+		_object = new (_region.get_address()) T;
+		_object->init();
+	}
+
+	// Maps an existing segment (server side)
+	ShmSegment(boost::interprocess::open_only_t, const std::string& name) : _name(name), _owner(false) {
+		_shm = boost::interprocess::shared_memory_object(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_write);
+		_region = boost::interprocess::mapped_region(_shm, boost::interprocess::read_write);
+		if (_region.get_size() < sizeof(T)) {
+			throw std::runtime_error("Shared memory segment has the wrong size");
+		}
+		_object = static_cast<T*>(_region.get_address());
+	}
+
+	// Maps an existing segment without write access (monitoring tools), writing through it faults
+	ShmSegment(boost::interprocess::open_read_only_t, const std::string& name) : _name(name), _owner(false) {
+		_shm = boost::interprocess::shared_memory_object(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_only);
+		_region = boost::interprocess::mapped_region(_shm, boost::interprocess::read_only);
+		if (_region.get_size() < sizeof(T)) {
+			throw std::runtime_error("Shared memory segment has the wrong size");
+		}
+		_object = static_cast<T*>(_region.get_address());
+	}
+
+	~ShmSegment() {
+		if (_owner) {
+			boost::interprocess::shared_memory_object::remove(_name.c_str());
+		}
+	}
+
+	ShmSegment(const ShmSegment&) = delete;
+	ShmSegment& operator=(const ShmSegment&) = delete;
+
+	T* operator->() { return _object; }
+	T& get() { return *_object; }
+	const std::string& name() const { return _name; }
+
+private:
+	std::string _name;
+	bool _owner;
+	boost::interprocess::shared_memory_object _shm;
+	boost::interprocess::mapped_region _region;
+	T* _object = nullptr;
+};
+
+
+typedef ShmSegment<ClientChannel> ClientChannelSegment;
+
+static const char* const shmRingDoorbellName = "driver_vrwalkinplace.server_doorbell";
+static const char* const shmChannelNameSuffix = ".channel";
+
+
+} // end namespace ipc
+} // end namespace vrwalkinplace
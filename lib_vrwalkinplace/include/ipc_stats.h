@@ -0,0 +1,249 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <ipc_shm_ring.h>
+#include <ipc_protocol.h>
+
+
+namespace vrwalkinplace {
+namespace ipc {
+
+
+#define IPC_STATS_VERSION 2
+#define IPC_STATS_REQUESTTYPE_COUNT 32 // > number of RequestType values
+#define IPC_STATS_HISTOGRAM_BUCKETS 24
+
+
+// Transports the driver receives requests on (see TransportType)
+enum StatsTransport : uint32_t {
+	StatsTransport_MessageQueue,
+	StatsTransport_ShmRing,
+	StatsTransport_Count
+};
+
+
+// Plain copy of a StatsHistogram
+struct StatsHistogramSnapshot {
+	uint32_t count = 0;
+	uint32_t sumUs = 0;
+	uint32_t maxUs = 0; // since the driver started
+	uint32_t buckets[IPC_STATS_HISTOGRAM_BUCKETS] = {};
+
+	// Upper bound of bucket n in microseconds, bucket n holds latencies in [2^n - 1, 2^(n+1) - 1)
+	static uint32_t bucketLimitUs(uint32_t n) {
+		return (1u << (n + 1)) - 1;
+	}
+
+	uint32_t averageUs() const {
+		return count > 0 ? sumUs / count : 0;
+	}
+
+	// Upper bucket limit below which the given fraction (0..1) of the values lies
+	uint32_t percentileUs(double fraction) const {
+		uint32_t limit = (uint32_t)(fraction * count);
+		uint32_t sum = 0;
+		for (uint32_t n = 0; n < IPC_STATS_HISTOGRAM_BUCKETS; ++n) {
+			sum += buckets[n];
+			if (sum > limit || (sum == count && sum > 0)) {
+				return bucketLimitUs(n);
+			}
+		}
+		return 0;
+	}
+
+	// Values added between earlier and this snapshot (counters wrap around)
+	StatsHistogramSnapshot since(const StatsHistogramSnapshot& earlier) const {
+		StatsHistogramSnapshot d;
+		d.count = count - earlier.count;
+		d.sumUs = sumUs - earlier.sumUs;
+		d.maxUs = maxUs;
+		for (uint32_t n = 0; n < IPC_STATS_HISTOGRAM_BUCKETS; ++n) {
+			d.buckets[n] = buckets[n] - earlier.buckets[n];
+		}
+		return d;
+	}
+};
+
+
+/**
+* Log2 latency histogram, any number of writers. All counters are 32 bit and wrap around,
+* readers look at the difference between two samples.
+*/
+struct StatsHistogram {
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> sumUs;
+	std::atomic<uint32_t> maxUs;
+	std::atomic<uint32_t> buckets[IPC_STATS_HISTOGRAM_BUCKETS];
+
+	void init() {
+		count.store(0, std::memory_order_relaxed);
+		sumUs.store(0, std::memory_order_relaxed);
+		maxUs.store(0, std::memory_order_relaxed);
+		for (auto& b : buckets) {
+			b.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void add(int64_t us) {
+		uint32_t value = us <= 0 ? 0 : (us >= 0xffffffffll ? 0xffffffffu : (uint32_t)us);
+		uint32_t n = 0;
+		for (uint32_t v = value + 1; v > 1 && n < IPC_STATS_HISTOGRAM_BUCKETS - 1; v >>= 1) {
+			n++;
+		}
+		buckets[n].fetch_add(1, std::memory_order_relaxed);
+		sumUs.fetch_add(value, std::memory_order_relaxed);
+		auto max = maxUs.load(std::memory_order_relaxed);
+		while (value > max && !maxUs.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+		}
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void snapshot(StatsHistogramSnapshot& s) const {
+		s.count = count.load(std::memory_order_relaxed);
+		s.sumUs = sumUs.load(std::memory_order_relaxed);
+		s.maxUs = maxUs.load(std::memory_order_relaxed);
+		for (uint32_t n = 0; n < IPC_STATS_HISTOGRAM_BUCKETS; ++n) {
+			s.buckets[n] = buckets[n].load(std::memory_order_relaxed);
+		}
+	}
+};
+
+
+// Plain copy of the StatsPage, see there
+struct StatsSnapshot {
+	int64_t sampleTimeUs = 0; // monotonicTimeUs() when the snapshot was taken
+	int64_t startTimeUs = 0;
+	uint32_t requests[IPC_STATS_REQUESTTYPE_COUNT] = {};
+	uint32_t messageQueueDepth = 0;
+	uint32_t messageQueueHighWater = 0;
+	uint32_t shmRingDepth = 0;
+	uint32_t shmRingHighWater = 0;
+	uint32_t outputQueueHighWater = 0;
+	uint32_t outputQueueDropped = 0;
+	uint32_t buttonInjections = 0;
+	uint32_t axisInjections = 0;
+	uint32_t injectionErrors = 0;
+	StatsHistogramSnapshot dispatchLatency[StatsTransport_Count];
+	StatsHistogramSnapshot laneLatency[(uint32_t)RequestLane::Count];
+	StatsHistogramSnapshot outputLatency;
+	StatsHistogramSnapshot injectionTime;
+};
+
+
+/**
+* Shared memory statistics page, created and written by the driver, mapped read-only by readers.
+*
+* Everything is a relaxed atomic counter, writers never wait and readers get a slightly torn but
+* monotonic view, which is good enough for rates and latency distributions.
+*/
+struct StatsPage {
+	uint32_t version;
+	uint32_t requestTypeCount;
+	int64_t startTimeUs; // monotonicTimeUs() when the driver created the page
+
+	std::atomic<uint32_t> requests[IPC_STATS_REQUESTTYPE_COUNT]; // received requests by RequestType
+	std::atomic<uint32_t> messageQueueDepth; // messages waiting in the server queue after the last receive
+	std::atomic<uint32_t> messageQueueHighWater;
+	std::atomic<uint32_t> shmRingDepth; // events waiting in a client ring when the driver started draining it
+	std::atomic<uint32_t> shmRingHighWater;
+	std::atomic<uint32_t> outputQueueHighWater; // updates queued for RunFrame
+	std::atomic<uint32_t> outputQueueDropped;
+	std::atomic<uint32_t> buttonInjections; // UpdateBooleanComponent calls
+	std::atomic<uint32_t> axisInjections; // UpdateScalarComponent calls
+	std::atomic<uint32_t> injectionErrors;
+
+	StatsHistogram dispatchLatency[StatsTransport_Count]; // Request::sendTime -> handled by the driver's ipc thread
+	StatsHistogram laneLatency[(uint32_t)RequestLane::Count]; // the same by lane, shm ring events count as movement
+	StatsHistogram outputLatency; // handled by the ipc thread -> applied in RunFrame
+	StatsHistogram injectionTime; // duration of one UpdateBooleanComponent / UpdateScalarComponent call
+
+	void init() {
+		version = IPC_STATS_VERSION;
+		requestTypeCount = IPC_STATS_REQUESTTYPE_COUNT;
+		startTimeUs = monotonicTimeUs();
+		for (auto& r : requests) {
+			r.store(0, std::memory_order_relaxed);
+		}
+		for (auto c : { &messageQueueDepth, &messageQueueHighWater, &shmRingDepth, &shmRingHighWater, &outputQueueHighWater,
+				&outputQueueDropped, &buttonInjections, &axisInjections, &injectionErrors }) {
+			c->store(0, std::memory_order_relaxed);
+		}
+		for (auto& h : dispatchLatency) {
+			h.init();
+		}
+		for (auto& h : laneLatency) {
+			h.init();
+		}
+		outputLatency.init();
+		injectionTime.init();
+	}
+
+	void countRequest(RequestType type) {
+		if ((uint32_t)type < IPC_STATS_REQUESTTYPE_COUNT) {
+			requests[(uint32_t)type].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	static void updateHighWater(std::atomic<uint32_t>& highWater, uint32_t value) {
+		auto current = highWater.load(std::memory_order_relaxed);
+		while (value > current && !highWater.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+		}
+	}
+
+	void snapshot(StatsSnapshot& s) const {
+		s.sampleTimeUs = monotonicTimeUs();
+		s.startTimeUs = startTimeUs;
+		for (uint32_t i = 0; i < IPC_STATS_REQUESTTYPE_COUNT; ++i) {
+			s.requests[i] = requests[i].load(std::memory_order_relaxed);
+		}
+		s.messageQueueDepth = messageQueueDepth.load(std::memory_order_relaxed);
+		s.messageQueueHighWater = messageQueueHighWater.load(std::memory_order_relaxed);
+		s.shmRingDepth = shmRingDepth.load(std::memory_order_relaxed);
+		s.shmRingHighWater = shmRingHighWater.load(std::memory_order_relaxed);
+		s.outputQueueHighWater = outputQueueHighWater.load(std::memory_order_relaxed);
+		s.outputQueueDropped = outputQueueDropped.load(std::memory_order_relaxed);
+		s.buttonInjections = buttonInjections.load(std::memory_order_relaxed);
+		s.axisInjections = axisInjections.load(std::memory_order_relaxed);
+		s.injectionErrors = injectionErrors.load(std::memory_order_relaxed);
+		for (uint32_t t = 0; t < StatsTransport_Count; ++t) {
+			dispatchLatency[t].snapshot(s.dispatchLatency[t]);
+		}
+		for (uint32_t l = 0; l < (uint32_t)RequestLane::Count; ++l) {
+			laneLatency[l].snapshot(s.laneLatency[l]);
+		}
+		outputLatency.snapshot(s.outputLatency);
+		injectionTime.snapshot(s.injectionTime);
+	}
+};
+
+
+inline const char* requestTypeName(RequestType type) {
+	switch (type) {
+	case RequestType::None: return "None";
+	case RequestType::IPC_ClientConnect: return "IPC_ClientConnect";
+	case RequestType::IPC_ClientDisconnect: return "IPC_ClientDisconnect";
+	case RequestType::IPC_Ping: return "IPC_Ping";
+	case RequestType::OpenVR_PoseUpdate: return "OpenVR_PoseUpdate";
+	case RequestType::OpenVR_ButtonEvent: return "OpenVR_ButtonEvent";
+	case RequestType::OpenVR_AxisEvent: return "OpenVR_AxisEvent";
+	case RequestType::OpenVR_EventBatch: return "OpenVR_EventBatch";
+	case RequestType::OpenVR_DeviceAdded: return "OpenVR_DeviceAdded";
+	case RequestType::WalkInPlace_GetDeviceInfo: return "WalkInPlace_GetDeviceInfo";
+	case RequestType::WalkInPlace_DefaultMode: return "WalkInPlace_DefaultMode";
+	case RequestType::WalkInPlace_StepDetectionMode: return "WalkInPlace_StepDetectionMode";
+	case RequestType::WalkInPlace_StepDetect: return "WalkInPlace_StepDetect";
+	case RequestType::WalkInPlace_LocomotionBinding: return "WalkInPlace_LocomotionBinding";
+	case RequestType::WalkInPlace_LocomotionIntent: return "WalkInPlace_LocomotionIntent";
+	default: return "Unknown";
+	}
+}
+
+
+typedef ShmSegment<StatsPage> StatsSegment;
+
+static const char* const statsPageName = "driver_vrwalkinplace.stats";
+
+
+} // end namespace ipc
+} // end namespace vrwalkinplace
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <ipc_protocol.h>
+#include <ipc_frame.h>
+#include <ipc_stats.h>
+
+
+namespace vrwalkinplace {
+namespace ipc {
+
+
+/**
+* Stand-in for the driver's ipc endpoint, so that clients can be exercised and profiled without SteamVR.
+*
+* Serves the same server queue as the driver and the same protocol version, but only offers the message queue
+* transport. Requests that expect a reply are answered with Ok (the step detection status never reports a step),
+* everything else is only counted. Request counts and send-to-dispatch latencies go into a StatsPage that lives
+* in this process.
+*/
+class StubServer {
+public:
+	explicit StubServer(const std::string& queueName = "driver_vrwalkinplace.server_queue") : _queueName(queueName) {
+		_stats.init();
+	}
+
+	~StubServer() {
+		stop();
+	}
+
+	StubServer(const StubServer&) = delete;
+	StubServer& operator=(const StubServer&) = delete;
+
+	/** Creates the server queue (replacing a stale one) and starts serving it. Throws when the queue cannot be created. */
+	void start() {
+		stop();
+		boost::interprocess::message_queue::remove(_queueName.c_str());
+		_queue.reset(new boost::interprocess::message_queue(boost::interprocess::create_only, _queueName.c_str(), 100, _messageSize));
+		_stopFlag = false;
+		_thread = std::thread(&StubServer::_threadFunc, this);
+	}
+
+	void stop() {
+		_stopFlag = true;
+		if (_thread.joinable()) {
+			_thread.join();
+		}
+		if (_queue) {
+			_queue.reset();
+			boost::interprocess::message_queue::remove(_queueName.c_str());
+		}
+	}
+
+	const StatsPage& stats() const {
+		return _stats;
+	}
+
+	uint32_t clientCount() const {
+		return _clientCount.load(std::memory_order_relaxed);
+	}
+
+private:
+	static const size_t _messageSize = sizeof(FramePacket);
+
+	std::string _queueName;
+	std::unique_ptr<boost::interprocess::message_queue> _queue;
+	std::thread _thread;
+	std::atomic<bool> _stopFlag = { true };
+	std::atomic<uint32_t> _clientCount = { 0 };
+	uint32_t _clientIdNext = 1;
+	std::unordered_map<uint32_t, std::shared_ptr<boost::interprocess::message_queue>> _clients; // owned by the thread
+	StatsPage _stats;
+
+	void _threadFunc() {
+		alignas(ConnectRequest) uint8_t buffer[_messageSize];
+		while (!_stopFlag) {
+			try {
+				uint64_t size;
+				unsigned priority;
+				if (!_queue->timed_receive(buffer, sizeof(buffer), size, priority,
+						boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100))) {
+					continue;
+				}
+				auto depth = (uint32_t)_queue->get_num_msg();
+				_stats.messageQueueDepth.store(depth, std::memory_order_relaxed);
+				StatsPage::updateHighWater(_stats.messageQueueHighWater, depth);
+				uint32_t marker = 0;
+				if (size >= sizeof(marker)) {
+					memcpy(&marker, buffer, sizeof(marker));
+				}
+				if (marker == IPC_FRAME_MARKER) {
+					reinterpret_cast<const FramePacket*>(buffer)->forEach(size, [this](const Request& request) { _handle(request); });
+				}
+				else if (size == sizeof(ConnectRequest)) {
+					ConnectRequest request;
+					memcpy(&request, buffer, sizeof(ConnectRequest));
+					if (request.type == RequestType::IPC_ClientConnect) {
+						_handle(request.request());
+					}
+				}
+			}
+			catch (std::exception&) {
+				// a client went away between its request and our reply
+			}
+		}
+		_clients.clear();
+		_clientCount.store(0, std::memory_order_relaxed);
+	}
+
+	void _handle(const Request& request) {
+		auto latencyUs = monotonicTimeUs() - request.sendTime;
+		_stats.countRequest(request.type);
+		_stats.dispatchLatency[StatsTransport_MessageQueue].add(latencyUs);
+		_stats.laneLatency[(uint32_t)requestLane(request.type)].add(latencyUs);
+		switch (request.type) {
+
+		case RequestType::IPC_ClientConnect:
+		{
+			auto& connect = request.msg.ipc_ClientConnect;
+			auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only,
+				std::string(connect.queueName, strnlen(connect.queueName, sizeof(connect.queueName))).c_str());
+			Reply reply(ReplyType::IPC_ClientConnect);
+			reply.messageId = connect.messageId;
+			reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+			reply.msg.ipc_ClientConnect.transportType = TransportType::MessageQueue;
+			if (connect.ipcProcotolVersion == IPC_PROTOCOL_VERSION) {
+				auto clientId = _clientIdNext++;
+				_clients[clientId] = queue;
+				_clientCount.store((uint32_t)_clients.size(), std::memory_order_relaxed);
+				reply.msg.ipc_ClientConnect.clientId = clientId;
+				reply.status = ReplyStatus::Ok;
+			}
+			else {
+				reply.msg.ipc_ClientConnect.clientId = 0;
+				reply.status = ReplyStatus::InvalidVersion;
+			}
+			ConnectReply message(reply);
+			queue->try_send(&message, sizeof(message), 0);
+		}
+		break;
+
+		case RequestType::IPC_ClientDisconnect:
+		{
+			auto client = _clients.find(request.msg.ipc_ClientDisconnect.clientId);
+			if (client != _clients.end()) {
+				auto queue = client->second;
+				_clients.erase(client);
+				_clientCount.store((uint32_t)_clients.size(), std::memory_order_relaxed);
+				_reply(*queue, ReplyType::GenericReply, request.msg.ipc_ClientDisconnect.messageId);
+			}
+		}
+		break;
+
+		case RequestType::IPC_Ping:
+		{
+			auto client = _clients.find(request.msg.ipc_Ping.clientId);
+			if (client != _clients.end()) {
+				Reply reply(ReplyType::IPC_Ping);
+				reply.messageId = request.msg.ipc_Ping.messageId;
+				reply.status = ReplyStatus::Ok;
+				reply.msg.ipc_Ping.nonce = request.msg.ipc_Ping.nonce;
+				if (reply.messageId != 0) {
+					client->second->try_send(&reply, sizeof(Reply), 0);
+				}
+			}
+		}
+		break;
+
+		case RequestType::WalkInPlace_StepDetectionMode:
+		{
+			auto client = _clients.find(request.msg.dm_StepDetectionMode.clientId);
+			if (client != _clients.end()) {
+				_reply(*client->second, ReplyType::GenericReply, request.msg.dm_StepDetectionMode.messageId);
+			}
+		}
+		break;
+
+		case RequestType::WalkInPlace_StepDetect:
+		{
+			auto client = _clients.find(request.msg.dm_StepDetect.clientId);
+			if (client != _clients.end() && request.msg.dm_StepDetect.messageId != 0) {
+				Reply reply(ReplyType::WalkInPlace_StepDetect);
+				reply.messageId = request.msg.dm_StepDetect.messageId;
+				reply.status = ReplyStatus::Ok;
+				reply.msg.dm_stepDetect.stepDetected = false;
+				reply.msg.dm_stepDetect.trackerStepDetected = false;
+				reply.msg.dm_stepDetect.gait = LocomotionGait::Stopped;
+				reply.msg.dm_stepDetect.deviceId = 0;
+				client->second->try_send(&reply, sizeof(Reply), 0);
+			}
+		}
+		break;
+
+		default:
+			break;
+		}
+	}
+
+	static void _reply(boost::interprocess::message_queue& queue, ReplyType type, uint32_t messageId) {
+		if (messageId != 0) {
+			Reply reply(type);
+			reply.messageId = messageId;
+			reply.status = ReplyStatus::Ok;
+			queue.try_send(&reply, sizeof(Reply), 0);
+		}
+	}
+};
+
+
+} // end namespace ipc
+} // end namespace vrwalkinplace
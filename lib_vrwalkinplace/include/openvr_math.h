@@ -151,6 +151,24 @@ namespace vrmath {
 		return q;
 	}
 
+	// Inverse of quaternionFromRotationMatrix(), the translation column is set to position
+	inline vr::HmdMatrix34_t matrixFromQuaternion(const vr::HmdQuaternion_t& q, const vr::HmdVector3d_t& position) {
+		vr::HmdMatrix34_t mat;
+		mat.m[0][0] = (float)(1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+		mat.m[0][1] = (float)(2.0 * (q.x * q.y - q.z * q.w));
+		mat.m[0][2] = (float)(2.0 * (q.x * q.z + q.y * q.w));
+		mat.m[1][0] = (float)(2.0 * (q.x * q.y + q.z * q.w));
+		mat.m[1][1] = (float)(1.0 - 2.0 * (q.x * q.x + q.z * q.z));
+		mat.m[1][2] = (float)(2.0 * (q.y * q.z - q.x * q.w));
+		mat.m[2][0] = (float)(2.0 * (q.x * q.z - q.y * q.w));
+		mat.m[2][1] = (float)(2.0 * (q.y * q.z + q.x * q.w));
+		mat.m[2][2] = (float)(1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+		for (int i = 0; i < 3; ++i) {
+			mat.m[i][3] = (float)position.v[i];
+		}
+		return mat;
+	}
+
 	inline vr::HmdQuaternion_t quaternionConjugate(const vr::HmdQuaternion_t& quat) {
 		return {
 			quat.w,
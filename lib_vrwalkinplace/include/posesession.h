@@ -0,0 +1,386 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+/**
+* Recorded pose sessions (the device poses the step detection saw, for threshold tuning and bug reports).
+*
+* A session file is a header followed by blocks of up to POSESESSION_BLOCK_FRAMES frames. Blocks are stored
+* column by column: first the frame timestamps, then for each device that had a pose in the block its flags
+* and one float column per position/velocity/rotation component. Devices without a pose cost nothing.
+*
+* posesession::Writer buffers one block and appends it when it is full, so a crash loses at most one block.
+* posesession::Reader maps the file and hands out pointers into the mapping, nothing is copied or loaded
+* up front: pages are read on demand while the blocks are walked, multi-hour sessions work fine.
+*/
+
+#define POSESESSION_FILE_VERSION 1
+#define POSESESSION_MAXDEVICES 64
+#define POSESESSION_BLOCK_FRAMES 1024
+
+
+namespace vrwalkinplace {
+namespace posesession {
+
+
+static const char fileMagic[8] = { 'V', 'R', 'W', 'I', 'P', 'P', 'O', 'S' };
+static const uint32_t blockMagic = 0x4b4c4250; // "PBLK"
+
+
+enum SampleFlags : uint8_t {
+	Flag_PoseIsValid = 1,
+	Flag_DeviceIsConnected = 2
+};
+
+
+// One float column per component, in file order
+enum Column : uint32_t {
+	Column_PositionX = 0,
+	Column_PositionY,
+	Column_PositionZ,
+	Column_VelocityX,
+	Column_VelocityY,
+	Column_VelocityZ,
+	Column_RotationW,
+	Column_RotationX,
+	Column_RotationY,
+	Column_RotationZ,
+	Column_Count
+};
+
+
+// Pose of one device as handed to the writer, in the standing tracking space
+struct DeviceSample {
+	uint8_t flags; // SampleFlags, 0 = no pose
+	uint8_t deviceClass; // vr::ETrackedDeviceClass
+	float position[3]; // meters
+	float velocity[3]; // meters per second
+	float rotation[4]; // w, x, y, z
+};
+
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t maxDevices;
+	uint32_t blockFrames;
+	uint32_t reserved;
+	int64_t startTimeMs; // timestamp of the first frame, same clock as the frame times
+};
+
+
+struct BlockHeader {
+	uint32_t magic;
+	uint32_t frameCount;
+	uint64_t deviceMask; // devices that have columns in this block
+	uint64_t byteSize; // including this header
+	uint64_t reserved;
+	uint8_t deviceClass[POSESESSION_MAXDEVICES];
+};
+
+
+// Every column starts at a multiple of 8 bytes
+inline uint64_t columnSize(uint64_t bytes) {
+	return (bytes + 7) & ~(uint64_t)7;
+}
+
+inline uint64_t deviceColumnsSize(uint32_t frameCount) {
+	return columnSize(frameCount) + Column_Count * columnSize(frameCount * sizeof(float));
+}
+
+inline uint64_t blockSize(uint32_t frameCount, uint64_t deviceMask) {
+	uint64_t deviceCount = 0;
+	for (; deviceMask; deviceMask &= deviceMask - 1) {
+		deviceCount++;
+	}
+	return sizeof(BlockHeader) + columnSize(frameCount * sizeof(double)) + deviceCount * deviceColumnsSize(frameCount);
+}
+
+
+class Writer {
+public:
+	~Writer() {
+		try {
+			close();
+		}
+		catch (...) {}
+	}
+
+	void open(const std::string& path) {
+		close();
+		_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!_file) {
+			throw std::runtime_error("Could not open pose session file " + path);
+		}
+		_frameCount = 0;
+		_blockFrames = 0;
+		_deviceMask = 0;
+		_headerWritten = false;
+	}
+
+	bool isOpen() const {
+		return _file.is_open();
+	}
+
+	uint64_t frameCount() const {
+		return _frameCount;
+	}
+
+	/** Adds one frame, devices[i] is the pose of device i. */
+	void append(double timeMs, const DeviceSample* devices, uint32_t deviceCount) {
+		if (!_file.is_open()) {
+			return;
+		}
+		if (!_headerWritten) {
+			FileHeader header = {};
+			memcpy(header.magic, fileMagic, sizeof(fileMagic));
+			header.version = POSESESSION_FILE_VERSION;
+			header.maxDevices = POSESESSION_MAXDEVICES;
+			header.blockFrames = POSESESSION_BLOCK_FRAMES;
+			header.startTimeMs = (int64_t)timeMs;
+			_file.write((const char*)&header, sizeof(header));
+			_headerWritten = true;
+		}
+		if (deviceCount > POSESESSION_MAXDEVICES) {
+			deviceCount = POSESESSION_MAXDEVICES;
+		}
+		auto frame = _blockFrames;
+		_time[frame] = timeMs;
+		for (uint32_t i = 0; i < deviceCount; ++i) {
+			auto& d = devices[i];
+			uint64_t bit = (uint64_t)1 << i;
+			if (d.flags == 0 && !(_deviceMask & bit)) {
+				continue;
+			}
+			auto& c = _devices[i];
+			if (c.flags.empty()) {
+				c.flags.resize(POSESESSION_BLOCK_FRAMES, 0);
+				for (auto& column : c.columns) {
+					column.resize(POSESESSION_BLOCK_FRAMES, 0.0f);
+				}
+			}
+			_deviceMask |= bit;
+			if (d.flags != 0) {
+				_deviceClass[i] = d.deviceClass;
+			}
+			c.flags[frame] = d.flags;
+			const float* values[Column_Count] = { &d.position[0], &d.position[1], &d.position[2], &d.velocity[0], &d.velocity[1], &d.velocity[2],
+				&d.rotation[0], &d.rotation[1], &d.rotation[2], &d.rotation[3] };
+			for (uint32_t k = 0; k < Column_Count; ++k) {
+				c.columns[k][frame] = *values[k];
+			}
+		}
+		_frameCount++;
+		if (++_blockFrames == POSESESSION_BLOCK_FRAMES) {
+			_flushBlock();
+		}
+	}
+
+	/** Appends the partial block and closes the file. */
+	void close() {
+		if (_file.is_open()) {
+			_flushBlock();
+			_file.close();
+		}
+	}
+
+private:
+	struct DeviceColumns {
+		std::vector<uint8_t> flags;
+		std::vector<float> columns[Column_Count];
+	};
+
+	std::ofstream _file;
+	bool _headerWritten = false;
+	uint64_t _frameCount = 0;
+	uint32_t _blockFrames = 0;
+	uint64_t _deviceMask = 0;
+	uint8_t _deviceClass[POSESESSION_MAXDEVICES] = {};
+	double _time[POSESESSION_BLOCK_FRAMES];
+	DeviceColumns _devices[POSESESSION_MAXDEVICES];
+
+	void _writeColumn(const void* data, uint64_t bytes) {
+		static const char padding[8] = {};
+		_file.write((const char*)data, bytes);
+		_file.write(padding, columnSize(bytes) - bytes);
+	}
+
+	void _flushBlock() {
+		if (_blockFrames == 0) {
+			return;
+		}
+		BlockHeader header = {};
+		header.magic = blockMagic;
+		header.frameCount = _blockFrames;
+		header.deviceMask = _deviceMask;
+		header.byteSize = blockSize(_blockFrames, _deviceMask);
+		memcpy(header.deviceClass, _deviceClass, sizeof(_deviceClass));
+		_file.write((const char*)&header, sizeof(header));
+		_writeColumn(_time, _blockFrames * sizeof(double));
+		for (uint32_t i = 0; i < POSESESSION_MAXDEVICES; ++i) {
+			if (_deviceMask & ((uint64_t)1 << i)) {
+				auto& c = _devices[i];
+				_writeColumn(c.flags.data(), _blockFrames);
+				for (auto& column : c.columns) {
+					_writeColumn(column.data(), _blockFrames * sizeof(float));
+				}
+				// frames of the next block in which the device has no pose must read as "no pose"
+				memset(c.flags.data(), 0, c.flags.size());
+			}
+		}
+		_file.flush();
+		if (!_file) {
+			throw std::runtime_error("Could not write pose session file");
+		}
+		_blockFrames = 0;
+		_deviceMask = 0;
+	}
+};
+
+
+/**
+* One block of a mapped session file. Only valid as long as the reader lives.
+*/
+class Block {
+public:
+	Block(const BlockHeader* header) : _header(header) {
+		auto base = (const uint8_t*)header + sizeof(BlockHeader);
+		_time = (const double*)base;
+		base += columnSize(header->frameCount * sizeof(double));
+		for (uint32_t i = 0; i < POSESESSION_MAXDEVICES; ++i) {
+			if (header->deviceMask & ((uint64_t)1 << i)) {
+				_devices[i] = base;
+				base += deviceColumnsSize(header->frameCount);
+			}
+			else {
+				_devices[i] = nullptr;
+			}
+		}
+	}
+
+	uint32_t frameCount() const {
+		return _header->frameCount;
+	}
+
+	const double* time() const {
+		return _time;
+	}
+
+	bool hasDevice(uint32_t deviceId) const {
+		return deviceId < POSESESSION_MAXDEVICES && _devices[deviceId] != nullptr;
+	}
+
+	uint8_t deviceClass(uint32_t deviceId) const {
+		return _header->deviceClass[deviceId];
+	}
+
+	/** SampleFlags per frame, hasDevice() must be true. */
+	const uint8_t* flags(uint32_t deviceId) const {
+		return _devices[deviceId];
+	}
+
+	/** Values of one component per frame, hasDevice() must be true. */
+	const float* column(uint32_t deviceId, Column column) const {
+		return (const float*)(_devices[deviceId] + columnSize(_header->frameCount) + column * columnSize(_header->frameCount * sizeof(float)));
+	}
+
+private:
+	const BlockHeader* _header;
+	const double* _time;
+	const uint8_t* _devices[POSESESSION_MAXDEVICES];
+};
+
+
+class Reader {
+public:
+	explicit Reader(const std::string& path) {
+		try {
+			_mapping = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+			_region = boost::interprocess::mapped_region(_mapping, boost::interprocess::read_only);
+		}
+		catch (boost::interprocess::interprocess_exception& e) {
+			throw std::runtime_error("Could not map pose session file " + path + ": " + e.what());
+		}
+		_region.advise(boost::interprocess::mapped_region::advice_sequential);
+		_data = (const uint8_t*)_region.get_address();
+		_size = _region.get_size();
+		if (_size < sizeof(FileHeader) || memcmp(header().magic, fileMagic, sizeof(fileMagic)) != 0) {
+			throw std::runtime_error("Not a pose session file: " + path);
+		}
+		if (header().version != POSESESSION_FILE_VERSION || header().maxDevices != POSESESSION_MAXDEVICES) {
+			throw std::runtime_error("Unsupported pose session file version " + std::to_string(header().version));
+		}
+	}
+
+	Reader(const Reader&) = delete;
+	Reader& operator=(const Reader&) = delete;
+
+	const FileHeader& header() const {
+		return *(const FileHeader*)_data;
+	}
+
+	uint64_t fileSize() const {
+		return _size;
+	}
+
+	/** True when the last forEachBlock()/blockAt() stopped at an incomplete or damaged block (e.g. the recorder crashed). */
+	bool truncated() const {
+		return _truncated;
+	}
+
+	/** Calls f(const Block&) for each complete block, returns the number of frames. */
+	template<typename F>
+	uint64_t forEachBlock(F f) {
+		uint64_t frames = 0;
+		uint64_t offset = firstBlockOffset();
+		const BlockHeader* header;
+		while ((header = blockAt(offset)) != nullptr) {
+			f(Block(header));
+			frames += header->frameCount;
+			offset += header->byteSize;
+		}
+		return frames;
+	}
+
+	static uint64_t firstBlockOffset() {
+		return sizeof(FileHeader);
+	}
+
+	/**
+	* Pull style access: returns the block at offset (the next one is at offset + byteSize), nullptr at the end
+	* of the file or at an incomplete or damaged block.
+	*/
+	const BlockHeader* blockAt(uint64_t offset) {
+		_truncated = false;
+		if (offset >= _size) {
+			return nullptr;
+		}
+		auto header = (const BlockHeader*)(_data + offset);
+		if (_size - offset < sizeof(BlockHeader) || header->magic != blockMagic || header->frameCount == 0
+				|| header->frameCount > POSESESSION_BLOCK_FRAMES || header->byteSize != blockSize(header->frameCount, header->deviceMask)
+				|| header->byteSize > _size - offset) {
+			_truncated = true;
+			return nullptr;
+		}
+		return header;
+	}
+
+private:
+	boost::interprocess::file_mapping _mapping;
+	boost::interprocess::mapped_region _region;
+	const uint8_t* _data = nullptr;
+	uint64_t _size = 0;
+	bool _truncated = false;
+};
+
+
+} // end namespace posesession
+} // end namespace vrwalkinplace
@@ -4,6 +4,8 @@
 #include <string>
 #include <future>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <thread>
 #include <map>
 #include <memory>
@@ -83,6 +85,9 @@ namespace vr {
 
 
 #include <ipc_protocol.h>
+#include <ipc_shm_ring.h>
+#include <ipc_pose_tap.h>
+#include <ipc_stats.h>
 
 
 namespace vrwalkinplace {
@@ -128,24 +133,71 @@ struct VirtualDeviceInfo {
 };
 
 
+// Counters of the non-blocking event channel
+struct EventChannelStats {
+	uint64_t dropped = 0; // button/axis events not sent because the server did not keep up
+	uint64_t coalesced = 0; // axis states that were overwritten before the driver applied them
+};
+
+
+// Maximum number of requests that can wait for a reply at the same time (power of two)
+#define IPC_REPLY_SLOT_COUNT 64
+
+// The driver answers every heartbeat, a connection without any reply for this long is considered lost
+#define IPC_CLIENT_CONNECTION_LOST_MS (2 * IPC_CLIENT_HEARTBEAT_INTERVAL_MS)
+
+// pollStepDetectionStatus() asks the driver at most this often
+#define IPC_STEPDETECT_POLL_INTERVAL_MS 100
+
+
 class VRWalkInPlace {
 public:
 	VRWalkInPlace(const std::string& driverQueue = "driver_vrwalkinplace.server_queue", const std::string& clientQueue = "driver_vrwalkinplace.client_queue.");
 	~VRWalkInPlace();
 	
-	void connect();
+	// transport is only a preference, the message queue is used when the server does not support the shared memory ring
+	void connect(ipc::TransportType transport = ipc::TransportType::ShmRing);
 	bool isConnected() const;
-	void disconnect();
+	// Set by the ipc thread when the driver stopped answering heartbeats, never blocks (disconnect and connect again)
+	bool connectionLost() const { return _ipcConnectionLost.load(std::memory_order_acquire); }
+	ipc::TransportType transportType() const { return _ipcTransport; }
+	// notifyServer = false drops the connection without the ClientDisconnect round trip (e.g. when the server is known to be gone)
+	void disconnect(bool notifyServer = true);
 
 	void ping(bool modal = true, bool enableReply = false);
 
+	// Latency between the server sending a reply and this client dispatching it
+	ipc::LatencyStats ipcReplyLatency();
+
 	void openvrDeviceAdded(uint32_t deviceId);
 	void openvrUpdatePose(uint32_t deviceId, bool flipYaw);
 	void openvrButtonEvent(ButtonEventType eventType, uint32_t deviceId, vr::EVRButtonId buttonId, double timeOffset = 0.0);
 	void openvrAxisEvent(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& axisState);
+	// Latest-value axis and touch state: the driver only applies the newest state per (device, axis) and touch changes
+	// are sent as button events. Events collected in an open batch are sent first to keep their order.
+	void openvrAxisState(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& axisState, vr::EVRButtonId touchButtonId, bool touched);
+	const EventChannelStats& eventChannelStats() const { return _eventChannelStats; }
+
+	// The driver keeps applying the last intent per device until the next one, so only send changes.
+	// Both return false when the request was dropped because the driver did not keep up (retry later).
+	bool setLocomotionBinding(uint32_t axisId, vr::EVRButtonId buttonId, LocomotionPressMode pressMode);
+	bool sendLocomotionIntent(uint32_t deviceId, LocomotionGait gait, float speed, const vr::HmdVector2_t& direction, float rampTime = 0.0f);
+
+	// Step detection inside the driver. clientId and messageId of mode are filled in here.
+	// The driver applies the detected movement itself, the status tells what it currently detects.
+	void setStepDetectionMode(const ipc::Request_WalkInPlace_StepDetectionMode& mode);
+	ipc::Reply_WalkInPlace_StepDetect getStepDetectionStatus();
+	// Never blocks: asks for a new status every IPC_STEPDETECT_POLL_INTERVAL_MS and returns the newest one that
+	// arrived. Returns false while none did since connect().
+	bool pollStepDetectionStatus(ipc::Reply_WalkInPlace_StepDetect& status);
+
+	// Between beginBatch() and commit() button and axis events and locomotion updates are collected and sent as one
+	// packet that the driver applies in a single pass. A full packet is sent early and a new one is started.
+	void beginBatch();
+	void commit();
+	bool isBatching() const { return _batchActive; }
 
 private:
-	std::recursive_mutex _mutex;
 	uint32_t m_clientId = 0;
 
 	bool _ipcThreadRunning = false;
@@ -153,20 +205,105 @@ private:
 	std::thread _ipcThread;
 	static void _ipcThreadFunc(VRWalkInPlace* _this);
 
-	std::random_device _ipcRandomDevice;
-	std::uniform_int_distribution<uint32_t> _ipcRandomDist;
-	struct _ipcPromiseMapEntry {
-		_ipcPromiseMapEntry() : isValid(false) {}
-		_ipcPromiseMapEntry(std::promise<ipc::Reply>&& _promise, bool isValid = true) 
-				: promise(std::move(_promise)), isValid(isValid) {}
-		bool isValid;
-		std::promise<ipc::Reply> promise;
+	// Pending replies live in a fixed slot array indexed by messageId. Message ids increase monotonically (0 means no reply).
+	// A slot's state word is (messageId << 32 | _ipcReplySlotState) so that a late reply can never complete a reused slot.
+	enum _ipcReplySlotState : uint32_t {
+		Free = 0,
+		Pending, // a thread waits in _ipcWaitForReply
+		Writing, // the ipc thread copies the reply
+		Ready,
+		Discard // nobody waits, the reply is dropped and the slot can be reused at any time
+	};
+	struct _ipcReplySlot {
+		std::atomic<uint64_t> state;
+		ipc::Reply reply;
 	};
-	std::map<uint32_t, _ipcPromiseMapEntry> _ipcPromiseMap;
+	_ipcReplySlot _ipcReplySlots[IPC_REPLY_SLOT_COUNT];
+	std::atomic<uint32_t> _ipcNextMessageId;
+	std::mutex _ipcReplyMutex; // only needed to sleep on _ipcReplyCondition and for _ipcReplyLatency
+	std::condition_variable _ipcReplyCondition;
+	ipc::LatencyStats _ipcReplyLatency;
+	uint32_t _ipcAcquireReplySlot(bool discardReply = false);
+	void _ipcCompleteReply(const ipc::Reply& reply);
+	void _ipcResetReplySlots();
 	std::string _ipcServerQueueName;
+	std::string _ipcClientQueuePrefix;
 	std::string _ipcClientQueueName;
+	// How long modal requests wait for a reply before the connection is considered dead
+	std::chrono::milliseconds _ipcReplyTimeout = std::chrono::milliseconds(2000);
+	void _ipcSend(const ipc::Request& message);
+	bool _ipcSendEvent(const ipc::Request& message);
+	bool _ipcSendPacket(const ipc::FramePacket& packet);
+	ipc::Reply _ipcClientConnect(ipc::TransportType transport);
+	ipc::Reply _ipcWaitForReply(uint32_t messageId);
+	ipc::Reply _ipcSendAndWaitForReply(const ipc::Request& message, uint32_t messageId);
+	void _ipcCloseQueues();
+	void _ipcHeartbeat();
+	std::atomic<uint32_t> _ipcHeartbeatClientId = { 0 }; // set while connected
+	int64_t _ipcLastHeartbeatUs = 0; // ipc thread only
+	int64_t _ipcLastReplyUs = 0; // ipc thread only
+	std::atomic<bool> _ipcConnectionLost = { false };
+	std::mutex _stepDetectionStatusMutex;
+	ipc::Reply_WalkInPlace_StepDetect _stepDetectionStatus; // newest reply, written by the ipc thread
+	bool _stepDetectionStatusValid = false;
+	int64_t _stepDetectionPollUs = 0;
 	boost::interprocess::message_queue* _ipcServerQueue = nullptr;
 	boost::interprocess::message_queue* _ipcClientQueue = nullptr;
+	ipc::TransportType _ipcTransport = ipc::TransportType::MessageQueue;
+	std::unique_ptr<ipc::ClientChannelSegment> _ipcChannel;
+	EventChannelStats _eventChannelStats;
+	std::unique_ptr<boost::interprocess::named_semaphore> _ipcRingDoorbell;
+
+	// Events between beginBatch() and commit() are packed into _batchPacket
+	bool _batchActive = false;
+	ipc::FramePacket _batchPacket;
+	void _batchFlush();
+};
+
+
+/**
+* Reads every pose sample the driver reported (see ipc_pose_tap.h) instead of polling snapshots.
+* Independent of the VRWalkInPlace connection; each reader keeps its own read position per device.
+*/
+class PoseTapReader {
+public:
+	// Throws vrwalkinplace_connectionerror when the driver is not running, vrwalkinplace_invalidversion on a layout mismatch.
+	// Reading starts with the newest sample of each device.
+	void open();
+	void close();
+	bool isOpen() const { return (bool)_segment; }
+
+	// Copies the samples of a device reported since the last call, oldest first. Returns the number of copied samples.
+	// lost counts samples that were overwritten before they could be read (the reader fell more than
+	// IPC_POSETAP_CAPACITY samples behind) or that did not fit into samples.
+	uint32_t read(uint32_t deviceId, ipc::PoseTapSample* samples, uint32_t maxCount, uint32_t* lost = nullptr);
+
+	// Newest sample of a device, returns false when there is none
+	bool latest(uint32_t deviceId, ipc::PoseTapSample& sample);
+
+	vr::ETrackedDeviceClass deviceClass(uint32_t deviceId);
+
+private:
+	std::unique_ptr<ipc::PoseTapSegment> _segment;
+	uint32_t _readCount[IPC_POSETAP_DEVICECOUNT];
+};
+
+
+/**
+* Samples the driver's statistics page (see ipc_stats.h), mapped read-only.
+* Independent of the VRWalkInPlace connection. Counters wrap around, compare two samples to get rates.
+*/
+class StatsReader {
+public:
+	// Throws vrwalkinplace_connectionerror when the driver is not running, vrwalkinplace_invalidversion on a layout mismatch.
+	void open();
+	void close();
+	bool isOpen() const { return (bool)_segment; }
+
+	void sample(ipc::StatsSnapshot& snapshot);
+
+private:
+	std::unique_ptr<ipc::StatsSegment> _segment;
 };
 
 } // end namespace vrwalkinplace
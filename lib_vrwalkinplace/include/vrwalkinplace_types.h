@@ -10,6 +10,7 @@ namespace vrwalkinplace {
 	static const char* const vrsettings_overrideHmdModel_string = "overrideHmdModel";
 	static const char* const vrsettings_overrideHmdTrackingSystem_string = "overrideHmdTrackingSystem";
 	static const char* const vrsettings_genericTrackerFakeController_bool = "genericTrackerFakeController";
+	static const char* const vrsettings_propertyOverrides_string = "propertyOverrides";
 
 	enum class VirtualDeviceType : uint32_t {
 		None = 0,
@@ -26,6 +27,22 @@ namespace vrwalkinplace {
 	};
 
 
+	enum class LocomotionGait : uint32_t {
+		Stopped = 0,
+		Walk = 1,
+		Jog = 2,
+		Run = 3
+	};
+
+
+	// When the bound button gets pressed (clicked) while moving
+	enum class LocomotionPressMode : uint32_t {
+		Never = 0,
+		OnRun = 1,
+		Always = 2
+	};
+
+
 	enum class DevicePropertyValueType : uint32_t {
 		None = 0,
 		FLOAT = 1,
@@ -25,24 +25,26 @@ namespace vrwalkinplace {
 				ipc::Reply message;
 				uint64_t recv_size;
 				unsigned priority;
-				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-				if (_this->_ipcClientQueue->timed_receive(&message, sizeof(ipc::Reply), recv_size, priority, timeout)) {
-					if (recv_size == sizeof(ipc::Reply)) {
-						std::lock_guard<std::recursive_mutex> lock(_this->_mutex);
-						auto i = _this->_ipcPromiseMap.find(message.messageId);
-						if (i != _this->_ipcPromiseMap.end()) {
-							if (i->second.isValid) {
-								i->second.promise.set_value(message);
-							}
-							else {
-								_this->_ipcPromiseMap.erase(i); // nobody wants it, so we delete it
-							}
-						}
-					}
+				// Blocks until a reply arrives, _ipcCloseQueues() posts a wakeup message or the next heartbeat is due
+				auto received = _this->_ipcClientQueue->timed_receive(&message, sizeof(ipc::Reply), recv_size, priority,
+					boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(IPC_CLIENT_HEARTBEAT_INTERVAL_MS / 2));
+				if (received && message.type != ipc::ReplyType::None) {
+					_this->_ipcLastReplyUs = ipc::monotonicTimeUs();
 				}
-				else {
-					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				if (received && recv_size == sizeof(ipc::Reply) && message.type == ipc::ReplyType::WalkInPlace_StepDetect && message.status == ipc::ReplyStatus::Ok) {
+					std::lock_guard<std::mutex> lock(_this->_stepDetectionStatusMutex);
+					_this->_stepDetectionStatus = message.msg.dm_stepDetect;
+					_this->_stepDetectionStatusValid = true;
+				}
+				if (received && recv_size == sizeof(ipc::Reply) && message.type != ipc::ReplyType::None) {
+					_this->_ipcCompleteReply(message);
 				}
+				else if (received && recv_size == sizeof(ipc::ConnectReply)) {
+					ipc::ConnectReply reply;
+					memcpy(&reply, static_cast<const void*>(&message), sizeof(reply));
+					_this->_ipcCompleteReply(reply.reply());
+				}
+				_this->_ipcHeartbeat();
 			}
 			catch (std::exception& ex) {
 				WRITELOG(ERROR, "Exception in ipc receive loop: " << ex.what() << std::endl);
@@ -52,7 +54,10 @@ namespace vrwalkinplace {
 	}
 
 
-	VRWalkInPlace::VRWalkInPlace(const std::string& serverQueue, const std::string& clientQueue) : _ipcServerQueueName(serverQueue), _ipcClientQueueName(clientQueue) {}
+	VRWalkInPlace::VRWalkInPlace(const std::string& serverQueue, const std::string& clientQueue) : _ipcServerQueueName(serverQueue), _ipcClientQueuePrefix(clientQueue) {
+		_ipcNextMessageId = 1;
+		_ipcResetReplySlots();
+	}
 
 	VRWalkInPlace::~VRWalkInPlace() {
 		disconnect();
@@ -62,7 +67,189 @@ namespace vrwalkinplace {
 		return _ipcServerQueue != nullptr;
 	}
 
-	void VRWalkInPlace::connect() {
+	void VRWalkInPlace::_ipcSend(const ipc::Request& message) {
+		// A dead server stops draining its queue, so never block forever on a full queue
+		auto timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(_ipcReplyTimeout.count());
+		bool sent;
+		if (message.type == ipc::RequestType::IPC_ClientConnect) {
+			// not framed, see ipc_frame.h
+			ipc::ConnectRequest connect(message);
+			sent = _ipcServerQueue->timed_send(&connect, sizeof(connect), (unsigned)ipc::requestLane(message.type), timeout);
+		}
+		else {
+			ipc::FramePacket packet;
+			packet.clear(m_clientId);
+			packet.append(message);
+			sent = _ipcServerQueue->timed_send(&packet, packet.byteSize(), (unsigned)ipc::requestLane(message.type), timeout);
+		}
+		if (!sent) {
+			throw vrwalkinplace_connectionerror("Timeout while sending to server.");
+		}
+	}
+
+	// Never blocks the caller (e.g. the overlay tick), events the server cannot take right now are dropped
+	bool VRWalkInPlace::_ipcSendEvent(const ipc::Request& message) {
+		if (_batchActive) {
+			if (!_batchPacket.append(message)) {
+				_batchFlush();
+				_batchPacket.append(message);
+			}
+			return true;
+		}
+		ipc::FramePacket packet;
+		packet.clear(m_clientId);
+		packet.append(message);
+		return _ipcSendPacket(packet);
+	}
+
+	// Copies just the used part of the packet into the queue message or ring slot.
+	bool VRWalkInPlace::_ipcSendPacket(const ipc::FramePacket& packet) {
+		bool sent;
+		if (_ipcTransport != ipc::TransportType::ShmRing) {
+			sent = _ipcServerQueue->try_send(&packet, packet.byteSize(), (unsigned)ipc::RequestLane::Movement);
+		}
+		else {
+			auto& channel = _ipcChannel->get();
+			auto slot = channel.events.tryReserve();
+			sent = slot != nullptr;
+			if (sent) {
+				memcpy(slot, &packet, packet.byteSize());
+				channel.events.publish();
+			}
+			if (channel.events.consumerNeedsWakeup()) {
+				_ipcRingDoorbell->post();
+			}
+		}
+		if (!sent) {
+			_eventChannelStats.dropped += packet.frameCount;
+		}
+		return sent;
+	}
+
+	uint32_t VRWalkInPlace::_ipcAcquireReplySlot(bool discardReply) {
+		for (unsigned tries = 0; tries < IPC_REPLY_SLOT_COUNT; tries++) {
+			auto messageId = _ipcNextMessageId++;
+			if (messageId == 0) {
+				messageId = _ipcNextMessageId++;
+			}
+			auto& slot = _ipcReplySlots[messageId % IPC_REPLY_SLOT_COUNT];
+			auto state = slot.state.load(std::memory_order_relaxed);
+			if ((state & 0xFFFFFFFF) == Free || (state & 0xFFFFFFFF) == Discard) {
+				uint64_t newState = ((uint64_t)messageId << 32) | (discardReply ? Discard : Pending);
+				if (slot.state.compare_exchange_strong(state, newState, std::memory_order_acq_rel)) {
+					return messageId;
+				}
+			}
+		}
+		throw vrwalkinplace_exception("Too many requests waiting for a server reply.");
+	}
+
+	// Called by the ipc thread
+	void VRWalkInPlace::_ipcCompleteReply(const ipc::Reply& reply) {
+		auto& slot = _ipcReplySlots[reply.messageId % IPC_REPLY_SLOT_COUNT];
+		uint64_t pending = ((uint64_t)reply.messageId << 32) | Pending;
+		uint64_t discard = ((uint64_t)reply.messageId << 32) | Discard;
+		if (slot.state.compare_exchange_strong(pending, ((uint64_t)reply.messageId << 32) | Writing, std::memory_order_acquire)) {
+			slot.reply = reply;
+			slot.state.store(((uint64_t)reply.messageId << 32) | Ready, std::memory_order_release);
+		}
+		else {
+			// nobody wants it (anymore)
+			slot.state.compare_exchange_strong(discard, Free, std::memory_order_relaxed);
+		}
+		{
+			std::lock_guard<std::mutex> lock(_ipcReplyMutex);
+			_ipcReplyLatency.add(reply.sendTime);
+		}
+		_ipcReplyCondition.notify_all();
+	}
+
+	ipc::Reply VRWalkInPlace::_ipcWaitForReply(uint32_t messageId) {
+		auto& slot = _ipcReplySlots[messageId % IPC_REPLY_SLOT_COUNT];
+		uint64_t pending = ((uint64_t)messageId << 32) | Pending;
+		uint64_t ready = ((uint64_t)messageId << 32) | Ready;
+		{
+			std::unique_lock<std::mutex> lock(_ipcReplyMutex);
+			_ipcReplyCondition.wait_for(lock, _ipcReplyTimeout, [&]() {
+				return slot.state.load(std::memory_order_acquire) == ready;
+			});
+		}
+		// Give the slot back. When the ipc thread is just writing the reply we still take it.
+		if (!slot.state.compare_exchange_strong(pending, Free, std::memory_order_relaxed)) {
+			while (slot.state.load(std::memory_order_acquire) != ready) {
+				std::this_thread::yield();
+			}
+			ipc::Reply reply = slot.reply;
+			slot.state.store(Free, std::memory_order_release);
+			return reply;
+		}
+		throw vrwalkinplace_connectionerror("Timeout while waiting for server reply.");
+	}
+
+	// Sends a request that carries messageId (from _ipcAcquireReplySlot) and waits for its reply.
+	// The slot is given back when the send fails.
+	ipc::Reply VRWalkInPlace::_ipcSendAndWaitForReply(const ipc::Request& message, uint32_t messageId) {
+		try {
+			_ipcSend(message);
+		}
+		catch (std::exception&) {
+			uint64_t pending = ((uint64_t)messageId << 32) | Pending;
+			_ipcReplySlots[messageId % IPC_REPLY_SLOT_COUNT].state.compare_exchange_strong(pending, Free);
+			throw;
+		}
+		return _ipcWaitForReply(messageId);
+	}
+
+	// Only call when the ipc thread is not running
+	void VRWalkInPlace::_ipcResetReplySlots() {
+		for (auto& slot : _ipcReplySlots) {
+			slot.state.store(Free, std::memory_order_relaxed);
+		}
+	}
+
+	void VRWalkInPlace::_ipcCloseQueues() {
+		// Stop ipc thread
+		_ipcHeartbeatClientId.store(0, std::memory_order_release);
+		if (_ipcThread.joinable()) {
+			_ipcThreadStop = true;
+			// A full queue means the thread is awake anyway
+			ipc::Reply wakeup(ipc::ReplyType::None);
+			_ipcClientQueue->try_send(&wakeup, sizeof(ipc::Reply), 0);
+			_ipcThread.join();
+		}
+		_ipcLastReplyUs = 0;
+		_ipcConnectionLost.store(false, std::memory_order_release);
+		_stepDetectionStatusValid = false;
+		_stepDetectionPollUs = 0;
+		// delete message queues
+		if (_ipcServerQueue) {
+			delete _ipcServerQueue;
+			_ipcServerQueue = nullptr;
+		}
+		if (_ipcClientQueue) {
+			delete _ipcClientQueue;
+			boost::interprocess::message_queue::remove(_ipcClientQueueName.c_str());
+			_ipcClientQueue = nullptr;
+		}
+		_ipcChannel.reset();
+		_ipcRingDoorbell.reset();
+		_ipcTransport = ipc::TransportType::MessageQueue;
+		_batchActive = false;
+		_ipcResetReplySlots();
+	}
+
+	ipc::Reply VRWalkInPlace::_ipcClientConnect(ipc::TransportType transport) {
+		ipc::Request message(ipc::RequestType::IPC_ClientConnect);
+		auto messageId = _ipcAcquireReplySlot();
+		message.msg.ipc_ClientConnect.messageId = messageId;
+		message.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+		strncpy_s(message.msg.ipc_ClientConnect.queueName, _ipcClientQueueName.c_str(), 127);
+		message.msg.ipc_ClientConnect.queueName[127] = '\0';
+		message.msg.ipc_ClientConnect.transportType = transport;
+		return _ipcSendAndWaitForReply(message, messageId);
+	}
+
+	void VRWalkInPlace::connect(ipc::TransportType transport) {
 		if (!_ipcServerQueue) {
 			// Open server-side message queue
 			try {
@@ -76,7 +263,9 @@ namespace vrwalkinplace {
 				throw vrwalkinplace_connectionerror(ss.str());
 			}
 			// Append random number to client queue name (and hopefully no other client uses the same random number)
-			_ipcClientQueueName += std::to_string(_ipcRandomDist(_ipcRandomDevice));
+			std::random_device randomDevice;
+			std::uniform_int_distribution<uint32_t> randomDist;
+			_ipcClientQueueName = _ipcClientQueuePrefix + std::to_string(randomDist(randomDevice));
 			// Open client-side message queue
 			try {
 				boost::interprocess::message_queue::remove(_ipcClientQueueName.c_str());
@@ -95,35 +284,44 @@ namespace vrwalkinplace {
 				ss << "Could not open client-side message queue: " << e.what();
 				throw vrwalkinplace_connectionerror(ss.str());
 			}
+			// Create the shared memory channel for event requests, fall back to the message queue when that fails
+			if (transport == ipc::TransportType::ShmRing) {
+				try {
+					_ipcRingDoorbell.reset(new boost::interprocess::named_semaphore(boost::interprocess::open_only, ipc::shmRingDoorbellName));
+					_ipcChannel.reset(new ipc::ClientChannelSegment(boost::interprocess::create_only, _ipcClientQueueName + ipc::shmChannelNameSuffix));
+				}
+				catch (std::exception& e) {
+					WRITELOG(WARNING, "Could not create shared memory channel, falling back to message queue: " << e.what() << std::endl);
+					_ipcChannel.reset();
+					_ipcRingDoorbell.reset();
+					transport = ipc::TransportType::MessageQueue;
+				}
+			}
 			// Start ipc thread
 			_ipcThreadStop = false;
 			_ipcThread = std::thread(_ipcThreadFunc, this);
 			// Send ClientConnect message to server
-			ipc::Request message(ipc::RequestType::IPC_ClientConnect);
-			auto messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.ipc_ClientConnect.messageId = messageId;
-			message.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
-			strncpy_s(message.msg.ipc_ClientConnect.queueName, _ipcClientQueueName.c_str(), 127);
-			message.msg.ipc_ClientConnect.queueName[127] = '\0';
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+			ipc::Reply resp;
+			try {
+				resp = _ipcClientConnect(transport);
+			}
+			catch (std::exception& e) {
+				_ipcCloseQueues();
+				std::stringstream ss;
+				ss << "Could not connect to server: " << e.what();
+				throw vrwalkinplace_connectionerror(ss.str());
 			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			// Wait for response
-			auto resp = respFuture.get();
 			m_clientId = resp.msg.ipc_ClientConnect.clientId;
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
+			if (resp.status == ipc::ReplyStatus::Ok) {
+				_ipcHeartbeatClientId.store(m_clientId, std::memory_order_release);
+				_ipcTransport = resp.msg.ipc_ClientConnect.transportType;
+				if (_ipcTransport != ipc::TransportType::ShmRing) {
+					_ipcChannel.reset();
+					_ipcRingDoorbell.reset();
+				}
 			}
-			if (resp.status != ipc::ReplyStatus::Ok) {
-				delete _ipcServerQueue;
-				_ipcServerQueue = nullptr;
-				delete _ipcClientQueue;
-				_ipcClientQueue = nullptr;
+			else {
+				_ipcCloseQueues();
 				std::stringstream ss;
 				ss << "Connection rejected by server: ";
 				if (resp.status == ipc::ReplyStatus::InvalidVersion) {
@@ -138,64 +336,59 @@ namespace vrwalkinplace {
 		}
 	}
 
-	void VRWalkInPlace::disconnect() {
-		if (_ipcServerQueue) {
+	void VRWalkInPlace::disconnect(bool notifyServer) {
+		if (_ipcServerQueue && !notifyServer) {
+			m_clientId = 0;
+			_ipcCloseQueues();
+		}
+		else if (_ipcServerQueue) {
 			// Send disconnect message (so the server can free resources)
 			ipc::Request message(ipc::RequestType::IPC_ClientDisconnect);
-			auto messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.ipc_ClientDisconnect.clientId = m_clientId;
-			message.msg.ipc_ClientDisconnect.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			m_clientId = resp.msg.ipc_ClientConnect.clientId;
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			// Stop ipc thread
-			if (_ipcThreadRunning) {
-				_ipcThreadStop = true;
-				_ipcThread.join();
-			}
-			// delete message queues
-			if (_ipcServerQueue) {
-				delete _ipcServerQueue;
-				_ipcServerQueue = nullptr;
+			try {
+				auto messageId = _ipcAcquireReplySlot();
+				message.msg.ipc_ClientDisconnect.clientId = m_clientId;
+				message.msg.ipc_ClientDisconnect.messageId = messageId;
+				_ipcSendAndWaitForReply(message, messageId);
 			}
-			if (_ipcClientQueue) {
-				delete _ipcClientQueue;
-				_ipcClientQueue = nullptr;
+			catch (std::exception& e) {
+				WRITELOG(WARNING, "Error while disconnecting from server: " << e.what() << std::endl);
 			}
+			m_clientId = 0;
+			_ipcCloseQueues();
 		}
 	}
 
+	// Called by the ipc thread. Keeps the lease of our endpoint in the driver alive.
+	void VRWalkInPlace::_ipcHeartbeat() {
+		auto clientId = _ipcHeartbeatClientId.load(std::memory_order_acquire);
+		auto now = ipc::monotonicTimeUs();
+		if (clientId == 0 || now - _ipcLastHeartbeatUs < IPC_CLIENT_HEARTBEAT_INTERVAL_MS * 500ll) {
+			return;
+		}
+		_ipcLastHeartbeatUs = now;
+		// The connect reply was the first reply, every heartbeat since then has been answered unless the driver is gone
+		if (now - _ipcLastReplyUs > IPC_CLIENT_CONNECTION_LOST_MS * 1000ll) {
+			_ipcConnectionLost.store(true, std::memory_order_release);
+		}
+		ipc::Request message(ipc::RequestType::IPC_Ping);
+		message.msg.ipc_Ping.clientId = clientId;
+		message.msg.ipc_Ping.messageId = _ipcAcquireReplySlot(true); // nobody waits, any reply refreshes _ipcLastReplyUs
+		message.msg.ipc_Ping.nonce = (uint64_t)now;
+		ipc::FramePacket packet;
+		packet.clear(clientId);
+		packet.append(message);
+		_ipcServerQueue->try_send(&packet, packet.byteSize(), (unsigned)ipc::RequestLane::Control);
+	}
+
 	void VRWalkInPlace::ping(bool modal, bool enableReply) {
 		if (_ipcServerQueue) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			uint64_t nonce = _ipcRandomDist(_ipcRandomDevice);
 			ipc::Request message(ipc::RequestType::IPC_Ping);
 			message.msg.ipc_Ping.clientId = m_clientId;
-			message.msg.ipc_Ping.messageId = messageId;
-			message.msg.ipc_Ping.nonce = nonce;
+			message.msg.ipc_Ping.nonce = (uint64_t)ipc::monotonicTimeUs();
 			if (modal) {
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
+				auto messageId = _ipcAcquireReplySlot();
+				message.msg.ipc_Ping.messageId = messageId;
+				auto resp = _ipcSendAndWaitForReply(message, messageId);
 				if (resp.status != ipc::ReplyStatus::Ok) {
 					std::stringstream ss;
 					ss << "Error while pinging server: Error code " << (int)resp.status;
@@ -204,14 +397,12 @@ namespace vrwalkinplace {
 			}
 			else {
 				if (enableReply) {
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					message.msg.ipc_Ping.messageId = messageId;
-					_ipcPromiseMap.insert({ messageId, _ipcPromiseMapEntry() });
+					message.msg.ipc_Ping.messageId = _ipcAcquireReplySlot(true);
 				}
 				else {
 					message.msg.ipc_Ping.messageId = 0;
 				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+				_ipcSend(message);
 			}
 		}
 		else {
@@ -223,7 +414,7 @@ namespace vrwalkinplace {
 		if (_ipcServerQueue) {
 			ipc::Request message(ipc::RequestType::OpenVR_DeviceAdded);
 			message.msg.ipc_DeviceAdded.deviceId = deviceId;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcSend(message);
 		}
 		else {
 			throw vrwalkinplace_connectionerror("No active connection.");
@@ -248,7 +439,7 @@ namespace vrwalkinplace {
 			message.msg.ipc_ButtonEvent.deviceId = deviceId;
 			message.msg.ipc_ButtonEvent.buttonId = buttonId;
 			message.msg.ipc_ButtonEvent.timeOffset = timeOffset;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcSendEvent(message);
 		}
 		else {
 			throw vrwalkinplace_connectionerror("No active connection.");
@@ -262,11 +453,286 @@ namespace vrwalkinplace {
 			message.msg.ipc_AxisEvent.deviceId = deviceId;
 			message.msg.ipc_AxisEvent.axisId = axisId;
 			message.msg.ipc_AxisEvent.axisState = axisState;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcSendEvent(message);
+		}
+		else {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+	}
+
+
+	void VRWalkInPlace::openvrAxisState(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& axisState, vr::EVRButtonId touchButtonId, bool touched) {
+		if (!_ipcServerQueue) {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+		if (_ipcTransport == ipc::TransportType::ShmRing && deviceId < IPC_AXISMAILBOX_DEVICECOUNT && axisId < IPC_AXISMAILBOX_AXISCOUNT) {
+			if (_batchActive) {
+				_batchFlush();
+			}
+			auto& channel = _ipcChannel->get();
+			if (channel.axes.write(deviceId, axisId, axisState, touchButtonId, touched)) {
+				_eventChannelStats.coalesced++;
+			}
+			if (channel.events.consumerNeedsWakeup()) {
+				_ipcRingDoorbell->post();
+			}
+		}
+		else if (touched) {
+			// same order the driver uses when applying the mailbox
+			openvrButtonEvent(ButtonEventType::ButtonTouched, deviceId, touchButtonId, 0.0);
+			openvrAxisEvent(deviceId, axisId, axisState);
+		}
+		else {
+			openvrAxisEvent(deviceId, axisId, axisState);
+			openvrButtonEvent(ButtonEventType::ButtonUntouched, deviceId, touchButtonId, 0.0);
+		}
+	}
+
+
+	void VRWalkInPlace::setStepDetectionMode(const ipc::Request_WalkInPlace_StepDetectionMode& mode) {
+		if (_ipcServerQueue) {
+			ipc::Request message(ipc::RequestType::WalkInPlace_StepDetectionMode);
+			message.msg.dm_StepDetectionMode = mode;
+			message.msg.dm_StepDetectionMode.clientId = m_clientId;
+			auto messageId = _ipcAcquireReplySlot();
+			message.msg.dm_StepDetectionMode.messageId = messageId;
+			auto resp = _ipcSendAndWaitForReply(message, messageId);
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				std::stringstream ss;
+				ss << "Error while setting step detection mode: Error code " << (int)resp.status;
+				throw vrwalkinplace_exception(ss.str());
+			}
+		}
+		else {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+	}
+
+	ipc::Reply_WalkInPlace_StepDetect VRWalkInPlace::getStepDetectionStatus() {
+		if (_ipcServerQueue) {
+			ipc::Request message(ipc::RequestType::WalkInPlace_StepDetect);
+			message.msg.dm_StepDetect.clientId = m_clientId;
+			auto messageId = _ipcAcquireReplySlot();
+			message.msg.dm_StepDetect.messageId = messageId;
+			auto resp = _ipcSendAndWaitForReply(message, messageId);
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				std::stringstream ss;
+				ss << "Error while getting step detection status: Error code " << (int)resp.status;
+				throw vrwalkinplace_exception(ss.str());
+			}
+			return resp.msg.dm_stepDetect;
 		}
 		else {
 			throw vrwalkinplace_connectionerror("No active connection.");
 		}
 	}
 
+
+	bool VRWalkInPlace::pollStepDetectionStatus(ipc::Reply_WalkInPlace_StepDetect& status) {
+		if (!_ipcServerQueue) {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+		auto now = ipc::monotonicTimeUs();
+		if (now - _stepDetectionPollUs >= IPC_STEPDETECT_POLL_INTERVAL_MS * 1000ll) {
+			_stepDetectionPollUs = now;
+			ipc::Request message(ipc::RequestType::WalkInPlace_StepDetect);
+			message.msg.dm_StepDetect.clientId = m_clientId;
+			message.msg.dm_StepDetect.messageId = _ipcAcquireReplySlot(true); // the ipc thread keeps the reply
+			ipc::FramePacket packet;
+			packet.clear(m_clientId);
+			packet.append(message);
+			// A full queue only skips this poll
+			_ipcServerQueue->try_send(&packet, packet.byteSize(), (unsigned)ipc::requestLane(message.type));
+		}
+		std::lock_guard<std::mutex> lock(_stepDetectionStatusMutex);
+		status = _stepDetectionStatus;
+		return _stepDetectionStatusValid;
+	}
+
+
+	bool VRWalkInPlace::setLocomotionBinding(uint32_t axisId, vr::EVRButtonId buttonId, LocomotionPressMode pressMode) {
+		if (_ipcServerQueue) {
+			ipc::Request message(ipc::RequestType::WalkInPlace_LocomotionBinding);
+			message.msg.wip_LocomotionBinding.axisId = axisId;
+			message.msg.wip_LocomotionBinding.buttonId = buttonId;
+			message.msg.wip_LocomotionBinding.pressMode = pressMode;
+			return _ipcSendEvent(message);
+		}
+		else {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+	}
+
+
+	bool VRWalkInPlace::sendLocomotionIntent(uint32_t deviceId, LocomotionGait gait, float speed, const vr::HmdVector2_t& direction, float rampTime) {
+		if (_ipcServerQueue) {
+			ipc::Request message(ipc::RequestType::WalkInPlace_LocomotionIntent);
+			message.msg.wip_LocomotionIntent.deviceId = deviceId;
+			message.msg.wip_LocomotionIntent.gait = gait;
+			message.msg.wip_LocomotionIntent.speed = speed;
+			message.msg.wip_LocomotionIntent.direction = direction;
+			message.msg.wip_LocomotionIntent.rampTime = rampTime;
+			return _ipcSendEvent(message);
+		}
+		else {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+	}
+
+
+	ipc::LatencyStats VRWalkInPlace::ipcReplyLatency() {
+		std::lock_guard<std::mutex> lock(_ipcReplyMutex);
+		return _ipcReplyLatency;
+	}
+
+
+	void VRWalkInPlace::beginBatch() {
+		if (_ipcServerQueue) {
+			if (!_batchActive) {
+				_batchPacket.clear(m_clientId);
+				_batchActive = true;
+			}
+		}
+		else {
+			throw vrwalkinplace_connectionerror("No active connection.");
+		}
+	}
+
+
+	void VRWalkInPlace::commit() {
+		if (_batchActive) {
+			_batchActive = false;
+			_batchFlush();
+		}
+	}
+
+
+	void VRWalkInPlace::_batchFlush() {
+		if (!_batchPacket.empty()) {
+			// reset first so that a failed send does not leave stale events behind
+			ipc::FramePacket packet = _batchPacket;
+			_batchPacket.clear(m_clientId);
+			_ipcSendPacket(packet);
+		}
+	}
+
+
+
+	void PoseTapReader::open() {
+		if (_segment) {
+			return;
+		}
+		std::unique_ptr<ipc::PoseTapSegment> segment;
+		try {
+			segment.reset(new ipc::PoseTapSegment(boost::interprocess::open_only, ipc::poseTapName));
+		}
+		catch (std::exception& e) {
+			throw vrwalkinplace_connectionerror(std::string("Could not open pose tap: ") + e.what());
+		}
+		if ((*segment)->version != IPC_POSETAP_VERSION || (*segment)->deviceCount != IPC_POSETAP_DEVICECOUNT) {
+			throw vrwalkinplace_invalidversion("Pose tap has an incompatible version");
+		}
+		for (uint32_t i = 0; i < IPC_POSETAP_DEVICECOUNT; ++i) {
+			auto writeCount = (*segment)->devices[i].writeCount.load(std::memory_order_acquire);
+			_readCount[i] = writeCount > 0 ? writeCount - 1 : 0;
+		}
+		_segment = std::move(segment);
+	}
+
+
+	void PoseTapReader::close() {
+		_segment.reset();
+	}
+
+
+	uint32_t PoseTapReader::read(uint32_t deviceId, ipc::PoseTapSample* samples, uint32_t maxCount, uint32_t* lost) {
+		if (!_segment) {
+			throw vrwalkinplace_connectionerror("Pose tap is not open.");
+		}
+		if (deviceId >= IPC_POSETAP_DEVICECOUNT) {
+			throw vrwalkinplace_invalidid("Invalid device id");
+		}
+		auto& ring = (*_segment)->devices[deviceId];
+		auto writeCount = ring.writeCount.load(std::memory_order_acquire);
+		uint32_t lostCount = 0;
+		// skip what was already overwritten and what does not fit, the newest samples are the interesting ones
+		uint32_t available = writeCount - _readCount[deviceId];
+		uint32_t skip = 0;
+		if (available > IPC_POSETAP_CAPACITY) {
+			skip = available - IPC_POSETAP_CAPACITY;
+		}
+		if (available - skip > maxCount) {
+			skip = available - maxCount;
+		}
+		_readCount[deviceId] += skip;
+		lostCount += skip;
+		uint32_t count = 0;
+		while (_readCount[deviceId] != writeCount) {
+			if (ring.read(_readCount[deviceId], samples[count])) {
+				count++;
+			}
+			else {
+				lostCount++;
+			}
+			_readCount[deviceId]++;
+		}
+		if (lost) {
+			*lost = lostCount;
+		}
+		return count;
+	}
+
+
+	bool PoseTapReader::latest(uint32_t deviceId, ipc::PoseTapSample& sample) {
+		if (!_segment) {
+			throw vrwalkinplace_connectionerror("Pose tap is not open.");
+		}
+		if (deviceId >= IPC_POSETAP_DEVICECOUNT) {
+			throw vrwalkinplace_invalidid("Invalid device id");
+		}
+		auto& ring = (*_segment)->devices[deviceId];
+		auto writeCount = ring.writeCount.load(std::memory_order_acquire);
+		return writeCount > 0 && ring.read(writeCount - 1, sample);
+	}
+
+
+	vr::ETrackedDeviceClass PoseTapReader::deviceClass(uint32_t deviceId) {
+		if (!_segment || deviceId >= IPC_POSETAP_DEVICECOUNT) {
+			return vr::TrackedDeviceClass_Invalid;
+		}
+		return (vr::ETrackedDeviceClass)(*_segment)->devices[deviceId].deviceClass.load(std::memory_order_relaxed);
+	}
+
+
+
+	void StatsReader::open() {
+		if (_segment) {
+			return;
+		}
+		std::unique_ptr<ipc::StatsSegment> segment;
+		try {
+			segment.reset(new ipc::StatsSegment(boost::interprocess::open_read_only, ipc::statsPageName));
+		}
+		catch (std::exception& e) {
+			throw vrwalkinplace_connectionerror(std::string("Could not open statistics page: ") + e.what());
+		}
+		if ((*segment)->version != IPC_STATS_VERSION || (*segment)->requestTypeCount != IPC_STATS_REQUESTTYPE_COUNT) {
+			throw vrwalkinplace_invalidversion("Statistics page has an incompatible version");
+		}
+		_segment = std::move(segment);
+	}
+
+
+	void StatsReader::close() {
+		_segment.reset();
+	}
+
+
+	void StatsReader::sample(ipc::StatsSnapshot& snapshot) {
+		if (!_segment) {
+			throw vrwalkinplace_connectionerror("Statistics page is not open.");
+		}
+		(*_segment)->snapshot(snapshot);
+	}
+
 } // end namespace vrwalkinplace
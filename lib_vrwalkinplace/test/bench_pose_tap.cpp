@@ -0,0 +1,111 @@
+#include <openvr.h>
+#include <ipc_pose_tap.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+
+
+/*
+* Cost of the pose tap writer path (PoseTapDeviceRing::write, what the driver adds to every
+* TrackedDevicePoseUpdated call) with 0 to 3 readers polling the same device ring from a second mapping,
+* and the cost of a reader's read() of one sample.
+*
+* Usage: bench_pose_tap [sampleCount]
+*/
+
+
+using namespace vrwalkinplace;
+
+
+static int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void benchWriter(ipc::PoseTapDeviceRing& writerRing, const ipc::PoseTapDeviceRing& readerRing, uint32_t count, unsigned readerCount) {
+	std::atomic<bool> done = { false };
+	std::atomic<uint64_t> readSamples = { 0 };
+	std::vector<std::thread> readers;
+	for (unsigned i = 0; i < readerCount; i++) {
+		readers.emplace_back([&]() {
+			uint32_t readCount = readerRing.writeCount.load(std::memory_order_acquire);
+			uint64_t read = 0;
+			ipc::PoseTapSample sample;
+			while (!done.load(std::memory_order_acquire)) {
+				auto writeCount = readerRing.writeCount.load(std::memory_order_acquire);
+				if (writeCount - readCount > IPC_POSETAP_CAPACITY) {
+					readCount = writeCount - IPC_POSETAP_CAPACITY;
+				}
+				for (; readCount != writeCount; readCount++) {
+					if (readerRing.read(readCount, sample)) {
+						read++;
+					}
+				}
+				std::this_thread::yield();
+			}
+			readSamples += read;
+		});
+	}
+
+	ipc::PoseTapSample sample = {};
+	sample.flags = ipc::PoseTapFlag_PoseIsValid | ipc::PoseTapFlag_DeviceIsConnected;
+	auto start = nowNs();
+	for (uint32_t i = 0; i < count; i++) {
+		sample.sampleTimeUs = i;
+		sample.position.v[1] = (double)i;
+		writerRing.write(sample);
+	}
+	auto elapsed = nowNs() - start;
+	done.store(true, std::memory_order_release);
+	for (auto& t : readers) {
+		t.join();
+	}
+	std::cout << "write, " << readerCount << " readers: " << std::fixed << std::setprecision(1) << std::setw(7)
+		<< (double)elapsed / count << " ns/sample   (" << readSamples.load() << " samples read)" << std::endl;
+}
+
+
+static void benchReader(ipc::PoseTapDeviceRing& writerRing, const ipc::PoseTapDeviceRing& readerRing, uint32_t count) {
+	ipc::PoseTapSample sample = {};
+	for (uint32_t i = 0; i < IPC_POSETAP_CAPACITY; i++) {
+		writerRing.write(sample);
+	}
+	auto writeCount = readerRing.writeCount.load(std::memory_order_acquire);
+	uint64_t read = 0;
+	auto start = nowNs();
+	for (uint32_t i = 0; i < count; i++) {
+		if (readerRing.read(writeCount - 1 - (i & (IPC_POSETAP_CAPACITY - 1)), sample)) {
+			read++;
+		}
+	}
+	auto elapsed = nowNs() - start;
+	std::cout << "read, no writer:   " << std::fixed << std::setprecision(1) << std::setw(7)
+		<< (double)elapsed / count << " ns/sample   (" << read << " samples read)" << std::endl;
+}
+
+
+int main(int argc, char* argv[]) {
+	uint32_t count = 10000000;
+	if (argc > 1) {
+		count = (uint32_t)std::stoul(argv[1]);
+	}
+	try {
+		auto name = std::string("driver_vrwalkinplace.bench_pose_tap.") + std::to_string(getpid());
+		ipc::PoseTapSegment writerSegment(boost::interprocess::create_only, name);
+		ipc::PoseTapSegment readerSegment(boost::interprocess::open_read_only, name);
+		std::cout << count << " samples, sizeof(PoseTapSample) " << sizeof(ipc::PoseTapSample) << std::endl;
+		for (unsigned readerCount = 0; readerCount <= 3; readerCount++) {
+			benchWriter(writerSegment->devices[0], readerSegment->devices[0], count, readerCount);
+		}
+		benchReader(writerSegment->devices[0], readerSegment->devices[0], count);
+	}
+	catch (std::exception& e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <openvr.h>
+#include <ipc_shm_ring.h>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+
+/*
+* One-way latency of a FramePacket holding one axis event, from the producer's send to the consumer's receive:
+* - ring/spin: ShmRing with a consumer that polls and yields (lower bound with more than one core)
+* - ring/doorbell: ShmRing with a consumer that sleeps on the doorbell semaphore like the driver's ring thread
+* - message_queue: boost::interprocess::message_queue with a blocking receive like the driver's ipc thread
+* The producer sends at a fixed interval so that sleeping consumers are asleep when a message arrives.
+*
+* Usage: bench_shm_ring [messageCount]
+*/
+
+
+using namespace vrwalkinplace;
+
+
+#define BENCH_SEND_INTERVAL_US 50
+#define BENCH_QUEUE_CAPACITY 256
+
+
+static int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string uniqueName(const char* what) {
+	return std::string("driver_vrwalkinplace.bench_shm_ring.") + what + "." + std::to_string(getpid());
+}
+
+static void makePacket(ipc::FramePacket& packet, int64_t sendTimeNs) {
+	packet.clear();
+	packet.frameCount = 1;
+	packet.size = (uint16_t)(sizeof(ipc::FrameHeader) + sizeof(ipc::Request_OpenVR_AxisEvent));
+	memcpy(packet.data, &sendTimeNs, sizeof(sendTimeNs));
+}
+
+static int64_t packetSendTime(const ipc::FramePacket& packet) {
+	int64_t sendTimeNs;
+	memcpy(&sendTimeNs, packet.data, sizeof(sendTimeNs));
+	return sendTimeNs;
+}
+
+// Calls send(sendTimeNs) count times, BENCH_SEND_INTERVAL_US apart
+template<typename F>
+static void pacedSend(uint32_t count, F send) {
+	auto next = nowNs();
+	for (uint32_t i = 0; i < count; i++) {
+		next += BENCH_SEND_INTERVAL_US * 1000;
+		while (nowNs() < next) {
+			std::this_thread::yield();
+		}
+		send(nowNs());
+	}
+}
+
+// fullCount is the number of sends that had to be retried because the consumer fell behind
+static void printLatencies(const char* name, std::vector<int64_t>& latencies, uint64_t fullCount) {
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) {
+		return latencies.empty() ? 0.0 : latencies[(size_t)(p * (latencies.size() - 1))] / 1000.0;
+	};
+	std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+		<< " p50 " << std::setw(8) << percentile(0.5) << " us"
+		<< "   p99 " << std::setw(8) << percentile(0.99) << " us"
+		<< "   max " << std::setw(9) << percentile(1.0) << " us"
+		<< "   (" << latencies.size() << " messages, full " << fullCount << " times)" << std::endl;
+}
+
+
+static void benchRing(uint32_t count, bool useDoorbell) {
+	typedef ipc::ShmRing<ipc::FramePacket, IPC_SHMRING_PACKET_CAPACITY> Ring;
+	auto segmentName = uniqueName("ring");
+	auto doorbellName = uniqueName("doorbell");
+	ipc::ShmSegment<Ring> producerSegment(boost::interprocess::create_only, segmentName);
+	ipc::ShmSegment<Ring> consumerSegment(boost::interprocess::open_only, segmentName);
+	boost::interprocess::named_semaphore::remove(doorbellName.c_str());
+	boost::interprocess::named_semaphore doorbell(boost::interprocess::create_only, doorbellName.c_str(), 0);
+
+	std::vector<int64_t> latencies;
+	latencies.reserve(count);
+	std::thread consumer([&]() {
+		auto& ring = consumerSegment.get();
+		while (latencies.size() < count) {
+			auto packet = ring.peek();
+			if (packet) {
+				auto sendTimeNs = packetSendTime(*packet);
+				ring.release();
+				latencies.push_back(nowNs() - sendTimeNs);
+			}
+			else if (!useDoorbell) {
+				std::this_thread::yield();
+			}
+			else if (ring.prepareSleep()) {
+				doorbell.wait();
+				ring.cancelSleep();
+			}
+		}
+	});
+
+	auto& ring = producerSegment.get();
+	uint64_t fullCount = 0;
+	pacedSend(count, [&](int64_t sendTimeNs) {
+		// Like the client, send the byteSize() part of the packet straight into the slot
+		ipc::FramePacket packet;
+		makePacket(packet, sendTimeNs);
+		ipc::FramePacket* slot;
+		while ((slot = ring.tryReserve()) == nullptr) {
+			fullCount++;
+			std::this_thread::yield();
+		}
+		memcpy(slot, &packet, packet.byteSize());
+		ring.publish();
+		if (useDoorbell && ring.consumerNeedsWakeup()) {
+			doorbell.post();
+		}
+	});
+	consumer.join();
+	boost::interprocess::named_semaphore::remove(doorbellName.c_str());
+	printLatencies(useDoorbell ? "ring/doorbell" : "ring/spin", latencies, fullCount);
+}
+
+
+static void benchMessageQueue(uint32_t count) {
+	auto queueName = uniqueName("queue");
+	boost::interprocess::message_queue::remove(queueName.c_str());
+	boost::interprocess::message_queue producerQueue(boost::interprocess::create_only, queueName.c_str(), BENCH_QUEUE_CAPACITY, sizeof(ipc::FramePacket));
+	boost::interprocess::message_queue consumerQueue(boost::interprocess::open_only, queueName.c_str());
+
+	std::vector<int64_t> latencies;
+	latencies.reserve(count);
+	std::thread consumer([&]() {
+		ipc::FramePacket packet;
+		boost::interprocess::message_queue::size_type receivedSize;
+		unsigned priority;
+		while (latencies.size() < count) {
+			consumerQueue.receive(&packet, sizeof(packet), receivedSize, priority);
+			latencies.push_back(nowNs() - packetSendTime(packet));
+		}
+	});
+
+	uint64_t fullCount = 0;
+	pacedSend(count, [&](int64_t sendTimeNs) {
+		ipc::FramePacket packet;
+		makePacket(packet, sendTimeNs);
+		while (!producerQueue.try_send(&packet, packet.byteSize(), 0)) {
+			fullCount++;
+		}
+	});
+	consumer.join();
+	boost::interprocess::message_queue::remove(queueName.c_str());
+	printLatencies("message_queue", latencies, fullCount);
+}
+
+
+int main(int argc, char* argv[]) {
+	uint32_t count = 100000;
+	if (argc > 1) {
+		count = (uint32_t)std::stoul(argv[1]);
+	}
+	try {
+		std::cout << count << " packets, one every " << BENCH_SEND_INTERVAL_US << " us" << std::endl;
+		benchRing(count, false);
+		benchRing(count, true);
+		benchMessageQueue(count);
+	}
+	catch (std::exception& e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include <openvr.h>
+#include <ipc_pose_tap.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+
+/*
+* Concurrent reader/writer test of the pose tap seqlock.
+*
+* One writer thread reports samples as fast as it can, every field of sample n is derived from n. Reader threads
+* on a second mapping follow the ring like PoseTapReader::read() (one in step, one that falls behind and gets
+* lapped, one that only looks at the newest sample like PoseTapReader::latest()). Every sample that read()
+* accepts must be exactly sample n, a mismatch is a torn read. The write counter starts right before the
+* slot sequence numbers (2n + 2) wrap around.
+*/
+
+
+using namespace vrwalkinplace;
+
+
+#define TEST_SAMPLE_COUNT 4000000u
+#define TEST_START_COUNT (0x80000000u - TEST_SAMPLE_COUNT / 2)
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+static void fillSample(ipc::PoseTapSample& sample, uint32_t n) {
+	double v = (double)n;
+	sample.sampleTimeUs = (int64_t)n * 11;
+	sample.poseTimeOffset = v * 0.5;
+	sample.position = { { v, v + 1.0, v + 2.0 } };
+	sample.velocity = { { -v, -v - 1.0, -v - 2.0 } };
+	sample.rotation = { v + 3.0, v + 4.0, v + 5.0, v + 6.0 };
+	sample.flags = n;
+}
+
+static bool checkSample(const ipc::PoseTapSample& sample, uint32_t n) {
+	ipc::PoseTapSample expected;
+	fillSample(expected, n);
+	return sample.sampleTimeUs == expected.sampleTimeUs
+		&& sample.poseTimeOffset == expected.poseTimeOffset
+		&& memcmp(&sample.position, &expected.position, sizeof(sample.position)) == 0
+		&& memcmp(&sample.velocity, &expected.velocity, sizeof(sample.velocity)) == 0
+		&& memcmp(&sample.rotation, &expected.rotation, sizeof(sample.rotation)) == 0
+		&& sample.flags == expected.flags;
+}
+
+
+struct ReaderResult {
+	uint64_t read = 0;
+	uint64_t lost = 0;
+	uint64_t torn = 0;
+};
+
+enum class ReaderMode {
+	InStep, // reads everything, like PoseTapReader::read()
+	Lagging, // sleeps now and then and gets lapped by the writer
+	Latest // only the newest sample, like PoseTapReader::latest()
+};
+
+static void readerFunc(const ipc::PoseTapDeviceRing& ring, ReaderMode mode, const std::atomic<bool>& done, ReaderResult& result) {
+	uint32_t readCount = ring.writeCount.load(std::memory_order_acquire);
+	ipc::PoseTapSample sample;
+	uint64_t polls = 0;
+	while (!done.load(std::memory_order_acquire)) {
+		auto writeCount = ring.writeCount.load(std::memory_order_acquire);
+		if (mode == ReaderMode::Latest) {
+			if (writeCount != TEST_START_COUNT) {
+				if (ring.read(writeCount - 1, sample)) {
+					result.read++;
+					if (!checkSample(sample, writeCount - 1)) {
+						result.torn++;
+					}
+				}
+				else {
+					result.lost++;
+				}
+			}
+			continue;
+		}
+		if (writeCount - readCount > IPC_POSETAP_CAPACITY) {
+			result.lost += writeCount - readCount - IPC_POSETAP_CAPACITY;
+			readCount = writeCount - IPC_POSETAP_CAPACITY;
+		}
+		while (readCount != writeCount) {
+			if (ring.read(readCount, sample)) {
+				result.read++;
+				if (!checkSample(sample, readCount)) {
+					result.torn++;
+				}
+			}
+			else {
+				result.lost++;
+			}
+			readCount++;
+		}
+		if (mode == ReaderMode::Lagging && (++polls & 0xFF) == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+int main() {
+	try {
+		auto name = std::string("driver_vrwalkinplace.test_pose_tap.") + std::to_string(getpid());
+		ipc::PoseTapSegment writerSegment(boost::interprocess::create_only, name);
+		ipc::PoseTapSegment readerSegment(boost::interprocess::open_read_only, name);
+		auto& writerRing = writerSegment->devices[0];
+		const auto& readerRing = readerSegment->devices[0];
+		writerRing.writeCount.store(TEST_START_COUNT, std::memory_order_release);
+
+		std::atomic<bool> done = { false };
+		const char* modeNames[] = { "in step", "lagging", "latest" };
+		ReaderMode modes[] = { ReaderMode::InStep, ReaderMode::Lagging, ReaderMode::Latest };
+		ReaderResult results[3];
+		std::vector<std::thread> readers;
+		for (unsigned i = 0; i < 3; i++) {
+			readers.emplace_back(readerFunc, std::cref(readerRing), modes[i], std::cref(done), std::ref(results[i]));
+		}
+
+		ipc::PoseTapSample sample;
+		for (uint32_t i = 0; i < TEST_SAMPLE_COUNT; i++) {
+			auto n = TEST_START_COUNT + i;
+			fillSample(sample, n);
+			writerRing.write(sample);
+			if ((i & 0xFFF) == 0) {
+				std::this_thread::yield();
+			}
+		}
+		done.store(true, std::memory_order_release);
+		for (auto& t : readers) {
+			t.join();
+		}
+
+		CHECK(readerRing.writeCount.load() == TEST_START_COUNT + TEST_SAMPLE_COUNT, "write count did not advance by the sample count");
+		uint32_t last = TEST_START_COUNT + TEST_SAMPLE_COUNT - 1;
+		CHECK(readerRing.read(last, sample) && checkSample(sample, last), "newest sample after the run");
+		CHECK(!readerRing.read(last - IPC_POSETAP_CAPACITY, sample), "overwritten sample was accepted");
+		for (unsigned i = 0; i < 3; i++) {
+			std::cout << modeNames[i] << " reader: " << results[i].read << " samples read, " << results[i].lost << " lost, "
+				<< results[i].torn << " torn" << std::endl;
+			CHECK(results[i].torn == 0, modeNames[i] << " reader saw torn samples");
+			CHECK(results[i].read > 0, modeNames[i] << " reader did not read anything");
+		}
+		CHECK(results[1].lost > 0, "lagging reader was never lapped by the writer");
+	}
+	catch (std::exception& e) {
+		std::cerr << "FAILED: exception " << e.what() << std::endl;
+		failures++;
+	}
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,248 @@
+#include <openvr.h>
+#include <ipc_shm_ring.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+
+/*
+* Two-thread producer/consumer stress test of ShmRing, mapped twice like the client and the driver do.
+*
+* Every message carries a sequence number and a checksum of it, the consumer checks that it sees every message
+* exactly once, in order and untorn. Runs start at 0 and right before the 32 bit head/tail wrap around, the consumer
+* stalls now and then so the producer runs into a full ring, and one run parks the consumer on a doorbell semaphore
+* the way the driver's ring thread does (prepareSleep/consumerNeedsWakeup).
+*/
+
+
+using namespace vrwalkinplace;
+
+
+#define TEST_RING_CAPACITY 64
+#define TEST_MESSAGE_COUNT 2000000u
+#define TEST_WAKEUP_TIMEOUT_MS 1000
+
+
+struct TestMessage {
+	uint64_t sequence;
+	uint64_t check;
+	uint8_t padding[48];
+};
+
+typedef ipc::ShmRing<TestMessage, TEST_RING_CAPACITY> TestRing;
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, msg) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << "FAILED: " << msg << " (" << #cond << ", line " << __LINE__ << ")" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+
+static uint64_t messageCheck(uint64_t sequence) {
+	return sequence * 0x9E3779B97F4A7C15ull ^ 0xA5A5A5A5A5A5A5A5ull;
+}
+
+static void fillMessage(TestMessage& message, uint64_t sequence) {
+	message.sequence = sequence;
+	message.check = messageCheck(sequence);
+	memset(message.padding, (int)(sequence & 0xFF), sizeof(message.padding));
+}
+
+// Returns false when the message is torn or out of order
+static bool checkMessage(const TestMessage& message, uint64_t expectedSequence) {
+	if (message.sequence != expectedSequence || message.check != messageCheck(expectedSequence)) {
+		return false;
+	}
+	for (auto b : message.padding) {
+		if (b != (uint8_t)(expectedSequence & 0xFF)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static std::string uniqueName(const char* what) {
+	return std::string("driver_vrwalkinplace.test_shm_ring.") + what + "." + std::to_string(getpid());
+}
+
+
+static void testFullRing() {
+	ipc::ShmSegment<TestRing> segment(boost::interprocess::create_only, uniqueName("full"));
+	auto& ring = segment.get();
+	TestMessage message;
+	for (uint64_t i = 0; i < TEST_RING_CAPACITY; i++) {
+		fillMessage(message, i);
+		CHECK(ring.tryPush(message), "push " << i << " into a non-full ring");
+	}
+	CHECK(ring.size() == TEST_RING_CAPACITY, "size of a full ring is " << ring.size());
+	fillMessage(message, TEST_RING_CAPACITY);
+	CHECK(!ring.tryPush(message), "push into a full ring");
+	CHECK(ring.tryReserve() == nullptr, "reserve in a full ring");
+
+	CHECK(ring.tryPop(message) && checkMessage(message, 0), "pop from a full ring");
+	auto slot = ring.tryReserve();
+	CHECK(slot != nullptr, "reserve after a pop");
+	if (slot) {
+		fillMessage(*slot, TEST_RING_CAPACITY);
+		ring.publish();
+	}
+	CHECK(ring.tryReserve() == nullptr, "reserve in a full ring again");
+	for (uint64_t i = 1; i <= TEST_RING_CAPACITY; i++) {
+		auto m = ring.peek();
+		CHECK(m != nullptr && checkMessage(*m, i), "peek " << i);
+		ring.release();
+	}
+	CHECK(ring.peek() == nullptr && !ring.tryPop(message), "pop from an empty ring");
+	CHECK(ring.size() == 0, "size of an empty ring is " << ring.size());
+}
+
+
+/**
+* Producer and consumer work on separate mappings of one segment. The producer alternates between tryPush and
+* tryReserve/publish, the consumer between tryPop and peek/release and stalls every stallInterval messages.
+* With useDoorbell the consumer sleeps on a semaphore instead of spinning when the ring is empty.
+*/
+static void testProducerConsumer(const char* name, uint32_t startIndex, uint32_t stallInterval, bool useDoorbell) {
+	auto segmentName = uniqueName(name);
+	auto doorbellName = uniqueName("doorbell");
+	ipc::ShmSegment<TestRing> producerSegment(boost::interprocess::create_only, segmentName);
+	ipc::ShmSegment<TestRing> consumerSegment(boost::interprocess::open_only, segmentName);
+	producerSegment->head.store(startIndex);
+	producerSegment->tail.store(startIndex);
+	boost::interprocess::named_semaphore::remove(doorbellName.c_str());
+	boost::interprocess::named_semaphore doorbell(boost::interprocess::create_only, doorbellName.c_str(), 0);
+
+	uint64_t fullCount = 0;
+	std::thread producer([&]() {
+		auto& ring = producerSegment.get();
+		std::mt19937 rng(1);
+		for (uint64_t i = 0; i < TEST_MESSAGE_COUNT; i++) {
+			while (true) {
+				bool pushed;
+				if (i & 1) {
+					auto slot = ring.tryReserve();
+					pushed = slot != nullptr;
+					if (pushed) {
+						fillMessage(*slot, i);
+						ring.publish();
+					}
+				}
+				else {
+					TestMessage message;
+					fillMessage(message, i);
+					pushed = ring.tryPush(message);
+				}
+				if (useDoorbell && ring.consumerNeedsWakeup()) {
+					doorbell.post();
+				}
+				if (pushed) {
+					break;
+				}
+				fullCount++;
+				std::this_thread::yield();
+			}
+			// Give the consumer a chance to run dry and go to sleep
+			if (useDoorbell && (rng() & 0x3FF) == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(rng() & 0xFF));
+			}
+		}
+	});
+
+	auto& ring = consumerSegment.get();
+	uint64_t expected = 0;
+	uint64_t sleepCount = 0;
+	uint64_t lostWakeups = 0;
+	bool ordered = true;
+	auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (expected < TEST_MESSAGE_COUNT && ordered && std::chrono::steady_clock::now() < timeout) {
+		bool popped;
+		if (expected & 1) {
+			auto m = ring.peek();
+			popped = m != nullptr;
+			if (popped) {
+				ordered = checkMessage(*m, expected);
+				ring.release();
+			}
+		}
+		else {
+			TestMessage message;
+			popped = ring.tryPop(message);
+			if (popped) {
+				ordered = checkMessage(message, expected);
+			}
+		}
+		if (popped) {
+			expected++;
+			if (stallInterval && expected % stallInterval == 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		else if (useDoorbell) {
+			if (ring.prepareSleep()) {
+				sleepCount++;
+				auto woken = doorbell.timed_wait(boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(TEST_WAKEUP_TIMEOUT_MS));
+				ring.cancelSleep();
+				if (!woken && ring.size() > 0) {
+					lostWakeups++;
+				}
+			}
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	// Drain after a failure so that the producer can finish
+	TestMessage message;
+	for (auto drained = expected; drained < TEST_MESSAGE_COUNT; ) {
+		if (ring.tryPop(message)) {
+			drained++;
+		}
+	}
+	producer.join();
+	boost::interprocess::named_semaphore::remove(doorbellName.c_str());
+
+	CHECK(ordered, name << ": message " << expected - 1 << " is torn or out of order");
+	CHECK(expected == TEST_MESSAGE_COUNT, name << ": received " << expected << " of " << TEST_MESSAGE_COUNT << " messages");
+	CHECK(ring.size() == 0, name << ": ring not empty after the run");
+	CHECK(producerSegment->tail.load() == (uint32_t)(startIndex + TEST_MESSAGE_COUNT), name << ": tail did not advance by the message count");
+	if (stallInterval) {
+		CHECK(fullCount > 0, name << ": producer never saw a full ring");
+	}
+	if (useDoorbell) {
+		CHECK(sleepCount > 0, name << ": consumer never went to sleep");
+		CHECK(lostWakeups == 0, name << ": " << lostWakeups << " lost wakeups");
+	}
+	std::cout << name << ": " << expected << " messages, producer saw a full ring " << fullCount << " times";
+	if (useDoorbell) {
+		std::cout << ", consumer slept " << sleepCount << " times";
+	}
+	std::cout << std::endl;
+}
+
+
+int main() {
+	try {
+		testFullRing();
+		testProducerConsumer("spin", 0, 0, false);
+		testProducerConsumer("wraparound", 0xFFFFFFFFu - TEST_MESSAGE_COUNT / 2, 0, false);
+		testProducerConsumer("full", 0xFFFFFFFFu - TEST_RING_CAPACITY / 2, 16 * 1024, false);
+		testProducerConsumer("doorbell", 0xFFFFFFFFu - TEST_MESSAGE_COUNT / 2, 0, true);
+	}
+	catch (std::exception& e) {
+		std::cerr << "FAILED: exception " << e.what() << std::endl;
+		failures++;
+	}
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
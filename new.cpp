@@ -0,0 +1,5 @@
+#include <openvr_driver.h>
+#include <ipc_protocol.h>
+#include <ipc_frame.h>
+#include <cstdio>
+int main(){printf("new Request %zu Reply %zu SDM %zu\n", sizeof(vrwalkinplace::ipc::Request), sizeof(vrwalkinplace::ipc::Reply), sizeof(vrwalkinplace::ipc::Request_WalkInPlace_StepDetectionMode));}